@@ -1382,6 +1382,18 @@ gchar *bf_portable_time(const time_t *timep) {
 	return retstr;
 }
 
+/* the number of processors that are online, used to size pools of worker threads */
+guint get_num_processors(void) {
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	return g_get_num_processors();
+#elif defined(_SC_NPROCESSORS_ONLN)
+	glong num = sysconf(_SC_NPROCESSORS_ONLN);
+	return (num > 0) ? num : 1;
+#else
+	return 1;
+#endif
+}
+
 /* these hash functions hash the first 3 strings in a gchar ** */
 gboolean arr3_equal (gconstpointer v1,gconstpointer v2)
 {
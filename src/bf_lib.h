@@ -119,6 +119,7 @@ void wordcount(gchar *text, guint *chars, guint *lines, guint *words);
 /*GSList *gslist_from_glist_reversed(GList *src);*/
 GList *glist_from_gslist(GSList *src);
 gchar *bf_portable_time(const time_t *timep);
+guint get_num_processors(void);
 
 gboolean arr3_equal (gconstpointer v1,gconstpointer v2);
 guint arr3_hash(gconstpointer v);
@@ -33,6 +33,9 @@
 #include "doc_text_tools.h"
 #include "bfwin.h"
 #include "bftextview2_scanner.h"
+#include "bftextview2_scheduler.h"
+#include "bftextview2_foundcache.h"
+#include "bftextview2_arena.h"
 #include "bftextview2_patcompile.h"
 #include "bftextview2_autocomp.h"
 #include "bftextview2_langmgr.h"
@@ -41,6 +44,7 @@
 #endif
 #ifdef MARKREGION
 #include "bftextview2_markregion.h"
+#include "bftextview2_sccache.h"
 #endif
 
 /*#undef DEBUG_MSG
@@ -83,7 +87,11 @@ gboolean character_is_symbol(Tscantable *st,guint16 context, gunichar uc) {
 	if (context > st->contexts->len) {
 		return FALSE;
 	}
-	return (g_array_index((GArray *)g_array_index(st->contexts, Tcontext, context).table, Ttablerow, 1).row[uc] != 1);
+	if (get_context(st, context)->dfa) {
+		return (dfa_next_state(get_context(st, context), 1, uc) != 1);
+	}
+	/* the context is still being compiled */
+	return (uc >= NUMSCANCHARS || get_tablerow(st, context, 1).row[uc] != 1);
 }
 
 static inline gboolean
@@ -201,15 +209,54 @@ bftextview2_reset_user_idle_timer(BluefishTextView * btv)
 }
 
 static void bftextview2_set_margin_size(BluefishTextView * btv);
-static gboolean bftextview2_scanner_idle(gpointer data);
 
+/* the lines that are visible in view, returns FALSE if view is not shown */
+static gboolean
+bftextview2_get_visible_window(GtkWidget * view, GtkTextIter * vstart, GtkTextIter * vend)
+{
+	GdkRectangle rect;
+
+	if (!view || !gtk_widget_get_mapped(view))
+		return FALSE;
+	gtk_text_view_get_visible_rect(GTK_TEXT_VIEW(view), &rect);
+	gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(view), vstart, rect.y, NULL);
+	gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(view), vend, rect.y + rect.height, NULL);
+	gtk_text_iter_forward_line(vend);
+	return TRUE;
+}
+
+/* scan the window that is visible in view ahead of the regular scanning, if the regular scanning
+is still far away from it. master is the view that owns the scancache */
+static gboolean
+bftextview2_scan_visible_window(BluefishTextView * master, GtkWidget * view)
+{
+	GtkTextIter vstart, vend;
+
+	if (!bftextview2_get_visible_window(view, &vstart, &vend))
+		return FALSE;
+	return bftextview2_scan_viewport(master, &vstart, &vend);
+}
+
+/* the scanning in large-file mode: highlight the windows that are visible in master and slave,
+and extend the checkpoints. Returns TRUE if there is more to do */
 static gboolean
-bftextview2_scanner_scan(BluefishTextView * btv, gboolean in_idle)
+bftextview2_largefile_scan(BluefishTextView * master)
+{
+	GtkTextIter vstart, vend;
+
+	if (bftextview2_get_visible_window(GTK_WIDGET(master), &vstart, &vend))
+		largefile_highlight_window(master, &vstart, &vend);
+	if (bftextview2_get_visible_window(master->slave, &vstart, &vend))
+		largefile_highlight_window(master, &vstart, &vend);
+	return largefile_extend_checkpoints(master);
+}
+
+/* one scanning and spellchecking run for master, called by the scheduler (bftextview2_scheduler.c)
+returns TRUE if there is more work to do */
+gboolean
+bftextview2_scanner_scan(BluefishTextView * btv)
 {
 	if (!btv->bflang) {
-		btv->scanner_idle = 0;
-		btv->scanner_immediate = 0;
-		btv->scanner_delayed = 0;
 		DBG_MSG("bftextview2_scanner_scan, no bflang, return FALSE\n");
 		return FALSE;
 	}
@@ -219,97 +266,54 @@ bftextview2_scanner_scan(BluefishTextView * btv, gboolean in_idle)
 #endif
 		) {
 		DBG_MSG("bftextview2_scanner_scan, no scantable or no spellcheck, return FALSE\n");
-		btv->scanner_idle = 0;
-		btv->scanner_immediate = 0;
-		btv->scanner_delayed = 0;
 		return FALSE;
 	}
 	DBG_DELAYSCANNING("bftextview2_scanner_scan, start scanning\n");
-	{
-		DBG_DELAYSCANNING
-			("bftextview2_scanner_idle, running scanner idle function, scanner_idle=%d, scanner_immediate=%d\n",
-			 btv->scanner_idle, btv->scanner_immediate);
-		if (!(btv->enable_scanner && bftextview2_run_scanner(btv, NULL))
+	if (btv->enable_scanner && btv->bflang->st && !btv->sccache_checked) {
+		/* only once for every language: a document that is large enough is scanned in large-file
+		   mode, otherwise we try the persisted scancache. A rescan should really scan */
+		btv->sccache_checked = TRUE;
+		if (!largefile_start(btv))
+			sccache_restore(btv);
+	}
+	if (btv->enable_scanner && !btv->largefile && !bftextview2_scan_visible_window(btv, GTK_WIDGET(btv))) {
+		bftextview2_scan_visible_window(btv, btv->slave);
+	}
+	if (!(btv->enable_scanner
+		  && (btv->largefile ? bftextview2_largefile_scan(btv) : bftextview2_run_scanner(btv, NULL)))
 #ifdef HAVE_LIBENCHANT
-			&& !bftextview2_run_spellcheck(btv)
+		&& !bftextview2_run_spellcheck(btv)
 #endif
-			) {
-			btv->scanner_idle = 0;
-			btv->scanner_immediate = 0;
-			DBG_DELAYSCANNING("bftextview2_scanner_idle, stopping scanner idle function\n");
-			bftextview2_set_margin_size(btv);
-			return FALSE;
-		} else if (btv->scanner_immediate) {
-			DBG_DELAYSCANNING
-				("bftextview2_scanner_idle, stop immediate priority callback, start idle priority callback, priority=%d\n",
-				 SCANNING_IDLE_AFTER_TIMEOUT_PRIORITY);
-			btv->scanner_immediate = 0;
-			btv->scanner_idle =
-				g_idle_add_full(SCANNING_IDLE_AFTER_TIMEOUT_PRIORITY, bftextview2_scanner_idle, btv, NULL);
-			DBG_DELAYSCANNING("bftextview2_scanner_idle, idle priority callback at %d\n", btv->scanner_idle);
-			return FALSE;
-		}
+		) {
+		DBG_DELAYSCANNING("bftextview2_scanner_scan, nothing left to do\n");
+		bftextview2_set_margin_size(btv);
+		return FALSE;
 	}
 	DBG_DELAYSCANNING("bftextview2_scanner_scan, end of function, return TRUE\n");
 	return TRUE;				/* call me again */
 }
 
-static gboolean
-bftextview2_scanner_idle(gpointer data)
-{
-	BluefishTextView *btv = data;
-#ifdef DEBUG_SIGNALS
-	if (btv->scanner_immediate) {
-		g_print("bftextview2_scanner_idle, immediate, priority=%d\n",SCANNING_IDLE_PRIORITY);
-	} else {
-		g_print("bftextview2_scanner_idle, idle, priority=%d\n",SCANNING_IDLE_AFTER_TIMEOUT_PRIORITY);
-	}
-#endif
-	DBG_DELAYSCANNING("bftextview2_scanner_idle callback started\n");
-	if (!btv->enable_scanner
-#ifdef HAVE_LIBENCHANT
-			&& !btv->spell_check
-#endif
-			) {
-		btv->scanner_idle = 0;
-		btv->scanner_immediate = 0;
-		return FALSE;
-	}
-	return bftextview2_scanner_scan(btv, TRUE);
-}
-
 void
 bftextview2_schedule_scanning(BluefishTextView * btv)
 {
-	DBG_MSG("bftextview2_schedule_scanning, enable=%d, spell_check=%d, bflang=%p,scanner_idle=%d,scanner_immediate=%d\n",
-			BLUEFISH_TEXT_VIEW(btv->master)->enable_scanner,
+	BluefishTextView *master = BLUEFISH_TEXT_VIEW(btv->master);
+	DBG_MSG("bftextview2_schedule_scanning, enable=%d, spell_check=%d, bflang=%p, queued=%d\n",
+			master->enable_scanner,
 #ifdef HAVE_LIBENCHANT
-			BLUEFISH_TEXT_VIEW(btv->master)->spell_check,
+			master->spell_check,
 #else
-			0
+			0,
 #endif
-			BLUEFISH_TEXT_VIEW(btv->master)->bflang,
-			BLUEFISH_TEXT_VIEW(btv->master)->scanner_idle,
-			BLUEFISH_TEXT_VIEW(btv->master)->scanner_immediate);
-	if (BLUEFISH_TEXT_VIEW(btv->master)->scanner_idle) {
-		DBG_MSG("bftextview2_schedule_scanning, remove scanning_idle callback\n");
-		g_source_remove(BLUEFISH_TEXT_VIEW(btv->master)->scanner_idle);
-		BLUEFISH_TEXT_VIEW(btv->master)->scanner_idle = 0;
-	}
-
-	if ((BLUEFISH_TEXT_VIEW(btv->master)->enable_scanner
+			master->bflang, bftextview2_scheduler_is_queued(master));
+	if ((master->enable_scanner
 #ifdef HAVE_LIBENCHANT
-	 || BLUEFISH_TEXT_VIEW(btv->master)->spell_check
+		 || master->spell_check
 #endif
-	 )
-		&& BLUEFISH_TEXT_VIEW(btv->master)->bflang
-		&& BLUEFISH_TEXT_VIEW(btv->master)->scanner_idle == 0
-		&& BLUEFISH_TEXT_VIEW(btv->master)->scanner_immediate == 0) {
-		DBG_DELAYSCANNING("scheduling scanning in idle function with priority %d\n", SCANNING_IDLE_PRIORITY);
-		BLUEFISH_TEXT_VIEW(btv->master)->scanner_immediate =
-			g_idle_add_full(SCANNING_IDLE_PRIORITY, bftextview2_scanner_idle, btv->master, NULL);
+		)
+		&& master->bflang) {
+		DBG_DELAYSCANNING("scheduling scanning with priority %d\n", SCANNING_IDLE_PRIORITY);
+		bftextview2_scheduler_add(master, TRUE);
 	}
-	DBG_DELAYSCANNING("bftextview2_schedule_scanning, scanner_immediate=%d\n", BLUEFISH_TEXT_VIEW(btv->master)->scanner_immediate);
 }
 
 static void
@@ -327,9 +331,8 @@ bftextview2_get_iters_at_foundblock(GtkTextBuffer * buffer, Tfoundblock * fblock
 static inline Tfoundblock *
 bftextview2_get_block_at_offset(BluefishTextView * btv, Tfound **found, guint offset)
 {
-	GSequenceIter *siter;
 	Tfound *rfound;
-	rfound = get_foundcache_at_offset(btv, offset, &siter);
+	rfound = get_foundcache_at_offset(btv, offset);
 	*found = rfound;
 	while (rfound) {
 		DBG_BLOCKMATCH("bftextview2_get_block_at_offset, found %p at offset %d with blockchange %d contextchange %d\n", rfound, rfound->charoffset_o, rfound->numblockchange, rfound->numcontextchange);
@@ -340,7 +343,7 @@ bftextview2_get_block_at_offset(BluefishTextView * btv, Tfound **found, guint of
 		} else if ((rfound)->numblockchange < 0) {
 			/ * TODO: if multiple blocks are popped, usually the last popped one if the one that matches thje end-of-block-tag
 			so that block should be returned * /
-			Tfoundblock *tmpfblock = pop_blocks((rfound)->numblockchange+1, (rfound)->fblock);
+			Tfoundblock *tmpfblock = pop_blocks(btv, (rfound)->numblockchange+1, (rfound)->fblock);
 			DBG_BLOCKMATCH("bftextview2_get_block_at_offset, found->fblock=%p, tmpfblock=%p\n",rfound->fblock,tmpfblock);
 			if (tmpfblock && (tmpfblock->start2_o == offset || tmpfblock->end2_o == offset)) {
 				*found = rfound;
@@ -350,16 +353,17 @@ bftextview2_get_block_at_offset(BluefishTextView * btv, Tfound **found, guint of
 		if ((rfound)->charoffset_o > offset)
 			break;
 		*found = rfound;
-		rfound = get_foundcache_next(btv, &siter);
+		rfound = get_foundcache_next(btv, rfound);
 	}
 	return NULL;
 }*/
 
+/* btv should be the master, it owns the scancache */
 static Tfoundblock *
-first_fully_defined_block(Tfoundblock * fblock)
+first_fully_defined_block(BluefishTextView * btv, Tfoundblock * fblock)
 {
 	while (fblock && fblock->start2_o == BF_OFFSET_UNDEFINED) {
-		fblock = fblock->parentfblock;
+		fblock = fblock_parent(btv, fblock);
 	}
 	return fblock;
 }
@@ -370,38 +374,37 @@ we might return a block if we are within the startmatch or within the end match
 static Tfoundblock *
 bftextview2_get_active_block_at_offset(BluefishTextView * btv, gboolean innerblock, guint offset)
 {
-	GSequenceIter *siter;
 	Tfound *found1, *found2;
 	Tfoundblock *fblock;
-	found1 = get_foundcache_at_offset(btv, offset, &siter);
+	found1 = get_foundcache_at_offset(btv, offset);
 	if (!found1)
 		return NULL;
 	DEBUG_MSG("offset=%d, got found1 %p with offset %d and found1->fblock %p\n", offset, found1,
-			  found1->charoffset_o, found1->fblock);
+			  found1->charoffset_o, found_fblock(btv, found1));
 	if (innerblock) {
 		if (!found1->fblock) {
 			DEBUG_MSG
 				("bftextview2_get_active_block_at_offset, found1 does not have an fblock, return NULL\n");
 			return NULL;
 		}
-		fblock = first_fully_defined_block(found1->fblock);
+		fblock = first_fully_defined_block(btv, found_fblock(btv, found1));
 		/* when innerblock is requested we have to check for the situation that we are in the middle of the end-of-block-match
 		   because it means that we are outside the innerblock already, and thus we need the parent */
 		if (fblock && found1->numblockchange < 0 && fblock->start2_o < offset) {
 			DEBUG_MSG("bftextview2_get_active_block_at_offset, in end-of-block match, return parent\n");
-			return fblock->parentfblock;
+			return fblock_parent(btv, fblock);
 		}
 	} else {
 		/* when outerblock is requested we have to check if we are in the middle of a new start-of-block
 		   which is stored in the next Tfound in the scancache */
-		found2 = get_foundcache_next(btv, &siter);
-		if (found2 && found2->numblockchange > 0 && found2->fblock->start1_o <= offset
-			&& found2->fblock->start2_o != BF_OFFSET_UNDEFINED) {
-			return found2->fblock;
+		found2 = get_foundcache_next(btv, found1);
+		if (found2 && found2->numblockchange > 0 && found_fblock(btv, found2)->start1_o <= offset
+			&& found_fblock(btv, found2)->start2_o != BF_OFFSET_UNDEFINED) {
+			return found_fblock(btv, found2);
 		}
 	}
 	if (found1->numblockchange < 0) {
-		fblock = first_fully_defined_block(found1->fblock);
+		fblock = first_fully_defined_block(btv, found_fblock(btv, found1));
 		if (!fblock)
 			return NULL;
 		/* if outerblock is requested, we have to check for the situation that we are exactly at the end-of-block
@@ -410,10 +413,10 @@ bftextview2_get_active_block_at_offset(BluefishTextView * btv, gboolean innerblo
 			return fblock;
 		}
 		DEBUG_MSG("return %d blocks popped from found1\n", found1->numblockchange);
-		return pop_blocks(found1->numblockchange, found1->fblock);
+		return pop_blocks(btv, found1->numblockchange, found_fblock(btv, found1));
 	}
 	DEBUG_MSG("return found1->fblock\n");
-	return first_fully_defined_block(found1->fblock);
+	return first_fully_defined_block(btv, found_fblock(btv, found1));
 }
 
 gboolean
@@ -426,7 +429,7 @@ bluefish_text_view_get_active_block_boundaries(BluefishTextView * btv, guint loc
 		return FALSE;
 	DEBUG_MSG("bluefish_text_view_get_active_block_boundaries, got block %p %d:%d-%d:%d\n",
 			  fblock, fblock->start1_o, fblock->end1_o, fblock->start2_o, fblock->end2_o);
-	fblock = first_fully_defined_block(fblock);
+	fblock = first_fully_defined_block(btv, fblock);
 	if (!fblock)
 		return FALSE;
 	DEBUG_MSG("bluefish_text_view_get_active_block_boundaries, got fully defined block %p %d:%d-%d:%d\n",
@@ -453,7 +456,7 @@ blockstack_string(BluefishTextView * btv, Tfoundblock * fblock)
 			if (parent != fblock)
 				tmp = g_string_prepend(tmp, " ");
 			if (g_array_index
-				(BLUEFISH_TEXT_VIEW(btv->master)->bflang->st->matches, Tpattern,
+				(BLUEFISH_TEXT_VIEW(btv->master)->bflang->st->matchinfo, Tpattern_cold,
 				 parent->patternum).is_regex) {
 				GtkTextIter it1, it2;
 				gchar *tmp2;
@@ -465,11 +468,11 @@ blockstack_string(BluefishTextView * btv, Tfoundblock * fblock)
 			} else {
 				tmp =
 					g_string_prepend(tmp,
-									 g_array_index(BLUEFISH_TEXT_VIEW(btv->master)->bflang->st->matches,
-												   Tpattern, parent->patternum).pattern);
+									 g_array_index(BLUEFISH_TEXT_VIEW(btv->master)->bflang->st->matchinfo,
+												   Tpattern_cold, parent->patternum).pattern);
 			}
 		}
-		parent = parent->parentfblock;
+		parent = fblock_parent(BLUEFISH_TEXT_VIEW(btv->master), parent);
 	}
 	return g_string_free(tmp, FALSE);
 }
@@ -484,7 +487,7 @@ bftextview2_get_block_at_boundary_location(BluefishTextView *btv, guint offset,
 
 	fblock = bftextview2_get_active_block_at_offset(btv->master, FALSE, offset);
 	if (fblock)
-		fblock = first_fully_defined_block(fblock);
+		fblock = first_fully_defined_block(btv->master, fblock);
 	if (fblock) {
 		if (fblock->start2_o != BF_OFFSET_UNDEFINED && (fblock->start1_o == offset || fblock->end1_o == offset || fblock->start2_o == offset
 			|| fblock->end2_o == offset)) {
@@ -518,7 +521,7 @@ mark_set_idle_lcb(gpointer widget)
 	DBG_BLOCKMATCH("mark_set_idle_lcb, got fblock %p\n", fblock);
 	DBG_SIGNALS("mark_set_idle_lcb, 'insert' set at %d\n", gtk_text_iter_get_offset(&location));
 	if (fblock)
-		fblock = first_fully_defined_block(fblock);
+		fblock = first_fully_defined_block(master, fblock);
 	if (fblock) {
 		if (fblock->start1_o == offset || fblock->end1_o == offset || fblock->start2_o == offset
 			|| fblock->end2_o == offset) {
@@ -547,7 +550,7 @@ mark_set_idle_lcb(gpointer widget)
 	}							/*else if (found && found->fblock && BFWIN(DOCUMENT(btv->doc)->bfwin)->session->view_blockstack) {
 								   fblock = found->fblock;
 								   if (found->numblockchange < 0) {
-								   fblock = pop_blocks(found->numblockchange, fblock);
+								   fblock = pop_blocks(master, found->numblockchange, fblock);
 								   }
 								   tmpstr = blockstack_string(btv, fblock);
 								   } */
@@ -615,7 +618,7 @@ bftextview2_set_margin_size(BluefishTextView * btv)
 		BLUEFISH_TEXT_VIEW(btv->master)->margin_pixels_chars = 0;
 	}
 	if (BLUEFISH_TEXT_VIEW(btv->master)->show_blocks
-		&& g_sequence_get_length(BLUEFISH_TEXT_VIEW(btv->master)->scancache.foundcaches) > 0) {
+		&& foundcache_length((Tfoundcache *) BLUEFISH_TEXT_VIEW(btv->master)->scancache.foundcaches) > 0) {
 		BLUEFISH_TEXT_VIEW(btv->master)->margin_pixels_block = 12;
 	} else {
 		BLUEFISH_TEXT_VIEW(btv->master)->margin_pixels_block = 0;
@@ -658,6 +661,9 @@ bftextview2_insert_text_lcb(GtkTextBuffer * buffer, GtkTextIter * iter, gchar *
 	guint startpos = gtk_text_iter_get_offset(iter);
 	if (btv == btv->master) {
 		foundcache_update_offsets(BLUEFISH_TEXT_VIEW(btv->master),startpos,charlen);
+#ifdef HAVE_LIBENCHANT
+		bftextview2_spell_cancel(btv);
+#endif
 	}
 }
 
@@ -714,6 +720,7 @@ bftextview2_insert_text_after_lcb(GtkTextBuffer * buffer, GtkTextIter * iter, gc
 #endif							/*HAVE_LIBENCHANT */
 #endif /* NEEDSCANNING */
 	btv->needremovetags = 0;
+	btv->viewscan_start_o = btv->viewscan_end_o = BF_OFFSET_UNDEFINED;
 
 #ifdef MARKREGION
 #ifdef NEEDSCANNING
@@ -835,19 +842,19 @@ paint_margin_symbol(BluefishTextView * btv, cairo_t * cr, gint w, gint height)
 }
 
 static gint
-get_num_foldable_blocks(Tfound * found)
+get_num_foldable_blocks(BluefishTextView * master, Tfound * found)
 {
 	gint count = 0;
-	Tfoundblock *tmpfblock = found->fblock;
-	if (found->numblockchange < 0 && found->fblock->foldable)
+	Tfoundblock *tmpfblock = found_fblock(master, found);
+	if (found->numblockchange < 0 && tmpfblock->foldable)
 		count = found->numblockchange;	/* don't count popped blocks */
 	DBG_MARGIN("found->numblockchange=%d, initial count=%d\n", found->numblockchange, count);
 	while (tmpfblock) {
-		DBG_MARGIN("check block %p (%d:%d), foldable=%d, parent=%p\n", tmpfblock, tmpfblock->start1_o,
+		DBG_MARGIN("check block %p (%d:%d), foldable=%d, parent=%u\n", tmpfblock, tmpfblock->start1_o,
 				   tmpfblock->end2_o, tmpfblock->foldable, tmpfblock->parentfblock);
 		if (tmpfblock->foldable)
 			count++;
-		tmpfblock = (Tfoundblock *) tmpfblock->parentfblock;
+		tmpfblock = fblock_parent(master, tmpfblock);
 	}
 	return count;
 }
@@ -857,7 +864,6 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 {
 	Tfound *found = NULL;
 	BluefishTextView *master = btv->master;
-	GSequenceIter *siter = NULL;
 	guint num_blocks;
 	gint cursor_line = -1;
 	GtkTextIter it;
@@ -894,22 +900,18 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 
 	/* to see how many blocks are active here */
 	if (G_UNLIKELY(gtk_text_iter_is_start(startvisible)
-				   && (g_sequence_get_length(master->scancache.foundcaches) != 0))) {
-		siter = g_sequence_get_begin_iter(master->scancache.foundcaches);
-		if (!g_sequence_iter_is_end(siter)) {
-			found = g_sequence_get(siter);
-		}
+				   && (foundcache_length((Tfoundcache *) master->scancache.foundcaches) != 0))) {
+		found = get_foundcache_first(master);
 		num_blocks = 0;
 		DBG_MARGIN("EXPOSE: start at begin, set num_blocks %d, found=%p\n", num_blocks, found);
 	} else {
-		found = get_foundcache_at_offset(master, gtk_text_iter_get_offset(startvisible), &siter);
+		found = get_foundcache_at_offset(master, gtk_text_iter_get_offset(startvisible));
 		if (found) {
-			num_blocks = get_num_foldable_blocks(found);
+			num_blocks = get_num_foldable_blocks(master, found);
 			DBG_MARGIN("EXPOSE: got %d foldable blocks at found %p at offset %d\n", num_blocks, found,
 					   found->charoffset_o);
 		} else {
-			DBG_MARGIN("EXPOSE: no found for position %d, siter=%p\n",
-					   gtk_text_iter_get_offset(startvisible), siter);
+			DBG_MARGIN("EXPOSE: no found for position %d\n", gtk_text_iter_get_offset(startvisible));
 			num_blocks = 0;
 		}
 	}
@@ -917,8 +919,8 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 	   the 'next' found */
 	if (!found || found->charoffset_o < gtk_text_iter_get_offset(startvisible)) {
 		DBG_MARGIN("get next found..\n");
-		if (siter)
-			found = get_foundcache_next(master, &siter);
+		if (found)
+			found = get_foundcache_next(master, found);
 	}
 	/*DBG_MARGIN("first found ");
 	   print_found(found); */
@@ -988,7 +990,7 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 					if (IS_FOUNDMODE_BLOCKPUSH(found)) {
 						/* on a pushedblock we should look where the block match start, charoffset_o is the end of the
 						   match, so multiline patterns are drawn on the wrong line */
-						foundpos = found->fblock->start1_o;
+						foundpos = found_fblock(master, found)->start1_o;
 					}
 					/*g_print("search block for line %d, curline_o=%d, nextline_o=%d, foundpos=%d, num_blocks=%d\n",i,curline_o,nextline_o, foundpos, num_blocks); */
 					if (foundpos > nextline_o) {
@@ -997,13 +999,13 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 
 					if (foundpos <= nextline_o && foundpos >= curline_o) {
 						/*g_print("line %d, looking at found at position %d which has numblockchange=%d\n",i,found->charoffset_o,found->numblockchange); */
-						if (IS_FOUNDMODE_BLOCKPUSH(found) && found->fblock->foldable) {
-							paint = found->fblock->folded ? 3 : 2;
-							num_blocks = get_num_foldable_blocks(found);
+						if (IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(master, found)->foldable) {
+							paint = found_fblock(master, found)->folded ? 3 : 2;
+							num_blocks = get_num_foldable_blocks(master, found);
 							/*g_print("paint_margin, pushed block, folded=%d, so paint=%d\n",found->fblock->folded,paint); */
 							break;
-						} else if (IS_FOUNDMODE_BLOCKPOP(found) && found->fblock->foldable) {
-							guint new_num_blocks = get_num_foldable_blocks(found);
+						} else if (IS_FOUNDMODE_BLOCKPOP(found) && found_fblock(master, found)->foldable) {
+							guint new_num_blocks = get_num_foldable_blocks(master, found);
 							if (new_num_blocks < num_blocks)
 								paint = 4;
 							/*else
@@ -1014,10 +1016,10 @@ paint_margin(BluefishTextView * btv, cairo_t * cr, GtkTextIter * startvisible, G
 						}
 					}
 					oldfound = found;
-					found = get_foundcache_next(master, &siter);
+					found = get_foundcache_next(master, found);
 					/* I'm not 100% sure about the !found ||  that I added to the next line.. */
 					if (num_blocks == -1 && (!found || found->charoffset_o >= curline_o)) {
-						num_blocks = get_num_foldable_blocks(oldfound);
+						num_blocks = get_num_foldable_blocks(master, oldfound);
 						/*g_print("re-set num_blocks to %d using found at %d, next found at %d\n", num_blocks, oldfound->charoffset_o, found->charoffset_o); */
 						paint = (num_blocks > 0) ? 1 : 0;
 					}
@@ -1144,6 +1146,11 @@ bluefish_text_view_draw(GtkWidget * widget, cairo_t * cr)
 	gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(widget), &endvisible, rect.y + rect.height, NULL);
 	gtk_text_view_buffer_to_window_coords(GTK_TEXT_VIEW(widget), GTK_TEXT_WINDOW_TEXT, rect.x,
 										  rect.y, &rect2x, &rect2y);
+	if (G_UNLIKELY(master->largefile) && master->enable_scanner
+		&& !largefile_window_highlighted(master, &startvisible, &endvisible)) {
+		/* scrolled to a window that is not highlighted yet */
+		bftextview2_schedule_scanning(master);
+	}
 
 	if (wleft && gtk_cairo_should_draw_window(cr, wleft)) {
 	   /******** the painting in the MARGIN area of the widget *********/
@@ -1231,6 +1238,11 @@ bluefish_text_view_expose_event(GtkWidget * widget, GdkEventExpose * event)
 	gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(widget), &endvisible, rect.y + rect.height, NULL);
 	gtk_text_view_buffer_to_window_coords(GTK_TEXT_VIEW(widget), GTK_TEXT_WINDOW_TEXT, rect.x,
 										  rect.y, &rect2x, &rect2y);
+	if (G_UNLIKELY(master->largefile) && master->enable_scanner
+		&& !largefile_window_highlighted(master, &startvisible, &endvisible)) {
+		/* scrolled to a window that is not highlighted yet */
+		bftextview2_schedule_scanning(master);
+	}
 
 	if (event->window == wleft) {
 	   /******** the painting in the MARGIN area of the widget *********/
@@ -1314,6 +1326,9 @@ bftextview2_delete_range_lcb(GtkTextBuffer * buffer, GtkTextIter * obegin,
 	eo = gtk_text_iter_get_offset(oend);
 	DBG_SIGNALS("bftextview2_delete_range_lcb, delete from %d to %d\n", so,eo);
 	foundcache_update_offsets(BLUEFISH_TEXT_VIEW(btv->master), so, so - eo);
+#ifdef HAVE_LIBENCHANT
+	bftextview2_spell_cancel(btv);
+#endif
 
 
 	/* mark the surroundings of the text that will be deleted */
@@ -1354,6 +1369,7 @@ bftextview2_delete_range_lcb(GtkTextBuffer * buffer, GtkTextIter * obegin,
 #endif							/*HAVE_LIBENCHANT */
 #endif
 	btv->needremovetags = 0;
+	btv->viewscan_start_o = btv->viewscan_end_o = BF_OFFSET_UNDEFINED;
 }
 
 static void
@@ -1618,50 +1634,64 @@ block_fold_tags(BluefishTextView * btv, Tfoundblock * fblock, Tfoldtags mode)
 }
 
 static void
-reapply_folded_tag_to_folded_blocks(BluefishTextView * btv, Tfoundblock * fblock, GSequenceIter ** siter)
+reapply_folded_tag_to_folded_blocks(BluefishTextView * btv, Tfoundblock * fblock, Tfound * blockfound)
 {
 	Tfound *found;
-	GSequenceIter *tsiter = *siter;
-	found = get_foundcache_next(btv, &tsiter);
+	found = get_foundcache_next(btv, blockfound);
 	DBG_FOLD("reapply_folded_tag from %d:%d, starting with found at %d\n", fblock->start1_o, fblock->start2_o,
 			 found ? found->charoffset_o : 0);
 	while (found && found->charoffset_o < fblock->start2_o) {
-		if (IS_FOUNDMODE_BLOCKPUSH(found) && found->fblock->folded) {
-			block_fold_tags(btv, found->fblock, foldtags_fold);
+		if (IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(btv, found)->folded) {
+			block_fold_tags(btv, found_fblock(btv, found), foldtags_fold);
 		}
-		found = get_foundcache_next(btv, &tsiter);
+		found = get_foundcache_next(btv, found);
 	}
 }
 
 static gboolean
-parent_block_is_folded(Tfoundblock * fblock)
+parent_block_is_folded(BluefishTextView * btv, Tfoundblock * fblock)
 {
-	Tfoundblock *tmpfblock = (Tfoundblock *) fblock->parentfblock;
+	Tfoundblock *tmpfblock = fblock_parent(btv, fblock);
 	while (tmpfblock) {
 		if (tmpfblock->folded) {
 			DBG_FOLD("parent_block_is_folded, return TRUE\n");
 			return TRUE;
 		}
-		tmpfblock = (Tfoundblock *) tmpfblock->parentfblock;
+		tmpfblock = fblock_parent(btv, tmpfblock);
 	}
 	return FALSE;
 }
 
 static void
-bftextview2_block_toggle_fold(BluefishTextView * btv, Tfoundblock * fblock, GSequenceIter ** siter)
+bftextview2_block_toggle_fold(BluefishTextView * btv, Tfoundblock * fblock, Tfound * blockfound)
 {
 	Tfoldtags mode;
 	fblock->folded = (!fblock->folded);
+	BLUEFISH_TEXT_VIEW(btv->master)->sccache_saved = FALSE;	/* the folded state is in the cache file */
 	if (fblock->folded) {
 		mode = foldtags_fold;
 	} else {
-		mode = parent_block_is_folded(fblock) ? foldtags_expand_hidden : foldtags_expand;
+		mode = parent_block_is_folded(btv, fblock) ? foldtags_expand_hidden : foldtags_expand;
 	}
 	DBG_FOLD("bftextview2_block_toggle_fold, block %d:%d has now folded=%d\n", fblock->start1_o,
 			 fblock->end2_o, fblock->folded);
 	block_fold_tags(btv, fblock, mode);
 	if (mode != foldtags_fold) {
-		reapply_folded_tag_to_folded_blocks(btv, fblock, siter);
+		reapply_folded_tag_to_folded_blocks(btv, fblock, blockfound);
+	}
+}
+
+/* applies the folding tags to all blocks that have folded set, used when the scancache
+is restored with sccache_restore() */
+void
+bftextview2_apply_folded_blocks(BluefishTextView * btv)
+{
+	Tfound *found = get_foundcache_first(btv);
+	while (found) {
+		if (IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(btv, found)->folded) {
+			block_fold_tags(btv, found_fblock(btv, found), foldtags_fold);
+		}
+		found = get_foundcache_next(btv, found);
 	}
 }
 
@@ -1669,7 +1699,6 @@ static void
 bftextview2_toggle_fold(BluefishTextView * btv, GtkTextIter * iter)
 {
 	Tfound *found;
-	GSequenceIter *siter;
 	GtkTextIter tmpiter;
 	guint offset, nextline_o;
 
@@ -1684,26 +1713,26 @@ bftextview2_toggle_fold(BluefishTextView * btv, GtkTextIter * iter)
 	nextline_o = gtk_text_iter_get_offset(&tmpiter);
 	/* returns the found PRIOR to iter, or the found excactly at iter,
 	   but this fails if the iter is the start of the buffer */
-	found = get_foundcache_at_offset(btv, offset, &siter);
+	found = get_foundcache_at_offset(btv, offset);
 	if (!found) {
 		/* is this 'if' block still required? I think get_foundcache_at_offset() now returns the first iter already */
 		DBG_FOLD("no found, retrieve first iter\n");
-		found = get_foundcache_first(btv, &siter);
+		found = get_foundcache_first(btv);
 	}
 	while (found && found->charoffset_o < nextline_o) {
-		if (IS_FOUNDMODE_BLOCKPUSH(found) && found->fblock->foldable && found->fblock->start1_o >= offset)
+		if (IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(btv, found)->foldable && found_fblock(btv, found)->start1_o >= offset)
 			break;
-		found = get_foundcache_next(btv, &siter);	/* should be the first found AFTER iter */
+		found = get_foundcache_next(btv, found);	/* should be the first found AFTER iter */
 	}
 	/*while (found && (found->charoffset_o < offset || !found->pushedblock || !found->pushedblock->foldable)) {
-	   found = get_foundcache_next(btv, &siter); / * should be the first found AFTER iter * /
+	   found = get_foundcache_next(btv, found); / * should be the first found AFTER iter * /
 	   if (found && found->pushedblock && found->pushedblock->foldable)
 	   break;
 	   } */
-	if (found && IS_FOUNDMODE_BLOCKPUSH(found) && found->fblock->start1_o >= offset
-		&& found->fblock->start1_o <= nextline_o && found->fblock->foldable) {
+	if (found && IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(btv, found)->start1_o >= offset
+		&& found_fblock(btv, found)->start1_o <= nextline_o && found_fblock(btv, found)->foldable) {
 		DBG_FOLD("toggle fold on found=%p\n", found);
-		bftextview2_block_toggle_fold(btv, found->fblock, &siter);
+		bftextview2_block_toggle_fold(btv, found_fblock(btv, found), found);
 	}
 }
 
@@ -1724,23 +1753,22 @@ enable_tooltip_idle_lcb(gpointer data)
 static void
 bftextview2_collapse_expand_toggle(BluefishTextView * btv, const gchar * name, gboolean collapse)
 {
-	GSequenceIter *siter = NULL;
 	Tfound *found;
 	g_object_set(btv, "has-tooltip", FALSE, NULL);
-	found = get_foundcache_first(btv, &siter);
+	found = get_foundcache_first(btv);
 	while (found) {
-		if (IS_FOUNDMODE_BLOCKPUSH(found) && found->fblock->foldable && found->fblock->folded != collapse) {
+		if (IS_FOUNDMODE_BLOCKPUSH(found) && found_fblock(btv, found)->foldable && found_fblock(btv, found)->folded != collapse) {
 			if (name) {
 				if (name ==
 					g_array_index(btv->bflang->st->blocks, Tpattern_block,
 								  g_array_index(btv->bflang->st->matches, Tpattern,
-												found->fblock->patternum).block).name)
-					bftextview2_block_toggle_fold(btv, found->fblock, &siter);
+												found_fblock(btv, found)->patternum).block).name)
+					bftextview2_block_toggle_fold(btv, found_fblock(btv, found), found);
 			} else {
-				bftextview2_block_toggle_fold(btv, found->fblock, &siter);
+				bftextview2_block_toggle_fold(btv, found_fblock(btv, found), found);
 			}
 		}
-		found = get_foundcache_next(btv, &siter);
+		found = get_foundcache_next(btv, found);
 	}
 	g_idle_add_full(G_PRIORITY_LOW, enable_tooltip_idle_lcb, btv, NULL);
 }
@@ -2075,21 +2103,20 @@ auto_indent_blockstackbased(BluefishTextView * btv)
 	GtkTextIter iter;
 	guint offset, num = 0;
 	Tfound *found;
-	GSequenceIter *siter;
 	Tfoundblock *fblock;
 	gboolean in_paste;
 	DBG_MSG("auto_indent_blockstackbased, started\n");
 	gtk_text_buffer_get_iter_at_mark(btv->buffer, &iter, gtk_text_buffer_get_insert(btv->buffer));
 	offset = gtk_text_iter_get_offset(&iter);
-	found = get_foundcache_at_offset(BLUEFISH_TEXT_VIEW(btv->master), offset, &siter);
+	found = get_foundcache_at_offset(BLUEFISH_TEXT_VIEW(btv->master), offset);
 	DBG_MSG("auto_indent_blockstackbased, found=%p\n", found);
 	if (!found || found->charoffset_o > offset)
 		return;
-	fblock = found->fblock;
+	fblock = found_fblock(BLUEFISH_TEXT_VIEW(btv->master), found);
 	if (found->numblockchange < 0)
 		num = found->numblockchange;
 	while (fblock) {
-		fblock = (Tfoundblock *) fblock->parentfblock;
+		fblock = fblock_parent(BLUEFISH_TEXT_VIEW(btv->master), fblock);
 		num++;
 	}
 	DBG_MSG("auto_indent_blockstackbased, num blocks=%d\n", num);
@@ -2168,6 +2195,7 @@ bluefish_text_view_scan_cleanup(BluefishTextView * btv)
 void
 bluefish_text_view_rescan(BluefishTextView * btv)
 {
+	gboolean largefile = (BLUEFISH_TEXT_VIEW(btv->master)->largefile != NULL);
 	DBG_MSG("bluefish_text_view_rescan, btv=%p, lang=%p\n", btv, btv->bflang);
 	cleanup_scanner(btv->master);
 	if (BLUEFISH_TEXT_VIEW(btv->master)->bflang) {
@@ -2189,6 +2217,8 @@ bluefish_text_view_rescan(BluefishTextView * btv)
 #endif							/*HAVE_LIBENCHANT */
 #endif
 		btv->needremovetags = 0;
+		if (largefile)
+			largefile_start(btv->master);
 		bftextview2_schedule_scanning(btv);
 	}
 }
@@ -2498,6 +2528,7 @@ bluefish_text_view_select_language(BluefishTextView * btv, const gchar * mime, c
 	if (bflang) {
 		/* set new language */
 		master->bflang = bflang;
+		master->sccache_checked = FALSE;
 		/* restart scanning */
 		gtk_text_buffer_get_bounds(buffer, &start, &end);
 #ifdef MARKREGION
@@ -2685,6 +2716,7 @@ bluefish_text_view_set_spell_check(BluefishTextView * btv, gboolean spell_check)
 #endif
 		bftextview2_schedule_scanning(master);
 	} else {
+		bftextview2_spell_cancel(master);
 		gtk_text_buffer_remove_tag_by_name(master->buffer, "_spellerror_", &start, &end);
 	}
 }
@@ -2714,7 +2746,7 @@ bluefish_text_view_query_tooltip(GtkWidget * widget, gint x, gint y, gboolean ke
 		return FALSE;
 	}
 
-	if (master->bflang && master->bflang->st && master->enable_scanner && master->scanner_idle == 0
+	if (master->bflang && master->bflang->st && master->enable_scanner && !bftextview2_scheduler_is_queued(master)
 		&& main_v->props.show_tooltip_reference) {
 		GtkTextIter iter, mstart;
 		GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(master));
@@ -2788,12 +2820,11 @@ bluefish_text_view_query_tooltip(GtkWidget * widget, gint x, gint y, gboolean ke
 					GPOINTER_TO_INT(g_hash_table_lookup
 									(g_array_index
 									 (master->bflang->st->contexts, Tcontext, contextnum).patternhash, key));
-				if (pattern_id && g_array_index(master->bflang->st->matches, Tpattern, pattern_id).reference) {
+				if (pattern_id && g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference) {
 					DBG_TOOLTIP("key=%s, value=%s\n", key,
-								g_array_index(master->bflang->st->matches, Tpattern, pattern_id).reference);
+								g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference);
 					gtk_tooltip_set_markup(tooltip,
-										   g_array_index(master->bflang->st->matches, Tpattern,
-														 pattern_id).reference);
+										   g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference);
 					g_free(key);
 					return TRUE;
 				}
@@ -2831,10 +2862,7 @@ bluefish_text_view_finalize(GObject * object)
 		g_source_remove(btv->scanner_delayed);
 		btv->scanner_delayed = 0;
 	}
-	if (btv->scanner_idle) {
-		g_source_remove(btv->scanner_idle);
-		btv->scanner_idle = 0;
-	}
+	bftextview2_scheduler_remove(btv);
 	if (btv->user_idle) {
 		g_source_remove(btv->user_idle);
 		btv->user_idle = 0;
@@ -2846,6 +2874,9 @@ bluefish_text_view_finalize(GObject * object)
 	if (btv->autocomp) {
 		autocomp_stop(btv);
 	}
+#ifdef HAVE_LIBENCHANT
+	bftextview2_spell_cancel(btv);
+#endif
 	if (btv->scancache.foundcaches) {
 		scancache_destroy(btv);
 	}
@@ -2941,10 +2972,11 @@ bluefish_text_view_init(BluefishTextView * textview)
 	GtkTextTagTable *ttt;
 /*	PangoFontDescription *font_desc;*/
 	textview->user_idle_timer = g_timer_new();
-	textview->scancache.foundcaches = g_sequence_new(NULL);
-#ifdef UPDATE_OFFSET_DELAYED
-	textview->scancache.offsetupdates = NULL;
-#endif
+	textview->scancache.arena = scanarena_new();
+	textview->scancache.foundcaches = foundcache_new(textview->scancache.arena);
+	textview->scancache.loops_per_timer = 1000;
+	textview->scancache.appliedtags = g_hash_table_new(g_direct_hash, g_direct_equal);
+	textview->viewscan_start_o = textview->viewscan_end_o = BF_OFFSET_UNDEFINED;
 	bluefish_text_view_set_colors(textview, main_v->props.btv_color_str);
 	textview->showsymbols = FALSE;
 	textview->button_press_line = -1;
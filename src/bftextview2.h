@@ -48,9 +48,19 @@ the widget code, including signal handlers and idle handlers are in bftextview2.
 nextcontext -1), we revert to the previous context
 
 - changed areas are marked with a GtkTextTag called 'needscanning'.
- - a idle function is started (if not running) to do the actual scanning
+ - the view is added to the queue of the scheduler (bftextview2_scheduler.c), which has one
+   idle function for all documents. Each time it runs it serves the active view first, then other
+   visible views, then background documents, until its time budget for that frame is used
  - the scanner keeps a timer and stops scanning once a certain time has passed
- - if the scanning is finished the idle function stops
+ - if the scanning is finished the view is removed from the queue, if the queue is empty the
+   idle function stops
+ - the scanning goes from the start of the buffer to the end. If the first changed area is far
+   in front of the visible window (after a jump in a large file that is still being scanned)
+   the idle function first does a provisional scan of the visible window. It continues from the
+   nearest scancache entry, so the context stack might be wrong, and the window stays marked
+   as changed. The regular scanning stops in front of the window (viewscan_start_o). Where the
+   two meet, the cache entries of the window are checked against the real stacks and removed
+   if they don't match, and the next run removes and rescans the window in a single run.
 
 
 ============ The scanned syntax cache ============
@@ -58,11 +68,15 @@ nextcontext -1), we revert to the previous context
   that is marked with the needscanning tag
  - to know which patterns to use we have to know in which context we are. we therefore keep
    a cache of the (context)stack. on each position where the contextstack changes, we make a copy
-   of the current state and store it in a sorted balanced tree (a GSequence), sorted by the
-   character offset in the text. We store a Tfound structure. A member of the Tfound structure
-   is a pointer to the Tfoundcontext stucture which describes the current context.
-   - the positions change when text is inserted or deleted, but never their order. a GSequence
-     allows us to update the offsets for the stacks without re-sorting the entire tree
+   of the current state and store it in a sorted array of chunks (a Tfoundcache, see
+   bftextview2_foundcache.c), sorted by the character offset in the text. We store a Tfound
+   structure. A member of the Tfound structure is a pointer to the Tfoundcontext stucture which
+   describes the current context.
+   - the positions change when text is inserted or deleted, but never their order. So we only
+     update the offsets in the chunk where the text changed, and add the change to the delta of
+     all further chunks. A search adds the delta of a chunk to its offsets, and the delta is only
+     applied to the entries of a chunk once one of them is used again, so typing at the start of
+     a large file does not update every entry in the cache.
  - same holds for the blocks. we keep a blockstack, and we keep a cache of the blockstack in the
    same foundcache as where we keep the contextstack. The member of the Tfound structure that
    describes the state for blocks is the Tfoundblock structure.
@@ -75,6 +89,10 @@ nextcontext -1), we revert to the previous context
   a popped block, you have to look at the parent of the fblock member!!!!
 - the Tfound member charoffset_o has the character offset of the end-of-the-end-of-context-match
   (Tfoundcontext->end_o) or the end-of-the-end-of-block-match (Tfoundblock->end2_o).
+- Tfound, Tfoundblock and Tfoundcontext are allocated from a per-view arena (a Tscanarena, see
+  bftextview2_arena.c) of large slabs. The parent of a Tfoundblock or Tfoundcontext is stored as
+  a 32bit handle in that arena, use fblock_parent() and fcontext_parent() to get the pointer.
+  When the scancache is destroyed or rebuilt the whole arena is freed at once.
 
 The next ascii art shows how blocks are stored in the scancache. This is a special situation
 in which a second block starts but does not have an end, so both blocks are popped at 'f'. A
@@ -93,7 +111,7 @@ Tfound structure is saved at offset B, D and F.
 
 
 - to paint the margin and detect if we can expand/collapse blocks, we can use this same
-  scancache. Along with walking the lines to draw the line numbers we walk the GSequence
+  scancache. Along with walking the lines to draw the line numbers we walk the scancache
   and see in the Tfound structures if there are new blocks that can be folded.
 
 
@@ -110,7 +128,22 @@ suspect that we never hit the 65500 states for a single context (largest pattern
 now is php, 4500 functions use 32000 states).
 When a state has a positive result (it matches something) it has an index number to
 an array 'matches' in structure Tscantable which is an array of type Tpattern structure
-that has the information for the matched pattern.
+that has the information for the matched pattern. Tpattern holds only what the scanner
+needs for a match (tag, block and context changes), so the matches of a language fit in a
+few cache lines. The pattern string, reference, autocompletion items and highlight name are
+in Tpattern_cold structures in array 'matchinfo', which has the same index as 'matches'.
+
+- a state in 'table' has an entry for every ascii character, which makes the php table 8Mb. Most
+characters behave exactly the same in every state of a context (all lowercase letters outside the
+function names, for example), so after compiling a context compress_context_dfa() groups the
+characters into character classes. The compressed table 'dfa' in Tcontext has for each state
+only an entry per class (and the match), and 'charclass' translates a character into a class. So
+the scanner uses state = dfa[state][charclass[character]];
+
+- inside a comment or a string almost every character leads back to the same state. A state that
+loops to itself for all but a few ascii characters is a skip state (Tcontext.skip), and when the
+scanner is in a skip state it jumps with strcspn() to the next character that leaves the state
+(see dfa_skip() in bftextview2_patcompile.c)
 
 - each context has it's own DFA table. The startcontext for each context is always
 position 0 and the identstate is always position 1 in that array
@@ -120,6 +153,48 @@ run for all patterns in a given context. The 1.0 scanner does multiple scanning
 and for <[a-z]+>. The new engine scans (<\?php|<[a-z]+>) but knows that both sub-patterns lead
 to different results (different color, different context).
 
+- the scanner does not apply a GtkTextTag for every match. It collects (tag, start, end) runs in
+Tscanning, merges runs of the same tag that touch or overlap, and applies them all at the end of
+the scanning run in text order. When an area is scanned again, only the tags that were ever
+applied (Tscancache.appliedtags) are removed, not every tag of the language.
+
+========== persisted scancache ==========
+reopening a large document means scanning it again from the start. When a document that is
+completely scanned is closed or autosaved, and the scancache changed since it was last saved or
+restored, sccache_save() writes (from a thread, on a snapshot) the Tfound, Tfoundblock (with
+the folded state) and Tfoundcontext entries, the applied highlighting and the identifiers to a
+cache file, with the uri, the md5 of the text and the scantable key as key. The first time the
+scanner runs on a document, sccache_restore() restores all of this if the key matches, and
+marks the scanning region as done. See bftextview2_sccache.c
+
+========== large-file mode ==========
+for documents of main_v->props.largefile_size MB or more (logs, SQL dumps) the scancache with a
+Tfound for every stack change, the blocks and the folding cost too much memory. When the scanning
+of a language starts, largefile_start() decides to use large-file mode instead. A lightweight
+scanning loop (largefile_run() in bftextview2_scanner.c) only keeps the context stack, and stores
+it in a checkpoint every LARGEFILE_CHECKPOINT_LINES lines, at an offset where the DFA is in its
+start state. The stacks of the checkpoints are interned, so most checkpoints share a stack.
+- the scheduler highlights the visible window of both views first. It scans from the last
+  checkpoint in front of the window up to the end of the window. If the checkpoints did not
+  reach the window yet the window is highlighted provisionally, and again once they did.
+  Only the last LARGEFILE_MAX_RANGES windows keep their highlighting. The draw handler schedules
+  scanning if it shows a window that is not highlighted
+- after a change, the checkpoints after the change are kept as old checkpoints. The scanning
+  continues at the last valid checkpoint and stops as soon as it finds an old checkpoint with
+  the same offset and the same stack, so typing does not rescan the rest of the document
+- there are no blocks, no folding, no identifiers and no persisted scancache in this mode
+
+========== scanner telemetry ==========
+the scanner can record every scanning run (regular, provisional viewport, and both kinds of
+large-file runs) in a ring buffer of SCANTELEMETRY_RECORDS Tscantelemetry records: the time of
+the four stages of the run (finding the region, reconstructing the stacks, removing the old
+highlighting, the scanning loop), the offsets, the number of characters, loops, matches and
+stack changes, and the size of the scancache and the scanning arena. Recording is off by default
+and the check is a single global, so it costs nothing in normal use. It is switched on from the
+Tools menu, or with the environment variable BLUEFISH_SCAN_TELEMETRY ("1" to only record, or a
+filename to write the records on exit). The records are exported as plain JSON or in Chrome trace
+format (view it in chrome://tracing), with a row for every document. See bftextview2_telemetry.c
+
 ========== language parsing from the XML file ==========
 - the languages are defined in an XML file. On startup, only the header of that file is parsed,
 into a Tbflang struct, which defines the language and the mime types. Only when scanning for
@@ -127,6 +202,11 @@ one of these mime-types is requested the rest of the file is parsed (in a separa
 and the DFA for this language is created. This saves memory and startup time for languages
 that are not used in a certain session.
 
+While the file is parsed the patterns are only added to the pending list of their context
+(Tcontext.pending). When parsing is finished, compile_scantable_contexts() compiles the
+DFA of every context, on a thread pool with a thread for each processor. The contexts
+are independent DFA's, so the only shared data is the (read-only) array of patterns.
+
 For parsing we use the libxml2 textreader interface
 http://xmlsoft.org/xmlreader.html
 It does not need to load the full XML file into memory, it
@@ -143,6 +223,14 @@ Language file loading is done in bftextview2_langmgr.c, the found patterns are a
 to the Tscantable structure and it's members (and compiled into a DFA table)
 in bftextview2_patcompile.c.
 
+After compiling, the Tscantable is written to ~/.bluefish/cache/ (bftextview2_stcache.c).
+The cache is keyed on the bluefish version, the language file name, the newest modification
+time of the .bflang2 file and the .bfinc files next to it, and all options that are set for
+this language. On the next run the file is mapped into memory: the DFA tables and the strings
+are used directly from the mapped file, only the GArray's, the pattern hashes, the autocomplete
+lists and the autocompletion indexes are rebuilt. If the cache is missing, out of date or corrupt, the
+XML file is parsed as before.
+
 ========== Symbols and identifiers in the DFA table ==========
 Each context has symbols. Symbols are characters that may start or end a pattern.
 Try to highlight for example:
@@ -199,12 +287,24 @@ as you see, the scanner is stuck in state 1 (the identstate) if
 either on the start or on the end there is no symbol.
 
 ======== Autocompleting patterns =============
-for autocompletion we keep a GCompletion in each context (member 'ac' of structure Tcontext).
-This is filled with all the patterns during XML load.
+for autocompletion we keep a Tacindex in each context (member 'ac' of structure Tcontext).
+This is filled with all the patterns during XML load, and sorted when the context is compiled
+(case insensitive if the context has autocomplete_case_insens), after that it does not change.
+All items that start with a prefix are a consecutive range in the sorted array, so the lookup
+is two binary searches (acindex_complete() in bftextview2_acindex.c). While the user types more
+characters the popup keeps the previous range, and only that range is searched again.
+
+from a prefix of AUTOCOMP_FUZZY_MIN_PREFIX characters the prefix is also matched as an
+abbreviation, for example "gtbi" for gtk_text_buffer_insert or gtkTextBufferInsert. The index
+keeps a 64 bit mask with the characters of every item, so most items are skipped with a single
+AND; the rest is scored by acindex_fuzzy_score(), with a bonus for characters on the start of a
+word and for consecutive characters. The popup shows the items that start with the prefix first,
+then the best abbreviation matches. Within both groups the items that the user selected recently
+(in this session) come first. Selecting an abbreviation match replaces the typed prefix.
 
 we use a similar scanning engine as above that can tell us where the string that
 the user is typing started, and in which context the curor position is. Once
-we know the context we know which GCompletion structure to use, so we can get
+we know the context we know which Tacindex to use, so we can get
 a list of possible completion strings.
 
 The scanning for the context is done in bftextview2_scanner.c, the rest of the autocompletion
@@ -212,7 +312,7 @@ code is in bftextview2_autocomp.c
 
 ======== Reference information ==========
 reference information can be shown in a tooltip above the text and in a side window
-during autocompletion. The reference information is stored in a member of the Tpattern
+during autocompletion. The reference information is stored in a member of the Tpattern_cold
 structure. Each Tcontext structure has a member patternhash that is a hashtable with the
 match as key and the index to the pattern in array Tscantable->matches as value.
 
@@ -227,6 +327,15 @@ after the syntax scanning is finished the spell checker is started. Similar to t
 scanner it runs in short timeslices such that it won't block the GUI. It scans only in
 certain GtkTextTag's (for example in the GtktextTag for comments and for strings).
 
+every dictionary has a verdict cache (a Tspelldict) with word -> correct or misspelled,
+shared by all windows that use the dictionary, so enchant is asked only once for every
+distinct word. The cache is emptied when a word is added to the dictionary or the session.
+
+with THREADED_SCANNING large regions are checked in chunks by a worker thread: the mainloop
+finds the parts of a chunk that need a spellcheck, the worker finds and checks the words in
+a copy of the text, and the mainloop only applies the _spellerror_ tags. Enchant
+dictionaries are not thread safe, so every call to enchant_dict_* holds the spelldicts lock.
+
 ======= Storing found function names and such for jump and autocompletion ======
 
 identifiers, such as function names or variable names can be stored for jump and for
@@ -236,10 +345,46 @@ for jump: found functions names are stored in a hashtable
 bfwin->identifier_jump as
 key Tbflang-context-name -> value Tdocument-linenumber
 
-for autocompletion they are added to a GCompletion
-the GCompletion can be found in hashtable
+for autocompletion they are inserted in a (sorted) Tacindex
+the Tacindex is part of a Tidentset that can be found in hashtable
 bfwin->identifier_ac with
-key Tbflang-context -> value GCompletion
+key Tbflang-context -> value Tidentset
+
+the Tidentset interns the names: a hashtable name -> Tidentname, and the jump key
+and the Tacindex both point to the name in the Tidentname. The Tidentname is refcounted,
+every jump key and every document that found the name for autocompletion holds a
+reference, the name is in the Tacindex as long as a document holds it for
+autocompletion. So a name that is found in two documents stays in the autocompletion
+if one of them is closed.
+
+what each document added is in hashtable
+bfwin->identifier_docs with
+key Tdocument -> value Tidentdoc (the Tidentname's of its jump keys, and the set of
+Tidentname's that it holds for autocompletion)
+
+so storing an identifier costs a few hash lookups, and removing the identifiers of a
+document (bftextview2_identifier_hash_remove_doc) only visits what that document added,
+not the identifiers of all the other documents in the window.
+
+======= the symbol index of a project =======
+
+the identifiers above are only known for documents that are open. For a project,
+bftextview2_symbolindex.c indexes all files in the basedir of the project (the basedir of the
+filebrowser) in a worker thread, shortly after the project is opened and after every save.
+
+The worker walks the directory tree, finds the language by mimetype and extension (a copy
+of the langmgr lookup table, the worker does not load languages, the languages that the
+project needs but that were not loaded are requested afterwards and the index is updated again),
+and runs the DFA over every file with the same identifier logic as the scanner, without
+GtkTextBuffer. Every update builds a new complete Tsymindex: a file with the same
+modification time and scantable key as in the previous index on disk
+(~/.bluefish/cache/<md5 of the basedir>.symbolindex) is not read, its symbols are copied.
+The mainloop only swaps the finished index, so the lookups need no locking.
+
+The index is an array of files, an array of Tsymbol (name, file, line, context, 16 bytes)
+and one block with all strings, each string only once. doc_jump() uses symbolindex_lookup()
+if the identifier is not found in an open document, and opens the file at the right line. The
+autocompletion uses symbolindex_ac_get_index() next to the identifier index.
 
 identifier_mode="1" means that the following the *following* identifier is to be stored. For example in
 php 'function', and in python 'def' and 'class' (implemented in bluefish 2.0.3).
@@ -263,7 +408,6 @@ The slave widget should always be destroyed before the master.
 #include "config.h"
 
 #define IDENTSTORING
-#define UPDATE_OFFSET_DELAYED
 
 /* MARKREGION: the new code the store the text locations where scanning or spellcheck is required */
 #define MARKREGION
@@ -273,6 +417,10 @@ if both old and new are defined, their results will be compared */
 #ifndef NEEDSCANNING
 #define MARKREGION
 #endif
+#ifdef MARKREGION
+/* THREADED_SCANNING: scan large regions in a worker thread, see bftextview2_scanthread.c */
+#define THREADED_SCANNING
+#endif
 
 #ifdef MARKREGION
 typedef struct {
@@ -296,18 +444,25 @@ typedef struct {
 typedef struct {
 	guint8 allsymbols[128];		/* this lookup table holds all symbols for all contexts, and is used to trigger scanning if reduced_scan_triggers is enabled */
 	GArray *contexts;			/* dynamic sized array of Tcontext that translates a context number into a rownumber in the DFA table */
-	GArray *matches;			/* dynamic sized array of Tpattern */
+	GArray *matches;			/* dynamic sized array of Tpattern, the part of each pattern that the scanner needs */
+	GArray *matchinfo;			/* dynamic sized array of Tpattern_cold with the same index as matches, the pattern
+								   string, reference and autocompletion data that the scanner never reads */
 	GArray *comments;			/* array of Tcomment, has max. 256 entries, we use a guint8 as index */
 	GArray *blocks; 			/* array of Tpattern_block with a guint16 as index */
+	gpointer mapped;			/* the GMappedFile if this scantable was loaded by stcache_load(), the strings
+								   and the DFA tables point into this file */
 } Tscantable;
 
 typedef struct {
-	GSequence *foundcaches;		/* a sorted structure of Tfound for
+	gpointer foundcaches;		/* a Tfoundcache (see bftextview2_foundcache.h), a sorted structure of Tfound for
 								   each position where the stack changes so we can restart scanning
 								   on any location */
-#ifdef UPDATE_OFFSET_DELAYED
-	gpointer offsetupdates; /* points to the last Toffsetupdate in the list (has an embedded list) */
-#endif
+	gpointer arena;				/* a Tscanarena (see bftextview2_arena.h) that holds all Tfound, Tfoundblock
+								   and Tfoundcontext for this scancache */
+	GHashTable *appliedtags;	/* the highlighting tags that the scanner applied since the last cleanup_scanner(),
+								   only these tags have to be removed when an area is scanned again */
+	guint loops_per_timer;		/* the number of scanning loops between two timer checks, auto-tuned for every document
+								   because the speed of the scanner depends on the language */
 } Tscancache;
 /********************************/
 /* language manager */
@@ -388,8 +543,15 @@ struct _BluefishTextView {
 	GtkTextTag *blockmatch;
 	GtkTextTag *cursortag;
 	Tscancache scancache;
-	guint scanner_immediate; /* event ID for the high priority scanning run */
-	guint scanner_idle;			/* event ID for the idle function that handles the scanning. 0 if no idle function is running */
+#ifdef THREADED_SCANNING
+	gpointer scanjob;			/* Tscanjob for a region that is scanned in a worker thread, or NULL */
+#ifdef HAVE_LIBENCHANT
+	gpointer spelljob;			/* Tspelljob for a chunk that is spellchecked in a worker thread, or NULL */
+#endif
+#endif
+	GList *schedlink;			/* the link in the queue of the scheduler (bftextview2_scheduler.c), NULL if this view has no
+								   scanning or spellchecking to do */
+	gdouble schedtime;			/* seconds that the scheduler spent on scanning and spellchecking this view */
 	guint scanner_delayed;		/* event ID for the timeout function that handles the delayed scanning. 0 if no timeout function is running */
 	GTimer *user_idle_timer;
 	guint user_idle;			/* event ID for the timed function that handles user idle events such as autocompletion popups */
@@ -413,6 +575,11 @@ struct _BluefishTextView {
 	guint needremovetags;	/* after we have removed all old highlighting, we set this to G_MAXUINT32, or to the
 									offset up to the point where we removed the old highlighting. but after a change that
 									needs highlighting we set this to the offset of the change. */
+	guint viewscan_start_o;	/* the visible window that was scanned ahead of the rest of the buffer, the regular scanning */
+	guint viewscan_end_o;	/* stops at viewscan_start_o until it has caught up. BF_OFFSET_UNDEFINED if not set */
+	gboolean sccache_checked;	/* TRUE once sccache_restore() was tried for the current language */
+	gboolean sccache_saved;	/* TRUE if the scancache did not change since sccache_save() or sccache_restore() */
+	gpointer largefile;		/* the checkpoints and highlighted windows of large-file mode (bftextview2_scanner.c), or NULL */
 	/* next three are used for margin painting */
 	gint margin_pixels_per_char;
 	gint margin_pixels_chars;
@@ -468,7 +635,9 @@ void bluefish_text_view_set_spell_check(BluefishTextView * btv, gboolean spell_c
 gchar *get_line_indenting(GtkTextBuffer * buffer, GtkTextIter * iter, gboolean prevline);
 void bluefish_text_view_scan_cleanup(BluefishTextView * btv);
 void bluefish_text_view_rescan(BluefishTextView * btv);
+gboolean bftextview2_scanner_scan(BluefishTextView * btv);
 void bftextview2_schedule_scanning(BluefishTextView * btv);
+void bftextview2_apply_folded_blocks(BluefishTextView * btv);
 gboolean bluefish_text_view_in_comment(BluefishTextView * btv, GtkTextIter * its, GtkTextIter * ite);
 Tcomment *bluefish_text_view_get_comment(BluefishTextView * btv, GtkTextIter * it,
 										 Tcomment_type preferred_type);
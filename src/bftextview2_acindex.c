@@ -0,0 +1,346 @@
+/* Bluefish HTML Editor
+ * bftextview2_acindex.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_acindex.h"
+
+/*#define DBG_ACINDEX g_print*/
+#define DBG_ACINDEX(args...)
+
+/* indexes are also created in the threads that build a scantable or a symbol index */
+G_LOCK_DEFINE_STATIC(acindex_generation);
+static guint acindex_generation = 0;
+
+Tacindex *
+acindex_new(gboolean case_insens)
+{
+	Tacindex *aci = g_slice_new0(Tacindex);
+	G_LOCK(acindex_generation);
+	aci->generation = ++acindex_generation;
+	G_UNLOCK(acindex_generation);
+	aci->items = g_ptr_array_new();
+	aci->masks = g_array_new(FALSE, FALSE, sizeof(guint64));
+	aci->case_insens = case_insens;
+	return aci;
+}
+
+/* adds a string while the index is built, acindex_finish() sorts the index */
+void
+acindex_add(Tacindex * aci, gchar * string)
+{
+	g_ptr_array_add(aci->items, string);
+	aci->sorted = FALSE;
+}
+
+/* the bit for a character in the masks: the letters case insensitive and the digits each have
+their own bit, the other characters share the remaining bits */
+static inline guint
+acindex_charbit(gchar c)
+{
+	if (c >= 'a' && c <= 'z')
+		return c - 'a';
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+	if (c >= '0' && c <= '9')
+		return 26 + c - '0';
+	return 36 + ((guchar) c % 28);
+}
+
+static guint64
+acindex_charmask(const gchar * string)
+{
+	guint64 mask = 0;
+	for (; *string; string++)
+		mask |= G_GUINT64_CONSTANT(1) << acindex_charbit(*string);
+	return mask;
+}
+
+static gint
+acindex_compare(const gchar * a, const gchar * b, gboolean case_insens)
+{
+	if (case_insens) {
+		gint ret = g_ascii_strcasecmp(a, b);
+		if (ret != 0)
+			return ret;
+	}
+	return strcmp(a, b);
+}
+
+static gint
+acindex_sort_func(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return acindex_compare(*(const gchar **) a, *(const gchar **) b, GPOINTER_TO_INT(data));
+}
+
+/* sorts the items and removes the duplicates */
+void
+acindex_finish(Tacindex * aci)
+{
+	guint i, j;
+	if (aci->sorted)
+		return;
+	g_ptr_array_sort_with_data(aci->items, acindex_sort_func, GINT_TO_POINTER((gint) aci->case_insens));
+	for (i = 1, j = 1; i < aci->items->len; i++) {
+		if (strcmp(acindex_item(aci, i), acindex_item(aci, j - 1)) != 0)
+			aci->items->pdata[j++] = aci->items->pdata[i];
+	}
+	if (aci->items->len > 0)
+		g_ptr_array_set_size(aci->items, j);
+	g_array_set_size(aci->masks, aci->items->len);
+	for (i = 0; i < aci->items->len; i++)
+		g_array_index(aci->masks, guint64, i) = acindex_charmask(acindex_item(aci, i));
+	aci->sorted = TRUE;
+	DBG_ACINDEX("acindex_finish, %p has %d items\n", aci, aci->items->len);
+}
+
+/* returns the position where string is, or where it should be inserted */
+static guint
+acindex_position(Tacindex * aci, const gchar * string, gboolean * found)
+{
+	guint low = 0, high = aci->items->len;
+	*found = FALSE;
+	while (low < high) {
+		guint mid = (low + high) / 2;
+		gint cmp = acindex_compare(acindex_item(aci, mid), string, aci->case_insens);
+		if (cmp == 0) {
+			*found = TRUE;
+			return mid;
+		}
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* adds a string to a finished index, returns FALSE if it was in the index already */
+gboolean
+acindex_insert(Tacindex * aci, gchar * string)
+{
+	gboolean found;
+	guint64 mask;
+	guint pos = acindex_position(aci, string, &found);
+	if (found)
+		return FALSE;
+	g_ptr_array_add(aci->items, NULL);
+	memmove(&aci->items->pdata[pos + 1], &aci->items->pdata[pos],
+			(aci->items->len - 1 - pos) * sizeof(gpointer));
+	aci->items->pdata[pos] = string;
+	mask = acindex_charmask(string);
+	g_array_insert_val(aci->masks, pos, mask);
+	aci->changes++;
+	return TRUE;
+}
+
+gboolean
+acindex_remove(Tacindex * aci, const gchar * string)
+{
+	gboolean found;
+	guint pos = acindex_position(aci, string, &found);
+	if (!found)
+		return FALSE;
+	g_ptr_array_remove_index(aci->items, pos);
+	g_array_remove_index(aci->masks, pos);
+	aci->changes++;
+	return TRUE;
+}
+
+/* returns the string in the index that equals string, or NULL */
+gchar *
+acindex_lookup(Tacindex * aci, const gchar * string)
+{
+	gboolean found;
+	guint pos = acindex_position(aci, string, &found);
+	return found ? acindex_item(aci, pos) : NULL;
+}
+
+/* the first item in low..high-1 that does not sort before prefix, or with upper the first item
+that sorts after it. Only the first plen bytes of the items are compared, so all items that start
+with prefix are equal to it */
+static guint
+acindex_bound(Tacindex * aci, const gchar * prefix, gsize plen, guint low, guint high, gboolean upper)
+{
+	while (low < high) {
+		guint mid = (low + high) / 2;
+		gint cmp = aci->case_insens ? g_ascii_strncasecmp(acindex_item(aci, mid), prefix, plen)
+			: strncmp(acindex_item(aci, mid), prefix, plen);
+		if (cmp < 0 || (upper && cmp == 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* sets range to the items that start with prefix. With narrow, and if range holds the result of
+a previous lookup in the same unchanged index for the start of prefix (the user typed more
+characters), only the items in that range are searched */
+void
+acindex_complete(Tacindex * aci, const gchar * prefix, Tacrange * range, gboolean narrow)
+{
+	gsize plen = strlen(prefix);
+	guint low = 0, high = aci->items->len;
+	if (narrow && range->generation == aci->generation && range->changes == aci->changes && range->end <= high) {
+		low = range->start;
+		high = range->end;
+	}
+	range->aci = aci;
+	range->generation = aci->generation;
+	range->changes = aci->changes;
+	range->start = acindex_bound(aci, prefix, plen, low, high, FALSE);
+	range->end = acindex_bound(aci, prefix, plen, range->start, high, TRUE);
+	DBG_ACINDEX("acindex_complete, prefix %s searched %d:%d, found %d:%d\n", prefix, low, high, range->start,
+				range->end);
+}
+
+/* returns prefix extended with the characters that all items in range have in common, in
+newly allocated memory, or NULL if range is empty */
+gchar *
+acrange_common_prefix(Tacrange * range, const gchar * prefix)
+{
+	gsize plen = strlen(prefix), len;
+	const gchar *first;
+	guint i;
+	if (range->start >= range->end)
+		return NULL;
+	first = acindex_item(range->aci, range->start) + plen;
+	len = strlen(first);
+	/* in a case sensitive index the items in between have at least what the first and the last have in common */
+	for (i = range->aci->case_insens ? range->start + 1 : range->end - 1; i < range->end && len > 0; i++) {
+		const gchar *item = acindex_item(range->aci, i) + plen;
+		gsize j;
+		for (j = 0; j < len && item[j] == first[j]; j++);
+		len = j;
+	}
+	/* do not cut a multibyte character */
+	while (len > 0 && (first[len] & 0xC0) == 0x80)
+		len--;
+	return len ? g_strdup_printf("%s%.*s", prefix, (gint) len, first) : g_strdup(prefix);
+}
+
+/* the start of a word in an identifier: the first character, a character after a separator such
+as '_', an uppercase letter after a lowercase letter (camelCase) and a digit after a letter */
+static inline gboolean
+acindex_wordstart(const gchar * string, gint i)
+{
+	gchar c, prev;
+	if (i == 0)
+		return TRUE;
+	c = string[i];
+	prev = string[i - 1];
+	if (!g_ascii_isalnum(prev))
+		return g_ascii_isalnum(c);
+	if (g_ascii_isupper(c) && g_ascii_islower(prev))
+		return TRUE;
+	return g_ascii_isdigit(c) && !g_ascii_isdigit(prev);
+}
+
+/* TRUE if query is a subsequence of string, case insensitive */
+static gboolean
+acindex_is_subsequence(const gchar * string, const gchar * query)
+{
+	for (; *query; query++) {
+		while (*string && g_ascii_tolower(*string) != g_ascii_tolower(*query))
+			string++;
+		if (!*string)
+			return FALSE;
+		string++;
+	}
+	return TRUE;
+}
+
+#define FUZZY_WORDSTART 10
+#define FUZZY_FIRST 4			/* extra for a match on the first character */
+#define FUZZY_CONSECUTIVE 5
+#define FUZZY_EXACTCASE 1
+#define FUZZY_MAXGAP 3			/* the penalty for skipped characters between two matches */
+
+/* scores how well query matches string as an abbreviation, such as "gtbi" for
+gtk_text_buffer_insert or gtkTextBufferInsert. Every character of query has to be found in
+string, in the same order and case insensitive. Returns -1 if it does not match. Matches on the
+start of a word and consecutive matches score higher, skipped characters score lower. Every
+character is matched on the first position where it can, except that a later start of a word is
+preferred if the rest of query still matches after it. */
+gint
+acindex_fuzzy_score(const gchar * string, const gchar * query)
+{
+	gint i = 0, prev = -1, score = 0, qlen = 0;
+	const gchar *q;
+	for (q = query; *q; q++, qlen++) {
+		gchar lc = g_ascii_tolower(*q);
+		gint j;
+		while (string[i] && g_ascii_tolower(string[i]) != lc)
+			i++;
+		if (!string[i])
+			return -1;
+		if (!acindex_wordstart(string, i)) {
+			for (j = i + 1; string[j]; j++) {
+				if (g_ascii_tolower(string[j]) == lc && acindex_wordstart(string, j)
+					&& acindex_is_subsequence(string + j + 1, q + 1)) {
+					i = j;
+					break;
+				}
+			}
+		}
+		if (acindex_wordstart(string, i))
+			score += (i == 0) ? FUZZY_WORDSTART + FUZZY_FIRST : FUZZY_WORDSTART;
+		if (i == prev + 1 && prev >= 0)
+			score += FUZZY_CONSECUTIVE;
+		else if (prev >= 0)
+			score -= MIN(i - prev - 1, FUZZY_MAXGAP);
+		if (string[i] == *q)
+			score += FUZZY_EXACTCASE;
+		prev = i;
+		i++;
+	}
+	/* shorter strings are better, a few characters do not matter */
+	return MAX(score - (gint) (strlen(string) - qlen) / 8, 0);
+}
+
+/* appends a Tacfuzzy for every item that fuzzy matches query to results. The masks skip most
+items without looking at the string */
+void
+acindex_fuzzy(Tacindex * aci, const gchar * query, GArray * results)
+{
+	guint64 qmask = acindex_charmask(query);
+	guint i;
+	for (i = 0; i < aci->items->len; i++) {
+		Tacfuzzy af;
+		if ((g_array_index(aci->masks, guint64, i) & qmask) != qmask)
+			continue;
+		af.score = acindex_fuzzy_score(acindex_item(aci, i), query);
+		if (af.score < 0)
+			continue;
+		af.string = acindex_item(aci, i);
+		g_array_append_val(results, af);
+	}
+}
+
+void
+acindex_free(Tacindex * aci)
+{
+	g_array_free(aci->masks, TRUE);
+	g_ptr_array_free(aci->items, TRUE);
+	g_slice_free(Tacindex, aci);
+}
@@ -0,0 +1,66 @@
+/* Bluefish HTML Editor
+ * bftextview2_acindex.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_ACINDEX_H_
+#define _BFTEXTVIEW2_ACINDEX_H_
+
+#include <glib.h>
+
+typedef struct {
+	GPtrArray *items;			/* the strings, sorted after acindex_finish(), the strings are not owned by the index */
+	GArray *masks;				/* for each item a guint64 with a bit for each character in it, for the fuzzy matching */
+	guint changes;				/* incremented on every change after acindex_finish(), invalidates Tacrange's */
+	guint generation;			/* unique for every index, a new index at the address of a freed one differs */
+	guint8 case_insens;
+	guint8 sorted;
+} Tacindex;
+
+/* the result of a prefix lookup, the items start to end-1 */
+typedef struct {
+	Tacindex *aci;
+	guint generation;			/* of aci when the range was set */
+	guint changes;
+	guint start;
+	guint end;
+} Tacrange;
+
+/* an item that matches a fuzzy query, see acindex_fuzzy() */
+typedef struct {
+	gchar *string;
+	gint score;
+} Tacfuzzy;
+
+#define acindex_length(aci) ((aci)->items->len)
+#define acindex_item(aci, i) ((gchar *) g_ptr_array_index((aci)->items, (i)))
+#define acrange_length(range) ((range)->end - (range)->start)
+
+Tacindex *acindex_new(gboolean case_insens);
+void acindex_add(Tacindex * aci, gchar * string);
+void acindex_finish(Tacindex * aci);
+gboolean acindex_insert(Tacindex * aci, gchar * string);
+gboolean acindex_remove(Tacindex * aci, const gchar * string);
+gchar *acindex_lookup(Tacindex * aci, const gchar * string);
+void acindex_complete(Tacindex * aci, const gchar * prefix, Tacrange * range, gboolean narrow);
+gchar *acrange_common_prefix(Tacrange * range, const gchar * prefix);
+gint acindex_fuzzy_score(const gchar * string, const gchar * query);
+void acindex_fuzzy(Tacindex * aci, const gchar * query, GArray * results);
+void acindex_free(Tacindex * aci);
+
+#endif							/* _BFTEXTVIEW2_ACINDEX_H_ */
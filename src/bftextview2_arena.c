@@ -0,0 +1,154 @@
+/* Bluefish HTML Editor
+ * bftextview2_arena.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+every BluefishTextView has a Tscanarena with a pool for Tfound, one for Tfoundblock and one for
+Tfoundcontext. A pool allocates its elements from slabs that start small and double in size up
+to ARENA_SLAB_SIZE elements. Freed elements go on a freelist and are handed out again before the
+last slab is used any further. An element in a pool can be referred to by a 32bit handle, which
+is used for the block and the context of a Tfound and for the parent links in Tfoundblock and
+Tfoundcontext. The whole arena is freed at once when the scancache is
+destroyed or rebuilt, there is no need to free every element on its own.
+*/
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_arena.h"
+
+static void
+arenapool_init(Tarenapool * pool, guint elsize)
+{
+	pool->slabs = g_ptr_array_new();
+	pool->sorted = g_array_new(FALSE, FALSE, sizeof(Tarenaslab));
+	pool->elsize = elsize;
+}
+
+static void
+arenapool_clear(Tarenapool * pool)
+{
+	guint i;
+	for (i = 0; i < pool->slabs->len; i++) {
+		g_free(g_ptr_array_index(pool->slabs, i));
+	}
+	g_ptr_array_set_size(pool->slabs, 0);
+	g_array_set_size(pool->sorted, 0);
+	pool->freelist = NULL;
+	pool->slabsize = 0;
+	pool->used = 0;
+	pool->count = 0;
+}
+
+/* returns the number of slabs in pool->sorted that start at or before data */
+static guint
+arenapool_sorted_pos(Tarenapool * pool, gconstpointer data)
+{
+	guint lo = 0, hi = pool->sorted->len;
+	while (lo < hi) {
+		guint mid = (lo + hi) / 2;
+		if (g_array_index(pool->sorted, Tarenaslab, mid).mem <= (const gchar *) data)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void
+arenapool_new_slab(Tarenapool * pool)
+{
+	Tarenaslab as;
+	as.num = pool->slabs->len;
+	pool->slabsize = arena_slab_size(as.num);
+	as.mem = g_malloc(pool->elsize * pool->slabsize);
+	g_array_insert_val(pool->sorted, arenapool_sorted_pos(pool, as.mem), as);
+	g_ptr_array_add(pool->slabs, as.mem);
+	pool->used = 0;
+}
+
+gpointer
+arenapool_alloc(Tarenapool * pool)
+{
+	gpointer data;
+	if (pool->freelist) {
+		data = pool->freelist;
+		pool->freelist = *(gpointer *) data;
+	} else {
+		if (G_UNLIKELY(pool->used == pool->slabsize))
+			arenapool_new_slab(pool);
+		data = (gchar *) g_ptr_array_index(pool->slabs, pool->slabs->len - 1) + pool->used * pool->elsize;
+		pool->used++;
+	}
+	pool->count++;
+	memset(data, 0, pool->elsize);
+	return data;
+}
+
+void
+arenapool_free(Tarenapool * pool, gpointer data)
+{
+	*(gpointer *) data = pool->freelist;
+	pool->freelist = data;
+	pool->count--;
+}
+
+/* the handle for data, which should be NULL or an element of pool */
+guint32
+arenapool_handle(Tarenapool * pool, gconstpointer data)
+{
+	Tarenaslab *as;
+	if (!data)
+		return 0;
+	as = &g_array_index(pool->sorted, Tarenaslab, arenapool_sorted_pos(pool, data) - 1);
+	return arena_slab_start(as->num) + ((const gchar *) data - as->mem) / pool->elsize + 1;
+}
+
+Tscanarena *
+scanarena_new(void)
+{
+	Tscanarena *sa = g_slice_new0(Tscanarena);
+	arenapool_init(&sa->found, sizeof(Tfound));
+	arenapool_init(&sa->fblock, sizeof(Tfoundblock));
+	arenapool_init(&sa->fcontext, sizeof(Tfoundcontext));
+	return sa;
+}
+
+/* frees all Tfound, Tfoundblock and Tfoundcontext elements */
+void
+scanarena_clear(Tscanarena * sa)
+{
+	arenapool_clear(&sa->found);
+	arenapool_clear(&sa->fblock);
+	arenapool_clear(&sa->fcontext);
+}
+
+void
+scanarena_free(Tscanarena * sa)
+{
+	scanarena_clear(sa);
+	g_ptr_array_free(sa->found.slabs, TRUE);
+	g_array_free(sa->found.sorted, TRUE);
+	g_ptr_array_free(sa->fblock.slabs, TRUE);
+	g_array_free(sa->fblock.sorted, TRUE);
+	g_ptr_array_free(sa->fcontext.slabs, TRUE);
+	g_array_free(sa->fcontext.sorted, TRUE);
+	g_slice_free(Tscanarena, sa);
+}
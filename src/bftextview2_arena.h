@@ -0,0 +1,95 @@
+/* Bluefish HTML Editor
+ * bftextview2_arena.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_ARENA_H_
+#define _BFTEXTVIEW2_ARENA_H_
+
+#include "bftextview2_private.h"
+
+#define ARENA_SLAB_FIRST_SHIFT 5
+#define ARENA_SLAB_SHIFT 10
+#define ARENA_SLAB_SIZE (1 << ARENA_SLAB_SHIFT)	/* the maximum number of elements in a slab */
+/* the first slab has 1 << ARENA_SLAB_FIRST_SHIFT elements, and every next slab doubles in size
+up to ARENA_SLAB_SIZE, so a small document does not need a large slab in every pool. This is the
+number of slabs that are smaller than ARENA_SLAB_SIZE */
+#define ARENA_SLAB_GROWING (ARENA_SLAB_SHIFT - ARENA_SLAB_FIRST_SHIFT)
+
+typedef struct {
+	gchar *mem;
+	guint num;					/* the position of this slab in Tarenapool.slabs */
+} Tarenaslab;
+
+typedef struct {
+	GPtrArray *slabs;			/* the slabs in allocation order, a handle refers to a position in this array */
+	GArray *sorted;				/* Tarenaslab for all slabs sorted by address, used to find the handle for a pointer */
+	gpointer freelist;			/* elements that were freed, linked through their first bytes */
+	guint elsize;
+	guint slabsize;				/* the number of elements in the last slab */
+	guint used;					/* the number of elements handed out from the last slab */
+	guint count;				/* the number of elements in use */
+} Tarenapool;
+
+typedef struct {
+	Tarenapool found;
+	Tarenapool fblock;
+	Tarenapool fcontext;
+} Tscanarena;
+
+Tscanarena *scanarena_new(void);
+void scanarena_clear(Tscanarena * sa);
+void scanarena_free(Tscanarena * sa);
+gpointer arenapool_alloc(Tarenapool * pool);
+void arenapool_free(Tarenapool * pool, gpointer data);
+guint32 arenapool_handle(Tarenapool * pool, gconstpointer data);
+
+/* the index of the first element in slab num, with an extra 1 << ARENA_SLAB_FIRST_SHIFT every
+slab starts at a power of 2 or at a multiple of ARENA_SLAB_SIZE */
+#define arena_slab_start(num) (((num) < ARENA_SLAB_GROWING ? (1u << (ARENA_SLAB_FIRST_SHIFT + (num))) \
+						: ((num) - ARENA_SLAB_GROWING + 1) << ARENA_SLAB_SHIFT) - (1u << ARENA_SLAB_FIRST_SHIFT))
+#define arena_slab_size(num) ((num) < ARENA_SLAB_GROWING ? (1u << (ARENA_SLAB_FIRST_SHIFT + (num))) : ARENA_SLAB_SIZE)
+
+/* a handle is the index of the element in the pool + 1, so 0 means NULL */
+static inline gpointer
+arenapool_get(Tarenapool * pool, guint32 handle)
+{
+	guint i, num;
+	if (!handle)
+		return NULL;
+	i = handle - 1 + (1u << ARENA_SLAB_FIRST_SHIFT);
+	if (G_LIKELY(i >= ARENA_SLAB_SIZE))
+		num = (i >> ARENA_SLAB_SHIFT) + ARENA_SLAB_GROWING - 1;
+	else
+		num = g_bit_storage(i) - 1 - ARENA_SLAB_FIRST_SHIFT;
+	return (gchar *) g_ptr_array_index(pool->slabs, num) + (handle - 1 - arena_slab_start(num)) * pool->elsize;
+}
+
+/* the memory in Kb that is allocated for the slabs of an arena pool */
+#define ARENAPOOL_KB(pool) ((guint) (arena_slab_start((pool)->slabs->len) * (pool)->elsize / 1024.0))
+
+/* btv should be the view that owns the scancache, so the master view */
+#define SCANARENA(btv) ((Tscanarena *) (btv)->scancache.arena)
+#define fblock_parent(btv, fblock) ((Tfoundblock *) arenapool_get(&SCANARENA(btv)->fblock, (fblock)->parentfblock))
+#define fcontext_parent(btv, fcontext) ((Tfoundcontext *) arenapool_get(&SCANARENA(btv)->fcontext, (fcontext)->parentfcontext))
+#define fblock_handle(btv, fblock) arenapool_handle(&SCANARENA(btv)->fblock, (fblock))
+#define fcontext_handle(btv, fcontext) arenapool_handle(&SCANARENA(btv)->fcontext, (fcontext))
+#define found_fblock(btv, found) ((Tfoundblock *) arenapool_get(&SCANARENA(btv)->fblock, (found)->fblock))
+#define found_fcontext(btv, found) ((Tfoundcontext *) arenapool_get(&SCANARENA(btv)->fcontext, (found)->fcontext))
+
+#endif							/* _BFTEXTVIEW2_ARENA_H_ */
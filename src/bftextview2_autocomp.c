@@ -23,6 +23,7 @@
 #include "bftextview2_private.h"
 #include "bftextview2_scanner.h"
 #include "bftextview2_identifier.h"
+#include "bftextview2_symbolindex.h"
 #include "bftextview2_autocomp.h"
 #include "stringlist.h"
 
@@ -43,10 +44,22 @@ typedef struct {
 	gint h;
 	gboolean in_fill; /* TRUE while filling the liststore */
 	guint16 contextnum;
+	Tacrange acrange;	/* the items for prefix in the autocompletion index of the context */
+	Tacrange identrange;	/* the items for prefix in the identifier index of the context */
+	Tacrange symbolrange;	/* the items for prefix in the symbol index of the project */
 } Tacwin;
 
 #define ACWIN(p) ((Tacwin *)(p))
 
+#define AUTOCOMP_MAX_ITEMS 512			/* the number of items in the popup, at most */
+#define AUTOCOMP_FUZZY_MIN_PREFIX 2		/* the prefix length from which abbreviations are matched */
+#define AUTOCOMP_FUZZY_MAX 32			/* the number of abbreviation matches in the popup, at most */
+#define AUTOCOMP_PREFIX_SCORE 1000		/* the score of an item that starts with the prefix, above any abbreviation */
+#define AUTOCOMP_RECENT 64				/* the number of recently selected items that rank higher */
+
+static GHashTable *recent_items = NULL;	/* the selected items, with a serial number of the last selection */
+static guint recent_serial = 0;
+
 static void
 acwin_cleanup(BluefishTextView * btv)
 {
@@ -224,7 +237,7 @@ acwin_check_keypress(BluefishTextView * btv, GdkEventKey * event)
 					DBG_AUTOCOMP("got pattern_id=%d\n", pattern_id);
 					if (pattern_id) {
 						GSList *tmpslist =
-							g_array_index(master->bflang->st->matches, Tpattern, pattern_id).autocomp_items;
+							g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).autocomp_items;
 						/* a pattern MAY have multiple autocomplete items. This code is not efficient iof in the future some
 						   patterns would have many autocomplete items. I don't expect this, so I leave this as it is right now  */
 						while (tmpslist) {
@@ -236,8 +249,18 @@ acwin_check_keypress(BluefishTextView * btv, GdkEventKey * event)
 						}
 					}
 				}
+				autocomp_recent_add(string);
 				stringlen = strlen(string);
 				prefix_len = strlen(ACWIN(btv->autocomp)->prefix);
+				if (strncmp(string, ACWIN(btv->autocomp)->prefix, prefix_len) != 0) {
+					/* an abbreviation (or a different case), replace what the user typed */
+					GtkTextIter it1, it2;
+					gtk_text_buffer_get_iter_at_mark(btv->buffer, &it2, gtk_text_buffer_get_insert(btv->buffer));
+					it1 = it2;
+					gtk_text_iter_backward_chars(&it1, g_utf8_strlen(ACWIN(btv->autocomp)->prefix, -1));
+					gtk_text_buffer_delete(btv->buffer, &it1, &it2);
+					prefix_len = 0;
+				}
 				existing_len = get_existing_end_len(btv, string, prefix_len);
 
 				DBG_AUTOCOMP("acwin_check_keypress: ENTER: insert %s\n",
@@ -320,13 +343,12 @@ acw_selection_changed_lcb(GtkTreeSelection * selection, Tacwin * acw)
 								(g_array_index
 								 (master->bflang->st->contexts, Tcontext, acw->contextnum).patternhash, key));
 			g_free(key);
-			if (pattern_id && g_array_index(master->bflang->st->matches, Tpattern, pattern_id).reference) {
+			if (pattern_id && g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference) {
 				GtkRequisition requisition;
 				DBG_AUTOCOMP("acw_selection_changed_lcb, show %s\n",
-							 g_array_index(master->bflang->st->matches, Tpattern, pattern_id).reference);
+							 g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference);
 				gtk_label_set_markup(GTK_LABEL(acw->reflabel),
-									 g_array_index(master->bflang->st->matches, Tpattern,
-												   pattern_id).reference);
+									 g_array_index(master->bflang->st->matchinfo, Tpattern_cold, pattern_id).reference);
 				gtk_widget_show(acw->reflabel);
 #if GTK_CHECK_VERSION(3,0,0)
 				gtk_widget_get_preferred_size(acw->reflabel, &requisition, NULL);
@@ -434,28 +456,19 @@ acwin_position_at_cursor(BluefishTextView * btv)
 }
 
 static void
-acwin_calculate_window_size(Tacwin * acw, GList * items, GList * items2, const gchar *closetag, gint *numitems)
+acwin_calculate_window_size(Tacwin * acw, GList * items, const gchar *closetag, gint *numitems)
 {
 	GList *tmplist;
-	gboolean runtwo = FALSE;
 	gchar *longest = NULL, *tmp;
 	guint longestlen = 1;
 	*numitems = 0;
-	DBG_AUTOCOMP("acwin_calculate_window_size, items=%p, items2=%p, closetag=%s\n", items, items2, closetag);
+	DBG_AUTOCOMP("acwin_calculate_window_size, items=%p, closetag=%s\n", items, closetag);
 	if (closetag) {
 		longest = g_markup_escape_text(closetag, -1);
 		longestlen = strlen(longest);
 	}
-	tmplist = g_list_first(items);
-	while (!runtwo || tmplist) {
+	for (tmplist = g_list_first(items); tmplist; tmplist = g_list_next(tmplist)) {
 		guint len;
-		if (!tmplist) {
-			tmplist = g_list_first(items2);
-			runtwo = TRUE;
-			if (!tmplist)
-				break;
-		}
-		g_assert(tmplist != NULL);
 		g_assert(tmplist->data != NULL);
 		DBG_AUTOCOMP("acwin_calculate_window_size, tmplist=%p", tmplist);
 		DBG_AUTOCOMP(", tmplist->data=%p",tmplist->data);
@@ -463,13 +476,13 @@ acwin_calculate_window_size(Tacwin * acw, GList * items, GList * items2, const g
 		tmp = g_markup_escape_text(tmplist->data, -1);
 		len = strlen(tmp);
 		if (len > longestlen) {
+			g_free(longest);
 			longest = tmp;
 			longestlen = len;
 		} else {
 			g_free(tmp);
 		}
 		(*numitems)++;
-		tmplist = g_list_next(tmplist);
 	}
 	if (longest) {
 		gint len, rowh;
@@ -499,24 +512,94 @@ ac_sort_func(const gchar *a, const gchar *b)
 	return g_strcmp0(a,b);
 }
 
-/* fills the tree */
+static gint
+ac_rank_func(gconstpointer a, gconstpointer b)
+{
+	const Tacfuzzy *fa = a, *fb = b;
+	if (fa->score != fb->score)
+		return fb->score - fa->score;
+	return ac_sort_func(fa->string, fb->string);
+}
+
+/* the items that the user selected recently, in this session, rank higher */
+static void
+autocomp_recent_add(const gchar * string)
+{
+	if (!recent_items)
+		recent_items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_replace(recent_items, g_strdup(string), GUINT_TO_POINTER(++recent_serial));
+}
+
+static gint
+autocomp_recent_score(const gchar * string)
+{
+	guint serial;
+	if (!recent_items)
+		return 0;
+	serial = GPOINTER_TO_UINT(g_hash_table_lookup(recent_items, string));
+	if (!serial || recent_serial - serial >= AUTOCOMP_RECENT)
+		return 0;
+	return AUTOCOMP_RECENT - (recent_serial - serial);
+}
+
 static void
-acwin_fill_tree(Tacwin * acw, GList * items, GList * items2, gchar * closetag, gboolean reverse, gint numitems)
+ranked_add(GArray * ranked, GHashTable * seen, gchar * string, gint score)
 {
-	GList *tmplist, *list = NULL;
-	gint everynth=1, i=0;
+	Tacfuzzy af;
+	if (g_hash_table_lookup(seen, string))
+		return;
+	g_hash_table_insert(seen, string, string);
+	af.string = string;
+	af.score = score + autocomp_recent_score(string);
+	g_array_append_val(ranked, af);
+}
 
-	/* to avoid that we show 10000 items in the autocomplete list, we insert every N items where N % everynth == 0 */
-	if (numitems > 512) {
-		everynth = 1.0 * numitems / 512.0;
-		DBG_AUTOCOMP("numitems=%d, everynth=%d\n", numitems, everynth);
+/* returns the list of completions for prefix, best first: the items that start with prefix,
+followed by the best AUTOCOMP_FUZZY_MAX items that match prefix as an abbreviation (see
+acindex_fuzzy_score()), both ranked by recent use, at most AUTOCOMP_MAX_ITEMS in total */
+static GList *
+autocomp_ranked_items(Tacrange * acrange, Tacrange * identrange, Tacrange * symbolrange, const gchar * prefix)
+{
+	Tacrange *ranges[3] = { acrange, identrange, symbolrange };
+	GArray *ranked = g_array_new(FALSE, FALSE, sizeof(Tacfuzzy));
+	GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+	GList *list = NULL;
+	guint i, j, numfuzzy = 0;
+
+	for (i = 0; i < 3; i++) {
+		for (j = ranges[i]->start; ranges[i]->aci && j < ranges[i]->end; j++)
+			ranked_add(ranked, seen, acindex_item(ranges[i]->aci, j), AUTOCOMP_PREFIX_SCORE);
+	}
+	if (g_utf8_strlen(prefix, -1) >= AUTOCOMP_FUZZY_MIN_PREFIX) {
+		GArray *fuzzy = g_array_new(FALSE, FALSE, sizeof(Tacfuzzy));
+		for (i = 0; i < 3; i++) {
+			if (ranges[i]->aci)
+				acindex_fuzzy(ranges[i]->aci, prefix, fuzzy);
+		}
+		for (j = 0; j < fuzzy->len; j++)
+			ranked_add(ranked, seen, g_array_index(fuzzy, Tacfuzzy, j).string,
+					   g_array_index(fuzzy, Tacfuzzy, j).score);
+		g_array_free(fuzzy, TRUE);
+	}
+	g_hash_table_destroy(seen);
+	g_array_sort(ranked, ac_rank_func);
+	for (i = 0; i < ranked->len && i < AUTOCOMP_MAX_ITEMS; i++) {
+		Tacfuzzy *af = &g_array_index(ranked, Tacfuzzy, i);
+		if (af->score < AUTOCOMP_PREFIX_SCORE && ++numfuzzy > AUTOCOMP_FUZZY_MAX)
+			break;
+		list = g_list_prepend(list, af->string);
 	}
-	if (items)
-		list = g_list_copy(items);
-	if (items2)
-		list = g_list_concat(g_list_copy(items2), list);
+	DBG_AUTOCOMP("autocomp_ranked_items, %d candidates for prefix %s, %d shown\n", ranked->len, prefix, i);
+	g_array_free(ranked, TRUE);
+	return g_list_reverse(list);
+}
+
+/* fills the tree with the ranked items */
+static void
+acwin_fill_tree(Tacwin * acw, GList * items, gchar * closetag, gboolean reverse)
+{
+	GList *tmplist, *list = g_list_copy(items);
 
-	list = g_list_sort(list, (GCompareFunc) ac_sort_func);
 	if (closetag) {
 		GList *tlist2;
 		tlist2 = find_in_stringlist(list, closetag);
@@ -531,29 +614,23 @@ acwin_fill_tree(Tacwin * acw, GList * items, GList * items2, gchar * closetag, g
 		list = g_list_reverse(list);
 		DBG_AUTOCOMP("reverse list!\n");
 	}
-	tmplist = g_list_first(list);
-	while (tmplist) {
-		if (i % everynth == 0) {
-			GtkTreeIter it;
-			gchar *tmp;
-			gtk_list_store_append(acw->store, &it);
-			tmp = g_markup_escape_text(tmplist->data, -1);
-			gtk_list_store_set(acw->store, &it, 0, tmp, 1, tmplist->data, -1);
-			DBG_AUTOCOMP("acwin_fill_tree, add item %s\n",tmp);
-			g_free(tmp);
-		}
-		i++;
-		tmplist = g_list_next(tmplist);
+	for (tmplist = g_list_first(list); tmplist; tmplist = g_list_next(tmplist)) {
+		GtkTreeIter it;
+		gchar *tmp;
+		gtk_list_store_append(acw->store, &it);
+		tmp = g_markup_escape_text(tmplist->data, -1);
+		gtk_list_store_set(acw->store, &it, 0, tmp, 1, tmplist->data, -1);
+		DBG_AUTOCOMP("acwin_fill_tree, add item %s\n",tmp);
+		g_free(tmp);
 	}
 	g_list_free(list);
 }
 
-/* static void print_ac_items(GCompletion *gc) {
-	GList *tmplist = g_list_first(gc->items);
-	DBG_AUTOCOMP("autocompletion has %d items:",g_list_length(g_list_first(gc->items)));
-	while (tmplist) {
-		DBG_AUTOCOMP(" %s",(char *)tmplist->data);
-		tmplist = g_list_next(tmplist);
+/* static void print_ac_items(Tacindex *aci) {
+	guint i;
+	DBG_AUTOCOMP("autocompletion has %d items:",acindex_length(aci));
+	for (i = 0; i < acindex_length(aci); i++) {
+		DBG_AUTOCOMP(" %s",acindex_item(aci, i));
 	}
 	DBG_AUTOCOMP("\n");
 } */
@@ -609,11 +686,10 @@ autocomp_run(BluefishTextView * btv, gboolean user_requested)
 
 	if (g_array_index(master->bflang->st->contexts, Tcontext, contextnum).has_tagclose_from_blockstack) {
 		Tfound *found;
-		GSequenceIter *siter = NULL;
-		found = get_foundcache_at_offset(master, gtk_text_iter_get_offset(&cursorpos), &siter);
+		found = get_foundcache_at_offset(master, gtk_text_iter_get_offset(&cursorpos));
 		if (found) {
 			fblock =
-				found->numblockchange < 0 ? pop_blocks(found->numblockchange, found->fblock) : found->fblock;
+				found->numblockchange < 0 ? pop_blocks(master, found->numblockchange, found_fblock(master, found)) : found_fblock(master, found);
 			if (fblock && fblock->start2_o != BF_OFFSET_UNDEFINED) {
 				g_print("abort offering closing tag: block has an end already\n");
 				fblock = NULL;
@@ -638,10 +714,22 @@ autocomp_run(BluefishTextView * btv, gboolean user_requested)
 		) {
 		/* we have a prefix or it is user requested, and we have a context with autocompletion or we have blockstack-tag-auto-closing */
 		gchar *newprefix = NULL, *prefix, *closetag = NULL;
-		GList *items = NULL, *items2 = NULL;
+		GList *items = NULL;
+		Tacrange acrange, identrange, symbolrange;
 		/*print_ac_items(g_array_index(btv->bflang->st->contexts,Tcontext, contextnum).ac); */
 
 		prefix = gtk_text_buffer_get_text(btv->buffer, &iter, &cursorpos, TRUE);
+		if (btv->autocomp && ACWIN(btv->autocomp)->contextnum == contextnum && ACWIN(btv->autocomp)->prefix
+			&& g_str_has_prefix(prefix, ACWIN(btv->autocomp)->prefix)) {
+			/* the user typed more characters, only search the items that matched the shorter prefix */
+			acrange = ACWIN(btv->autocomp)->acrange;
+			identrange = ACWIN(btv->autocomp)->identrange;
+			symbolrange = ACWIN(btv->autocomp)->symbolrange;
+		} else {
+			memset(&acrange, 0, sizeof(Tacrange));
+			memset(&identrange, 0, sizeof(Tacrange));
+			memset(&symbolrange, 0, sizeof(Tacrange));
+		}
 
 		if (fblock) {
 			GString *tmpstr;
@@ -666,29 +754,39 @@ autocomp_run(BluefishTextView * btv, gboolean user_requested)
 			}
 		}
 		if (g_array_index(master->bflang->st->contexts, Tcontext, contextnum).ac) {
-			items =
-				g_completion_complete(g_array_index(master->bflang->st->contexts, Tcontext, contextnum).ac,
-									  prefix, &newprefix);
+			acindex_complete(g_array_index(master->bflang->st->contexts, Tcontext, contextnum).ac, prefix,
+							 &acrange, TRUE);
+			newprefix = acrange_common_prefix(&acrange, prefix);
 			DBG_AUTOCOMP("got %d autocompletion items for prefix %s in context %d, newprefix=%s\n",
-						 g_list_length(items), prefix, contextnum, newprefix);
+						 acrange_length(&acrange), prefix, contextnum, newprefix);
 #ifdef IDENTSTORING
 			{
-				GCompletion *compl = identifier_ac_get_completion(master, contextnum, FALSE);
-				DBG_IDENTIFIER("got completion %p for context %d\n", compl, contextnum);
-				if (compl) {
-					gchar *newprefix2 = NULL;
-					items2 = g_completion_complete(compl, prefix, &newprefix2);
-					DBG_IDENTIFIER("got %d identifier_items for prefix %s, newprefix=%s\n", g_list_length(items2), prefix, newprefix2);
+				Tacindex *aci = identifier_ac_get_index(master, contextnum, FALSE);
+				DBG_IDENTIFIER("got identifier index %p for context %d\n", aci, contextnum);
+				if (aci) {
+					acindex_complete(aci, prefix, &identrange, TRUE);
+					DBG_IDENTIFIER("got %d identifier_items for prefix %s\n", acrange_length(&identrange), prefix);
+					if (!newprefix)
+						newprefix = acrange_common_prefix(&identrange, prefix);
+				} else {
+					/* the range of the previous prefix might refer to an index that was freed */
+					memset(&identrange, 0, sizeof(Tacrange));
+				}
+				aci = symbolindex_ac_get_index(DOCUMENT(master->doc)->bfwin, master->bflang, contextnum);
+				if (aci) {
+					acindex_complete(aci, prefix, &symbolrange, TRUE);
+					DBG_IDENTIFIER("got %d project symbols for prefix %s\n", acrange_length(&symbolrange), prefix);
 					if (!newprefix)
-						newprefix = newprefix2;
-					else
-						g_free(newprefix2);
+						newprefix = acrange_common_prefix(&symbolrange, prefix);
+				} else {
+					/* the project was closed, symbolindex_stop() freed the index */
+					memset(&symbolrange, 0, sizeof(Tacrange));
 				}
 			}
 #endif
+			items = autocomp_ranked_items(&acrange, &identrange, &symbolrange, prefix);
 		}
-		if (closetag || items2
-			|| (items != NULL && (items->next != NULL || strcmp(items->data, prefix) != 0))) {
+		if (closetag || (items != NULL && (items->next != NULL || strcmp(items->data, prefix) != 0))) {
 			/* do not popup if there are 0 items, and also not if there is 1 item which equals the prefix */
 			GtkTreeSelection *selection;
 			GtkTreeIter it;
@@ -707,12 +805,15 @@ autocomp_run(BluefishTextView * btv, gboolean user_requested)
 			}
 			ACWIN(btv->autocomp)->contextnum = contextnum;
 			ACWIN(btv->autocomp)->prefix = g_strdup(prefix);
+			ACWIN(btv->autocomp)->acrange = acrange;
+			ACWIN(btv->autocomp)->identrange = identrange;
+			ACWIN(btv->autocomp)->symbolrange = symbolrange;
 			if (newprefix) {
 				ACWIN(btv->autocomp)->newprefix = g_strdup(newprefix);
 			}
-			acwin_calculate_window_size(ACWIN(btv->autocomp), items, items2, closetag, &numitems);
+			acwin_calculate_window_size(ACWIN(btv->autocomp), items, closetag, &numitems);
 			below = acwin_position_at_cursor(btv);
-			acwin_fill_tree(ACWIN(btv->autocomp), items, items2, closetag, !below, numitems);
+			acwin_fill_tree(ACWIN(btv->autocomp), items, closetag, !below);
 			gtk_widget_show(ACWIN(btv->autocomp)->win);
 			selection = gtk_tree_view_get_selection(ACWIN(btv->autocomp)->tree);
 			if (below)
@@ -733,6 +834,7 @@ autocomp_run(BluefishTextView * btv, gboolean user_requested)
 		} else {
 			acwin_cleanup(btv);
 		}
+		g_list_free(items);
 		g_free(newprefix);
 		g_free(prefix);
 	} else {
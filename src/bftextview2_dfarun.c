@@ -0,0 +1,192 @@
+/* Bluefish HTML Editor
+ * bftextview2_dfarun.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+dfa_run() is the scanning loop. bftextview2_run_scanner(), the large-file mode, the scanning
+thread, the project symbol index and the scanner benchmark all run the DFA with it, and only
+differ in what they do with a match (the callbacks in Tdfarun).
+
+At the current offset (iter_o) we get a character (uc), and lookup the next state (newpos) in the
+DFA of the current context, using the previous state (pos). We do not step a GtkTextIter for every
+character, the text is UTF-8 and walked with pointer p. Characters above 127 cannot be matched
+by the engine, they are scanned as character 1 ("SOH, start of heading"), so a pattern like [^#]*
+still works.
+
+if newpos==0 we have a symbol (see bftextview2.h for an explanation of symbols and identifiers).
+A symbol can be the start or the end of a match, and may be part of the match. So whenever we hit
+a symbol, we set the match start (mstart_o) to the current offset. If we find a symbol again, and
+the previous state has a match, the match runs from mstart_o to the current position.
+
+At the end of the region the DFA is fed a final '\0', so a pattern that ends at the end of the
+region is found as well.
+
+The identifier handling (identmode and identaction of the last pattern that matched) is done
+here, so every user stores exactly the same identifiers as found_identifier() does for an open
+document.
+*/
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+
+/* start_o is the offset of text, the DFA is in its start state there. For a text that is
+fetched in slices, text and text_end are NULL and fetch should be set before dfa_run() */
+void
+dfarun_init(Tdfarun * run, Tscantable * st, GArray * stack, const gchar * text, const gchar * text_end,
+			guint32 start_o, guint32 end_o)
+{
+	memset(run, 0, sizeof(Tdfarun));
+	run->st = st;
+	run->stack = stack;
+	run->p = run->mstart = text;
+	run->text_end = text_end;
+	run->iter_o = run->mstart_o = start_o;
+	run->end_o = end_o;
+	run->context = (stack && stack->len) ? g_array_index(stack, gint16, stack->len - 1) : 1;
+	run->last_character_run = (start_o >= end_o || (text && text >= text_end));
+}
+
+/* a match callback for a run with a context stack, the context stack is changed exactly like
+found_match() changes the stack of Tfoundcontext's */
+gint16
+dfarun_context_change(Tdfarun * run, guint16 patternum, Tpattern * pat)
+{
+	GArray *stack = run->stack;
+	if (pat->nextcontext == 0 || pat->nextcontext == run->context)
+		return run->context;
+	if (pat->nextcontext < 0) {
+		gint num = -1 * pat->nextcontext;
+		while (num > 0 && stack->len > 0) {
+			g_array_set_size(stack, stack->len - 1);
+			num--;
+		}
+		return stack->len ? g_array_index(stack, gint16, stack->len - 1) : 1;
+	}
+	g_array_append_val(stack, pat->nextcontext);
+	return pat->nextcontext;
+}
+
+/* runs the DFA from run->iter_o until the end of the region, or until maxloops steps are done.
+The state is kept in run, so dfa_run() can be called again to continue */
+Tdfarun_status
+dfa_run(Tdfarun * run, guint maxloops)
+{
+	Tcontext *ctx = get_context(run->st, run->context);
+	const gchar *p = run->p;
+	guint32 iter_o = run->iter_o;
+	guint pos = run->pos, newpos, loop = 0;
+	Tdfarun_status status = dfarun_loops;
+
+	while (loop < maxloops) {
+		gunichar uc;
+		gboolean end_of_region;
+		loop++;
+		if (G_UNLIKELY(run->last_character_run)) {
+			uc = '\0';
+		} else {
+			if (G_UNLIKELY(p >= run->text_end)) {
+				/* only with fetch, otherwise the region ends at text_end */
+				run->iter_o = iter_o;
+				run->fetch(run);
+				p = run->p;
+				if (G_UNLIKELY(p >= run->text_end)) {
+					/* the text is shorter than the region */
+					run->end_o = iter_o;
+				}
+			}
+			uc = (guchar) *p;
+			if (G_UNLIKELY(uc > 127))
+				uc = 1;
+		}
+		DBG_SCANNING("scanning offset %d pos %d '%c'=%d ", iter_o, pos, uc, uc);
+		newpos = dfa_next_state(ctx, pos, uc);
+		DBG_SCANNING("(context=%d).. got newpos %d\n", run->context, newpos);
+		if (G_UNLIKELY(newpos == 0 || uc == '\0')) {
+			guint16 patternum = dfa_match(ctx, pos);
+			run->p = p;
+			run->iter_o = iter_o;
+			if (G_UNLIKELY(patternum)) {
+				Tpattern *pat = &g_array_index(run->st->matches, Tpattern, patternum);
+#ifdef IDENTSTORING
+				gint16 oldcontext = run->context;
+				run->identmode = pat->identmode;
+				run->identaction = pat->identaction;
+#endif							/* IDENTSTORING */
+				DBG_SCANNING("we have a match from pos %d to %d\n", run->mstart_o, iter_o);
+				run->context = run->match(run, patternum, pat);
+				ctx = get_context(run->st, run->context);
+#ifdef IDENTSTORING
+				if (G_UNLIKELY(run->identmode == 2 && run->identifier && run->identifier(run, oldcontext)))
+					run->identmode = 0;
+#endif							/* IDENTSTORING */
+			}
+#ifdef IDENTSTORING
+			else if (G_UNLIKELY(run->identmode == 1 && pos == 1 && run->identifier)) {
+				if (run->identifier(run, run->context))
+					run->identmode = 0;
+			}
+#endif							/* IDENTSTORING */
+			if (G_UNLIKELY(run->last_character_run && run->region_end)) {
+				run->region_end(run, (patternum != 0));
+			}
+			if (G_LIKELY(run->mstart_o == iter_o && !run->last_character_run && p < run->text_end)) {
+				p = g_utf8_next_char(p);
+				iter_o++;
+			}
+			run->mstart_o = iter_o;
+			run->mstart = p;
+			newpos = 0;
+			if (run->symbol && !run->last_character_run) {
+				run->p = p;
+				run->iter_o = iter_o;
+				run->pos = 0;
+				if (!run->symbol(run))
+					status = dfarun_stopped;
+			}
+		} else if (G_LIKELY(!run->last_character_run)) {
+			p = g_utf8_next_char(p);
+			iter_o++;
+			if (G_UNLIKELY(newpos == pos) && ctx->skip[pos] && iter_o < run->end_o) {
+				/* a comment or string body, jump to the next character that leaves this state */
+				guint skipped;
+				p = dfa_skip(ctx, pos, p, run->end_o - iter_o, &skipped);
+				iter_o += skipped;
+			}
+		}
+		pos = newpos;
+		/* without fetch there is no text after text_end */
+		end_of_region = (iter_o >= run->end_o || (!run->fetch && p >= run->text_end));
+		if (G_UNLIKELY(end_of_region || run->last_character_run)) {
+			run->last_character_run = !run->last_character_run;
+		}
+		if (G_UNLIKELY(end_of_region && !run->last_character_run)) {
+			status = dfarun_end;
+			break;
+		}
+		if (G_UNLIKELY(status == dfarun_stopped))
+			break;
+	}
+	run->p = p;
+	run->iter_o = iter_o;
+	run->pos = (status == dfarun_stopped) ? 0 : pos;
+	run->loops += loop;
+	return status;
+}
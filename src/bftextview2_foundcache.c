@@ -0,0 +1,449 @@
+/* Bluefish HTML Editor
+ * bftextview2_foundcache.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+the scancache is an array of chunks, every chunk holds up to FOUNDCACHE_CHUNK_SIZE pointers
+to Tfound, sorted by offset. A Tfound pointer can be used as an iterator, its chunk and its
+position in that chunk are found again by its offset, so it stays valid if other entries are
+inserted or removed.
+
+If text is inserted or deleted, the Tfound's after the change in the same chunk are updated
+directly, and the offset is added to Tfoundchunk.delta of every further chunk. The offsets in a
+chunk are compared with the delta added, so a search does not update any chunk. Before a Tfound
+in a chunk is returned, the delta of that chunk is applied to its Tfound's and to the blocks and
+contexts they push (foundcache_make_clean()). The blocks and contexts that are on the stack at
+the start of the chunk were pushed by an earlier chunk, they know that chunk by its id, and the
+chunks on the stack are made clean as well, but none of the chunks in between.
+*/
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_arena.h"
+#include "bftextview2_foundcache.h"
+
+#define get_chunk(fc, num) ((Tfoundchunk *) g_ptr_array_index((fc)->chunks, (num)))
+#define get_chunk_by_id(fc, id) ((Tfoundchunk *) g_ptr_array_index((fc)->byid, (id)))
+/* the offset of the Tfound at index i in chunk, including the delta that is not yet applied */
+#define chunk_offset(chunk, i) ((chunk)->found[(i)]->charoffset_o + (chunk)->delta)
+#define get_fblock(fc, handle) ((Tfoundblock *) arenapool_get(&(fc)->arena->fblock, (handle)))
+#define get_fcontext(fc, handle) ((Tfoundcontext *) arenapool_get(&(fc)->arena->fcontext, (handle)))
+
+static void foundcache_make_clean(Tfoundcache * fc, Tfoundchunk * chunk);
+
+/* sets the chunk id in the block and the context that found pushes */
+static inline void
+found_set_chunkid(Tfoundcache * fc, Tfound * found, guint32 id)
+{
+	if (G_UNLIKELY(IS_FOUNDMODE_CONTEXTPUSH(found)) && found->fcontext)
+		get_fcontext(fc, found->fcontext)->chunkid = id;
+	if (G_UNLIKELY(IS_FOUNDMODE_BLOCKPUSH(found)) && found->fblock)
+		get_fblock(fc, found->fblock)->chunkid = id;
+}
+
+static void
+chunk_set_chunkid(Tfoundcache * fc, Tfoundchunk * chunk, guint16 from)
+{
+	guint16 i;
+	for (i = from; i < chunk->len; i++) {
+		found_set_chunkid(fc, chunk->found[i], chunk->id);
+	}
+}
+
+static void
+chunks_renumber(Tfoundcache * fc, guint from)
+{
+	guint i;
+	for (i = from; i < fc->chunks->len; i++) {
+		get_chunk(fc, i)->pos = i;
+	}
+}
+
+static Tfoundchunk *
+foundcache_new_chunk(Tfoundcache * fc)
+{
+	Tfoundchunk *chunk = g_slice_new0(Tfoundchunk);
+	if (fc->freeids->len) {
+		chunk->id = g_array_index(fc->freeids, guint32, fc->freeids->len - 1);
+		g_array_set_size(fc->freeids, fc->freeids->len - 1);
+		fc->byid->pdata[chunk->id] = chunk;
+	} else {
+		chunk->id = fc->byid->len;
+		g_ptr_array_add(fc->byid, chunk);
+	}
+	return chunk;
+}
+
+/* the same update that foundcache_update_offsets() used to do for every Tfound after the change */
+static void
+chunk_apply_offset(Tfoundcache * fc, Tfoundchunk * chunk, guint16 from, gint32 offset)
+{
+	guint16 i;
+	for (i = from; i < chunk->len; i++) {
+		Tfound *found = chunk->found[i];
+		if (G_UNLIKELY(IS_FOUNDMODE_CONTEXTPUSH(found))) {
+			Tfoundcontext *fcontext = get_fcontext(fc, found->fcontext);
+			if (G_LIKELY(fcontext->start_o != BF_OFFSET_UNDEFINED))
+				fcontext->start_o += offset;
+			if (G_LIKELY(fcontext->end_o != BF_OFFSET_UNDEFINED))
+				fcontext->end_o += offset;
+		}
+		if (G_UNLIKELY(IS_FOUNDMODE_BLOCKPUSH(found))) {
+			Tfoundblock *fblock = get_fblock(fc, found->fblock);
+			if (G_LIKELY(fblock->start1_o != BF_POSITION_UNDEFINED))
+				fblock->start1_o += offset;
+			if (G_LIKELY(fblock->end1_o != BF_POSITION_UNDEFINED))
+				fblock->end1_o += offset;
+			if (G_LIKELY(fblock->start2_o != BF_POSITION_UNDEFINED))
+				fblock->start2_o += offset;
+			if (G_LIKELY(fblock->end2_o != BF_POSITION_UNDEFINED))
+				fblock->end2_o += offset;
+		}
+		found->charoffset_o += offset;
+	}
+}
+
+/* makes the chunk that pushed a block or context on the stack clean. Returns TRUE if the rest
+of the stack is clean, which is the case once an element is found that was pushed by another
+chunk: that chunk is clean, and a clean chunk has a clean stack */
+static inline gboolean
+stack_make_clean(Tfoundcache * fc, Tfoundchunk * chunk, guint32 chunkid)
+{
+	Tfoundchunk *other;
+	if (chunkid == 0 || chunkid == chunk->id)
+		return FALSE;
+	other = get_chunk_by_id(fc, chunkid);
+	if (other->dirty)
+		foundcache_make_clean(fc, other);
+	return TRUE;
+}
+
+/* applies the delta of chunk to its Tfound's, after the blocks and contexts on the stack at the
+start of the chunk are made clean. The stack at the start of the chunk is the stack of its first
+Tfound: a push adds to it, and a pop points to the top of the stack before the pop */
+static void
+foundcache_make_clean(Tfoundcache * fc, Tfoundchunk * chunk)
+{
+	Tfoundblock *fblock;
+	Tfoundcontext *fcontext;
+	if (G_LIKELY(!chunk->dirty))
+		return;
+	for (fblock = get_fblock(fc, chunk->found[0]->fblock); fblock; fblock = get_fblock(fc, fblock->parentfblock)) {
+		if (stack_make_clean(fc, chunk, fblock->chunkid))
+			break;
+	}
+	for (fcontext = get_fcontext(fc, chunk->found[0]->fcontext); fcontext;
+		 fcontext = get_fcontext(fc, fcontext->parentfcontext)) {
+		if (stack_make_clean(fc, chunk, fcontext->chunkid))
+			break;
+	}
+	if (chunk->delta != 0)
+		chunk_apply_offset(fc, chunk, 0, chunk->delta);
+	chunk->delta = 0;
+	chunk->dirty = FALSE;
+}
+
+/* inserts a new chunk after chunk, and moves all entries from position at to the new chunk. chunk
+should be clean */
+static Tfoundchunk *
+foundcache_split_chunk(Tfoundcache * fc, Tfoundchunk * chunk, guint16 at)
+{
+	Tfoundchunk *newchunk = foundcache_new_chunk(fc);
+	guint pos = chunk->pos + 1;
+
+	newchunk->len = chunk->len - at;
+	memcpy(newchunk->found, &chunk->found[at], newchunk->len * sizeof(Tfound *));
+	chunk->len = at;
+	chunk_set_chunkid(fc, newchunk, 0);
+	/* g_ptr_array_insert() needs glib 2.40 */
+	g_ptr_array_set_size(fc->chunks, fc->chunks->len + 1);
+	memmove(&fc->chunks->pdata[pos + 1], &fc->chunks->pdata[pos],
+			(fc->chunks->len - pos - 1) * sizeof(gpointer));
+	fc->chunks->pdata[pos] = newchunk;
+	chunks_renumber(fc, pos);
+	return newchunk;
+}
+
+/* the chunk should be empty */
+static void
+foundcache_remove_chunk(Tfoundcache * fc, Tfoundchunk * chunk)
+{
+	guint pos = chunk->pos;
+	g_ptr_array_remove_index(fc->chunks, pos);
+	chunks_renumber(fc, pos);
+	fc->byid->pdata[chunk->id] = NULL;
+	g_array_append_val(fc->freeids, chunk->id);
+	g_slice_free(Tfoundchunk, chunk);
+}
+
+/* returns the last chunk that starts at or before offset, or the first chunk */
+static Tfoundchunk *
+foundcache_search_chunk(Tfoundcache * fc, guint32 offset)
+{
+	guint lo = 0, hi = fc->chunks->len;
+	if (hi == 0)
+		return NULL;
+	while (hi - lo > 1) {
+		guint mid = (lo + hi) / 2;
+		if (chunk_offset(get_chunk(fc, mid), 0) <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return get_chunk(fc, lo);
+}
+
+/* returns the index of the last Tfound at or before offset, or 0 */
+static guint16
+chunk_search(Tfoundchunk * chunk, guint32 offset)
+{
+	guint16 lo = 0, hi = chunk->len;
+	while (hi - lo > 1) {
+		guint16 mid = (lo + hi) / 2;
+		if (chunk_offset(chunk, mid) <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* finds the chunk and the index in that chunk of found, by its offset. More Tfound's can have
+the same offset, even in different chunks, so it searches from the first one with that offset */
+static Tfoundchunk *
+foundcache_locate(Tfoundcache * fc, Tfound * found, guint16 * idx)
+{
+	guint lo = 0, hi = fc->chunks->len, pos;
+	/* the first chunk that ends at or after the offset of found */
+	while (lo < hi) {
+		guint mid = (lo + hi) / 2;
+		Tfoundchunk *chunk = get_chunk(fc, mid);
+		if (chunk_offset(chunk, chunk->len - 1) < found->charoffset_o)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (pos = lo; pos < fc->chunks->len; pos++) {
+		Tfoundchunk *chunk = get_chunk(fc, pos);
+		guint16 i = 0;
+		if (pos == lo) {
+			/* the first Tfound in the chunk with the offset of found */
+			guint16 last = chunk->len - 1;
+			while (i < last) {
+				guint16 mid = (i + last) / 2;
+				if (chunk_offset(chunk, mid) < found->charoffset_o)
+					i = mid + 1;
+				else
+					last = mid;
+			}
+		}
+		for (; i < chunk->len; i++) {
+			if (chunk->found[i] == found) {
+				*idx = i;
+				return chunk;
+			}
+			if (chunk_offset(chunk, i) > found->charoffset_o)
+				break;
+		}
+		if (i < chunk->len)
+			break;
+	}
+	/* the offset of found is outdated, which happens if it was kept while the text changed */
+	DEBUG_MSG("foundcache_locate, found %p with offset %d is not at its offset\n", found, found->charoffset_o);
+	for (pos = 0; pos < fc->chunks->len; pos++) {
+		Tfoundchunk *chunk = get_chunk(fc, pos);
+		guint16 i;
+		for (i = 0; i < chunk->len; i++) {
+			if (chunk->found[i] == found) {
+				*idx = i;
+				return chunk;
+			}
+		}
+	}
+	g_warning("foundcache_locate, found %p is not in the scancache\n", found);
+	return NULL;
+}
+
+Tfoundcache *
+foundcache_new(Tscanarena * arena)
+{
+	Tfoundcache *fc = g_slice_new0(Tfoundcache);
+	fc->chunks = g_ptr_array_new();
+	fc->byid = g_ptr_array_new();
+	/* id 0 means that a block or context is not pushed by a Tfound in the cache */
+	g_ptr_array_add(fc->byid, NULL);
+	fc->freeids = g_array_new(FALSE, FALSE, sizeof(guint32));
+	fc->arena = arena;
+	return fc;
+}
+
+/* removes all entries, but does not free the Tfound's, they are owned by the Tscanarena */
+void
+foundcache_clear(Tfoundcache * fc)
+{
+	guint i;
+	for (i = 0; i < fc->chunks->len; i++) {
+		g_slice_free(Tfoundchunk, get_chunk(fc, i));
+	}
+	g_ptr_array_set_size(fc->chunks, 0);
+	g_ptr_array_set_size(fc->byid, 1);
+	g_array_set_size(fc->freeids, 0);
+	fc->length = 0;
+}
+
+void
+foundcache_free(Tfoundcache * fc)
+{
+	foundcache_clear(fc);
+	g_ptr_array_free(fc->chunks, TRUE);
+	g_ptr_array_free(fc->byid, TRUE);
+	g_array_free(fc->freeids, TRUE);
+	g_slice_free(Tfoundcache, fc);
+}
+
+Tfound *
+foundcache_first(Tfoundcache * fc)
+{
+	if (fc->chunks->len == 0)
+		return NULL;
+	foundcache_make_clean(fc, get_chunk(fc, 0));
+	return get_chunk(fc, 0)->found[0];
+}
+
+Tfound *
+foundcache_next(Tfoundcache * fc, Tfound * found)
+{
+	guint16 idx;
+	Tfoundchunk *chunk = foundcache_locate(fc, found, &idx);
+	if (!chunk)
+		return NULL;
+	if (G_LIKELY(idx + 1 < chunk->len)) {
+		foundcache_make_clean(fc, chunk);
+		return chunk->found[idx + 1];
+	}
+	if (chunk->pos + 1 >= fc->chunks->len)
+		return NULL;
+	chunk = get_chunk(fc, chunk->pos + 1);
+	foundcache_make_clean(fc, chunk);
+	return chunk->found[0];
+}
+
+/* returns the last Tfound with charoffset_o <= offset. If there is none, the first Tfound is returned */
+Tfound *
+foundcache_search(Tfoundcache * fc, guint32 offset)
+{
+	Tfoundchunk *chunk = foundcache_search_chunk(fc, offset);
+	if (!chunk)
+		return NULL;
+	foundcache_make_clean(fc, chunk);
+	return chunk->found[chunk_search(chunk, offset)];
+}
+
+void
+foundcache_insert(Tfoundcache * fc, Tfound * found)
+{
+	Tfoundchunk *chunk = foundcache_search_chunk(fc, found->charoffset_o);
+	guint16 idx;
+
+	if (!chunk) {
+		chunk = foundcache_new_chunk(fc);
+		g_ptr_array_add(fc->chunks, chunk);
+		idx = 0;
+	} else {
+		foundcache_make_clean(fc, chunk);
+		idx = chunk_search(chunk, found->charoffset_o);
+		if (chunk->found[idx]->charoffset_o <= found->charoffset_o)
+			idx++;
+		if (G_UNLIKELY(chunk->len == FOUNDCACHE_CHUNK_SIZE)) {
+			if (idx == chunk->len) {
+				if (chunk->pos + 1 < fc->chunks->len
+					&& get_chunk(fc, chunk->pos + 1)->len < FOUNDCACHE_CHUNK_SIZE) {
+					chunk = get_chunk(fc, chunk->pos + 1);
+					foundcache_make_clean(fc, chunk);
+				} else {
+					/* appending, usually during scanning, so start a new empty chunk */
+					chunk = foundcache_split_chunk(fc, chunk, chunk->len);
+				}
+				idx = 0;
+			} else {
+				Tfoundchunk *newchunk = foundcache_split_chunk(fc, chunk, FOUNDCACHE_CHUNK_SIZE / 2);
+				if (idx > FOUNDCACHE_CHUNK_SIZE / 2) {
+					chunk = newchunk;
+					idx -= FOUNDCACHE_CHUNK_SIZE / 2;
+				}
+			}
+		}
+	}
+	memmove(&chunk->found[idx + 1], &chunk->found[idx], (chunk->len - idx) * sizeof(Tfound *));
+	chunk->found[idx] = found;
+	chunk->len++;
+	found_set_chunkid(fc, found, chunk->id);
+	fc->length++;
+}
+
+/* removes found from the cache, but does not free it. Pointers to other Tfound's stay valid */
+void
+foundcache_remove(Tfoundcache * fc, Tfound * found)
+{
+	guint16 idx;
+	Tfoundchunk *chunk = foundcache_locate(fc, found, &idx);
+
+	if (!chunk)
+		return;
+	foundcache_make_clean(fc, chunk);
+	found_set_chunkid(fc, found, 0);
+	chunk->len--;
+	memmove(&chunk->found[idx], &chunk->found[idx + 1], (chunk->len - idx) * sizeof(Tfound *));
+	fc->length--;
+	if (chunk->len == 0) {
+		foundcache_remove_chunk(fc, chunk);
+	} else if (chunk->len < FOUNDCACHE_CHUNK_SIZE / 4 && chunk->pos + 1 < fc->chunks->len) {
+		/* merge small chunks, else a lot of removals leave us with a lot of nearly empty chunks */
+		Tfoundchunk *next = get_chunk(fc, chunk->pos + 1);
+		if (chunk->len + next->len <= FOUNDCACHE_CHUNK_SIZE / 2) {
+			guint16 oldlen = chunk->len;
+			foundcache_make_clean(fc, next);
+			memcpy(&chunk->found[oldlen], next->found, next->len * sizeof(Tfound *));
+			chunk->len += next->len;
+			chunk_set_chunkid(fc, chunk, oldlen);
+			next->len = 0;
+			foundcache_remove_chunk(fc, next);
+		}
+	}
+}
+
+/* adds offset to found and all Tfound's after found. Only the chunk of found is updated directly,
+all further chunks get the offset in their delta */
+void
+foundcache_shift(Tfoundcache * fc, Tfound * found, gint32 offset)
+{
+	guint16 idx;
+	guint i;
+	Tfoundchunk *chunk = foundcache_locate(fc, found, &idx);
+	if (!chunk)
+		return;
+	foundcache_make_clean(fc, chunk);
+	chunk_apply_offset(fc, chunk, idx, offset);
+	for (i = chunk->pos + 1; i < fc->chunks->len; i++) {
+		get_chunk(fc, i)->delta += offset;
+		get_chunk(fc, i)->dirty = TRUE;
+	}
+}
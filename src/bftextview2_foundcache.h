@@ -0,0 +1,58 @@
+/* Bluefish HTML Editor
+ * bftextview2_foundcache.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_FOUNDCACHE_H_
+#define _BFTEXTVIEW2_FOUNDCACHE_H_
+
+#include "bftextview2_private.h"
+#include "bftextview2_arena.h"
+
+#define FOUNDCACHE_CHUNK_SIZE 128
+
+typedef struct {
+	Tfound *found[FOUNDCACHE_CHUNK_SIZE];
+	guint pos;					/* the index of this chunk in Tfoundcache.chunks */
+	guint32 id;					/* the index of this chunk in Tfoundcache.byid, stored in the blocks and contexts it pushes */
+	gint32 delta;				/* an offset change that is not yet applied to the Tfound's in this chunk */
+	guint16 len;
+	gboolean dirty;				/* the delta changed since this chunk was made clean, also if it added up to 0 */
+} Tfoundchunk;
+
+typedef struct {
+	GPtrArray *chunks;			/* array of Tfoundchunk, sorted by offset */
+	GPtrArray *byid;			/* Tfoundchunk by id, NULL for an unused id */
+	GArray *freeids;			/* the unused ids (guint32) in byid */
+	Tscanarena *arena;			/* the arena of the blocks and contexts, to find their parents */
+	guint length;				/* the number of Tfound's in all chunks */
+} Tfoundcache;
+
+Tfoundcache *foundcache_new(Tscanarena * arena);
+void foundcache_free(Tfoundcache * fc);
+void foundcache_clear(Tfoundcache * fc);
+Tfound *foundcache_first(Tfoundcache * fc);
+Tfound *foundcache_next(Tfoundcache * fc, Tfound * found);
+Tfound *foundcache_search(Tfoundcache * fc, guint32 offset);
+void foundcache_insert(Tfoundcache * fc, Tfound * found);
+void foundcache_remove(Tfoundcache * fc, Tfound * found);
+void foundcache_shift(Tfoundcache * fc, Tfound * found, gint32 offset);
+
+#define foundcache_length(fc) ((fc)->length)
+
+#endif							/* _BFTEXTVIEW2_FOUNDCACHE_H_ */
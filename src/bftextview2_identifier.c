@@ -49,7 +49,7 @@ static void
 identifier_jump_key_free(gpointer p)
 {
 	DBG_IDENTIFIER("identifier_jump_key_free %p\n", p);
-	g_free(JUMPKEY(p)->name);
+	/* the name is owned by the Tidentname */
 	g_slice_free(Tjumpkey, p);
 }
 
@@ -78,62 +78,85 @@ identifier_ac_hash(gconstpointer v)
 }
 
 static void
-identifier_ac_key_free(gpointer p)
+identifier_name_free(gpointer p)
 {
-	DBG_IDENTIFIER("identifier_ac_key_free\n");
-	g_slice_free(Tackey, p);
+	g_free(IDENTNAME(p)->name);
+	g_slice_free(Tidentname, p);
 }
 
 static void
-identifier_ac_data_free(gpointer p)
+identifier_set_free(gpointer p)
 {
-	DBG_IDENTIFIER("identifier_ac_data_free\n");
-	g_completion_free(p);
+	DBG_IDENTIFIER("identifier_set_free %p\n", p);
+	acindex_free(IDENTSET(p)->aci);
+	g_hash_table_destroy(IDENTSET(p)->names);
+	g_slice_free(Tidentset, p);
 }
 
-static gboolean
-identifier_remove_by_doc(gpointer key, gpointer value, gpointer user_data)
+static void
+identifier_doc_free(gpointer p)
+{
+	DBG_IDENTIFIER("identifier_doc_free %p\n", p);
+	g_ptr_array_free(IDENTDOC(p)->jumpnames, TRUE);
+	g_hash_table_destroy(IDENTDOC(p)->acnames);
+	g_slice_free(Tidentdoc, p);
+}
+
+static void
+identifier_name_unref(Tidentname * in)
 {
-	if (JUMPDATA(value)->doc == user_data)
-		return TRUE;
-	return FALSE;
+	in->refcount--;
+	if (in->refcount == 0) {
+		DBG_IDENTIFIER("identifier_name_unref, free %s\n", in->name);
+		/* the destroy function of the names hashtable frees in */
+		g_hash_table_remove(in->set->names, in->name);
+	}
 }
 
 void
 bftextview2_identifier_hash_remove_doc(gpointer bfwin, gpointer doc)
 {
+	Tidentdoc *idoc;
 	GHashTableIter iter;
-	gpointer key, value;
-	DBG_IDENTIFIER("bftextview2_identifier_hash_remove_doc, start for bfwin=%p, doc=%p\n", bfwin, doc);
-	/* iterate of the jump table to find the strings that have to be removed
-	   from the GCompletion structures in the autocompletion table */
-	g_hash_table_iter_init(&iter, BFWIN(bfwin)->identifier_jump);
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		if (JUMPDATA(value)->doc == doc) {
-			Tackey iak;
-			GCompletion *compl;
+	gpointer key;
+	guint i;
 
-			iak.bflang = JUMPKEY(key)->bflang;
-			iak.context = JUMPKEY(key)->context;
-			compl = g_hash_table_lookup(BFWIN(bfwin)->identifier_ac, &iak);
-			if (compl) {
-				GList *items = g_list_append(NULL, JUMPKEY(key)->name);
-				DBG_IDENTIFIER("remove item %p(%s)\n", JUMPKEY(key)->name, JUMPKEY(key)->name);
-				g_completion_remove_items(compl, items);
-				g_list_free(items);
-			}
+	idoc = g_hash_table_lookup(BFWIN(bfwin)->identifier_docs, doc);
+	if (!idoc)
+		return;
+	DBG_IDENTIFIER("bftextview2_identifier_hash_remove_doc, remove %d jump and %d autocompletion names for doc=%p\n",
+				   idoc->jumpnames->len, g_hash_table_size(idoc->acnames), doc);
+	/* only what this document added is visited, the other documents are not touched */
+	for (i = 0; i < idoc->jumpnames->len; i++) {
+		Tidentname *in = g_ptr_array_index(idoc->jumpnames, i);
+		Tjumpkey ijk;
+		ijk.bflang = in->set->key.bflang;
+		ijk.context = in->set->key.context;
+		ijk.name = in->name;
+		g_hash_table_remove(BFWIN(bfwin)->identifier_jump, &ijk);
+		identifier_name_unref(in);
+	}
+	g_hash_table_iter_init(&iter, idoc->acnames);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		Tidentname *in = key;
+		in->acrefcount--;
+		if (in->acrefcount == 0) {
+			DBG_IDENTIFIER("remove item %p(%s)\n", in->name, in->name);
+			acindex_remove(in->set->aci, in->name);
 		}
+		identifier_name_unref(in);
 	}
-
-	g_hash_table_foreach_remove(BFWIN(bfwin)->identifier_jump, identifier_remove_by_doc, doc);
-	DBG_IDENTIFIER("bftextview2_identifier_hash_remove_doc, done for bfwin=%p, doc=%p\n", bfwin, doc);
+	g_hash_table_remove(BFWIN(bfwin)->identifier_docs, doc);
 }
 
 void
 bftextview2_identifier_hash_destroy(gpointer bfwin)
 {
+	/* the jump keys and the documents point to the names in the sets, so the sets go last */
 	g_hash_table_destroy(BFWIN(bfwin)->identifier_jump);
 	BFWIN(bfwin)->identifier_jump = NULL;
+	g_hash_table_destroy(BFWIN(bfwin)->identifier_docs);
+	BFWIN(bfwin)->identifier_docs = NULL;
 	g_hash_table_destroy(BFWIN(bfwin)->identifier_ac);
 	BFWIN(bfwin)->identifier_ac = NULL;
 }
@@ -144,9 +167,11 @@ bftextview2_identifier_hash_init(gpointer bfwin)
 	BFWIN(bfwin)->identifier_jump =
 		g_hash_table_new_full(identifier_jump_hash, identifier_jump_equal, identifier_jump_key_free,
 							  identifier_jump_data_free);
+	/* the key is a member of the Tidentset */
 	BFWIN(bfwin)->identifier_ac =
-		g_hash_table_new_full(identifier_ac_hash, identifier_ac_equal, identifier_ac_key_free,
-							  identifier_ac_data_free);
+		g_hash_table_new_full(identifier_ac_hash, identifier_ac_equal, NULL, identifier_set_free);
+	BFWIN(bfwin)->identifier_docs =
+		g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, identifier_doc_free);
 }
 
 Tjumpdata *
@@ -168,7 +193,7 @@ identifier_jumpkey_new(gpointer bflang, gint16 context, gchar * name)
 	Tjumpkey *ijk = g_slice_new0(Tjumpkey);
 	ijk->bflang = bflang;
 	ijk->context = context;
-	ijk->name = name;			/* don't dup the string, we allocate that memory only once and re-use the same block in the completion and in this key  */
+	ijk->name = name;			/* don't dup the string, it is the interned string from the Tidentname */
 	return ijk;
 }
 
@@ -181,80 +206,119 @@ identifier_jumpdata_new(Tdocument * doc, guint line)
 	return ijd;
 }
 
-GCompletion *
-identifier_ac_get_completion(BluefishTextView * btv, gint16 context, gboolean create)
+static Tidentset *
+identifier_set_get(BluefishTextView * btv, gint16 context, gboolean create)
 {
 	Tackey iak;
-	GCompletion *compl;
+	Tidentset *set;
 	iak.bflang = btv->bflang;
 	iak.context = context;
-	compl = g_hash_table_lookup(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_ac, &iak);
-	if (!compl && create) {
-		Tackey *iakp = g_slice_new0(Tackey);
-		*iakp = iak;
-		compl = g_completion_new(NULL);
-		g_hash_table_insert(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_ac, iakp, compl);
+	set = g_hash_table_lookup(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_ac, &iak);
+	if (!set && create) {
+		set = g_slice_new0(Tidentset);
+		set->key = iak;
+		set->aci = acindex_new(FALSE);
+		acindex_finish(set->aci);
+		/* the key is the name in the Tidentname */
+		set->names = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, identifier_name_free);
+		g_hash_table_insert(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_ac, &set->key, set);
 	}
-	return compl;
+	return set;
 }
 
-void
-found_identifier(BluefishTextView * btv, GtkTextIter * start, GtkTextIter * end, gint16 context, guint8 identaction)
+Tacindex *
+identifier_ac_get_index(BluefishTextView * btv, gint16 context, gboolean create)
 {
-	Tjumpkey *ijk;
-	Tjumpdata *ijd, *oldijd;
-	GCompletion *compl;
-	gchar *tmp;
-	GList *items;
-	gboolean freetmp=TRUE;
+	Tidentset *set = identifier_set_get(btv, context, create);
+	return set ? set->aci : NULL;
+}
 
-	tmp = gtk_text_buffer_get_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(btv)), start, end, TRUE);
-	DBG_IDENTIFIER("found identifier %s at %p, identaction=%d\n", tmp, tmp, identaction);
+Tidentdoc *
+identifier_doc_get(BluefishTextView * btv)
+{
+	return g_hash_table_lookup(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_docs, btv->doc);
+}
+
+/* returns the interned Tidentname for tmp, which is newly allocated memory that is either stored or freed */
+static Tidentname *
+identifier_intern(Tidentset * set, gchar * tmp)
+{
+	Tidentname *in = g_hash_table_lookup(set->names, tmp);
+	if (in) {
+		g_free(tmp);
+		return in;
+	}
+	in = g_slice_new0(Tidentname);
+	in->name = tmp;
+	in->set = set;
+	g_hash_table_insert(set->names, in->name, in);
+	return in;
+}
+
+/* stores identifier tmp, which is newly allocated memory that is either stored or freed */
+static void
+identifier_store(BluefishTextView * btv, gchar * tmp, guint line, gint16 context, guint8 identaction)
+{
+	Tbfwin *bfwin = BFWIN(DOCUMENT(btv->doc)->bfwin);
+	Tidentdoc *idoc;
+	Tidentname *in;
+
+	DBG_IDENTIFIER("store identifier %s at %p, identaction=%d\n", tmp, tmp, identaction);
+	idoc = g_hash_table_lookup(bfwin->identifier_docs, btv->doc);
+	if (!idoc) {
+		idoc = g_slice_new0(Tidentdoc);
+		idoc->jumpnames = g_ptr_array_new();
+		idoc->acnames = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_hash_table_insert(bfwin->identifier_docs, btv->doc, idoc);
+	}
+	in = identifier_intern(identifier_set_get(btv, context, TRUE), tmp);
+	/* a new name has refcount 0, and every reference that is added below increments it */
+	in->refcount++;
 	if (identaction & 1) {
-		ijk = identifier_jumpkey_new(btv->bflang, context, tmp);
-		oldijd = g_hash_table_lookup(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_jump, ijk);
+		Tjumpkey ijk;
+		Tjumpdata *oldijd;
+		ijk.bflang = btv->bflang;
+		ijk.context = context;
+		ijk.name = in->name;
+		oldijd = g_hash_table_lookup(bfwin->identifier_jump, &ijk);
 		if (oldijd) {
-			DBG_IDENTIFIER("found identifier, %s already exists\n", tmp);
-			/* it exists, now only update the line number, don't add to the completion */
+			DBG_IDENTIFIER("found identifier, %s already exists\n", in->name);
+			/* it exists, only the document that owns the jump key updates the line number */
 			if (oldijd->doc == btv->doc)
-				oldijd->line = gtk_text_iter_get_line(end) + 1;
-			identifier_jump_key_free(ijk);	/* that will free tmp as well */
-			return; /* if it has identaction 2 it should exist in the completion already */
+				oldijd->line = line;
 		} else {
-			DBG_IDENTIFIER("found identifier, %s is new\n", tmp);
-			ijd = identifier_jumpdata_new(DOCUMENT(btv->doc), gtk_text_iter_get_line(end) + 1);
-			g_hash_table_insert(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_jump, ijk, ijd);
-			freetmp=FALSE;
+			DBG_IDENTIFIER("found identifier, %s is new\n", in->name);
+			g_hash_table_insert(bfwin->identifier_jump, identifier_jumpkey_new(btv->bflang, context, in->name),
+								identifier_jumpdata_new(DOCUMENT(btv->doc), line));
+			g_ptr_array_add(idoc->jumpnames, in);
+			in->refcount++;
 		}
 	}
-	if (identaction & 2) {
-		gboolean havecompl=FALSE;
-		DBG_IDENTIFIER("freetmp=%d for identifier %s\n", freetmp, tmp);
-		compl = identifier_ac_get_completion(btv, context, TRUE);
-		if (freetmp!=FALSE) { /* if tmp was new as jumpkey, it cannot exist in the autocompletion, so we don't have to check it */
-			/* see if we have this item already */
-			GList *tmplist;
-			DBG_IDENTIFIER("look if %s is in the autocompletion list\n", tmp);
-			for (tmplist=g_list_first(compl->items);tmplist;tmplist=g_list_next(tmplist)) {
-				if (g_strcmp0(tmp, tmplist->data)==0) {
-					havecompl=TRUE;
-					DBG_IDENTIFIER("identifier %s exists already\n", tmp);
-					break;
-				}
-			}
-		}
-		if (!havecompl) {
-			items = g_list_prepend(NULL, tmp);
-			DBG_IDENTIFIER("add identifier %s to completion %p for context %d\n",tmp,compl,context);
-			g_completion_add_items(compl, items);
-			g_list_free(items);
-			freetmp=FALSE;
+	if ((identaction & 2) && !g_hash_table_lookup(idoc->acnames, in)) {
+		g_hash_table_insert(idoc->acnames, in, in);
+		in->refcount++;
+		in->acrefcount++;
+		if (in->acrefcount == 1) {
+			DBG_IDENTIFIER("added identifier %s to index %p for context %d\n", in->name, in->set->aci, context);
+			acindex_insert(in->set->aci, in->name);
 		}
 	}
-	if (freetmp) {
-		DBG_IDENTIFIER("tmp is not stored somewhere, free tmp\n");
-		g_free(tmp);
-	}
+	identifier_name_unref(in);
+}
+
+void
+found_identifier(BluefishTextView * btv, GtkTextIter * start, GtkTextIter * end, gint16 context, guint8 identaction)
+{
+	gchar *tmp = gtk_text_buffer_get_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(btv)), start, end, TRUE);
+	DBG_IDENTIFIER("found identifier %s at %p, identaction=%d\n", tmp, tmp, identaction);
+	identifier_store(btv, tmp, gtk_text_iter_get_line(end) + 1, context, identaction);
+}
+
+/* used to restore the identifiers of a document without scanning it, see bftextview2_sccache.c */
+void
+identifier_restore(BluefishTextView * btv, const gchar * name, guint line, gint16 context, guint8 identaction)
+{
+	identifier_store(btv, g_strdup(name), line, context, identaction);
 }
 
 #endif							/* IDENTSTORING */
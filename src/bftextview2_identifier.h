@@ -22,6 +22,7 @@
 #define _BFTEXTVIEW2_IDENTIFIER_H_
 
 #include "bftextview2.h"
+#include "bftextview2_acindex.h"
 
 typedef struct {
 	gpointer doc;
@@ -42,6 +43,29 @@ typedef struct {
 } Tackey;
 #define ACKEY(var) ((Tackey *)var)
 
+/* the interned identifiers for one bflang-context, the value in bfwin->identifier_ac */
+typedef struct {
+	Tackey key;
+	Tacindex *aci;				/* the names with acrefcount > 0, sorted for autocompletion */
+	GHashTable *names;			/* name -> Tidentname */
+} Tidentset;
+#define IDENTSET(var) ((Tidentset *)var)
+
+typedef struct {
+	gchar *name;				/* shared by the jump key and the autocompletion index */
+	Tidentset *set;
+	guint refcount;				/* the jump keys plus the documents that hold it for autocompletion */
+	guint acrefcount;			/* the documents that hold it for autocompletion */
+} Tidentname;
+#define IDENTNAME(var) ((Tidentname *)var)
+
+/* what a document added, the value in bfwin->identifier_docs */
+typedef struct {
+	GPtrArray *jumpnames;		/* Tidentname's whose jump key points to this document */
+	GHashTable *acnames;		/* Tidentname -> Tidentname, held by this document for autocompletion */
+} Tidentdoc;
+#define IDENTDOC(var) ((Tidentdoc *)var)
+
 void bftextview2_identifier_hash_remove_doc(gpointer bfwin, gpointer doc);
 void bftextview2_identifier_hash_destroy(gpointer bfwin);
 void bftextview2_identifier_hash_init(gpointer bfwin);
@@ -52,7 +76,9 @@ Tjumpdata *bftextview2_lookup_identifier(gpointer bfwin, BluefishTextView * btv,
 
 
 /* only called internally within bftextview2 */
-GCompletion *identifier_ac_get_completion(BluefishTextView * btv, gint16 context, gboolean create);
+Tacindex *identifier_ac_get_index(BluefishTextView * btv, gint16 context, gboolean create);
+Tidentdoc *identifier_doc_get(BluefishTextView * btv);
 void found_identifier(BluefishTextView * btv, GtkTextIter * start, GtkTextIter * end, gint16 context, guint8 identaction);
+void identifier_restore(BluefishTextView * btv, const gchar * name, guint line, gint16 context, guint8 identaction);
 
 #endif							/* _BFTEXTVIEW2_IDENTIFIER_H_ */
@@ -27,6 +27,7 @@
 #include "bftextview2_private.h"
 #include "bftextview2_langmgr.h"
 #include "bftextview2_patcompile.h"
+#include "bftextview2_stcache.h"
 
 #include "bluefish.h"
 #include "bf_lib.h"
@@ -1053,7 +1054,7 @@ process_scanning_tag(xmlTextReaderPtr reader, Tbflangparsing * bfparser, guint16
 				   because a tag can also have a reference, but it is a start  */
 				contexttag = GPOINTER_TO_INT(g_hash_table_lookup(bfparser->contexts, attrib_context_id));
 				if (contexttag) {
-				   g_print("HIT for %s, saves %ld bytes\n",attrib_context_id, (long int)((GArray *)g_array_index(bfparser->st->contexts, Tcontext, contexttag).table)->len*sizeof(Ttablerow));
+				   g_print("HIT for %s, saves compiling %d patterns\n",attrib_context_id, g_array_index(bfparser->st->contexts, Tcontext, contexttag).pending ? g_array_index(bfparser->st->contexts, Tcontext, contexttag).pending->len : 0);
 				}
 			}
 			tmp = g_strconcat("<", tag, NULL);
@@ -1487,49 +1488,57 @@ process_scanning_context(xmlTextReaderPtr reader, Tbflangparsing * bfparser, GQu
 	return context;
 }
 
-static gpointer
-build_lang_thread(gpointer data)
+/* all options that are set for this language, this decides which parts of the bflang2 file are compiled */
+static gchar *
+bflang_options_string(Tbflang * bflang)
 {
-	xmlTextReaderPtr reader;
-	Tbflang *bflang = data;
-	Tbflangparsing *bfparser;
-	const gchar *tmp;
-	GList *tmplist;
-
-	bfparser = g_slice_new0(Tbflangparsing);
-	bfparser->patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-	bfparser->contexts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-	/*bfparser->setoptions =  g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL); */
-	bfparser->bflang = bflang;
-	/*for(tmplist = g_list_first(bfparser->bflang->setoptions);tmplist;tmplist=g_list_next(tmplist)) {
-	   g_hash_table_insert(bfparser->setoptions,g_strdup(tmplist->data),GINT_TO_POINTER(1));
-	   } */
-	bfparser->st = scantable_new(bflang->size_table, bflang->size_matches, bflang->size_contexts);
-	bfparser->commentid_table = g_hash_table_new_full(g_str_hash, g_str_equal, xmlFree, NULL);
+	GHashTableIter iter;
+	gpointer key, value;
+	GList *tmplist, *list = NULL;
+	GString *retstr;
+
+	g_hash_table_iter_init(&iter, langmgr.bflang_options);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		gchar **arr = key;
+		if (g_strcmp0(arr[0], bflang->name) == 0)
+			list = g_list_prepend(list, g_strconcat(arr[1], "=", (gchar *) value, NULL));
+	}
+	list = g_list_sort(list, (GCompareFunc) strcmp);
+	retstr = g_string_new(langmgr.load_reference ? "load_reference\n" : "\n");
+	for (tmplist = list; tmplist; tmplist = g_list_next(tmplist)) {
+		g_string_append(retstr, tmplist->data);
+		g_string_append_c(retstr, '\n');
+		g_free(tmplist->data);
+	}
+	g_list_free(list);
+	return g_string_free(retstr, FALSE);
+}
 
-	tmp = lookup_user_option(bflang->name, "load_reference");
-	bfparser->load_reference = !(tmp && tmp[0] == '0');
-	tmp = lookup_user_option(bflang->name, "load_completion");
-	bfparser->load_completion = !(tmp && tmp[0] == '0');
-	tmp = lookup_user_option(bflang->name, "autoclose_tags");
-	bfparser->autoclose_tags = !(tmp && tmp[0] == '0');
-	tmp = lookup_user_option(bflang->name, "stretch_tag_block");
-	bfparser->stretch_tag_block = !(tmp && tmp[0] == '0');
+/* a key that changes whenever the scantable of this language is compiled differently, so
+the pattern, context and block numbers in a persisted scancache are no longer valid */
+gchar *
+langmgr_scantable_key(Tbflang * bflang)
+{
+	gchar *options, *key;
+	options = bflang_options_string(bflang);
+	key = stcache_key(bflang->filename, options);
+	g_free(options);
+	return key;
+}
 
-	/* insert the special option is_LANGNAME to the hashtable, so you can check for the language file being parsed using class or notclass */
-	for (tmplist=g_list_first(langmgr.bflang_list);tmplist;tmplist=g_list_next(tmplist)) {
-		Tbflang* tmpbflang = tmplist->data;
-		gchar *tmp2 = g_strconcat("is_", tmpbflang->name, NULL);
-		langmgr_insert_user_option(bflang->name, tmp2, (tmpbflang == bflang) ? "1" : "0");
-		g_free(tmp2);
-	}
+/* parses the <definition> and <properties> of the bflang2 file into bfparser->st */
+static gboolean
+build_lang_parse_xml(Tbflangparsing * bfparser)
+{
+	xmlTextReaderPtr reader;
+	Tbflang *bflang = bfparser->bflang;
 
 	DBG_PARSING("build_lang_thread %p, started for %s\n", g_thread_self(), bfparser->bflang->filename);
 	reader = xmlNewTextReaderFilename(bfparser->bflang->filename);
 	if (!reader) {
 		g_print("failed to open %s\n", bfparser->bflang->filename);
 		/* TODO CLEANUP */
-		return NULL;
+		return FALSE;
 	}
 	xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, TRUE);
 
@@ -1546,6 +1555,7 @@ build_lang_thread(gpointer data)
 				DBG_PARSING("empty <definition />\n");
 				/* empty <definition />, probably text/plain */
 				g_array_free(bfparser->st->matches, TRUE);
+				g_array_free(bfparser->st->matchinfo, TRUE);
 				g_array_free(bfparser->st->contexts, TRUE);
 				g_array_free(bfparser->st->comments, TRUE);
 				g_array_free(bfparser->st->blocks, TRUE);
@@ -1617,23 +1627,87 @@ build_lang_thread(gpointer data)
 		xmlFree(name);
 	}
 	xmlFreeTextReader(reader);
+	return TRUE;
+}
+
+static gpointer
+build_lang_thread(gpointer data)
+{
+	Tbflang *bflang = data;
+	Tbflangparsing *bfparser;
+	Tstcache_props props;
+	const gchar *tmp;
+	gchar *options;
+	GList *tmplist;
+	gboolean from_cache;
+
+	bfparser = g_slice_new0(Tbflangparsing);
+	bfparser->patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	bfparser->contexts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	/*bfparser->setoptions =  g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL); */
+	bfparser->bflang = bflang;
+	/*for(tmplist = g_list_first(bfparser->bflang->setoptions);tmplist;tmplist=g_list_next(tmplist)) {
+	   g_hash_table_insert(bfparser->setoptions,g_strdup(tmplist->data),GINT_TO_POINTER(1));
+	   } */
+	bfparser->commentid_table = g_hash_table_new_full(g_str_hash, g_str_equal, xmlFree, NULL);
+
+	tmp = lookup_user_option(bflang->name, "load_reference");
+	bfparser->load_reference = !(tmp && tmp[0] == '0');
+	tmp = lookup_user_option(bflang->name, "load_completion");
+	bfparser->load_completion = !(tmp && tmp[0] == '0');
+	tmp = lookup_user_option(bflang->name, "autoclose_tags");
+	bfparser->autoclose_tags = !(tmp && tmp[0] == '0');
+	tmp = lookup_user_option(bflang->name, "stretch_tag_block");
+	bfparser->stretch_tag_block = !(tmp && tmp[0] == '0');
+
+	/* insert the special option is_LANGNAME to the hashtable, so you can check for the language file being parsed using class or notclass */
+	for (tmplist=g_list_first(langmgr.bflang_list);tmplist;tmplist=g_list_next(tmplist)) {
+		Tbflang* tmpbflang = tmplist->data;
+		gchar *tmp2 = g_strconcat("is_", tmpbflang->name, NULL);
+		langmgr_insert_user_option(bflang->name, tmp2, (tmpbflang == bflang) ? "1" : "0");
+		g_free(tmp2);
+	}
+
+	options = bflang_options_string(bflang);
+	bfparser->st = stcache_load(bflang->filename, options, &props);
+	from_cache = (bfparser->st != NULL);
+	if (from_cache) {
+		DBG_PARSING("build_lang_thread, loaded scantable for %s from the cache\n", bflang->filename);
+		bfparser->smartindentchars = props.smartindentchars;
+		bfparser->smartoutdentchars = props.smartoutdentchars;
+#ifdef HAVE_LIBENCHANT
+		bfparser->default_spellcheck = props.default_spellcheck;
+		bfparser->spell_decode_entities = props.spell_decode_entities;
+#endif
+	} else {
+		bfparser->st = scantable_new(bflang->size_table, bflang->size_matches, bflang->size_contexts);
+		if (!build_lang_parse_xml(bfparser)) {
+			g_free(options);
+			return NULL;
+		}
+	}
 	/* do some final memory management */
-	if (bfparser->st) {
+	if (bfparser->st && !from_cache) {
 		gint i, tablenum=0, largest_table=0;
+		guint dfasize=0;
 		bfparser->st->contexts->data =
 			g_realloc(bfparser->st->contexts->data, (bfparser->st->contexts->len + 1) * sizeof(Tcontext));
 		bfparser->st->matches->data =
 			g_realloc(bfparser->st->matches->data, (bfparser->st->matches->len + 1) * sizeof(Tpattern));
+		bfparser->st->matchinfo->data =
+			g_realloc(bfparser->st->matchinfo->data, (bfparser->st->matchinfo->len + 1) * sizeof(Tpattern_cold));
 		bfparser->st->comments->data =
 			g_realloc(bfparser->st->comments->data, (bfparser->st->comments->len + 1) * sizeof(Tcomment));
 		bfparser->st->blocks->data =
 			g_realloc(bfparser->st->blocks->data, (bfparser->st->blocks->len + 1) * sizeof(Tpattern_block));
-		/* now optimise the DFA tables for each context */
+		/* now compile and optimise the DFA tables for each context, this frees the uncompressed tables */
+		compile_scantable_contexts(bfparser->st);
 		for (i = 1; i < bfparser->st->contexts->len; i++) {
-			g_array_index(bfparser->st->contexts, Tcontext, i).table->data = g_realloc(g_array_index(bfparser->st->contexts, Tcontext, i).table->data, (g_array_index(bfparser->st->contexts, Tcontext, i).table->len + 1) * sizeof(Ttablerow));
-			tablenum += get_table(bfparser->st, i)->len + 1;
-			if (get_table(bfparser->st, i)->len > largest_table)
-				largest_table = get_table(bfparser->st, i)->len;
+			Tcontext *ctx = get_context(bfparser->st, i);
+			tablenum += ctx->numstates;
+			if ((gint) ctx->numstates > largest_table)
+				largest_table = ctx->numstates;
+			dfasize += ctx->numstates * ctx->rowlen * sizeof(guint16);
 		}
 		g_print("Language statistics for %s from %s\n", bfparser->bflang->name, bfparser->bflang->filename);
 		g_print("reference size       %9.2f Kbytes\n", bfparser->reference_size/1024.0);
@@ -1641,15 +1715,29 @@ build_lang_thread(gpointer data)
 				1.0 * largest_table * sizeof(Ttablerow) / 1024.0);
 		g_print("total tables  %5d (%9.2f Kbytes)\n", tablenum,
 				1.0 * tablenum * sizeof(Ttablerow) / 1024.0);
+		g_print("compressed    %5d (%9.2f Kbytes)\n", tablenum, dfasize / 1024.0);
 		g_print("contexts      %5d (%9.2f Kbytes)\n", bfparser->st->contexts->len,
 				1.0 * bfparser->st->contexts->len * sizeof(Tcontext) / 1024.0);
-		g_print("matches       %5d (%9.2f Kbytes)\n", bfparser->st->matches->len,
-				1.0 * bfparser->st->matches->len * sizeof(Tpattern) / 1024.0);
+		g_print("matches       %5d (%9.2f Kbytes, %9.2f Kbytes not used by the scanner)\n", bfparser->st->matches->len,
+				1.0 * bfparser->st->matches->len * sizeof(Tpattern) / 1024.0,
+				1.0 * bfparser->st->matchinfo->len * sizeof(Tpattern_cold) / 1024.0);
 		g_print("blocks        %5d (%9.2f Kbytes)\n", bfparser->st->blocks->len,
 				1.0 * bfparser->st->blocks->len * sizeof(Tpattern_block) / 1024.0);
 		/*print_DFA(bfparser->st, '&','Z'); */
 		/*print_DFA_subset(bfparser->st, "<PpIi>"); */
 
+		props.smartindentchars = bfparser->smartindentchars;
+		props.smartoutdentchars = bfparser->smartoutdentchars;
+#ifdef HAVE_LIBENCHANT
+		props.default_spellcheck = bfparser->default_spellcheck;
+		props.spell_decode_entities = bfparser->spell_decode_entities;
+#else
+		props.default_spellcheck = props.spell_decode_entities = FALSE;
+#endif
+		stcache_save(bflang->filename, options, bfparser->st, &props);
+	}
+	g_free(options);
+	if (bfparser->st) {
 		bflang->tags = bftextview2_scantable_rematch_highlights(bfparser->st, bflang->name);
 	}
 	DBG_PARSING("build_lang_thread finished bflang=%p\n", bflang);
@@ -1691,6 +1779,27 @@ langmgr_get_bflang(const gchar * mimetype, const gchar * filename)
 	return bflang;
 }
 
+/* a copy of the lookup table (mimetype and mimetype?extension -> Tbflang) for a thread
+that cannot call langmgr_get_bflang(), the keys are owned by the copy */
+GHashTable *
+langmgr_get_bflang_lookup(void)
+{
+	GHashTable *lookup = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init(&iter, langmgr.bflang_lookup);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		g_hash_table_insert(lookup, g_strdup(key), value);
+	}
+	return lookup;
+}
+
+gboolean
+langmgr_done_scanning(void)
+{
+	return langmgr.done_scanning;
+}
+
 GtkTextTagTable *
 langmgr_get_tagtable(void)
 {
@@ -1806,40 +1915,55 @@ static void
 bflang_cleanup_scantable(Tbflang * bflang)
 {
 	gint i;
+	/* a scantable from the cache has all strings and DFA tables inside the mapped file */
+	gboolean mapped = (bflang->st->mapped != NULL);
 	for (i = 1; i < bflang->st->matches->len; i++) {
 		GSList *slist;
-		g_free(g_array_index(bflang->st->matches, Tpattern, i).reference);
-		g_free(g_array_index(bflang->st->matches, Tpattern, i).pattern);
+		if (!mapped) {
+			g_free(g_array_index(bflang->st->matchinfo, Tpattern_cold, i).reference);
+			g_free(g_array_index(bflang->st->matchinfo, Tpattern_cold, i).pattern);
+		}
 		/* TODO: cleanup autocomplete list */
 /*		g_free(g_array_index(bflang->st->matches, Tpattern, i).autocomplete_string);*/
 		/* we cannot cleanup selfhighlight because there are several tags/elements that
 		   use the same string in memory for this value... for example if they are part of
 		   the same <group>
-		   g_free(g_array_index(bflang->st->matches, Tpattern, i).selfhighlight); */
+		   g_free(g_array_index(bflang->st->matchinfo, Tpattern_cold, i).selfhighlight); */
 		/*g_free(g_array_index(bflang->st->matches, Tpattern, i).blockhighlight);*/
-		for (slist = g_array_index(bflang->st->matches, Tpattern, i).autocomp_items; slist;
+		for (slist = g_array_index(bflang->st->matchinfo, Tpattern_cold, i).autocomp_items; slist;
 			 slist = g_slist_next(slist)) {
 			g_slice_free(Tpattern_autocomplete, slist->data);
 		}
-		g_slist_free(g_array_index(bflang->st->matches, Tpattern, i).autocomp_items);
+		g_slist_free(g_array_index(bflang->st->matchinfo, Tpattern_cold, i).autocomp_items);
 	}
 	for (i = 1; i < bflang->st->contexts->len; i++) {
 		if (g_array_index(bflang->st->contexts, Tcontext, i).ac)
-			g_completion_free(g_array_index(bflang->st->contexts, Tcontext, i).ac);
+			acindex_free(g_array_index(bflang->st->contexts, Tcontext, i).ac);
 		if (g_array_index(bflang->st->contexts, Tcontext, i).patternhash)
 			g_hash_table_destroy(g_array_index(bflang->st->contexts, Tcontext, i).patternhash);
-		g_free(g_array_index(bflang->st->contexts, Tcontext, i).contexthighlight);
-		g_array_free(g_array_index(bflang->st->contexts, Tcontext, i).table, TRUE);
+		if (g_array_index(bflang->st->contexts, Tcontext, i).table)
+			g_array_free(g_array_index(bflang->st->contexts, Tcontext, i).table, TRUE);
+		if (g_array_index(bflang->st->contexts, Tcontext, i).pending)
+			g_array_free(g_array_index(bflang->st->contexts, Tcontext, i).pending, TRUE);
+		g_free(g_array_index(bflang->st->contexts, Tcontext, i).skip);
+		g_free(g_array_index(bflang->st->contexts, Tcontext, i).skipexits);
+		if (!mapped) {
+			g_free(g_array_index(bflang->st->contexts, Tcontext, i).contexthighlight);
+			g_free(g_array_index(bflang->st->contexts, Tcontext, i).dfa);
+		}
 	}
-	for (i = 1; i < bflang->st->comments->len; i++) {
+	for (i = 1; !mapped && i < bflang->st->comments->len; i++) {
 		g_free(g_array_index(bflang->st->comments, Tcomment, i).so);
 		g_free(g_array_index(bflang->st->comments, Tcomment, i).eo);
 	}
-	for (i = 1; i < bflang->st->blocks->len; i++) {
+	for (i = 1; !mapped && i < bflang->st->blocks->len; i++) {
 		g_free(g_array_index(bflang->st->blocks, Tpattern_block, i).name);
 		g_free(g_array_index(bflang->st->blocks, Tpattern_block, i).highlight);
 	}
+	if (mapped)
+		g_mapped_file_unref(bflang->st->mapped);
 	g_array_free(bflang->st->matches, TRUE);
+	g_array_free(bflang->st->matchinfo, TRUE);
 	g_array_free(bflang->st->contexts, TRUE);
 	g_array_free(bflang->st->comments, TRUE);
 	g_array_free(bflang->st->blocks, TRUE);
@@ -29,7 +29,10 @@ void langmgr_reload_user_highlights(void);
 gchar *langmgr_get_option_description(const gchar *optionname);
 GtkTextTag *langmrg_lookup_tag_highlight(const gchar * lang, const gchar * highlight);
 GtkTextTagTable *langmgr_get_tagtable(void);
+gboolean langmgr_done_scanning(void);
 Tbflang *langmgr_get_bflang(const gchar * mimetype, const gchar * filename);
+GHashTable *langmgr_get_bflang_lookup(void);
+gchar *langmgr_scantable_key(Tbflang * bflang);
 GList *langmgr_get_languages_mimetypes(void);
 gboolean langmgr_in_highlight_tags(GtkTextTag * tag);
 #ifdef HAVE_LIBENCHANT
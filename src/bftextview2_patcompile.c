@@ -83,16 +83,16 @@ bftextview2_scantable_rematch_highlights(Tscantable * st, const gchar * lang)
 	}
 	for (i = 0; i < (st->matches->len); i++) {
 		/*g_print("pattern %d",i);
-		   g_print(" (%s)",g_array_index(st->matches, Tpattern, i).pattern);
-		   g_print(" has selfhighlight %s and blockhighlight %s\n",g_array_index(st->matches, Tpattern, i).selfhighlight,g_array_index(st->matches, Tpattern, i).blockhighlight); */
-		if (g_array_index(st->matches, Tpattern, i).selfhighlight) {
+		   g_print(" (%s)",g_array_index(st->matchinfo, Tpattern_cold, i).pattern);
+		   g_print(" has selfhighlight %s and blockhighlight %s\n",g_array_index(st->matchinfo, Tpattern_cold, i).selfhighlight,g_array_index(st->matches, Tpattern, i).blockhighlight); */
+		if (g_array_index(st->matchinfo, Tpattern_cold, i).selfhighlight) {
 			g_array_index(st->matches, Tpattern, i).selftag =
-				langmrg_lookup_tag_highlight(lang, g_array_index(st->matches, Tpattern, i).selfhighlight);
+				langmrg_lookup_tag_highlight(lang, g_array_index(st->matchinfo, Tpattern_cold, i).selfhighlight);
 			if (g_array_index(st->matches, Tpattern, i).selftag)
 				retlist = g_list_prepend(retlist, g_array_index(st->matches, Tpattern, i).selftag);
 			else
 				g_print("Possible error in language file, no textstyle found for highlight %s\n",
-						g_array_index(st->matches, Tpattern, i).selfhighlight);
+						g_array_index(st->matchinfo, Tpattern_cold, i).selfhighlight);
 		}
 		/*if (g_array_index(st->matches, Tpattern, i).blockhighlight) {
 			g_array_index(st->matches, Tpattern, i).blocktag =
@@ -600,7 +600,7 @@ compile_limitedregex_to_DFA(Tscantable * st, gchar * input, gboolean caseinsensi
 		if (get_tablerow(st, context, p).match != 0
 			&& get_tablerow(st, context, p).match != matchnum) {
 			g_print("Error in language file, patterns %s and %s in context %d overlap each other\n", input,
-					g_array_index(st->matches, Tpattern,
+					g_array_index(st->matchinfo, Tpattern_cold,
 								  get_tablerow(st, context, p).match).pattern, context);
 		} else {
 			get_tablerow(st, context, p).match = matchnum;
@@ -661,7 +661,7 @@ compile_keyword_to_DFA(Tscantable * st, const gchar * keyword, guint16 matchnum,
 				if (get_tablerow(st, context, p).match != 0
 					&& get_tablerow(st, context, p).match != matchnum) {
 					g_print("Error in language file: patterns %s and %s in context %d overlap each other\n",
-							keyword, g_array_index(st->matches, Tpattern,
+							keyword, g_array_index(st->matchinfo, Tpattern_cold,
 												   get_tablerow(st, context, p).match).pattern,
 							context);
 				}
@@ -727,6 +727,133 @@ new_context(Tscantable * st, guint expected_size, const gchar * lang, const gcha
 	return context;
 }
 
+static inline guint16
+column_value(Ttablerow * rows, guint state, guint c)
+{
+	/* the last character (DEL) is not in the Ttablerow, it is handled like a symbol */
+	return (c < NUMSCANCHARS) ? rows[state].row[c] : 0;
+}
+
+/* after all patterns are compiled for a context, the characters that lead to the same next state
+in every state of the DFA form a character class. The compressed table (Tcontext.dfa) has for each
+state the match followed by the next state for each class, and Tcontext.charclass maps a character
+to the class. Returns the size of the compressed table in bytes */
+guint
+compress_context_dfa(Tscantable * st, gint16 context)
+{
+	Tcontext *ctx = &g_array_index(st->contexts, Tcontext, context);
+	Ttablerow *rows = (Ttablerow *) ctx->table->data;
+	guint numstates = ctx->table->len;
+	guint32 hash[NUMSCANCHARS + 1];
+	guint8 representative[NUMSCANCHARS + 1];	/* the first character of each class */
+	guint numclasses = 0, c, s;
+
+	/* hash the columns first, so we only compare the complete column for likely duplicates */
+	for (c = 0; c <= NUMSCANCHARS; c++)
+		hash[c] = 5381;
+	for (s = 0; s < numstates; s++) {
+		for (c = 0; c <= NUMSCANCHARS; c++) {
+			hash[c] = hash[c] * 33 + column_value(rows, s, c);
+		}
+	}
+	for (c = 0; c <= NUMSCANCHARS; c++) {
+		guint k;
+		for (k = 0; k < numclasses; k++) {
+			guint r = representative[k];
+			if (hash[r] == hash[c]) {
+				for (s = 0; s < numstates && column_value(rows, s, r) == column_value(rows, s, c); s++);
+				if (s == numstates)
+					break;
+			}
+		}
+		if (k == numclasses) {
+			representative[numclasses] = c;
+			numclasses++;
+		}
+		ctx->charclass[c] = k + 1;	/* column 0 in a row is the match */
+	}
+	ctx->rowlen = numclasses + 1;
+	ctx->numstates = numstates;
+	ctx->dfa = g_new(guint16, numstates * ctx->rowlen);
+	for (s = 0; s < numstates; s++) {
+		guint16 *row = ctx->dfa + s * ctx->rowlen;
+		guint k;
+		row[0] = rows[s].match;
+		for (k = 0; k < numclasses; k++) {
+			row[k + 1] = column_value(rows, s, representative[k]);
+		}
+	}
+	DBG_PATCOMPILE("compress_context_dfa, context %d has %d states and %d character classes\n", context, numstates,
+				   numclasses);
+	g_array_free(ctx->table, TRUE);
+	ctx->table = NULL;
+	compute_dfa_skips(ctx);
+	return numstates * ctx->rowlen * sizeof(guint16);
+}
+
+/*
+inside a comment, a string or a CDATA section almost every character leads back to the same
+state. compute_dfa_skips() finds the states that loop to themselves for every character
+except at most DFA_SKIP_MAX_EXITS ascii characters (all non-ascii characters are scanned as
+character 1, so that one has to loop as well). For those states the scanner calls dfa_skip(),
+which only tests each byte against a bitmap of the characters that leave the state, instead of
+a table lookup for every character.
+*/
+void
+compute_dfa_skips(Tcontext * ctx)
+{
+	GArray *exits = g_array_new(FALSE, TRUE, sizeof(guint32));
+	guint s, c, numskips = 0;
+
+	ctx->skip = g_new0(guint8, ctx->numstates);
+	for (s = 1; s < ctx->numstates && numskips < 255; s++) {
+		guint32 stateexits[DFA_SKIP_WORDS];
+		guint numexits = 0;
+		if (dfa_next_state(ctx, s, 1) != s)
+			continue;
+		memset(stateexits, 0, sizeof(stateexits));
+		/* the terminating nul always leaves the state */
+		stateexits[0] = 1;
+		for (c = 2; c <= NUMSCANCHARS; c++) {
+			if (dfa_next_state(ctx, s, c) != s) {
+				if (numexits == DFA_SKIP_MAX_EXITS)
+					break;
+				stateexits[c >> 5] |= 1u << (c & 31);
+				numexits++;
+			}
+		}
+		if (c <= NUMSCANCHARS)
+			continue;
+		g_array_append_vals(exits, stateexits, DFA_SKIP_WORDS);
+		numskips++;
+		ctx->skip[s] = numskips;
+	}
+	DBG_PATCOMPILE("compute_dfa_skips, %d of %d states are skip states\n", numskips, ctx->numstates);
+	ctx->skipexits = (guint32 *) g_array_free(exits, FALSE);
+}
+
+/* skip from p to the first character that leaves curstate (a skip state), but not more than
+maxchars characters. p should be nul terminated. returns the new position, and the number
+of characters that were skipped in numchars */
+const gchar *
+dfa_skip(Tcontext * ctx, guint curstate, const gchar * p, guint maxchars, guint * numchars)
+{
+	const guint32 *exits = ctx->skipexits + (ctx->skip[curstate] - 1) * DFA_SKIP_WORDS;
+	const guchar *q = (const guchar *) p;
+	guint chars = 0;
+	for (;; q++) {
+		guchar c = *q;
+		/* continuation bytes of a multibyte character never leave the state */
+		if ((c & 0xC0) == 0x80)
+			continue;
+		if (chars == maxchars || (c < 128 && (exits[c >> 5] & (1u << (c & 31)))))
+			break;
+		chars++;
+	}
+	*numchars = chars;
+	return (const gchar *) q;
+}
+
 void
 match_set_nextcontext(Tscantable * st, guint16 matchnum, guint16 nextcontext)
 {
@@ -743,7 +870,7 @@ match_autocomplete_reference(Tscantable * st, guint16 matchnum, guint16 context)
 			g_hash_table_new(g_str_hash, g_str_equal);
 	}
 	g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).patternhash,
-						g_array_index(st->matches, Tpattern, matchnum).pattern, GINT_TO_POINTER(pattern_id));
+						g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern, GINT_TO_POINTER(pattern_id));
 
 	if (g_array_index(st->matches, Tpattern, matchnum).tagclose_from_blockstack
 		&& !g_array_index(st->contexts, Tcontext, context).has_tagclose_from_blockstack) {
@@ -751,56 +878,48 @@ match_autocomplete_reference(Tscantable * st, guint16 matchnum, guint16 context)
 		g_array_index(st->contexts, Tcontext, context).has_tagclose_from_blockstack = 1;
 	}
 
-/*	if (g_array_index(st->matches, Tpattern, matchnum).reference && !g_array_index(st->matches, Tpattern, matchnum).is_regex) {
+/*	if (g_array_index(st->matchinfo, Tpattern_cold, matchnum).reference && !g_array_index(st->matchinfo, Tpattern_cold, matchnum).is_regex) {
 		if (!g_array_index(st->contexts, Tcontext, context).reference) {
 			DBG_PATCOMPILE("create hashtable for context %d\n",context);
 			g_array_index(st->contexts, Tcontext, context).reference = g_hash_table_new(g_str_hash,g_str_equal);
 		}
-		g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).reference,g_array_index(st->matches, Tpattern, matchnum).pattern,g_array_index(st->matches, Tpattern, matchnum).reference);
+		g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).reference,g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern,g_array_index(st->matchinfo, Tpattern_cold, matchnum).reference);
 	}*/
-	if (g_array_index(st->matches, Tpattern, matchnum).autocomp_items) {
-		GSList *tmpslist = g_array_index(st->matches, Tpattern, matchnum).autocomp_items;
-		GList *list = NULL;
+	if (g_array_index(st->matchinfo, Tpattern_cold, matchnum).autocomp_items) {
+		GSList *tmpslist = g_array_index(st->matchinfo, Tpattern_cold, matchnum).autocomp_items;
 		if (!g_array_index(st->contexts, Tcontext, context).ac) {
-			DBG_PATCOMPILE("create g_completion for context %d\n", context);
-			g_array_index(st->contexts, Tcontext, context).ac = g_completion_new(NULL);
-			if (g_array_index(st->contexts, Tcontext, context).autocomplete_case_insens)
-				g_completion_set_compare(g_array_index(st->contexts, Tcontext, context).ac, strncasecmp);
+			DBG_PATCOMPILE("create autocompletion index for context %d\n", context);
+			g_array_index(st->contexts, Tcontext, context).ac =
+				acindex_new(g_array_index(st->contexts, Tcontext, context).autocomplete_case_insens);
 		}
 
 		while (tmpslist) {
 			Tpattern_autocomplete *pac = tmpslist->data;
-			list = g_list_prepend(list, pac->autocomplete_string);
+			acindex_add(g_array_index(st->contexts, Tcontext, context).ac, pac->autocomplete_string);
 			g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).patternhash,
 								pac->autocomplete_string, GINT_TO_POINTER(pattern_id));
 			tmpslist = g_slist_next(tmpslist);
 		}
-		g_completion_add_items(g_array_index(st->contexts, Tcontext, context).ac, list);
-		g_list_free(list);
 	}
 #ifdef OLD_AUTOCOMP
 	if (g_array_index(st->matches, Tpattern, matchnum).autocomplete) {
-		GList *list;
 		gchar *tmp;
 		if (!g_array_index(st->contexts, Tcontext, context).ac) {
-			DBG_PATCOMPILE("create g_completion for context %d\n", context);
-			g_array_index(st->contexts, Tcontext, context).ac = g_completion_new(NULL);
-			if (g_array_index(st->contexts, Tcontext, context).autocomplete_case_insens)
-				g_completion_set_compare(g_array_index(st->contexts, Tcontext, context).ac, strncasecmp);
+			DBG_PATCOMPILE("create autocompletion index for context %d\n", context);
+			g_array_index(st->contexts, Tcontext, context).ac =
+				acindex_new(g_array_index(st->contexts, Tcontext, context).autocomplete_case_insens);
 		}
 		if (g_array_index(st->matches, Tpattern, matchnum).autocomplete_string) {
 			tmp = g_array_index(st->matches, Tpattern, matchnum).autocomplete_string;
 		} else {
-			tmp = g_array_index(st->matches, Tpattern, matchnum).pattern;
+			tmp = g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern;
 		}
 
-		list = g_list_prepend(NULL, tmp);
-		g_completion_add_items(g_array_index(st->contexts, Tcontext, context).ac, list);
-		DBG_AUTOCOMP("adding %s to GCompletion\n", (gchar *) list->data);
-		g_list_free(list);
+		acindex_add(g_array_index(st->contexts, Tcontext, context).ac, tmp);
+		DBG_AUTOCOMP("adding %s to the autocompletion index\n", tmp);
 		if (g_array_index(st->matches, Tpattern, matchnum).autocomplete_string) {
-			/*if (g_array_index(st->matches, Tpattern, matchnum).reference) {
-			   g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).reference,g_array_index(st->matches, Tpattern, matchnum).autocomplete_string,g_array_index(st->matches, Tpattern, matchnum).reference);
+			/*if (g_array_index(st->matchinfo, Tpattern_cold, matchnum).reference) {
+			   g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).reference,g_array_index(st->matches, Tpattern, matchnum).autocomplete_string,g_array_index(st->matchinfo, Tpattern_cold, matchnum).reference);
 			   } */
 			g_hash_table_insert(g_array_index(st->contexts, Tcontext, context).patternhash,
 								g_array_index(st->matches, Tpattern, matchnum).autocomplete_string,
@@ -820,38 +939,130 @@ match_add_autocomp_item(Tscantable * st, guint16 matchnum, const gchar * autocom
 		pac->autocomplete_string = (gchar *) autocomplete_string;
 	} else if (autocomplete_append) {
 		pac->autocomplete_string =
-			g_strconcat(g_array_index(st->matches, Tpattern, matchnum).pattern, autocomplete_append, NULL);
+			g_strconcat(g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern, autocomplete_append, NULL);
 	} else {
-		pac->autocomplete_string = g_array_index(st->matches, Tpattern, matchnum).pattern;
+		pac->autocomplete_string = g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern;
 	}
 	pac->autocomplete_backup_cursor = autocomplete_backup_cursor;
-	g_array_index(st->matches, Tpattern, matchnum).autocomp_items =
-		g_slist_prepend(g_array_index(st->matches, Tpattern, matchnum).autocomp_items, pac);
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).autocomp_items =
+		g_slist_prepend(g_array_index(st->matchinfo, Tpattern_cold, matchnum).autocomp_items, pac);
 }
 
 void
 match_set_reference(Tscantable * st, guint16 matchnum, const gchar * reference)
 {
 	if (reference)
-		g_array_index(st->matches, Tpattern, matchnum).reference = g_strdup(reference);
+		g_array_index(st->matchinfo, Tpattern_cold, matchnum).reference = g_strdup(reference);
+}
+
+/* the patterns are not compiled into the DFA while the language file is parsed, they are
+added to the pending list of the context, and compile_scantable_contexts() compiles each
+context once parsing is finished. The order within a context is kept, because the
+resulting DFA depends on it (see the bug described in create_state_tables()) */
+static void
+queue_match_for_context(Tscantable * st, guint16 matchnum, gint16 context)
+{
+	Tcontext *ctx = get_context(st, context);
+	if (!ctx->pending)
+		ctx->pending = g_array_new(FALSE, FALSE, sizeof(guint16));
+	g_array_append_val(ctx->pending, matchnum);
+}
+
+static void
+compile_match(Tscantable * st, guint16 matchnum, gint16 context)
+{
+	Tpattern_cold *patc = &g_array_index(st->matchinfo, Tpattern_cold, matchnum);
+	if (patc->is_regex) {
+		compile_limitedregex_to_DFA(st, patc->pattern, patc->case_insens, matchnum, context);
+	} else {
+		compile_keyword_to_DFA(st, patc->pattern, matchnum, context, patc->case_insens);
+	}
 }
 
 void
 compile_existing_match(Tscantable * st, guint16 matchnum, gint16 context)
 {
 	DBG_PATCOMPILE("compile existing match %d (%s) in context %d\n", matchnum,
-				   g_array_index(st->matches, Tpattern, matchnum).pattern, context);
-	if (g_array_index(st->matches, Tpattern, matchnum).is_regex) {
-		compile_limitedregex_to_DFA(st, g_array_index(st->matches, Tpattern, matchnum).pattern,
-									g_array_index(st->matches, Tpattern, matchnum).case_insens, matchnum,
-									context);
-	} else {
-		compile_keyword_to_DFA(st, g_array_index(st->matches, Tpattern, matchnum).pattern, matchnum, context,
-							   g_array_index(st->matches, Tpattern, matchnum).case_insens);
-	}
+				   g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern, context);
+	queue_match_for_context(st, matchnum, context);
 	match_autocomplete_reference(st, matchnum, context);
 }
 
+/* compiles the pending patterns of a single context and compresses the result. This only
+touches the Tcontext itself and reads st->matchinfo, so different contexts can be compiled
+by different threads, as long as no contexts or matches are added at the same time */
+static void
+compile_context(Tscantable * st, gint16 context)
+{
+	Tcontext *ctx = get_context(st, context);
+	if (ctx->pending) {
+		guint i;
+		for (i = 0; i < ctx->pending->len; i++) {
+			compile_match(st, g_array_index(ctx->pending, guint16, i), context);
+		}
+		g_array_free(ctx->pending, TRUE);
+		ctx->pending = NULL;
+	}
+	if (ctx->ac)
+		acindex_finish(ctx->ac);
+	compress_context_dfa(st, context);
+}
+
+static void
+compile_context_thread(gpointer data, gpointer user_data)
+{
+	compile_context((Tscantable *) user_data, GPOINTER_TO_INT(data));
+}
+
+static gint
+pending_length(Tscantable * st, gint16 context)
+{
+	GArray *pending = get_context(st, context)->pending;
+	return pending ? pending->len : 0;
+}
+
+static gint
+pending_length_compare(gconstpointer a, gconstpointer b, gpointer st)
+{
+	return pending_length(st, *(const gint16 *) b) - pending_length(st, *(const gint16 *) a);
+}
+
+/* compiles all contexts after the language file is parsed. The contexts are independent DFA's,
+so they are compiled on a pool with a thread for each processor. The contexts with the most
+patterns are started first, for php and html the single large context with all functions or
+all tags takes most of the time, and the small contexts are compiled while that one runs. */
+void
+compile_scantable_contexts(Tscantable * st)
+{
+	guint numthreads = get_num_processors();
+	gint16 *order;
+	gint i, num = st->contexts->len - 1;	/* context 0 is not used */
+	GThreadPool *pool = NULL;
+
+	if (num <= 0)
+		return;
+	if (numthreads > (guint) num)
+		numthreads = num;
+	if (numthreads > 1)
+		pool = g_thread_pool_new(compile_context_thread, st, numthreads, TRUE, NULL);
+	if (!pool) {
+		for (i = 1; i <= num; i++)
+			compile_context(st, i);
+		return;
+	}
+	order = g_new(gint16, num);
+	for (i = 0; i < num; i++)
+		order[i] = i + 1;
+	g_qsort_with_data(order, num, sizeof(gint16), pending_length_compare, st);
+	DBG_PATCOMPILE("compile_scantable_contexts, %d contexts on %d threads, largest has %d patterns\n", num,
+				   numthreads, pending_length(st, order[0]));
+	for (i = 0; i < num; i++)
+		g_thread_pool_push(pool, GINT_TO_POINTER((gint) order[i]), NULL);
+	/* wait until all contexts are compiled */
+	g_thread_pool_free(pool, FALSE, TRUE);
+	g_free(order);
+}
+
 void
 pattern_set_blockmatch(Tscantable * st, guint16 matchnum,
 							gboolean starts_block,
@@ -863,7 +1074,7 @@ pattern_set_blockmatch(Tscantable * st, guint16 matchnum,
 {
 	if (starts_block == TRUE && ends_block == TRUE) {
 		g_warning("Error in language file or Bluefish bug: pattern %s both starts and ends a block\n",
-						g_array_index(st->matches, Tpattern, matchnum).pattern);
+						g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern);
 	}
 	if (blockname && !starts_block) {
 		g_warning("Error in language file or Bluefish bug: block_name %s can only be set on a block start\n", blockname);
@@ -897,7 +1108,7 @@ pattern_set_runtime_properties(Tscantable * st, guint16 matchnum,
 								gboolean identjump,
 								gboolean identautocomp)
 {
-	g_array_index(st->matches, Tpattern, matchnum).selfhighlight = (gchar *) selfhighlight;
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).selfhighlight = (gchar *) selfhighlight;
 	g_array_index(st->matches, Tpattern, matchnum).nextcontext = nextcontext;
 	g_array_index(st->matches, Tpattern, matchnum).tagclose_from_blockstack = tagclose_from_blockstack;
 	g_array_index(st->matches, Tpattern, matchnum).stretch_blockstart = stretch_blockstart;
@@ -923,15 +1134,12 @@ add_pattern_to_scanning_table(Tscantable * st, const gchar * pattern,
 		g_warning("Language file has too many patterns, this will very likely result in a crash!\n");
 	}
 	g_array_set_size(st->matches, st->matches->len + 1);
-	g_array_index(st->matches, Tpattern, matchnum).pattern = g_strdup(pattern);
-	g_array_index(st->matches, Tpattern, matchnum).case_insens = case_insens;
-	g_array_index(st->matches, Tpattern, matchnum).is_regex = is_regex;
+	g_array_set_size(st->matchinfo, st->matches->len);
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern = g_strdup(pattern);
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).case_insens = case_insens;
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).is_regex = is_regex;
 	DBG_PATCOMPILE("add_pattern_to_scanning_table,pattern=%s for context=%d got matchnum %d\n",pattern, context, matchnum);
-	if (is_regex) {
-		compile_limitedregex_to_DFA(st, g_array_index(st->matches, Tpattern, matchnum).pattern, case_insens, matchnum, context);
-	} else {
-		compile_keyword_to_DFA(st, g_array_index(st->matches, Tpattern, matchnum).pattern, matchnum, context, case_insens);
-	}
+	queue_match_for_context(st, matchnum, context);
 	/*if (g_strcmp0(pattern, "rem ")==0 || g_strcmp0(pattern, "\\.?[a-zA-Z][a-zA-Z_0-9]*[\\$%]?")==0) {
 		print_DFA_subset(st, context, "rem var");
 	}*/
@@ -962,15 +1170,15 @@ add_keyword_to_scanning_table(Tscantable * st, gchar * pattern, const gchar * la
 				   matchnum, blockstartpattern, nextcontext);
 	g_array_set_size(st->matches, st->matches->len + 1);
 
-	g_array_index(st->matches, Tpattern, matchnum).pattern = g_strdup(pattern);
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).pattern = g_strdup(pattern);
 	g_array_index(st->matches, Tpattern, matchnum).ends_block = ends_block;
 	g_array_index(st->matches, Tpattern, matchnum).starts_block = starts_block;
 	g_array_index(st->matches, Tpattern, matchnum).blockstartpattern = blockstartpattern;
 	g_array_index(st->matches, Tpattern, matchnum).blockhighlight = (gchar *) blockhighlight;
 	g_array_index(st->matches, Tpattern, matchnum).nextcontext = nextcontext;
-	g_array_index(st->matches, Tpattern, matchnum).case_insens = case_insens;
-	g_array_index(st->matches, Tpattern, matchnum).is_regex = is_regex;
-	g_array_index(st->matches, Tpattern, matchnum).selfhighlight = (gchar *) selfhighlight;
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).case_insens = case_insens;
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).is_regex = is_regex;
+	g_array_index(st->matchinfo, Tpattern_cold, matchnum).selfhighlight = (gchar *) selfhighlight;
 
 	g_array_index(st->matches, Tpattern, matchnum).tagclose_from_blockstack = tagclose_from_blockstack;
 	g_array_index(st->matches, Tpattern, matchnum).stretch_blockstart = stretch_blockstart;
@@ -1019,7 +1227,7 @@ print_DFA_subset(Tscantable * st, gint16 context, char *chars)
 		g_print(": %4d", g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match);
 		if (g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match > 0) {
 			g_print(" %s",
-					g_array_index(st->matches, Tpattern,
+					g_array_index(st->matchinfo, Tpattern_cold,
 								  g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match).pattern);
 			if (g_array_index(st->matches, Tpattern, g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match).nextcontext
 				> 0) {
@@ -1054,7 +1262,7 @@ print_DFA(Tscantable * st, gint16 context, char start, char end)
 			g_print("%3d ", g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).row[j]);
 		}
 		g_print(": %3d (%s)\n", g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match,
-					g_array_index(st->matches, Tpattern,g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match).pattern);
+					g_array_index(st->matchinfo, Tpattern_cold,g_array_index(g_array_index(st->contexts, Tcontext, context).table, Ttablerow, i).match).pattern);
 	}
 
 }
@@ -1069,9 +1277,11 @@ scantable_new(guint size_table, guint size_matches, guint size_contexts)
 				size_contexts);
 	st->contexts = g_array_sized_new(TRUE, TRUE, sizeof(Tcontext), size_contexts);
 	st->matches = g_array_sized_new(TRUE, TRUE, sizeof(Tpattern), size_matches);
+	st->matchinfo = g_array_sized_new(TRUE, TRUE, sizeof(Tpattern_cold), size_matches);
 	st->comments = g_array_sized_new(TRUE, FALSE, sizeof(Tcomment), 8);
 	st->blocks = g_array_sized_new(TRUE, FALSE, sizeof(Tpattern_block), 8);
 	st->matches->len = 1;		/* match 0 means no match */
+	st->matchinfo->len = 1;
 	st->contexts->len = 1;		/* a match with nextcontext 0 means no context change, so we cannot use context 0 */
 	st->blocks->len = 1;			/* block 0 means no block */
 	return st;
@@ -1459,15 +1669,11 @@ bftextview2_scantable_new(GtkTextBuffer * buffer)
 	st->matches->len = 12;		/* match 0 is not used */
 
 	g_array_index(st->contexts, Tcontext, 0).startstate = 0;
-	g_array_index(st->contexts, Tcontext, 0).ac = g_completion_new(NULL);
-	{
-		GList *list = NULL;
-		list = g_list_prepend(list, "<img");
-		list = g_list_prepend(list, "<i");
-		list = g_list_prepend(list, "<!--");
-		g_completion_add_items(g_array_index(st->contexts, Tcontext, 0).ac, list);
-		g_list_free(list);
-	}
+	g_array_index(st->contexts, Tcontext, 0).ac = acindex_new(FALSE);
+	acindex_add(g_array_index(st->contexts, Tcontext, 0).ac, "<img");
+	acindex_add(g_array_index(st->contexts, Tcontext, 0).ac, "<i");
+	acindex_add(g_array_index(st->contexts, Tcontext, 0).ac, "<!--");
+	acindex_finish(g_array_index(st->contexts, Tcontext, 0).ac);
 
 	g_array_index(st->table, Ttablerow, 0).row['<'] = 1;
 
@@ -1557,15 +1763,11 @@ bftextview2_scantable_new(GtkTextBuffer * buffer)
 
 	/* closure > in context for <img */
 	g_array_index(st->contexts, Tcontext, 2).startstate = 32;
-	g_array_index(st->contexts, Tcontext, 2).ac = g_completion_new(NULL);
-	{
-		GList *list = NULL;
-		list = g_list_prepend(list, "src=");
-		list = g_list_prepend(list, "width=");
-		list = g_list_prepend(list, "height=");
-		g_completion_add_items(g_array_index(st->contexts, Tcontext, 2).ac, list);
-		g_list_free(list);
-	}
+	g_array_index(st->contexts, Tcontext, 2).ac = acindex_new(FALSE);
+	acindex_add(g_array_index(st->contexts, Tcontext, 2).ac, "src=");
+	acindex_add(g_array_index(st->contexts, Tcontext, 2).ac, "width=");
+	acindex_add(g_array_index(st->contexts, Tcontext, 2).ac, "height=");
+	acindex_finish(g_array_index(st->contexts, Tcontext, 2).ac);
 	g_array_index(st->table, Ttablerow, 32).row['>'] = 33;
 	g_array_index(st->table, Ttablerow, 33).match = 9;
 	g_array_index(st->matches, Tpattern, 9).message = ">";
@@ -31,6 +31,8 @@ void match_add_autocomp_item(Tscantable * st, guint16 matchnum, const gchar * au
 							 const gchar * autocomplete_append, guint8 autocomplete_backup_cursor);
 void match_set_reference(Tscantable * st, guint16 matchnum, const gchar * reference);
 void compile_existing_match(Tscantable * st, guint16 matchnum, gint16 context);
+guint compress_context_dfa(Tscantable * st, gint16 context);
+void compile_scantable_contexts(Tscantable * st);
 
 void
 pattern_set_blockmatch(Tscantable * st, guint16 matchnum,
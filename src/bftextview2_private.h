@@ -30,6 +30,8 @@ extern void g_none(char *first, ...);
 #endif
  /**/
 
+#include "bftextview2_acindex.h"
+
 #define CURRENT_BFLANG2_VERSION "2.0"
 
 #define BF_OFFSET_UNDEFINED G_MAXINT32
@@ -47,6 +49,7 @@ extern void g_none(char *first, ...);
 #define DBG_SIGNALS DBG_NONE
 #define DBG_AUTOCOMP DBG_NONE
 #define DBG_DELAYSCANNING DBG_NONE
+#define DBG_SCHEDULER DBG_NONE
 #define DBG_FOLD DBG_NONE
 #define DBG_MARGIN DBG_NONE
 #define DBG_PARSING DBG_NONE
@@ -55,16 +58,6 @@ extern void g_none(char *first, ...);
 #define DBG_IDENTIFIER DBG_NONE
 #define DBG_MARKREGION DBG_NONE
 
-#ifdef UPDATE_OFFSET_DELAYED
-#include "bf_lib.h"
-typedef struct {
-	BF_ELIST_HEAD;
-	guint32 startpos;
-	gint32 offset;
-} Toffsetupdate;
-#define OFFSETUPDATE(var) ((Toffsetupdate *)var)
-#endif /*UPDATE_OFFSET_DELAYED*/
-
 #define NUMSCANCHARS 127		/* 128 is ascii, but the last character is never scanned (DEL)
 								   and the Ttablerow has one more 16bit value. By setting this to 127 instead of 128
 								   we dont need padding to align the Ttablerow in memory
@@ -78,8 +71,15 @@ typedef struct {
 #define SPELLCHECK_ENABLED 1
 #define SPELLCHECK_DISABLED 0
 typedef struct {
-	GArray *table; /* a pointer to the DFA table for this context */
-	GCompletion *ac;			/* autocompletion items in this context */
+	GArray *table; /* a pointer to the DFA table (Ttablerow) for this context while it is compiled, NULL after compress_context_dfa() */
+	GArray *pending;	/* the matches (guint16) that are not yet compiled into table, NULL after compile_scantable_contexts() */
+	guint16 *dfa;	/* the compressed DFA table, for each state a row of rowlen entries: the match, followed by the next state for each character class */
+	guint8 charclass[NUMSCANCHARS + 1];	/* the character class (the index in a row of dfa) for each character */
+	guint16 rowlen;	/* the number of character classes + 1 */
+	guint numstates;	/* the number of rows in dfa */
+	guint8 *skip;	/* for each state 0, or the index+1 in skipexits if the state loops to itself for all but a few characters */
+	guint32 *skipexits;	/* for each skip state DFA_SKIP_WORDS words, a bitmap of the ascii characters (and the nul) that leave the state */
+	Tacindex *ac;			/* autocompletion items in this context, sorted by compile_context() */
 	GHashTable *patternhash;	/* a hash table where the pattern and its autocompletion string are the keys, and an integer to the ID of the pattern is the value */
 	GtkTextTag *contexttag;		/* if the context area itself needs some kind of style (to implement a string context for example) */
 	gchar *contexthighlight;	/* the string that has the id for the highlight */
@@ -105,15 +105,10 @@ typedef struct {
 	gboolean foldable;
 } Tpattern_block;
 
+/* the scanner reads a Tpattern for every match, so this contains only what the scanner needs and
+it is kept as small as possible (16 bytes on 64bit). Everything else is in Tpattern_cold. */
 typedef struct {
 	GtkTextTag *selftag;		/* the tag used to highlight this pattern */
-	gchar *reference;			/* the reference data, or NULL. may be inserted in hash tables for multiple keys in multiple contexts */
-	gchar *pattern;				/* the pattern itself. stored in the Tpattern so we can re-use it in another context */
-	GSList *autocomp_items; /* a list of Tpattern_autocomplete - a pattern can autocomplete in multiple ways, for 
-										example with and without closing tag, or with and without function arguments.
-										to be able to recompile a pattern in multiple contexts we need this information in Tpattern */
-	gchar *selfhighlight;		/* a string with the highlight for this pattern. used when re-linking highlights and textstyles
-								   if the user changed any of these in the preferences */
 	guint16 block;			/* this is 0 for most blocks, only blocks that need a tag have this set, refers to a a position in an array of Tpattern_block*/
 	gint16 blockstartpattern;	/* the number of the pattern that may start this block, or -1 to end the last started block, also used for stretch block */
 	gint16 nextcontext;			/* 0, or if this pattern starts a new context the number of the context, or -1 or -2 etc.
@@ -126,15 +121,30 @@ typedef struct {
 	guint8 ends_block :1;			/* wether or not this pattern may end a block */
 	guint8 tagclose_from_blockstack :1;	/* this is a generix xml close tag that needs the blockstack to autoclose */
 	guint8 stretch_blockstart :1; /* the end of this match is the new end-of-blockstart, used for HTML/XML tags */
-	guint8 case_insens :1;
-	guint8 is_regex :1;
 #ifdef IDENTSTORING
 	guint8 identmode :1;
 #endif							/* IDENTSTORING */
 } Tpattern;
+
+/* the data of a pattern that is used to compile it, for autocompletion and for the reference
+popups, but not for scanning. Tscantable.matchinfo has the same index as Tscantable.matches */
+typedef struct {
+	gchar *reference;			/* the reference data, or NULL. may be inserted in hash tables for multiple keys in multiple contexts */
+	gchar *pattern;				/* the pattern itself. stored in the Tpattern_cold so we can re-use it in another context */
+	GSList *autocomp_items; /* a list of Tpattern_autocomplete - a pattern can autocomplete in multiple ways, for 
+										example with and without closing tag, or with and without function arguments.
+										to be able to recompile a pattern in multiple contexts we need this information here */
+	gchar *selfhighlight;		/* a string with the highlight for this pattern. used when re-linking highlights and textstyles
+								   if the user changed any of these in the preferences */
+	guint8 case_insens;
+	guint8 is_regex;
+} Tpattern_cold;
 /*
-32bit size = 5*32 + 3*16 + 1*2 + 8*1 = 217 + 7 padding bits = 28 bytes
-64bit size = 5*64 + 3*16 + 1*2 + 8*1 = 361 + 7 padding bits = 48 bytes
+Tpattern:
+32bit size = 1*32 + 3*16 + 1*2 + 5*1 = 87 + 9 padding bits = 12 bytes
+64bit size = 1*64 + 3*16 + 1*2 + 5*1 = 119 + 9 padding bits = 16 bytes
+Tpattern_cold:
+64bit size = 4*64 + 2*8 = 272 + 48 padding bits = 40 bytes
 */
 
 typedef struct {
@@ -149,19 +159,74 @@ typedef struct {
 /*#define character_is_symbol(st,context,c) (g_array_index((GArray *)g_array_index(st->contexts, Tcontext, context).table, Ttablerow, 1).row[c] != 1)*/
 gboolean character_is_symbol(Tscantable *st,guint16 context, gunichar uc);
 
+/* get_table() and get_tablerow() can only be used while the context is compiled */
 #define get_table(scantable, context) ((GArray *)g_array_index(scantable->contexts, Tcontext, context).table)
 
 #define get_tablerow(scantable, context, curstate) (g_array_index(g_array_index(scantable->contexts, Tcontext, context).table, Ttablerow, curstate))
 
+#define get_context(scantable, context) (&g_array_index(scantable->contexts, Tcontext, context))
+/* the next state and the match in the compressed DFA, ctx is a Tcontext pointer */
+#define dfa_next_state(ctx, curstate, uc) ((ctx)->dfa[(curstate) * (ctx)->rowlen + (ctx)->charclass[(uc)]])
+#define dfa_match(ctx, curstate) ((ctx)->dfa[(curstate) * (ctx)->rowlen])
+#define DFA_SKIP_MAX_EXITS 8		/* a state that is left by more characters than this is not a skip state */
+#define DFA_SKIP_WORDS 4			/* the guint32 words in the bitmap of a skip state, one bit for each ascii character */
+void compute_dfa_skips(Tcontext * ctx);
+const gchar *dfa_skip(Tcontext * ctx, guint curstate, const gchar * p, guint maxchars, guint * numchars);
+
+/* the DFA walking a text, every scanning loop uses this, see bftextview2_dfarun.c */
+typedef struct _Tdfarun Tdfarun;
+typedef enum {
+	dfarun_end,					/* the region is scanned, including the final '\0' */
+	dfarun_loops,				/* maxloops was reached, call dfa_run() again to continue */
+	dfarun_stopped				/* the symbol callback returned FALSE */
+} Tdfarun_status;
+struct _Tdfarun {
+	Tscantable *st;
+	GArray *stack;				/* the context stack for dfarun_context_change(), gint16's with the bottom
+								   first, NULL if the match callback keeps its own stack */
+	const gchar *p;				/* the text at iter_o */
+	const gchar *text_end;		/* the end of the text, or of the current slice if fetch is set */
+	const gchar *mstart;		/* the text at mstart_o, only valid if fetch is not set */
+	guint32 iter_o;
+	guint32 mstart_o;			/* the offset of the last symbol, a match runs from mstart_o to iter_o */
+	guint32 end_o;				/* the region ends here, the callbacks may enlarge it */
+	guint pos;					/* the DFA state */
+	guint loops;				/* the number of DFA steps so far */
+	gint16 context;
+	guint8 identmode;			/* from the last pattern that matched, reset after an identifier is stored */
+	guint8 identaction;
+	gboolean last_character_run;
+	/* pattern patternum matched from mstart_o to iter_o, returns the context after the match */
+	gint16 (*match) (Tdfarun * run, guint16 patternum, Tpattern * pat);
+	/* an identifier from mstart_o to iter_o in context, returns TRUE if it was stored, optional */
+	gboolean (*identifier) (Tdfarun * run, gint16 context);
+	/* called at every symbol once the DFA is back in its start state at iter_o (but not for the
+	   final '\0'), returns FALSE to stop, optional */
+	gboolean (*symbol) (Tdfarun * run);
+	/* called at the final '\0' of the region, matched is TRUE if a pattern ended there. It may
+	   enlarge end_o to continue scanning, optional */
+	void (*region_end) (Tdfarun * run, gboolean matched);
+	/* sets p and text_end to the next slice of the text, starting at iter_o. If NULL the whole
+	   text is in p..text_end */
+	void (*fetch) (Tdfarun * run);
+	gpointer data;
+};
+void dfarun_init(Tdfarun * run, Tscantable * st, GArray * stack, const gchar * text, const gchar * text_end,
+				 guint32 start_o, guint32 end_o);
+gint16 dfarun_context_change(Tdfarun * run, guint16 patternum, Tpattern * pat);
+Tdfarun_status dfa_run(Tdfarun * run, guint maxloops);
+
 /*****************************************************************/
 /* scanning the text and caching the results */
 /*****************************************************************/
 typedef struct {
-	gpointer parentfblock;
+	guint32 parentfblock;		/* handle in the Tscanarena, see fblock_parent() */
 	guint32 start1_o;
 	guint32 end1_o;
 	guint32 start2_o;
 	guint32 end2_o;
+	guint32 chunkid;			/* the chunk in the foundcache that holds the Tfound that pushed this block, 0 if
+								   it is not in the foundcache, see bftextview2_foundcache.c */
 	gint16 patternum;			/* which pattern (number of the array element in scantable->matches) started the block */
 	guint8 folded;
 	guint8 foldable;			/* FALSE on a single line */
@@ -173,14 +238,15 @@ typedef struct {
 								   The Tfoundblock is popped as current block, and the parent
 								   is active again. This is also put on the foundcache
 
-								   on 64bit this type has size 8+4+4+4+4+2+1+1 + 4 padding = 32 bytes
-								   on 32bit this type has size 4+4+4+4+4+2+1+1 NO padding = 24 bytes
+								   this type has size 4+4+4+4+4+4+2+1+1 = 28 bytes
 								 */
 
 typedef struct {
-	gpointer parentfcontext;
+	guint32 parentfcontext;		/* handle in the Tscanarena, see fcontext_parent() */
 	guint32 start_o;
 	guint32 end_o;
+	guint32 chunkid;			/* the chunk in the foundcache that holds the Tfound that pushed this context, 0 if
+								   it is not in the foundcache, see bftextview2_foundcache.c */
 	gint16 context;				/* number of the element in scantable->contexts */
 } Tfoundcontext;				/* Once a start-of-context is found start is set
 								   and the Tfoundcontext is added to the current foundcache.
@@ -190,16 +256,17 @@ typedef struct {
 								   The Tfoundcontext is popped from the current stack and
 								   this entry is also added to the foundcache
 
-								   on 64bit this type has size 8+4+4+2 + 6 padding = 24 bytes
-								   on 32bit this type has size 4+4+4+2 + 2 padding = 16 bytes
+								   this type has size 4+4+4+4+2 + 2 padding = 20 bytes
 								 */
 
 typedef struct {
-	Tfoundcontext *fcontext;	/* if numcontextchange == 0 this points to the current active context
+	guint32 fcontext;			/* handle in the Tscanarena, see found_fcontext()
+								   if numcontextchange == 0 this points to the current active context
 								   if numcontextchange > 0 this points to the pushed context, which also happens to be the current context
 								   if numcontextchange < 0 this points to the top of the stack at this position, to get the current position
 								   you'll have to pop N items (where N is -1 * numcontextchange). */
-	Tfoundblock *fblock;		/* if numblockchange == 0 this points to the current active block
+	guint32 fblock;				/* handle in the Tscanarena, see found_fblock()
+								   if numblockchange == 0 this points to the current active block
 								   if numblockchange > 0 this points to the pushed block, which also happens to be the current block
 								   if numblockchange < 0 this points to the top of the stack at this position, to get the current position
 								   you'll have to pop N items (where N is -1 * numblockchange). */
@@ -208,8 +275,7 @@ typedef struct {
 								   for example html files that don't close paragrahs or tablerows */
 	gint8 numcontextchange;		/* 0 means no change, 1 means 1 push, -2 means 2 popped etc. */
 } Tfound;						/*
-								   on 64bit this type has size 8+8+4+2+1 + 1 padding = 24 bytes
-								   on 32bit this type has size 4+4+4+2+1 + 1 padding = 16 bytes
+								   this type has size 4+4+4+2+1 + 1 padding = 16 bytes
 								 */
 
 #define IS_FOUNDMODE_CONTEXTPUSH(i)   (i->numcontextchange > 0)
@@ -0,0 +1,290 @@
+/* Bluefish HTML Editor
+ * bftextview2_scanbench.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+the scanner benchmark runs the DFA engine headless over a corpus of files, without
+a BluefishTextView or a GtkTextBuffer. It loads every language through the normal
+langmgr/patcompile path, and then runs dfa_run() (bftextview2_dfarun.c), the DFA loop of
+bftextview2_run_scanner(), with the block and context stack handling of found_match() from
+bftextview2_scanstack.h (Tfound/Tfoundblock/Tfoundcontext from a Tscanarena stored in a
+Tfoundcache). What is not done is applying GtkTextTags, validating an existing scancache and
+storing identifiers, because those need a document. The reported scancache is the largest foundcache_length() and
+the largest arena of a single file.
+
+run it with
+src/bluefish --bench-scanner file1.php file2.html ...
+or
+make bench-scanner BENCH_FILES="file1.php file2.html"
+*/
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_langmgr.h"
+#include "bftextview2_foundcache.h"
+#include "bftextview2_arena.h"
+#include "bftextview2_scanstack.h"
+#include "bftextview2_scanbench.h"
+
+typedef struct {
+	Tbflang *bflang;
+	guint numfiles;
+	guint64 numchars;
+	guint64 numloops;
+	guint64 nummatches;
+	guint64 numcontextpush;
+	guint64 numcontextpop;
+	guint64 numblockpush;
+	guint64 numblockpop;
+	guint peak_foundcache;		/* the largest foundcache_length() of a single file */
+	guint peak_found;			/* the largest number of elements in use in the arena pools of a single file */
+	guint peak_fblock;
+	guint peak_fcontext;
+	guint peak_arena_kb;		/* the largest memory of the arena slabs of a single file */
+	gdouble seconds;
+} Tscanbench;
+
+typedef struct {
+	Tscantable *st;
+	Tscanbench *sb;
+	Tfoundcache *foundcaches;
+	Tscanarena *arena;
+	Tfoundcontext *curfcontext;
+	Tfoundblock *curfblock;
+	gint16 context;
+} Tscanbenchrun;
+
+/* found_match() in bftextview2_scanner.c without the GtkTextTag and cache validation, the block and
+context stack is handled by the same functions from bftextview2_scanstack.h */
+static gint16
+scanbench_found_match(Tscanbenchrun * sbr, guint16 patternum, guint match_start_o, guint match_end_o)
+{
+	Tpattern *pat = &g_array_index(sbr->st->matches, Tpattern, patternum);
+	Tfoundblock *fblock = sbr->curfblock;
+	Tfoundcontext *fcontext = sbr->curfcontext;
+	gint numblockchange = 0, numcontextchange = 0;
+	Tfound *found;
+
+	sbr->sb->nummatches++;
+	scanstack_stretch_block(sbr->curfblock, pat, match_end_o);
+	if (G_LIKELY(!pat->starts_block && !pat->ends_block
+				 && (pat->nextcontext == 0 || pat->nextcontext == sbr->context))) {
+		return sbr->context;
+	}
+
+	if (pat->starts_block) {
+		fblock = scanstack_push_block(sbr->arena, sbr->curfblock, patternum, match_start_o, match_end_o);
+		sbr->curfblock = fblock;
+		sbr->sb->numblockpush++;
+		numblockchange = 1;
+	} else if (pat->ends_block && sbr->curfblock) {
+		Tfoundblock *startfblock = scanstack_find_block_start(sbr->arena, sbr->curfblock, pat, &numblockchange);
+		sbr->sb->numblockpop++;
+		if (startfblock)
+			sbr->curfblock = scanstack_end_block(sbr->arena, startfblock, match_start_o, match_end_o,
+												 &numblockchange);
+	}
+
+	if (pat->nextcontext != 0 && pat->nextcontext != sbr->context) {
+		if (pat->nextcontext < 0) {
+			sbr->sb->numcontextpop++;
+			sbr->curfcontext = scanstack_pop_contexts(sbr->arena, sbr->curfcontext, pat->nextcontext,
+													  match_start_o, &numcontextchange);
+			sbr->context = sbr->curfcontext ? sbr->curfcontext->context : 1;
+		} else {
+			fcontext = scanstack_push_context(sbr->arena, sbr->curfcontext, pat->nextcontext, match_end_o);
+			sbr->curfcontext = fcontext;
+			sbr->context = pat->nextcontext;
+			sbr->sb->numcontextpush++;
+			numcontextchange = 1;
+		}
+	}
+	if (numblockchange == 0 && numcontextchange == 0)
+		return sbr->context;
+
+	found = arenapool_alloc(&sbr->arena->found);
+	found->numblockchange = numblockchange;
+	found->fblock = arenapool_handle(&sbr->arena->fblock, fblock);
+	found->numcontextchange = numcontextchange;
+	found->fcontext = arenapool_handle(&sbr->arena->fcontext, fcontext);
+	found->charoffset_o = match_end_o;
+	foundcache_insert(sbr->foundcaches, found);
+	return sbr->context;
+}
+
+static gint16
+scanbench_match(Tdfarun * run, guint16 patternum, Tpattern * pat)
+{
+	return scanbench_found_match(run->data, patternum, run->mstart_o, run->iter_o);
+}
+
+/* runs dfa_run() over an UTF-8 string instead of a GtkTextBuffer */
+static void
+scanbench_scan_buffer(Tscanbench * sb, const gchar * buf, gsize buflen)
+{
+	Tscanbenchrun sbr;
+	Tdfarun run;
+
+	memset(&sbr, 0, sizeof(Tscanbenchrun));
+	sbr.st = sb->bflang->st;
+	sbr.sb = sb;
+	sbr.context = 1;
+	sbr.arena = scanarena_new();
+	sbr.foundcaches = foundcache_new(sbr.arena);
+
+	/* scanbench_found_match() keeps its own stack of Tfoundcontext's, like found_match() */
+	dfarun_init(&run, sbr.st, NULL, buf, buf + buflen, 0, G_MAXUINT32);
+	run.match = scanbench_match;
+	run.data = &sbr;
+	dfa_run(&run, G_MAXUINT);
+	sb->numchars += run.iter_o;
+	sb->numloops += run.loops;
+
+	sb->peak_foundcache = MAX(sb->peak_foundcache, foundcache_length(sbr.foundcaches));
+	sb->peak_found = MAX(sb->peak_found, sbr.arena->found.count);
+	sb->peak_fblock = MAX(sb->peak_fblock, sbr.arena->fblock.count);
+	sb->peak_fcontext = MAX(sb->peak_fcontext, sbr.arena->fcontext.count);
+	sb->peak_arena_kb = MAX(sb->peak_arena_kb, ARENAPOOL_KB(&sbr.arena->found) + ARENAPOOL_KB(&sbr.arena->fblock)
+							+ ARENAPOOL_KB(&sbr.arena->fcontext));
+
+	foundcache_free(sbr.foundcaches);
+	scanarena_free(sbr.arena);
+}
+
+static gchar *
+scanbench_guess_mimetype(const gchar * filename, const gchar * buf, gsize buflen)
+{
+	gchar *conttype;
+	gboolean uncertain = FALSE;
+#ifdef WIN32
+	gchar *tmp;
+#endif
+	conttype = g_content_type_guess(filename, (const guchar *) buf, buflen, &uncertain);
+#ifdef WIN32
+	tmp = g_content_type_get_mime_type(conttype);
+	g_free(conttype);
+	conttype = tmp;
+#endif
+	if (strcmp(conttype, "text/html") == 0 && strstr(buf, "<!DOCTYPE html>") != NULL) {
+		g_free(conttype);
+		conttype = g_strdup("text/x-html5");
+	}
+	return conttype;
+}
+
+/* returns the bflang with a complete scantable, or NULL if this file has no highlighting */
+static Tbflang *
+scanbench_get_bflang(const gchar * mimetype, const gchar * filename)
+{
+	Tbflang *bflang;
+	while (!langmgr_done_scanning()) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	bflang = langmgr_get_bflang(mimetype, filename);
+	if (!bflang)
+		return NULL;
+	/* the scantable is built in a thread, and handed over in build_lang_finished_lcb() in the mainloop */
+	while (bflang->parsing) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	return bflang->st ? bflang : NULL;
+}
+
+static void
+scanbench_print(Tscanbench * sb)
+{
+	gdouble secs = sb->seconds > 0 ? sb->seconds : 1e-9;
+	g_print("%-16s files %4u chars %10" G_GUINT64_FORMAT " time %8.1f ms\n", sb->bflang->name, sb->numfiles,
+			sb->numchars, 1000.0 * sb->seconds);
+	g_print("%-16s %12.0f chars/s %12.0f matches/s (%" G_GUINT64_FORMAT " matches, %" G_GUINT64_FORMAT
+			" loops)\n", "", sb->numchars / secs, sb->nummatches / secs, sb->nummatches, sb->numloops);
+	g_print("%-16s contexts %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT " blocks %" G_GUINT64_FORMAT "/%"
+			G_GUINT64_FORMAT " (push/pop)\n", "", sb->numcontextpush, sb->numcontextpop, sb->numblockpush,
+			sb->numblockpop);
+	g_print("%-16s peak foundcache %u entries, arena %u/%u/%u (found/fblock/fcontext) in %u Kbytes\n", "",
+			sb->peak_foundcache, sb->peak_found, sb->peak_fblock, sb->peak_fcontext, sb->peak_arena_kb);
+}
+
+/* runs the benchmark over all files, forcemime may be NULL to autodetect the language for each file.
+returns the exit status for main() */
+gint
+bftextview2_scanbench_run(gchar ** files, const gchar * forcemime)
+{
+	GHashTable *results;
+	GList *tmplist, *langs = NULL;
+	GTimer *timer;
+	gchar **tmp;
+
+	if (!files || !*files) {
+		g_print("bench-scanner: no files given\n");
+		return 1;
+	}
+	results = g_hash_table_new(g_direct_hash, g_direct_equal);
+	timer = g_timer_new();
+	for (tmp = files; *tmp; tmp++) {
+		gchar *buf = NULL, *mimetype;
+		gsize buflen = 0;
+		GError *gerror = NULL;
+		Tbflang *bflang;
+		Tscanbench *sb;
+
+		if (!g_file_get_contents(*tmp, &buf, &buflen, &gerror)) {
+			g_print("bench-scanner: failed to read %s: %s\n", *tmp, gerror->message);
+			g_error_free(gerror);
+			continue;
+		}
+		if (!g_utf8_validate(buf, buflen, NULL)) {
+			g_print("bench-scanner: skipping %s, not valid UTF-8\n", *tmp);
+			g_free(buf);
+			continue;
+		}
+		mimetype = forcemime ? g_strdup(forcemime) : scanbench_guess_mimetype(*tmp, buf, buflen);
+		bflang = scanbench_get_bflang(mimetype, *tmp);
+		if (!bflang) {
+			g_print("bench-scanner: skipping %s, no highlighting for %s\n", *tmp, mimetype);
+			g_free(mimetype);
+			g_free(buf);
+			continue;
+		}
+		sb = g_hash_table_lookup(results, bflang);
+		if (!sb) {
+			sb = g_slice_new0(Tscanbench);
+			sb->bflang = bflang;
+			g_hash_table_insert(results, bflang, sb);
+			langs = g_list_append(langs, sb);
+		}
+		sb->numfiles++;
+		g_timer_start(timer);
+		scanbench_scan_buffer(sb, buf, buflen);
+		sb->seconds += g_timer_elapsed(timer, NULL);
+		g_free(mimetype);
+		g_free(buf);
+	}
+	g_timer_destroy(timer);
+
+	for (tmplist = g_list_first(langs); tmplist; tmplist = g_list_next(tmplist)) {
+		scanbench_print(tmplist->data);
+		g_slice_free(Tscanbench, tmplist->data);
+	}
+	g_list_free(langs);
+	g_hash_table_destroy(results);
+	return 0;
+}
@@ -0,0 +1,28 @@
+/* Bluefish HTML Editor
+ * bftextview2_scanbench.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_SCANBENCH_H_
+#define _BFTEXTVIEW2_SCANBENCH_H_
+
+#include "bftextview2.h"
+
+gint bftextview2_scanbench_run(gchar ** files, const gchar * forcemime);
+
+#endif
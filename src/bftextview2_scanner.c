@@ -17,7 +17,6 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 /*#define DEVELOPMENT*/
-#define HL_PROFILING
 /*#define VALGRIND_PROFILING*/
 
 /*#define DUMP_SCANCACHE*/
@@ -28,15 +27,21 @@
 #include <valgrind/callgrind.h>
 #endif
 
-#ifdef HL_PROFILING
-#include <unistd.h>
-#endif
+#include <string.h>				/* strlen() */
 /* for the design docs see bftextview2.h */
 #include "bluefish.h"
 #include "bf_lib.h"
 #include "bftextview2_private.h"
 #include "bftextview2_scanner.h"
+#include "bftextview2_foundcache.h"
+#include "bftextview2_arena.h"
+#include "bftextview2_scanstack.h"
 #include "bftextview2_identifier.h"
+#include "bftextview2_scanthread.h"
+#include "bftextview2_telemetry.h"
+#ifdef HAVE_LIBENCHANT
+#include "bftextview2_spell.h"
+#endif
 
 #ifdef MARKREGION
 #include "bftextview2_markregion.h"
@@ -67,6 +72,10 @@ G_SLICE=always-malloc G_DEBUG=gc-friendly,resident-modules valgrind --tool=memch
 
 #define NUM_TIMER_CHECKS_PER_RUN 10
 
+#define SCANNING_CHUNK_CHARS 4096	/* the number of characters that the scanner fetches from the buffer at once */
+
+#define TAGRUN_LOOKBACK 4			/* the number of previous runs that scanning_add_tag() tries to merge with */
+
 #ifdef DEVELOPMENT
 static void scancache_check_integrity(BluefishTextView * btv, GTimer *timer);
 #endif
@@ -77,108 +86,83 @@ typedef struct {
 	guint16 patternum;
 } Tmatch;
 
+typedef struct {
+	GtkTextTag *tag;
+	guint start_o;
+	guint end_o;
+} Ttagrun;
+
 typedef struct {
 	Tfoundcontext *curfcontext;
 	Tfoundblock *curfblock;
 	/*Tfound *curfound; *//* items from the cache */
 	Tfound *nextfound;			/* items from the cache */
-	GSequenceIter *siter;		/* an iterator to get the next item from the cache */
 	GTimer *timer;
 	GtkTextIter start;			/* start of area to scan */
 	GtkTextIter end;			/* end of area to scan */
+	guint end_o;				/* offset of end, the scanning loop compares offsets instead of iters */
+	GArray *tagruns;			/* Ttagrun's that are applied by scanning_apply_tags() at the end of the run */
 	gint16 context;
-	guint8 identmode;
-	guint8 identaction;
-#ifdef HL_PROFILING
-	guint startpos;
-	gdouble stage1;
-	gdouble stage2;
-	gdouble stage3;
-	gdouble stage4;
-#endif
+	/* counters for the scanner telemetry, see bftextview2_telemetry.c */
+	guint nummatches;
+	guint numcontextpush;
+	guint numcontextpop;
+	guint numblockpush;
+	guint numblockpop;
 } Tscanning;
 
-#ifdef HL_PROFILING
-typedef struct {
-	gint longest_contextstack;
-	gint longest_blockstack;
-	gint numcontextstart;
-	gint numcontextend;
-	gint numblockstart;
-	gint numblockend;
-	gint numchars;
-	gint numloops;
-	gint fblock_refcount;
-	gint fcontext_refcount;
-	gint found_refcount;
-	guint total_runs;
-	guint total_chars;
-	guint total_time_ms;
-} Thl_profiling;
-
-Thl_profiling hl_profiling = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, };
-GTimer *totalruntimer = NULL;
-#endif
-
-guint loops_per_timer = 1000;	/* a tunable to avoid asking time too often. this is auto-tuned. */
 
 #ifdef DEVELOPMENT
 void
 dump_scancache(BluefishTextView * btv)
 {
-	GSequenceIter *siter = g_sequence_get_begin_iter(btv->scancache.foundcaches);
+	Tfound *found = get_foundcache_first(btv);
 	g_print("\nDUMP SCANCACHE\nwith length %d, document length=%d\n\n",
-			g_sequence_get_length(btv->scancache.foundcaches), gtk_text_buffer_get_char_count(btv->buffer));
-	while (siter && !g_sequence_iter_is_end(siter)) {
-		Tfound *found = g_sequence_get(siter);
-		if (!found)
-			break;
-		g_print("%3d: %p, fblock %p, fcontext %p siter %p\n", found->charoffset_o, found, found->fblock,
-				found->fcontext, siter);
+			foundcache_length((Tfoundcache *) btv->scancache.foundcaches), gtk_text_buffer_get_char_count(btv->buffer));
+	while (found) {
+		g_print("%3d: %p, fblock %p, fcontext %p\n", found->charoffset_o, found, found_fblock(btv, found),
+				found_fcontext(btv, found));
 		if (found->numcontextchange != 0) {
 			g_print("\tnumcontextchange=%d", found->numcontextchange);
-			if (found->fcontext) {
-				g_print(",context %d", found->fcontext->context);
-				g_print(", highlight %s, parent=%p, %d:%d",
+			if (found_fcontext(btv, found)) {
+				g_print(",context %d", found_fcontext(btv, found)->context);
+				g_print(", highlight %s, parent=%u, %d:%d",
 						g_array_index(btv->bflang->st->contexts, Tcontext,
-									  found->fcontext->context).contexthighlight,
-						found->fcontext->parentfcontext, found->fcontext->start_o, found->fcontext->end_o);
+									  found_fcontext(btv, found)->context).contexthighlight,
+						found_fcontext(btv, found)->parentfcontext, found_fcontext(btv, found)->start_o, found_fcontext(btv, found)->end_o);
 			}
 			g_print("\n");
 		}
 		if (found->numblockchange != 0) {
 			g_print("\tnumblockchange=%d", found->numblockchange);
-			if (found->fblock) {
-				g_print(", pattern %d ", found->fblock->patternum);
-				if (g_array_index(btv->bflang->st->matches, Tpattern,
-																found->fblock->patternum).is_regex) {
+			if (found_fblock(btv, found)) {
+				g_print(", pattern %d ", found_fblock(btv, found)->patternum);
+				if (g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, found_fblock(btv, found)->patternum).is_regex) {
 					GtkTextIter it1, it2;
 					gchar *tmp2;
 					if (found->numblockchange > 0) {
-						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, found->fblock->start1_o);
-						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it2, found->fblock->end1_o);
+						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, found_fblock(btv, found)->start1_o);
+						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it2, found_fblock(btv, found)->end1_o);
 						tmp2 = gtk_text_buffer_get_text(btv->buffer, &it1, &it2, TRUE);
-					} else if (found->fblock->start2_o != -1) {
-						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, found->fblock->start2_o);
-						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it2, found->fblock->end2_o);
+					} else if (found_fblock(btv, found)->start2_o != -1) {
+						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, found_fblock(btv, found)->start2_o);
+						gtk_text_buffer_get_iter_at_offset(btv->buffer, &it2, found_fblock(btv, found)->end2_o);
 						tmp2 = gtk_text_buffer_get_text(btv->buffer, &it1, &it2, TRUE);
 					} else {
-						tmp2 = g_strdup(g_array_index(btv->bflang->st->matches, Tpattern,
-																found->fblock->patternum).pattern);
+						tmp2 = g_strdup(g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, found_fblock(btv, found)->patternum).pattern);
 					}
 					g_print("%s", tmp2);
 					g_free(tmp2);
 				} else {
-					g_print("%s", g_array_index(btv->bflang->st->matches, Tpattern,
-																found->fblock->patternum).pattern);
+					g_print("%s", g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, found_fblock(btv, found)->patternum).pattern);
 				}
-				g_print(", parent=%p, %d:%d-%d:%d",
-						found->fblock->parentfblock, found->fblock->start1_o, found->fblock->end1_o,
-						found->fblock->start2_o, found->fblock->end2_o);
+				g_print(", parent=%u, %d:%d-%d:%d",
+						found_fblock(btv, found)->parentfblock, found_fblock(btv, found)->start1_o, found_fblock(btv, found)->end1_o,
+						found_fblock(btv, found)->start2_o, found_fblock(btv, found)->end2_o);
 			}
 			g_print("\n");
 		}
-		siter = g_sequence_iter_next(siter);
+		found = get_foundcache_next(btv, found);
 	}
 	g_print("END OF DUMP\n\n");
 }
@@ -215,136 +199,101 @@ dump_highlighting(BluefishTextView * btv)
 #endif
 
 Tfound *
-get_foundcache_next(BluefishTextView * btv, GSequenceIter ** siter)
+get_foundcache_next(BluefishTextView * btv, Tfound * found)
 {
-	DBG_MSG("get_foundcache_next, *siter=%p\n", *siter);
-	*siter = g_sequence_iter_next(*siter);
-	if G_LIKELY((*siter && !g_sequence_iter_is_end(*siter))) {
-		DBG_MSG("get_foundcache_next, next *siter=%p, return found %p\n", *siter, g_sequence_get(*siter));
-		return g_sequence_get(*siter);
-	}
-	DBG_MSG("get_foundcache_next, *siter=%p is end, return NULL\n", *siter);
-	return NULL;
+	DBG_MSG("get_foundcache_next, found=%p\n", found);
+	return foundcache_next(btv->scancache.foundcaches, found);
 }
 
 Tfound *
-get_foundcache_first(BluefishTextView * btv, GSequenceIter ** retsiter)
-{
-	*retsiter = g_sequence_get_begin_iter(btv->scancache.foundcaches);
-	if (*retsiter && !g_sequence_iter_is_end(*retsiter)) {
-		return g_sequence_get(*retsiter);
-	}
-	DBG_MSG("get_foundcache_first, return NULL\n");
-	return NULL;
-}
-
-static gint
-foundcache_compare_charoffset_o(gconstpointer a, gconstpointer b, gpointer user_data)
+get_foundcache_first(BluefishTextView * btv)
 {
-	return ((Tfound *) a)->charoffset_o - ((Tfound *) b)->charoffset_o;
+	return foundcache_first(btv->scancache.foundcaches);
 }
 
+/* returns the last Tfound at or before offset, or the first Tfound if there is none before offset */
 Tfound *
-get_foundcache_at_offset(BluefishTextView * btv, guint offset, GSequenceIter ** retsiter)
+get_foundcache_at_offset(BluefishTextView * btv, guint offset)
 {
-	GSequenceIter *siter;
-	Tfound fakefound;
-	Tfound *found = NULL;
+	Tfound *found;
 
 	g_assert(btv == btv->master);
 
-	fakefound.charoffset_o = offset;
-	siter = g_sequence_search(btv->scancache.foundcaches, &fakefound, foundcache_compare_charoffset_o, NULL);
-	if (G_LIKELY(!g_sequence_iter_is_begin(siter))) {
-		/* now get the previous position, and get the stack at that position */
-		DBG_SCANCACHE("search for offset %d returned iter-position %d (cache length %d)\n", offset,
-					  g_sequence_iter_get_position(siter), g_sequence_get_length(btv->scancache.foundcaches));
-		siter = g_sequence_iter_prev(siter);
-		if (siter && !g_sequence_iter_is_end(siter)) {
-			found = g_sequence_get(siter);
-			if (retsiter)
-				*retsiter = siter;
-			DBG_SCANCACHE("found nearest stack %p with charoffset_o %d\n", found, found->charoffset_o);
-		} else {
-			DBG_SCANCACHE("no siter no cache\n");
-		}
-	} else if (!g_sequence_iter_is_end(siter)) {
-		DBG_SCANCACHE("got begin siter\n");
-		found = g_sequence_get(siter);	/* get the first found */
-		if (retsiter)
-			*retsiter = siter;
-	}
+	found = foundcache_search(btv->scancache.foundcaches, offset);
+	DBG_SCANCACHE("get_foundcache_at_offset, nearest stack for offset %d is %p with charoffset_o %d\n", offset,
+				  found, found ? found->charoffset_o : -1);
 	return found;
 }
 
-void found_free_lcb(gpointer data, gpointer btv);
+static void found_free(BluefishTextView * btv, Tfound * found);
+static void largefile_text_changed(BluefishTextView * btv, guint startpos, gint offset);
+static void largefile_free(BluefishTextView * btv);
 
 static gboolean
-is_fblock_on_stack(Tfoundblock * topfblock, Tfoundblock * searchfblock)
+is_fblock_on_stack(BluefishTextView * btv, Tfoundblock * topfblock, Tfoundblock * searchfblock)
 {
 	Tfoundblock *fblock = topfblock;
 	while (fblock) {
 		if (fblock == searchfblock)
 			return TRUE;
-		fblock = (Tfoundblock *) fblock->parentfblock;
+		fblock = fblock_parent(btv, fblock);
 	}
 	return FALSE;
 }
 
 static gboolean
-is_fcontext_on_stack(Tfoundcontext * topfcontext, Tfoundcontext * searchfcontext)
+is_fcontext_on_stack(BluefishTextView * btv, Tfoundcontext * topfcontext, Tfoundcontext * searchfcontext)
 {
 	Tfoundcontext *fcontext = topfcontext;
 	while (fcontext) {
 		if (fcontext == searchfcontext)
 			return TRUE;
-		fcontext = (Tfoundcontext *) fcontext->parentfcontext;
+		fcontext = fcontext_parent(btv, fcontext);
 	}
 	return FALSE;
 }
 
 static guint
-remove_cache_entry(BluefishTextView * btv, Tfound ** found, GSequenceIter ** siter, Tfoundblock *curblockstack, Tfoundcontext *curcontextstack)
+remove_cache_entry(BluefishTextView * btv, Tfound ** found, Tfoundblock *curblockstack, Tfoundcontext *curcontextstack)
 {
 	Tfound *tmpfound1 = *found;
-	GSequenceIter *tmpsiter1 = *siter;
 	guint invalidoffset;
 	gint blockstackcount = 0, contextstackcount = 0;
 
 	if (!tmpfound1)
 		return 0;
 
-	*found = get_foundcache_next(btv, siter);
+	*found = get_foundcache_next(btv, tmpfound1);
 	DBG_SCANCACHE("remove_cache_entry, STARTED, remove %p at offset %d and any children, numblockchange=%d, numcontextchange=%d\n", tmpfound1,
 				  tmpfound1->charoffset_o, tmpfound1->numblockchange, tmpfound1->numcontextchange);
 	invalidoffset = tmpfound1->charoffset_o;
 	/* if this entry pops blocks or contexts, mark the ends of those as undefined */
 	if (tmpfound1->numblockchange < 0) {
-		Tfoundblock *tmpfblock = tmpfound1->fblock;
+		Tfoundblock *tmpfblock = found_fblock(btv, tmpfound1);
 		DBG_SCANCACHE("remove_cache_entry, found %p pops blocks, mark end of %d fblock's as undefined, fblock=%p\n",
-					  tmpfound1, tmpfound1->numblockchange, tmpfound1->fblock);
+					  tmpfound1, tmpfound1->numblockchange, found_fblock(btv, tmpfound1));
 		blockstackcount = tmpfound1->numblockchange;
 		while (tmpfblock && blockstackcount < 0) {
-			if (!curblockstack || is_fblock_on_stack(curblockstack, tmpfblock)) {
+			if (!curblockstack || is_fblock_on_stack(btv, curblockstack, tmpfblock)) {
 				DBG_SCANCACHE("remove_cache_entry, mark end of fblock %p as undefined\n", tmpfblock);
 				tmpfblock->start2_o = BF_POSITION_UNDEFINED;
 				tmpfblock->end2_o = BF_POSITION_UNDEFINED;
 			}
-			tmpfblock = tmpfblock->parentfblock;
+			tmpfblock = fblock_parent(btv, tmpfblock);
 			blockstackcount++;
 		}
 	}
 	if (tmpfound1->numcontextchange < 0) {
-		Tfoundcontext *tmpfcontext = tmpfound1->fcontext;
+		Tfoundcontext *tmpfcontext = found_fcontext(btv, tmpfound1);
 		DBG_SCANCACHE("remove_cache_entry, found %p pops contexts, mark end of %d fcontext's as undefined, fcontext=%p\n",
-					  tmpfound1, tmpfound1->numcontextchange, tmpfound1->fcontext);
+					  tmpfound1, tmpfound1->numcontextchange, found_fcontext(btv, tmpfound1));
 		contextstackcount = tmpfound1->numcontextchange;
 		while (tmpfcontext && contextstackcount < 0) {
-			if (!curcontextstack || is_fcontext_on_stack(curcontextstack, tmpfcontext)) {
+			if (!curcontextstack || is_fcontext_on_stack(btv, curcontextstack, tmpfcontext)) {
 				DBG_SCANCACHE("remove_cache_entry, mark end of fcontext %p as undefined\n", tmpfcontext);
 				tmpfcontext->end_o = BF_POSITION_UNDEFINED;
 			}
-			tmpfcontext = tmpfcontext->parentfcontext;
+			tmpfcontext = fcontext_parent(btv, tmpfcontext);
 			contextstackcount++;
 		}
 	}
@@ -358,32 +307,31 @@ remove_cache_entry(BluefishTextView * btv, Tfound ** found, GSequenceIter ** sit
 		 tmpfound1, tmpfound1->numblockchange, tmpfound1->numcontextchange, tmpfound1->charoffset_o, *found);
 	while (*found && (blockstackcount > 0 || contextstackcount > 0)) {
 		Tfound *tmpfound2 = *found;
-		GSequenceIter *tmpsiter2 = *siter;
-		*found = get_foundcache_next(btv, siter);
+		*found = get_foundcache_next(btv, tmpfound2);
 		blockstackcount += tmpfound2->numblockchange;
 		contextstackcount += tmpfound2->numcontextchange;
 
 		DBG_SCANCACHE
 			("in loop: remove Tfound %p with offset %d, fcontext=%p, numcontextchange=%d, fblock=%p, numblockchange=%d, from the cache and free, contextstackcount=%d, blockstackcount=%d, nextfound=%p\n",
-			 tmpfound2, tmpfound2->charoffset_o, tmpfound2->fcontext, tmpfound2->numcontextchange, tmpfound2->fblock, tmpfound2->numblockchange, contextstackcount, blockstackcount, *found);
+			 tmpfound2, tmpfound2->charoffset_o, found_fcontext(btv, tmpfound2), tmpfound2->numcontextchange, found_fblock(btv, tmpfound2), tmpfound2->numblockchange, contextstackcount, blockstackcount, *found);
 		if (tmpfound2->numblockchange < 0 && blockstackcount < 0) {
 			/* a blockstack < 0 probably means that this found pops a 
 			block that started before the found that we started to remove 
 			in this function, so let's set the end to undefined */
-			tmpfound2->fblock->start2_o = BF_POSITION_UNDEFINED;
-			tmpfound2->fblock->end2_o = BF_POSITION_UNDEFINED;
+			found_fblock(btv, tmpfound2)->start2_o = BF_POSITION_UNDEFINED;
+			found_fblock(btv, tmpfound2)->end2_o = BF_POSITION_UNDEFINED;
 		}
 		
 		invalidoffset = tmpfound2->charoffset_o;
-		g_sequence_remove(tmpsiter2);
-		found_free_lcb(tmpfound2, btv);
+		foundcache_remove(btv->scancache.foundcaches, tmpfound2);
+		found_free(btv, tmpfound2);
 	}
 
 	DBG_SCANCACHE("remove_cache_entry, finally remove found %p itself with offset %d and return invalidoffset %d\n", tmpfound1,
 				  tmpfound1->charoffset_o, invalidoffset);
 
-	g_sequence_remove(tmpsiter1);
-	found_free_lcb(tmpfound1, btv);
+	foundcache_remove(btv->scancache.foundcaches, tmpfound1);
+	found_free(btv, tmpfound1);
 	return invalidoffset;
 }
 
@@ -397,6 +345,7 @@ mark_needscanning(BluefishTextView * btv, gint startpos, gint endpos)
 	situation */
 	if (startpos < 0) startpos = 0;
 	if (endpos <= 0) return;
+	btv->sccache_saved = FALSE;
 
 #ifdef NEEDSCANNING
 	gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, startpos);
@@ -435,458 +384,74 @@ mark_needscanning(BluefishTextView * btv, gint startpos, gint endpos)
 #endif
 }
 
-#ifdef UPDATE_OFFSET_DELAYED
-
-typedef struct {
-	BF_ELIST_HEAD;
-	guint32 prevpos; /* the last location where the accumulated offset was changed */
-	gint32 prevoffset; /* the accumulated offset from all previous processed offset updates */
-	GSequenceIter *siter; /* the last position in the scancache that had it's offset updated */
-	Tfound *found; /* the Tfound at that same position in the scancache */
-} Tscancache_offset_update;
-
-/*
- * scancache_update_single_offset updates the offset in the scancache, it (is|might be) called
- * multiple times if there have been multiple changes to the offsets (multiple inserts or deletes)
- * it is called from foundcache_process_offsetupdates() which loops over all changes that can be 
- * combined:
- *
- * if it will be called a second time, nextpos will be set to indicate the position where 
- * the offset will change. 
- *
- * This function may thus return
- * for a found > nextpos because the it will be called again for the next new offset.
- *
- * when it is called again for a second change, for any Tfound with charoffset_o > sou->prevpos the new
- * offset will be offset + prevoffset;
- */
+#ifdef THREADED_SCANNING
 static void
-scancache_update_single_offset(BluefishTextView * btv, Tscancache_offset_update *sou, guint32 startpos, gint32 offset, guint32 nextpos)
+scanthread_cancel(BluefishTextView * btv)
 {
-	gint comparepos;
-	gint handleoffset=sou->prevoffset;
-	Tfound *nextfound;
-	GSequenceIter *nextsiter;
-
-	g_assert(btv == btv->master);
-
-	comparepos = (offset < 0) ? startpos - offset : startpos;
-	DBG_SCANCACHE
-		("scancache_update_single_offset, update with offset %d starting at startpos %u, cache length=%u, comparepos=%d, prevpos=%u, prevoffset=%d, nextpos=%u\n",
-		 offset, startpos, g_sequence_get_length(btv->scancache.foundcaches), comparepos, sou->prevpos, sou->prevoffset, nextpos);
-	
-	/* the first thing to do is to initialize sou->found with the next Tfound that we have to change.
-	
-	if this is the first call to scancache_update_single_offset() we will simply get the Tfound at offset 
-	
-	if it is a later call, we can use sou->found (which is always beyond the last position that was handled), but we have to
-	check if sou->found is beyond nextpos, in which case it also needs to be updated for the next change in the scancache, handled
-	by the next call to this function */
-	
-	if (sou->found == NULL) {
-		DBG_SCANCACHE("scancache_update_single_offset, no found, get new found for startpos %u\n",startpos);
-		sou->found = get_foundcache_at_offset(btv, startpos, &sou->siter);
-	} else {
-		DBG_SCANCACHE("scancache_update_single_offset, continue with found %p at charpos %u\n",sou->found, sou->found->charoffset_o);
-	}
-
-#ifdef DEVELOPMENT
-	if (sou->found)
-		DBG_SCANCACHE("scancache_update_single_offset, got found %p with offset %u\n", sou->found, sou->found->charoffset_o);
-	else
-		DBG_SCANCACHE("scancache_update_single_offset, got NULL found (%p)\n", sou->found);
-#endif
-
-	if (!sou->found)
-		return;
-
-	if (sou->found->charoffset_o > startpos && ((gint)sou->found->charoffset_o+(gint)offset) >= ((gint)nextpos)) {
-		DBG_SCANCACHE("current found at %d is bigger then startpos(%u) and bigger then nextpos(%u), return\n",sou->found->charoffset_o,startpos,nextpos);
-		sou->prevoffset += offset;
-		return;
-	}
-
-	/*
-	We have sou->found now set.
-	either found is returned by get_foundcache_at_offset() and prevpos and prevoffset are 0
-	or found is defined in the previous call to scancache_update_single_offset()
-			if it was defined, and it has a position before startpos, this position should equal prevpos
-						and prevoffset is included already
-			if it was defined, and it has a position beyond startpos, that essentially means it is the
-						first found in the cache, so prevpos should be still at 0
-
-	first update all block ends and context ends that are on the stack already before the position where the offset changes
-	if there is a found before the offset changes it should have an updated prevpos already, and prevpos should equal
-	this location.*/
-#ifdef DEVELOPMENT
-	if (sou->found && sou->prevpos!=0 && sou->found->charoffset_o != sou->prevpos) {
-		g_print("ABORT: we have a found(%u) before startpos(%u), but the found is not at prevpos(%u)\n",
-											sou->found->charoffset_o, startpos, sou->prevpos);
-		g_assert_not_reached();
-	}
-#endif
-	if (sou->found && sou->found->charoffset_o <= startpos) {
-		Tfoundcontext *tmpfcontext;
-		Tfoundblock *tmpfblock;
-		DBG_SCANCACHE
-			("scancache_update_single_offset, handle first found %p with offset %u, complete stack fcontext %p fblock %p\n",
-			 sou->found, sou->found->charoffset_o, sou->found->fcontext, sou->found->fblock);
-		/* for the first found (if we have one) we have to update the end-offsets for all contexts/blocks on the stack.
-		These are pushed on the stack at an earlier found already, and are _thus_ corrected for sou->prevpos
-		*/
-		tmpfcontext = sou->found->fcontext;
-		while (tmpfcontext) {
-			DBG_SCANCACHE("scancache_update_single_offset, fcontext on stack=%p, start_o=%u end_o=%u\n",
-						  tmpfcontext, tmpfcontext->start_o, tmpfcontext->end_o);
-			if (tmpfcontext->end_o > startpos && tmpfcontext->end_o != BF_OFFSET_UNDEFINED) {
-				DBG_SCANCACHE("scancache_update_single_offset, update fcontext %p end from %u to %u\n",
-							  tmpfcontext, tmpfcontext->end_o, tmpfcontext->end_o + offset);
-				tmpfcontext->end_o += offset;
-			}
-			tmpfcontext = (Tfoundcontext *) tmpfcontext->parentfcontext;
-		}
-
-		tmpfblock = sou->found->fblock;
-		while (tmpfblock) {
-			DBG_SCANCACHE("scancache_update_single_offset, fblock on stack=%p, %u:%u-%u:%u\n", tmpfblock,
-						  tmpfblock->start1_o, tmpfblock->end1_o,tmpfblock->start2_o, tmpfblock->end2_o);
-			/* there is a special situation for a block: it might be a tretched block, in which 
-			case end1_o possibly needs updating too */
-			DBG_SCANCACHE("comparepos=%d, end1_o=%d for pattern %d (%s)\n",comparepos,tmpfblock->end1_o,tmpfblock->patternum,g_array_index(btv->bflang->st->matches, Tpattern, tmpfblock->patternum).pattern);
-			if (G_UNLIKELY(tmpfblock->end1_o >= comparepos && tmpfblock == sou->found->fblock && tmpfblock->end1_o > sou->found->charoffset_o)) {
-				tmpfblock->end1_o += offset;
-			}
-			if (G_UNLIKELY(tmpfblock->start2_o != BF_POSITION_UNDEFINED)) {
-				if (G_UNLIKELY(offset < 0 && tmpfblock->start2_o < comparepos && tmpfblock->end2_o >= comparepos)) {
-					/* the end of the block might be within the deleted region, if so, set the end as undefined */
-					DBG_SCANCACHE("update end of fblock %p %u:%u-%u:%u to UNDEFINED\n",tmpfblock
-									, tmpfblock->start1_o, tmpfblock->end1_o, tmpfblock->start2_o, tmpfblock->end2_o );
-					tmpfblock->start2_o = BF_POSITION_UNDEFINED;
-					tmpfblock->end2_o = BF_POSITION_UNDEFINED;
-				} else {
-					if (tmpfblock->start2_o >= startpos) {
-					/* notice the difference: the start needs >= startpos and the end needs > startpos */
-						DBG_SCANCACHE
-							("scancache_update_single_offset, update fblock %p from start2_o=%u to start2_o=%u\n",
-						 	tmpfblock, tmpfblock->start2_o, tmpfblock->start2_o + offset);
-						tmpfblock->start2_o += offset;
-					}
-					if (tmpfblock->end2_o > startpos) {
-						DBG_SCANCACHE
-							("scancache_update_single_offset, update fblock %p from end2_o=%u to end2_o=%u\n",
-						 	tmpfblock, tmpfblock->end2_o, tmpfblock->end2_o + offset);
-						tmpfblock->end2_o += offset;
-					}
-				}
-			}
-			tmpfblock = (Tfoundblock *) tmpfblock->parentfblock;
-		}
-	}
-
-	if (offset < 0 /* text was deleted*/ ) {
-		Tfound *tmpfound = sou->found;
-		GSequenceIter *tmpsiter=sou->siter;
-
-		/*
-		in the situation that there was a Tfound before the deleted region, sou->found points to this found that does not need to be deleted
-		BUT in the case that there was no found before the deleted region (for example when the deleted region starts at 0), the current found
-		could be in the deleted region already!!!!
-		*/
-		if (sou->found->charoffset_o > startpos) {
-			/* no need to go the next item, the current items needs to be deleted too */
-			DBG_SCANCACHE("sou->found(%d) is beyond startpos(%d), set found and siter to NULL\n",(gint)sou->found->charoffset_o, (gint)startpos);
-			sou->found = NULL;
-			sou->siter = NULL;
-		} else {
-			DBG_SCANCACHE("before get_foundcache_next, tmpfound is at %u\n",tmpfound?tmpfound->charoffset_o:-1);
-			tmpfound = get_foundcache_next(btv, &tmpsiter);
-			DBG_SCANCACHE("after get_foundcache_next, tmpfound is at %u\n",tmpfound?tmpfound->charoffset_o:-1);
-		}
-
-#ifdef DEVELOPMENT
-		if (tmpfound)
-			DBG_SCANCACHE("tmpfound->charoffset_o=%d, startpos=%u\n",(gint)tmpfound->charoffset_o, (gint)startpos);
-
-		/* we should have a tmpfound now that has offset > startpos and thus it should be beyond prevpos as well */
-		if (tmpfound && ((gint)(tmpfound->charoffset_o+sou->prevoffset)) < startpos) {
-			g_print("ABORT: tmpfound->charoffset_o(%u)+sou->prevoffset(%d)=%u < startpos(%u) (sou->prevpos=%u, offset=%d, nextpos=%d)\n",
-								(gint)tmpfound->charoffset_o, (gint)sou->prevoffset,
-								(gint)tmpfound->charoffset_o+sou->prevoffset,
-								(gint)startpos, (gint)sou->prevpos, (gint)offset, (gint)nextpos);
-			g_assert_not_reached();
-		}
-#endif
-
-		/* loop over any items within the deleted region and remove them. because these
-		Tfound offsets are not yet updated we don't compare with 'startpos-offset' but we
-		compare with 'startpos-offset-sou->prevoffset' */
-		DBG_SCANCACHE("before loop, tmpfound(%p) at position %d +offset+prevoffset=%d\n",tmpfound,tmpfound?tmpfound->charoffset_o:-1,tmpfound?tmpfound->charoffset_o+offset+sou->prevoffset:-1);
-		while (tmpfound && ((gint)tmpfound->charoffset_o+offset+sou->prevoffset) <= ((gint)startpos)) {
-			if (G_LIKELY(((gint)tmpfound->charoffset_o+sou->prevoffset) > ((gint)startpos))) {
-				gint numblockchange = tmpfound->numblockchange;
-				DBG_SCANCACHE("scancache_update_single_offset, remove found %p at %d from the cache\n",tmpfound, tmpfound->charoffset_o);
-				if (numblockchange > 0) {
-					/* we have to enlarge needscanning to the place where this was popped */
-					DBG_SCANCACHE("scancache_update_single_offset, found pushed a block, mark obsolete block %u:%u as needscanning\n",tmpfound->fblock->start1_o, tmpfound->fblock->end2_o);
-					mark_needscanning(btv, tmpfound->fblock->start1_o+sou->prevoffset+offset, tmpfound->fblock->end2_o==BF_OFFSET_UNDEFINED ? BF_OFFSET_UNDEFINED : tmpfound->fblock->end2_o+sou->prevoffset+offset);
-				}
-				if (tmpfound->numcontextchange > 0) {
-					/* we have to enlarge needscanning to the place where this was popped */
-					DBG_SCANCACHE("scancache_update_single_offset, found pushed a context, mark obsolete context %u:%u as needscanning\n",tmpfound->fcontext->start_o, tmpfound->fcontext->end_o);
-					mark_needscanning(btv, tmpfound->fcontext->start_o+sou->prevoffset+offset, tmpfound->fcontext->end_o==BF_OFFSET_UNDEFINED ? BF_OFFSET_UNDEFINED : tmpfound->fcontext->end_o+sou->prevoffset+offset);
-				}
-				remove_cache_entry(btv, &tmpfound, &tmpsiter, NULL, NULL);
-				if (!tmpfound && (numblockchange < 0)) {
-					mark_needscanning(btv, startpos, BF_OFFSET_UNDEFINED);
-					/* there is a special situation: if this is the last found in the cache, and it pops a block,
-					   we have to enlarge the scanning region to the end of the text */
-					DBG_SCANCACHE("scancache_update_single_offset, mark area from %u to end (-1) with needscanning\n",
-								  startpos);
-				}
-			} else {
-				tmpfound = get_foundcache_next(btv, &tmpsiter);
-				DBG_SCANCACHE("in loop, tmpfound(%p) at position %d +offset+prevoffset=%d\n",tmpfound,tmpfound?tmpfound->charoffset_o:-1,tmpfound?tmpfound->charoffset_o+offset+sou->prevoffset:-1);
-			}
-		}
-	}
-
-	/* from this point on: see if we have to update offsets for any other founds, or if we are ready in the case that the found
-	is beyond nextpos (in that case the next call to scancache_update_single_offset() will update their offsets) */
-	if (!sou->found) {
-		/* possibly text was deleted starting at offset 0, in that case all previous founds have been deleted, so get the first one */
-		DBG_SCANCACHE("scancache_update_single_offset, after delete loop, sou->found==NULL, so get the first found\n");
-		nextfound = get_foundcache_first(btv, &nextsiter);
-	} else {
-		nextsiter=sou->siter;
-		nextfound = get_foundcache_next(btv, &nextsiter);
-	}
-	if (nextfound && ((gint)nextfound->charoffset_o + sou->prevoffset) == ((gint)startpos)) {
-		DBG_SCANCACHE("nextfound(%u)+prevoffset(%d)=%u is at the startpos(%u) itself, so handleoffset=%d\n",
-					nextfound->charoffset_o,
-					sou->prevoffset,
-					nextfound->charoffset_o+sou->prevoffset,
-					startpos,
-					handleoffset);
-		/* nextfound is at the startpos itself, beyond here we need to correct with 'offset+prevoffset', but this one needs only correction with 'prevoffset' */
-	} else {
-		DBG_SCANCACHE("update handleoffset(%d)+offset(%d)=%d\n",handleoffset,offset,handleoffset+offset);
-		handleoffset += offset;
-	}
-
-	DBG_SCANCACHE("found(%p) was at %d, nextfound(%d)+handleoffset(%d)=%d, nextpos=%u\n",sou->found
-							, sou->found?sou->found->charoffset_o:-1
-							, nextfound?nextfound->charoffset_o:-1
-							, handleoffset
-							, nextfound?nextfound->charoffset_o+handleoffset:-1
-							, nextpos);
-	/* if the nextfound is already beyond nextpos, we mark the current found as prevpos, set sou->prevoffset and return */
-	if (!nextfound || (((gint)nextfound->charoffset_o) + handleoffset) >= ((gint)nextpos)) {
-		if (sou->found) {
-			sou->prevpos = sou->found->charoffset_o;
-			DBG_SCANCACHE("nextfound(%d)+handleoffset(%d)=%d >= nextpos(%d), so we return at the current found(%d) and set prevpos to %d as well\n"
-					,nextfound?nextfound->charoffset_o:-1
-					, handleoffset
-					, nextfound?nextfound->charoffset_o+handleoffset:-1
-					,nextpos
-					, sou->found->charoffset_o
-					, sou->prevpos);
-		} else {
-			sou->prevpos = 0;
-		}
-		sou->prevoffset += offset;
-		return;
-	}
-	sou->found = nextfound;
-	sou->siter = nextsiter;
-
-	/* if we reach this point, sou->found is NULL or points to a position before nextpos but beyond prevpos */
-#ifdef DEVELOPMENT
-	if (sou->found) {
-		if (((gint)sou->found->charoffset_o+handleoffset) > sou->prevpos) {
-			if (((gint)sou->found->charoffset_o + sou->prevoffset) < startpos) {
-				g_print("ABORT: scancache_update_single_offset, sou->found->charoffset_o(%u)+sou->prevoffset(%d)=%d < startpos(%u) (prevpos=%u)\n",
-							(gint)sou->found->charoffset_o, (gint)sou->prevoffset,sou->found->charoffset_o + sou->prevoffset, (gint)startpos, (gint)sou->prevpos);
-				g_assert_not_reached();
-			}
-		} else {
-
-			/*if (sou->found->charoffset_o < startpos) {*/
-			g_print("ABORT: scancache_update_single_offset, sou->found(%p)->charoffset_o(%u)+sou->prevoffset(%d)+offset(%d)=%u <= prevpos(%u) (startpos=%u, prevoffset=%d)\n",
-							sou->found,sou->found->charoffset_o,sou->prevoffset,offset,sou->found->charoffset_o+sou->prevoffset+offset, (gint)sou->prevpos, (gint)startpos, (gint)sou->prevoffset);
-			g_assert_not_reached();
-			/*}*/
-		}
-	}
-#endif
-
-
-	while (sou->found && ((gint)sou->found->charoffset_o+handleoffset) < ((gint)nextpos)) {
-		Tfound *tmpfound = sou->found;
-		GSequenceIter *tmpsiter=sou->siter;
-		/* loop over all the remaining entries in the cache < nextpos
-		for all further founds, we only handle the pushedblock and pushedcontext, and
-		we update both start and end of the blocks and contexts */
-
-		DBG_SCANCACHE
-			("scancache_update_single_offset, about to update found %p with charoffset %u to %u, fcontext %p and fblock %p\n",
-			 sou->found, sou->found->charoffset_o,
-			 sou->found->charoffset_o + handleoffset,
-			 sou->found->fcontext, sou->found->fblock);
-		if (G_UNLIKELY(IS_FOUNDMODE_CONTEXTPUSH(sou->found))) {
-			DBG_SCANCACHE("scancache_update_single_offset, contextpush %p update from %u:%u to %u:%u\n",
-						  sou->found->fcontext, sou->found->fcontext->start_o, sou->found->fcontext->end_o,
-						  sou->found->fcontext->start_o + handleoffset,
-						  sou->found->fcontext->end_o + handleoffset);
-			if (G_LIKELY(sou->found->fcontext->start_o != BF_OFFSET_UNDEFINED))
-				sou->found->fcontext->start_o += handleoffset;
-			if (G_LIKELY(sou->found->fcontext->end_o != BF_OFFSET_UNDEFINED))
-				sou->found->fcontext->end_o += handleoffset;
-		}
-		if (G_UNLIKELY(IS_FOUNDMODE_BLOCKPUSH(sou->found))) {
-			DBG_SCANCACHE("scancache_update_single_offset, blockpush %p update from %u:%u to %u:%u\n",
-						  sou->found->fblock, sou->found->fblock->start1_o, sou->found->fblock->end2_o
-						  , sou->found->fblock->start1_o + handleoffset
-						  , sou->found->fblock->end2_o + handleoffset);
-			if (G_LIKELY(sou->found->fblock->start1_o != BF_POSITION_UNDEFINED))
-				sou->found->fblock->start1_o += handleoffset;
-			if (G_LIKELY(sou->found->fblock->end1_o != BF_POSITION_UNDEFINED))
-				sou->found->fblock->end1_o += handleoffset;
-			if (G_LIKELY(sou->found->fblock->start2_o != BF_POSITION_UNDEFINED))
-				sou->found->fblock->start2_o += handleoffset;
-			if (G_LIKELY(sou->found->fblock->end2_o != BF_POSITION_UNDEFINED))
-				sou->found->fblock->end2_o += handleoffset;
-		}
-		DBG_SCANCACHE("startpos=%u, offset=%d, prevoffset=%d, found=%p, update charoffset_o from %u to %u\n",startpos,offset,sou->prevoffset, sou->found,sou->found->charoffset_o,sou->found->charoffset_o+handleoffset);
-#ifdef DEVELOPMENT
-		if (((gint)(handleoffset+((gint)sou->found->charoffset_o))) < 0) {
-			g_print("ABORT: scancache_update_single_offset, sou->found(%p)->charoffset_o(%d) will become < 0 ?!?!?! offset=%d, prevoffset=%d\n",
-							sou->found,sou->found->charoffset_o,offset,sou->prevoffset);
-			g_assert_not_reached();
-		}
-#endif
-		sou->found->charoffset_o += handleoffset;
-
-		tmpfound = get_foundcache_next(btv, &tmpsiter);
-		if (tmpfound && tmpfound->charoffset_o > sou->prevpos && handleoffset == sou->prevoffset) {
-			DBG_SCANCACHE("tmpfound(%u) > prevpos(%u), update handleoffset\n",tmpfound->charoffset_o,sou->prevpos);
-			handleoffset += offset;
-		}
-
-		if (!tmpfound || ((gint)tmpfound->charoffset_o+handleoffset) >= ((gint)nextpos)) {
-#ifdef DEVELOPMENT
-			if (tmpfound)
-				DBG_SCANCACHE("abort loop, tmpfound->charoffset=%u+handleoffset=%d=%d >= nextpos=%u\n",tmpfound->charoffset_o,handleoffset,
-						tmpfound->charoffset_o+handleoffset,
-						nextpos);
-#endif
-			break;
-		}
-		sou->found = tmpfound;
-		sou->siter = tmpsiter;
-	}
-
-	if (sou->found && sou->found->charoffset_o < nextpos) {
-		sou->prevpos = sou->found->charoffset_o;
+	if (btv->scanjob) {
+		DBG_SCANNING("scanthread_cancel, cancel job %p\n", btv->scanjob);
+		scanjob_cancel(btv->scanjob);
+		btv->scanjob = NULL;
 	}
-	sou->prevoffset += offset;
-	DBG_SCANCACHE("return prevpos %d, prevoffset=%d, nextpos=%u, found->charoffset=%d\n",sou->prevpos,sou->prevoffset, nextpos, sou->found?sou->found->charoffset_o:-1);
 }
 
+/* called for every insert or delete, with the same arguments as foundcache_update_offsets(). If the change is in
+the part of the job that was already applied, all offsets that the worker will deliver shift by offset. If
+the change is in the part that the worker is scanning, its results are useless */
 static void
-foundcache_process_offsetupdates(BluefishTextView * btv)
-{
-	Tscancache_offset_update sou = {NULL, NULL, 0,0,NULL,NULL};
-	Toffsetupdate *ou = (Toffsetupdate *)bf_elist_first((Toffsetupdate *)btv->scancache.offsetupdates);
-	while(ou) {
-		Toffsetupdate *nextou = ou->next;
-		DBG_SCANCACHE("foundcache_process_offsetupdates, update position %u with offset %d, next position at %u, prevpos=%u, prevoffset=%d\n",
-							(guint) ou->startpos, (gint) ou->offset,
-							(guint) (nextou ? OFFSETUPDATE(nextou)->startpos : BF_POSITION_UNDEFINED),
-							sou.prevpos, sou.prevoffset);
-		scancache_update_single_offset(btv, &sou, ou->startpos, ou->offset, nextou ? OFFSETUPDATE(nextou)->startpos : BF_POSITION_UNDEFINED);
-		g_slice_free(Toffsetupdate, ou);
-		ou = nextou;
-	}
-	btv->scancache.offsetupdates = NULL;
-#ifdef DUMP_SCANCACHE_UPDATE_OFFSET
-	dump_scancache(btv);
-#endif
-}
-
-/**
- * foundcache_update_offsets for UPDATE_OFFSET_DELAYED
- *
- * runs for every call to the insert_text and delete_text signal
- * this version only registers the offset changes, and processes them later
- * this reduces the latency on the insert_text and delete_text signals
- *
- * startpos is the lowest position
- *  so on insert it is the point _after_ which the insert will be (and offset is a positive number)
- *  on delete it is the point _after_ which the delete area starts (and offset is a negative number)
-*/
-void
-foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
+scanthread_text_changed(BluefishTextView * btv, guint startpos, gint offset)
 {
-	Toffsetupdate *ou;
-	if (offset == 0)
+	Tscanjob *job = btv->scanjob;
+	guint applied_o, end_o;
+	if (!job)
 		return;
-
-#ifdef HL_PROFILING
-	if (totalruntimer == NULL) {
-		totalruntimer = g_timer_new();
-	}
-#endif
-
-	/* check if the current offsetupdate has an offset greater than the last one */
-	if (btv->scancache.offsetupdates && OFFSETUPDATE(btv->scancache.offsetupdates)->startpos > startpos) {
-		DBG_SCANCACHE("foundcache_update_offsets, offset=%d, tail offset=%d, call process_offsetupdates()\n", startpos, OFFSETUPDATE(btv->scancache.offsetupdates)->startpos);
-		/* handle all the offsets */
-		foundcache_process_offsetupdates(btv);
-	} else if (btv->scancache.offsetupdates && OFFSETUPDATE(btv->scancache.offsetupdates)->startpos == startpos) {
-		/* merge them together if they are on the same position */
-		OFFSETUPDATE(btv->scancache.offsetupdates)->offset += offset;
+	applied_o = job->applied_o + job->delta;
+	end_o = job->end_o + job->delta;
+	if (startpos > end_o)
+		return;
+	if (startpos < applied_o && (offset > 0 || startpos - offset <= applied_o)) {
+		job->delta += offset;
 		return;
 	}
-	ou = g_slice_new(Toffsetupdate);
-	ou->startpos = (guint32)startpos;
-	ou->offset = (gint32)offset;
-	DBG_SCANCACHE("foundcache_update_offsets, push offset %d at position %d on offsetupdates\n",offset,startpos);
-	btv->scancache.offsetupdates = bf_elist_append(btv->scancache.offsetupdates, ou);
+	scanthread_cancel(btv);
 }
+#endif							/* THREADED_SCANNING */
 
-#else
 /**
- * foundcache_update_offsets original version
+ * foundcache_update_offsets
  * runs for every call to the insert_text and delete_text signal
  *
  * startpos is the lowest position
  *  so on insert it is the point _after_ which the insert will be (and offset is a positive number)
  *  on delete it is the point _after_ which the delete area starts (and offset is a negative number)
+ *
+ * the stack at startpos and the entries in a deleted region are handled here, all entries
+ * after startpos are shifted by foundcache_shift(), which does not touch them before they are used
 */
 void
 foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 {
 	Tfound *found;
-	GSequenceIter *siter;
 	gint comparepos;
 
 	g_assert(btv == btv->master);
 
 	if (offset == 0)
 		return;
-
-#ifdef HL_PROFILING
-	if (totalruntimer == NULL) {
-		totalruntimer = g_timer_new();
+	if (G_UNLIKELY(btv->largefile)) {
+		largefile_text_changed(btv, startpos, offset);
+		return;
 	}
+#ifdef THREADED_SCANNING
+	scanthread_text_changed(btv, startpos, offset);
 #endif
 
 	comparepos = (offset < 0) ? startpos - offset : startpos;
 	DBG_SCANCACHE
 		("foundcache_update_offsets, update with offset %d starting at startpos %d, cache length=%d, comparepos=%d\n",
-		 offset, startpos, g_sequence_get_length(btv->scancache.foundcaches), comparepos);
+		 offset, startpos, foundcache_length((Tfoundcache *) btv->scancache.foundcaches), comparepos);
 
-	found = get_foundcache_at_offset(btv, startpos, &siter);
+	found = get_foundcache_at_offset(btv, startpos);
 	if (found)
 		DBG_SCANCACHE("foundcache_update_offsets, got found %p with offset %d\n", found, found->charoffset_o);
 	else
@@ -898,9 +463,9 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 		Tfoundblock *tmpfblock;
 		DBG_SCANCACHE
 			("foundcache_update_offsets, handle first found %p with offset %d, complete stack fcontext %p fblock %p\n",
-			 found, found->charoffset_o, found->fcontext, found->fblock);
+			 found, found->charoffset_o, found_fcontext(btv, found), found_fblock(btv, found));
 		/* for the first found, we have to update the end-offsets for all contexts/blocks on the stack */
-		tmpfcontext = found->fcontext;
+		tmpfcontext = found_fcontext(btv, found);
 		while (tmpfcontext) {
 			DBG_SCANCACHE("foundcache_update_offsets, fcontext on stack=%p, start_o=%d end_o=%d\n",
 						  tmpfcontext, tmpfcontext->start_o, tmpfcontext->end_o);
@@ -909,13 +474,18 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 							  tmpfcontext, tmpfcontext->end_o, tmpfcontext->end_o + offset);
 				tmpfcontext->end_o += offset;
 			}
-			tmpfcontext = (Tfoundcontext *) tmpfcontext->parentfcontext;
+			tmpfcontext = fcontext_parent(btv, tmpfcontext);
 		}
 
-		tmpfblock = found->fblock;
+		tmpfblock = found_fblock(btv, found);
 		while (tmpfblock) {
 			DBG_SCANCACHE("foundcache_update_offsets, fblock on stack=%p, %d:%d-%d:%d\n", tmpfblock,
 						  tmpfblock->start1_o, tmpfblock->end1_o,tmpfblock->start2_o, tmpfblock->end2_o);
+			/* there is a special situation for a block: it might be a stretched block, in which
+			case end1_o possibly needs updating too */
+			if (G_UNLIKELY(tmpfblock->end1_o >= comparepos && tmpfblock == found_fblock(btv, found) && tmpfblock->end1_o > found->charoffset_o)) {
+				tmpfblock->end1_o += offset;
+			}
 			if (G_UNLIKELY(tmpfblock->start2_o != BF_POSITION_UNDEFINED)) {
 				if (G_UNLIKELY(offset < 0 && tmpfblock->start2_o < comparepos && tmpfblock->end2_o >= comparepos)) {
 					/* the end of the block might be within the deleted region, if so, set the end as undefined */
@@ -939,7 +509,7 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 					}
 				}
 			}
-			tmpfblock = (Tfoundblock *) tmpfblock->parentfblock;
+			tmpfblock = fblock_parent(btv, tmpfblock);
 		}
 	}
 
@@ -951,15 +521,15 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 				DBG_SCANCACHE("foundcache_update_offsets, remove found %p from the cache\n",found);
 				if (numblockchange > 0) {
 					/* we have to enlarge needscanning to the place where this was popped */
-					DBG_SCANCACHE("foundcache_update_offsets, found pushed a block, mark obsolete block %d:%d as needscanning\n",found->fblock->start1_o, found->fblock->end2_o);
-					mark_needscanning(btv, found->fblock->start1_o, found->fblock->end2_o);
+					DBG_SCANCACHE("foundcache_update_offsets, found pushed a block, mark obsolete block %d:%d as needscanning\n",found_fblock(btv, found)->start1_o, found_fblock(btv, found)->end2_o);
+					mark_needscanning(btv, found_fblock(btv, found)->start1_o + offset, found_fblock(btv, found)->end2_o == BF_OFFSET_UNDEFINED ? BF_OFFSET_UNDEFINED : found_fblock(btv, found)->end2_o + offset);
 				}
 				if (found->numcontextchange > 0) {
 					/* we have to enlarge needscanning to the place where this was popped */
-					DBG_SCANCACHE("foundcache_update_offsets, found pushed a context, mark obsolete context %d:%d as needscanning\n",found->fcontext->start_o, found->fcontext->end_o);
-					mark_needscanning(btv, found->fcontext->start_o, found->fcontext->end_o);
+					DBG_SCANCACHE("foundcache_update_offsets, found pushed a context, mark obsolete context %d:%d as needscanning\n",found_fcontext(btv, found)->start_o, found_fcontext(btv, found)->end_o);
+					mark_needscanning(btv, found_fcontext(btv, found)->start_o + offset, found_fcontext(btv, found)->end_o == BF_OFFSET_UNDEFINED ? BF_OFFSET_UNDEFINED : found_fcontext(btv, found)->end_o + offset);
 				}
-				remove_cache_entry(btv, &found, &siter, NULL, NULL);
+				remove_cache_entry(btv, &found, NULL, NULL);
 				if (!found && (numblockchange < 0)) {
 					mark_needscanning(btv, startpos, BF_OFFSET_UNDEFINED);
 					/* there is a special situation: if this is the last found in the cache, and it pops a block,
@@ -968,7 +538,7 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 								  startpos);
 				}
 			} else {
-				found = get_foundcache_next(btv, &siter);
+				found = get_foundcache_next(btv, found);
 			}
 		}
 	} else {
@@ -976,79 +546,75 @@ foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset)
 			DBG_SCANCACHE
 				("foundcache_update_offsets, now search for found > startpos, try found %p with charoffset %d\n",
 				 found, found->charoffset_o);
-			found = get_foundcache_next(btv, &siter);
+			found = get_foundcache_next(btv, found);
 		}
 	}
-	while (found) {
-		DBG_SCANCACHE
-			("foundcache_update_offsets, about to update found %p with charoffset %d to %d, fcontext %p and fblock %p\n",
-			 found, found->charoffset_o, found->charoffset_o + offset, found->fcontext, found->fblock);
-		/* for all further founds, we only handle the pushedblock and pushedcontext */
-		if (G_UNLIKELY(IS_FOUNDMODE_CONTEXTPUSH(found))) {
-			DBG_SCANCACHE("foundcache_update_offsets, contextpush %p update from %d:%d to %d:%d\n",
-						  found->fcontext, found->fcontext->start_o, found->fcontext->end_o,
-						  found->fcontext->start_o + offset, found->fcontext->end_o + offset);
-			if (G_LIKELY(found->fcontext->start_o != BF_OFFSET_UNDEFINED))
-				found->fcontext->start_o += offset;
-			if (G_LIKELY(found->fcontext->end_o != BF_OFFSET_UNDEFINED))
-				found->fcontext->end_o += offset;
-		}
-		if (G_UNLIKELY(IS_FOUNDMODE_BLOCKPUSH(found))) {
-			DBG_SCANCACHE("foundcache_update_offsets, blockpush %p update from %d:%d to %d:%d\n",
-						  found->fblock, found->fblock->start1_o, found->fblock->end2_o,
-						  found->fblock->start1_o + offset, found->fblock->end2_o + offset);
-			if (G_LIKELY(found->fblock->start1_o != BF_POSITION_UNDEFINED))
-				found->fblock->start1_o += offset;
-			if (G_LIKELY(found->fblock->end1_o != BF_POSITION_UNDEFINED))
-				found->fblock->end1_o += offset;
-			if (G_LIKELY(found->fblock->start2_o != BF_POSITION_UNDEFINED))
-				found->fblock->start2_o += offset;
-			if (G_LIKELY(found->fblock->end2_o != BF_POSITION_UNDEFINED))
-				found->fblock->end2_o += offset;
-		}
-		/*g_print("startpos=%d, offset=%d, found=%p, update charoffset_o from %d to %d\n",startpos,offset, found,found->charoffset_o,found->charoffset_o+offset); */
-		found->charoffset_o += offset;
-		found = get_foundcache_next(btv, &siter);
+	if (found) {
+		DBG_SCANCACHE("foundcache_update_offsets, shift found %p with charoffset %d and all further entries by %d\n",
+					  found, found->charoffset_o, offset);
+		foundcache_shift(btv->scancache.foundcaches, found, offset);
 	}
 #ifdef DUMP_SCANCACHE_UPDATE_OFFSET
 	dump_scancache(btv);
 #endif
 }
-#endif
 
-void
-found_free_lcb(gpointer data, gpointer btv)
+/* returns a single Tfound to the arena, use scanarena_clear() to free all of them at once */
+static void
+found_free(BluefishTextView * btv, Tfound * found)
 {
-	Tfound *found = data;
-	DBG_SCANCACHE("found_free_lcb, btv=%p, destroy found=%p\n", btv, found);
+	DBG_SCANCACHE("found_free, btv=%p, destroy found=%p\n", btv, found);
 	if (IS_FOUNDMODE_BLOCKPUSH(found)) {
-#ifdef HL_PROFILING
-		hl_profiling.fblock_refcount--;
-#endif
-		DBG_SCANCACHE("found_free_lcb, btv=%p, free fblock=%p\n", btv, found->fblock);
-		g_slice_free(Tfoundblock, found->fblock);
+		DBG_SCANCACHE("found_free, btv=%p, free fblock=%p\n", btv, found_fblock(btv, found));
+		arenapool_free(&SCANARENA(btv)->fblock, found_fblock(btv, found));
 	}
 	if (IS_FOUNDMODE_CONTEXTPUSH(found)) {
-#ifdef HL_PROFILING
-		hl_profiling.fcontext_refcount--;
-#endif
-		DBG_SCANCACHE("found_free_lcb, btv=%p, free fcontext=%p\n", btv, found->fcontext);
-		g_slice_free(Tfoundcontext, found->fcontext);
+		DBG_SCANCACHE("found_free, btv=%p, free fcontext=%p\n", btv, found_fcontext(btv, found));
+		arenapool_free(&SCANARENA(btv)->fcontext, found_fcontext(btv, found));
 	}
-#ifdef HL_PROFILING
-	hl_profiling.found_refcount--;
-#endif
-	g_slice_free(Tfound, found);
+	arenapool_free(&SCANARENA(btv)->found, found);
+}
+
+/* tags are not applied for every match, but collected in scanning->tagruns, and runs of the same
+tag that touch or overlap are merged. scanning_apply_tags() applies them at the end of the run */
+static inline void
+scanning_add_tag(Tscanning * scanning, GtkTextTag * tag, guint start_o, guint end_o)
+{
+	Ttagrun newrun;
+	guint i, stop;
+	if (start_o > end_o) {
+		guint tmp = start_o;
+		start_o = end_o;
+		end_o = tmp;
+	}
+	if (G_UNLIKELY(start_o == end_o))
+		return;
+	stop = scanning->tagruns->len > TAGRUN_LOOKBACK ? scanning->tagruns->len - TAGRUN_LOOKBACK : 0;
+	for (i = scanning->tagruns->len; i > stop; i--) {
+		Ttagrun *run = &g_array_index(scanning->tagruns, Ttagrun, i - 1);
+		if (run->tag == tag && start_o <= run->end_o && end_o >= run->start_o) {
+			run->start_o = MIN(run->start_o, start_o);
+			run->end_o = MAX(run->end_o, end_o);
+			return;
+		}
+	}
+	newrun.tag = tag;
+	newrun.start_o = start_o;
+	newrun.end_o = end_o;
+	g_array_append_val(scanning->tagruns, newrun);
 }
 
 static void
 remove_all_highlighting_in_area(BluefishTextView * btv, GtkTextIter * start, GtkTextIter * end, guint endoffset)
 {
-	GList *tmplist = g_list_first(btv->bflang->tags);
+	GHashTableIter hiter;
+	gpointer tag;
 	DEBUG_MSG("remove_all_highlighting_in_area %d:%d\n",gtk_text_iter_get_offset(start),gtk_text_iter_get_offset(end));
-	while (tmplist) {
-		gtk_text_buffer_remove_tag(btv->buffer, (GtkTextTag *) tmplist->data, start, end);
-		tmplist = g_list_next(tmplist);
+	/* only the tags that scanning_apply_tags() has applied can be in the buffer, the other tags
+	of the language don't need a (costly) remove_tag call */
+	g_hash_table_iter_init(&hiter, btv->scancache.appliedtags);
+	while (g_hash_table_iter_next(&hiter, &tag, NULL)) {
+		gtk_text_buffer_remove_tag(btv->buffer, (GtkTextTag *) tag, start, end);
 	}
 	btv->needremovetags = endoffset;
 }
@@ -1060,18 +626,18 @@ static void print_blockstack(BluefishTextView * btv, Tscanning *scanning) {
 	g_print("blockstack:");
 	for (tmplist=scanning->blockstack->tail;tmplist;tmplist=tmplist->prev) {
 		fblock = tmplist->data;
-		g_print(" %s",g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).pattern);
+		g_print(" %s",g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, fblock->patternum).pattern);
 	}
 	g_print("\n");
 }*/
 
 Tfoundblock *
-pop_blocks(gint numchange, Tfoundblock * curblock)
+pop_blocks(BluefishTextView * btv, gint numchange, Tfoundblock * curblock)
 {
 	gint num = numchange;
 	Tfoundblock *fblock = curblock;
 	while (num < 0 && fblock) {
-		fblock = (Tfoundblock *) fblock->parentfblock;
+		fblock = fblock_parent(btv, fblock);
 		num++;
 	}
 	return fblock;
@@ -1081,22 +647,13 @@ static inline Tfoundblock *
 found_start_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 {
 	Tfoundblock *fblock;
-#ifdef HL_PROFILING
-	hl_profiling.numblockstart++;
-	hl_profiling.fblock_refcount++;
-#endif
-	fblock = g_slice_new0(Tfoundblock);
-	fblock->start1_o = gtk_text_iter_get_offset(&match->start);
-	fblock->end1_o = gtk_text_iter_get_offset(&match->end);
-	/*g_print("found blockstart with start_1 %d end1 %d\n",fblock->start1_o,fblock->end1_o); */
-	fblock->start2_o = BF_POSITION_UNDEFINED;
-	fblock->end2_o = BF_POSITION_UNDEFINED;
-	fblock->patternum = match->patternum;
+	scanning->numblockpush++;
+	fblock = scanstack_push_block(SCANARENA(btv), scanning->curfblock, match->patternum,
+								  gtk_text_iter_get_offset(&match->start), gtk_text_iter_get_offset(&match->end));
 	DBG_BLOCKMATCH("found_start_of_block, %d:%d, put block for pattern %d (%s) on blockstack\n",
 					fblock->start1_o,fblock->start2_o,match->patternum,
-				   g_array_index(btv->bflang->st->matches, Tpattern, match->patternum).pattern);
-	fblock->parentfblock = scanning->curfblock;
-	DBG_BLOCKMATCH("found_start_of_block, new block at %p with parent %p\n", fblock, fblock->parentfblock);
+				   g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, match->patternum).pattern);
+	DBG_BLOCKMATCH("found_start_of_block, new block at %p with parent %u\n", fblock, fblock->parentfblock);
 	scanning->curfblock = fblock;
 	return fblock;
 }
@@ -1107,14 +664,14 @@ static inline Tfoundblock *
 found_end_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning, Tpattern * pat,
 				   gint * numblockchange)
 {
-	Tfoundblock *retfblock, *fblock = scanning->curfblock;
+	Tfoundblock *retfblock, *fblock;
 	GtkTextIter iter;
 	gboolean allowfold=TRUE;
 	guint match_start_o, match_end_o;
 	
 	DBG_BLOCKMATCH("found_end_of_block(), found %d (%s), blockstartpattern %d, curfblock=%p\n",
 					match->patternum,
-					g_array_index(btv->bflang->st->matches, Tpattern, match->patternum).pattern,
+					g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, match->patternum).pattern,
 					pat->blockstartpattern,
 				   scanning->curfblock);
 
@@ -1122,36 +679,20 @@ found_end_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning,
 		return NULL;
 
 	retfblock = scanning->curfblock;
-#ifdef HL_PROFILING
-	hl_profiling.numblockend++;
-#endif
-	while (fblock && fblock->patternum != pat->blockstartpattern && pat->blockstartpattern != -1) {
-		DBG_BLOCKMATCH("pop fblock %p (%d:%d-%d:%d)with patternum %d and parent %p\n", fblock
-						, fblock->start1_o, fblock->end1_o , fblock->start2_o, fblock->end2_o
-						, fblock->patternum, fblock->parentfblock);
-		fblock = (Tfoundblock *) fblock->parentfblock;
-		(*numblockchange)--;
-	}
-
+	scanning->numblockpop++;
+	fblock = scanstack_find_block_start(SCANARENA(btv), scanning->curfblock, pat, numblockchange);
 	if (G_UNLIKELY(!fblock)) {
-		*numblockchange = 0;
 		DBG_BLOCKMATCH("no matching start-of-block found\n");
 		return NULL;
 	}
 
-	DBG_BLOCKMATCH("found the matching start-of-block fblock %p, patternum %d, parent %p, end2_o=%d\n",
+	DBG_BLOCKMATCH("found the matching start-of-block fblock %p, patternum %d, parent %u, end2_o=%d\n",
 				   fblock, fblock->patternum, fblock->parentfblock, fblock->end2_o);
 	match_start_o = gtk_text_iter_get_offset(&match->start);
 	match_end_o = gtk_text_iter_get_offset(&match->end);
-	if (G_UNLIKELY(fblock->end1_o > match_start_o)) {
-		/* possibly the block was stretched with stretch_block, undo the stretch */
-		fblock->end1_o = match_start_o;
-	}
-	
-	
+
 	if (G_UNLIKELY(fblock->start2_o != BF_POSITION_UNDEFINED)) {
 		Tfound *ifound;
-		GSequenceIter *isiter = NULL, *cursiter;
 		DBG_SCANCACHE
 			("found_end_of_block, block (start at %d:%d) has an end already (old end %d:%d)! invalidate and enlarge region to previous end at end2_o %d\n",
 					fblock->start1_o, fblock->end1_o,fblock->start2_o, fblock->end2_o, fblock->end2_o);
@@ -1162,19 +703,21 @@ found_end_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning,
 			g_print("BUG: block %p started at %d:%d, ended at %d:%d\n",fblock, fblock->start1_o, fblock->end1_o, fblock->start2_o, fblock->end2_o);
 		} else {
 			enlarge_scanning_region(btv, scanning, fblock->end2_o);
-			ifound = get_foundcache_at_offset(btv, fblock->end2_o, &isiter);
-			if (ifound && ifound->charoffset_o == fblock->end2_o && isiter) {
+			ifound = get_foundcache_at_offset(btv, fblock->end2_o);
+			if (ifound && ifound->charoffset_o == fblock->end2_o && scanning->nextfound
+						&& scanning->nextfound->charoffset_o <= ifound->charoffset_o) {
+				Tfound *tmpfound = scanning->nextfound;
 				DBG_SCANCACHE("found_end_of_block, invalidate ifound=%p at offset %d\n", ifound,
 							  ifound->charoffset_o);
-				cursiter = scanning->siter;
-				if (scanning->siter) {
-					scanning->nextfound = get_foundcache_next(btv, &isiter);
-					scanning->siter = isiter;
-				}
+				scanning->nextfound = get_foundcache_next(btv, ifound);
 				DBG_SCANCACHE("found_end_of_block, btv=%p, remove cache in range, nextfound=%p\n", btv, scanning->nextfound);
-				g_sequence_foreach_range(cursiter, isiter, found_free_lcb, btv);
-				DBG_SCANCACHE("found_end_of_block, remove range\n");
-				g_sequence_remove_range(cursiter, isiter);
+				/* remove everything from the old nextfound up to and including ifound */
+				while (tmpfound && tmpfound != scanning->nextfound) {
+					Tfound *tmpfound2 = get_foundcache_next(btv, tmpfound);
+					foundcache_remove(btv->scancache.foundcaches, tmpfound);
+					found_free(btv, tmpfound);
+					tmpfound = tmpfound2;
+				}
 				DBG_SCANCACHE("found_end_of_block, check nextfound %p\n",scanning->nextfound);
 				if (scanning->nextfound) {
 					DBG_SCANCACHE("nextfound %p is now set to charoffset %d\n", scanning->nextfound,
@@ -1184,13 +727,12 @@ found_end_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning,
 		}
 	}
 
-	fblock->start2_o = match_start_o;
-	fblock->end2_o = match_end_o;
+	scanning->curfblock = scanstack_end_block(SCANARENA(btv), fblock, match_start_o, match_end_o, numblockchange);
 	gtk_text_buffer_get_iter_at_offset(btv->buffer, &iter, fblock->end1_o);
 	if (G_UNLIKELY(g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).block)) {
 		if (g_array_index(btv->bflang->st->blocks, Tpattern_block, g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).block).tag
 			 	) {
-			gtk_text_buffer_apply_tag(btv->buffer, g_array_index(btv->bflang->st->blocks, Tpattern_block, g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).block).tag, &iter, &match->start);
+			scanning_add_tag(scanning, g_array_index(btv->bflang->st->blocks, Tpattern_block, g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).block).tag, fblock->end1_o, match_start_o);
 		}
 		allowfold = g_array_index(btv->bflang->st->blocks, Tpattern_block, g_array_index(btv->bflang->st->matches, Tpattern, fblock->patternum).block).foldable;
 	}
@@ -1198,48 +740,40 @@ found_end_of_block(BluefishTextView * btv, Tmatch * match, Tscanning * scanning,
 		fblock->foldable = TRUE;
 	}
 	DBG_BLOCKMATCH("found_end_of_block, set end for block %p to %d:%d, foldable=%d\n", fblock, fblock->start2_o, fblock->end2_o, fblock->foldable);
-	scanning->curfblock = fblock->parentfblock;
-	(*numblockchange)--;
 	return retfblock;
 }
 /* pop_contexts expects a negative number !!!!!!!!!! */
 static Tfoundcontext *
-pop_contexts(gint numchange, Tfoundcontext * curcontext)
+pop_contexts(BluefishTextView * btv, gint numchange, Tfoundcontext * curcontext)
 {
 	gint num = numchange;
 	Tfoundcontext *fcontext = curcontext;
 	while (num < 0 && fcontext) {
-		fcontext = (Tfoundcontext *) fcontext->parentfcontext;
+		fcontext = fcontext_parent(btv, fcontext);
 		num++;
 	}
 	return fcontext;
 }
 
 static Tfoundcontext *
-pop_and_apply_contexts(BluefishTextView * btv, gint numchange, Tfoundcontext * curcontext,
+pop_and_apply_contexts(BluefishTextView * btv, Tscanning * scanning, gint numchange, Tfoundcontext * curcontext,
 					   GtkTextIter * matchstart, gint * numchanged)
 {
-	gint num = numchange;
 	guint offset = gtk_text_iter_get_offset(matchstart);
-	Tfoundcontext *fcontext = curcontext;
-	while (num < 0 && fcontext) {	/* pop, but don't pop if there is nothing to pop (because of an error in the language file) */
-		DBG_SCANNING("pop_and_apply_contexts, end context %d at %d:%d, has tag %p and parent %p\n",
-					 fcontext->context, fcontext->start_o, gtk_text_iter_get_offset(matchstart),
+	Tfoundcontext *fcontext, *newfcontext;
+	newfcontext = scanstack_pop_contexts(SCANARENA(btv), curcontext, numchange, offset, numchanged);
+	/* the popped contexts are still linked to their parents, apply their highlighting */
+	for (fcontext = curcontext; fcontext != newfcontext; fcontext = fcontext_parent(btv, fcontext)) {
+		DBG_SCANNING("pop_and_apply_contexts, end context %d at %d:%d, has tag %p and parent %u\n",
+					 fcontext->context, fcontext->start_o, offset,
 					 g_array_index(btv->bflang->st->contexts, Tcontext, fcontext->context).contexttag,
 					 fcontext->parentfcontext);
-		fcontext->end_o = offset;
 		if (G_UNLIKELY(g_array_index(btv->bflang->st->contexts, Tcontext, fcontext->context).contexttag)) {
-			GtkTextIter iter;
-			gtk_text_buffer_get_iter_at_offset(btv->buffer, &iter, fcontext->start_o);
-			gtk_text_buffer_apply_tag(btv->buffer,
-									  g_array_index(btv->bflang->st->contexts, Tcontext,
-													fcontext->context).contexttag, &iter, matchstart);
+			scanning_add_tag(scanning, g_array_index(btv->bflang->st->contexts, Tcontext,
+										fcontext->context).contexttag, fcontext->start_o, offset);
 		}
-		fcontext = (Tfoundcontext *) fcontext->parentfcontext;
-		(*numchanged)--;
-		num++;
 	}
-	return fcontext;
+	return newfcontext;
 }
 
 static inline Tfoundcontext *
@@ -1249,63 +783,56 @@ found_context_change(BluefishTextView * btv, Tmatch * match, Tscanning * scannin
 	/* check if we change up or down the stack */
 	if (pat->nextcontext < 0) {
 		Tfoundcontext *retcontext = scanning->curfcontext;
-#ifdef HL_PROFILING
-		hl_profiling.numcontextend++;
-#endif
+		scanning->numcontextpop++;
 		DBG_SCANNING("found_context_change, should pop %d contexts, curfcontext=%p\n",
 					 (-1 * pat->nextcontext), scanning->curfcontext);
 		*numcontextchange = 0;
 		scanning->curfcontext =
-			pop_and_apply_contexts(btv, pat->nextcontext, scanning->curfcontext, &match->start,
+			pop_and_apply_contexts(btv, scanning, pat->nextcontext, scanning->curfcontext, &match->start,
 								   numcontextchange);
 		scanning->context = scanning->curfcontext ? scanning->curfcontext->context : 1;
 		return retcontext;
 	} else {
 		Tfoundcontext *fcontext;
-#ifdef HL_PROFILING
-		hl_profiling.numcontextstart++;
-		hl_profiling.fcontext_refcount++;
-#endif
-		fcontext = g_slice_new0(Tfoundcontext);
-		fcontext->start_o = gtk_text_iter_get_offset(&match->end);
-		fcontext->end_o = BF_OFFSET_UNDEFINED;
-		fcontext->parentfcontext = scanning->curfcontext;
-		DBG_SCANNING("found_context_change, new fcontext %p with context %d onto the stack, parent=%p\n",
+		scanning->numcontextpush++;
+		fcontext = scanstack_push_context(SCANARENA(btv), scanning->curfcontext, pat->nextcontext,
+										  gtk_text_iter_get_offset(&match->end));
+		DBG_SCANNING("found_context_change, new fcontext %p with context %d onto the stack, parent=%u\n",
 					 fcontext, pat->nextcontext, fcontext->parentfcontext);
 		scanning->curfcontext = fcontext;
-		scanning->context = fcontext->context = pat->nextcontext;
+		scanning->context = pat->nextcontext;
 		*numcontextchange = 1;
 		return fcontext;
 	}
 }
 
 static gboolean
-nextcache_valid(Tscanning * scanning)
+nextcache_valid(BluefishTextView * btv, Tscanning * scanning)
 {
 	if (G_UNLIKELY(!scanning->nextfound))
 		return FALSE;
-	if (G_UNLIKELY(scanning->nextfound->numblockchange <= 0 && scanning->nextfound->fblock != scanning->curfblock)) {
+	if (G_UNLIKELY(scanning->nextfound->numblockchange <= 0 && found_fblock(btv, scanning->nextfound) != scanning->curfblock)) {
 		DBG_SCANCACHE("nextcache_valid, next found %p with numblockchange=%d has fblock=%p, current fblock=%p, return FALSE\n",
-					  scanning->nextfound, scanning->nextfound->numblockchange, scanning->nextfound->fblock, scanning->curfblock);
+					  scanning->nextfound, scanning->nextfound->numblockchange, found_fblock(btv, scanning->nextfound), scanning->curfblock);
 		return FALSE;
 	}
 	DBG_SCANCACHE("nextcache_valid, next found %p with numcontextchange=%d has fcontext=%p, current fcontext=%p\n",
-		scanning->nextfound, scanning->nextfound->numcontextchange, scanning->nextfound->fcontext, scanning->curfcontext);
-	if (G_UNLIKELY(scanning->nextfound->numcontextchange <= 0 && scanning->nextfound->fcontext != scanning->curfcontext)) {
+		scanning->nextfound, scanning->nextfound->numcontextchange, found_fcontext(btv, scanning->nextfound), scanning->curfcontext);
+	if (G_UNLIKELY(scanning->nextfound->numcontextchange <= 0 && found_fcontext(btv, scanning->nextfound) != scanning->curfcontext)) {
 		DBG_SCANCACHE("nextcache_valid, next found %p with numcontextchange=%d has fcontext=%p, current fcontext=%p, return FALSE\n",
-					  scanning->nextfound, scanning->nextfound->numcontextchange, scanning->nextfound->fcontext, scanning->curfcontext);
+					  scanning->nextfound, scanning->nextfound->numcontextchange, found_fcontext(btv, scanning->nextfound), scanning->curfcontext);
 		return FALSE;
 	}
-	if (G_UNLIKELY(scanning->nextfound->numcontextchange > 0 && (!scanning->nextfound->fcontext
-													  || scanning->nextfound->fcontext->parentfcontext !=
+	if (G_UNLIKELY(scanning->nextfound->numcontextchange > 0 && (!found_fcontext(btv, scanning->nextfound)
+													  || fcontext_parent(btv, found_fcontext(btv, scanning->nextfound)) !=
 													  scanning->curfcontext))) {
 		DBG_SCANCACHE
 			("nextcache_valid, next found %p doesn't push context on top of current fcontext %p, return FALSE\n",
 			 scanning->nextfound, scanning->curfcontext);
 		return FALSE;
 	}
-	if (G_UNLIKELY(scanning->nextfound->numblockchange > 0 && (!scanning->nextfound->fblock
-													|| scanning->nextfound->fblock->parentfblock !=
+	if (G_UNLIKELY(scanning->nextfound->numblockchange > 0 && (!found_fblock(btv, scanning->nextfound)
+													|| fblock_parent(btv, found_fblock(btv, scanning->nextfound)) !=
 													scanning->curfblock))) {
 		DBG_SCANCACHE
 			("nextcache_valid, next found %p doesn't push block on top of current fblock %p, return FALSE\n",
@@ -1332,19 +859,19 @@ cached_found_is_valid(BluefishTextView * btv, Tmatch * match, Tscanning * scanni
 	DBG_SCANCACHE("cached_found_is_valid, testing %p at offset %d\n", scanning->nextfound,
 				  scanning->nextfound->charoffset_o);
 
-	if (G_UNLIKELY(!nextcache_valid(scanning)))
+	if (G_UNLIKELY(!nextcache_valid(btv, scanning)))
 		return FALSE;
 
 	DBG_SCANCACHE("with numcontextchange=%d, numblockchange=%d\n", scanning->nextfound->numcontextchange,
 				  scanning->nextfound->numblockchange);
 	if (IS_FOUNDMODE_BLOCKPUSH(scanning->nextfound)
-		&& (!pat->starts_block || scanning->nextfound->fblock->patternum != match->patternum)) {
+		&& (!pat->starts_block || found_fblock(btv, scanning->nextfound)->patternum != match->patternum)) {
 		DBG_SCANCACHE("cached_found_is_valid, cached entry %p does not push the same block\n",
 					  scanning->nextfound);
 		DBG_SCANCACHE
-			("pat->startsblock=%d, nextfound->fblock->patternum=%d,match->patternum=%d,nextfound->fblock->parentfblock=%p,scanning->curfblock=%p\n",
-			 pat->starts_block, scanning->nextfound->fblock->patternum, match->patternum,
-			 scanning->nextfound->fblock->parentfblock, scanning->curfblock);
+			("pat->startsblock=%d, nextfound->fblock->patternum=%d,match->patternum=%d,nextfound->fblock->parentfblock=%u,scanning->curfblock=%p\n",
+			 pat->starts_block, found_fblock(btv, scanning->nextfound)->patternum, match->patternum,
+			 found_fblock(btv, scanning->nextfound)->parentfblock, scanning->curfblock);
 		return FALSE;
 	}
 	if (IS_FOUNDMODE_BLOCKPOP(scanning->nextfound) && !pat->ends_block) {
@@ -1354,12 +881,12 @@ cached_found_is_valid(BluefishTextView * btv, Tmatch * match, Tscanning * scanni
 	}
 	if (IS_FOUNDMODE_CONTEXTPUSH(scanning->nextfound) && (pat->nextcontext <= 0
 														  /*|| pat.nextcontext != scanning->context */
-														  || scanning->nextfound->fcontext->context !=
+														  || found_fcontext(btv, scanning->nextfound)->context !=
 														  pat->nextcontext)) {
 		DBG_SCANCACHE("cached_found_is_valid, cached entry %p does not push the same context\n",
 					  scanning->nextfound);
 		DBG_SCANCACHE("cached pat->nextcontext=%d, fcontext->context=%d, current context=%d\n",
-					  pat->nextcontext, scanning->nextfound->fcontext->context, scanning->context);
+					  pat->nextcontext, found_fcontext(btv, scanning->nextfound)->context, scanning->context);
 		return FALSE;
 	}
 	if ((scanning->nextfound->numcontextchange < 0)
@@ -1382,12 +909,12 @@ remove_invalid_cache(BluefishTextView * btv, guint match_end_o, Tscanning * scan
 	guint invalidoffset=0;
 	DBG_SCANNING("remove_invalid_cache, match_end_o=%d, scanning->nextfound=%p, scanning->curfblock=%p, scanning->curfblock=%p\n", match_end_o, scanning->nextfound, scanning->curfblock, scanning->curfblock);
 	do {
-		gint ret = remove_cache_entry(btv, &scanning->nextfound, &scanning->siter, scanning->curfblock, scanning->curfcontext);
+		gint ret = remove_cache_entry(btv, &scanning->nextfound, scanning->curfblock, scanning->curfcontext);
 		/* remove cache entry may return 0 if nothing was removed */
 		DBG_SCANNING("remove_invalid_cache, scanning->nextfound=%p with offset %d\n", scanning->nextfound, scanning->nextfound ? scanning->nextfound->charoffset_o : -1);
 		if (ret > invalidoffset)
 			invalidoffset = ret;
-	} while (scanning->nextfound && (scanning->nextfound->charoffset_o <= match_end_o || !nextcache_valid(scanning)));
+	} while (scanning->nextfound && (scanning->nextfound->charoffset_o <= match_end_o || !nextcache_valid(btv, scanning)));
 	/* if there is no nextfound (so we removed the last items in the cache, we should return up to the end of the buffer as invalid */
 	if (!scanning->nextfound) {
 		GtkTextIter iter;
@@ -1403,34 +930,34 @@ remove_invalid_cache(BluefishTextView * btv, guint match_end_o, Tscanning * scan
 				 scanning->nextfound->charoffset_o);
 	if (scanning->nextfound->numblockchange < 0) {
 		gint i = scanning->nextfound->numblockchange;
-		Tfoundblock *tmpfblock = scanning->nextfound->fblock;
+		Tfoundblock *tmpfblock = found_fblock(btv, scanning->nextfound);
 		while (i < 0 && tmpfblock) {
 			/ * if tmpfblock is still on the stack, we have to set the end as undefined * /
-			if (is_fblock_on_stack(scanning->curfblock, tmpfblock)) {
+			if (is_fblock_on_stack(btv, scanning->curfblock, tmpfblock)) {
 				DBG_SCANNING("setting end of fblock %p as undefined\n", tmpfblock);
 				tmpfblock->start2_o = BF_OFFSET_UNDEFINED;
 				tmpfblock->end2_o = BF_OFFSET_UNDEFINED;
 			}
-			tmpfblock = tmpfblock->parentfblock;
+			tmpfblock = fblock_parent(btv, tmpfblock);
 			i++;
 		}
 	}
 	if (scanning->nextfound->numcontextchange < 0) {
 		gint i = scanning->nextfound->numcontextchange;
-		Tfoundcontext *tmpfcontext = scanning->nextfound->fcontext;
+		Tfoundcontext *tmpfcontext = found_fcontext(btv, scanning->nextfound);
 		while (i < 0 && tmpfcontext) {
-			if (is_fcontext_on_stack(scanning->curfcontext, tmpfcontext)) {
+			if (is_fcontext_on_stack(btv, scanning->curfcontext, tmpfcontext)) {
 				DBG_SCANNING("setting end of fcontext %p as undefined\n", tmpfcontext);
 				tmpfcontext->end_o = BF_OFFSET_UNDEFINED;
 			}
-			tmpfcontext = tmpfcontext->parentfcontext;
+			tmpfcontext = fcontext_parent(btv, tmpfcontext);
 			i++;
 		}
 	}
 	DBG_SCANNING("remove_invalid_cache, remove everything up to %d from the cache, and any invalid entries following that offset\n", match_end_o);
 	do {
-		invalidoffset = remove_cache_entry(btv, &scanning->nextfound, &scanning->siter);
-	} while (scanning->nextfound && (scanning->nextfound->charoffset_o < match_end_o || !nextcache_valid(scanning)));
+		invalidoffset = remove_cache_entry(btv, &scanning->nextfound);
+	} while (scanning->nextfound && (scanning->nextfound->charoffset_o < match_end_o || !nextcache_valid(btv, scanning)));
 	DBG_SCANNING("remove_invalid_cache, return invalidoffset %d\n", invalidoffset);
 	return invalidoffset;*/
 }
@@ -1442,6 +969,7 @@ enlarge_scanning_region_to_iter(BluefishTextView * btv, Tscanning * scanning, Gt
 		DBG_SCANCACHE("enlarge_scanning_region to offset %d\n", gtk_text_iter_get_offset(iter));
 		remove_all_highlighting_in_area(btv, &scanning->end, iter, gtk_text_iter_get_offset(iter));
 		scanning->end = *iter;
+		scanning->end_o = gtk_text_iter_get_offset(iter);
 		return TRUE;
 	}
 	DBG_SCANCACHE("no need to increase scanning region to %d, is at %d already\n",gtk_text_iter_get_offset(iter), gtk_text_iter_get_offset(&scanning->end));
@@ -1469,40 +997,18 @@ found_match(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 	Tpattern *pat = &g_array_index(btv->bflang->st->matches, Tpattern, match->patternum);
 	DBG_SCANNING
 		("found_match for pattern %d %s at charoffset %d, starts_block=%d,ends_block=%d, nextcontext=%d (current=%d)\n",
-		 match->patternum, pat->pattern, gtk_text_iter_get_offset(&match->start), pat->starts_block,
+		 match->patternum, g_array_index(btv->bflang->st->matchinfo, Tpattern_cold, match->patternum).pattern,
+		 gtk_text_iter_get_offset(&match->start), pat->starts_block,
 		 pat->ends_block, pat->nextcontext, scanning->context);
 /*	DBG_MSG("pattern no. %d (%s) matches (%d:%d) --> nextcontext=%d\n", match->patternum, scantable.matches[match->patternum].message,
 			gtk_text_iter_get_offset(&match->start), gtk_text_iter_get_offset(&match->end), scantable.matches[match->patternum].nextcontext);*/
-#ifdef IDENTSTORING
-	scanning->identmode = pat->identmode;
-	scanning->identaction = pat->identaction;
-#endif							/* IDENTSTORING */
-
 	match_end_o = gtk_text_iter_get_offset(&match->end);
 	if (pat->selftag) {
 		DBG_SCANNING("found_match, apply tag %p from %d to %d\n", pat->selftag,
 					 gtk_text_iter_get_offset(&match->start), gtk_text_iter_get_offset(&match->end));
-		gtk_text_buffer_apply_tag(btv->buffer, pat->selftag, &match->start, &match->end);
-	}
-	/* the conditions when to apply stretch_blocktag:
-		- currently found pattern (pat) has stretch_blockstart set
-		- there must be a block on the stack
-		- the blockstartpattern for the current found pattern must refer to the block on the stack 
-		- the block on the stack must not have an end that is before the current position. start2_o 
-		  could be equal to the current position if the end starts where the start ends as in  <p></p>
-		  or it could be undefined
-	*/
-	if (G_UNLIKELY(pat->stretch_blockstart 
-				&& scanning->curfblock 
-				&& scanning->curfblock->patternum == pat->blockstartpattern
-				&& (scanning->curfblock->start2_o == BF_POSITION_UNDEFINED || scanning->curfblock->start2_o < match_end_o))) {
-		/* get the current block on the stack and stretch the end-of-blockstart to the end of the match */
-		DBG_SCANNING("found_match, pat->stretch_blockstart=%d, pat->blockstartpattern=%d, update curfblock(%d:%d-%d:%d) with patternum=%d from end1_o from %d to %d\n", 
-						pat->stretch_blockstart,pat->blockstartpattern,
-						scanning->curfblock->start1_o, scanning->curfblock->end1_o, scanning->curfblock->start2_o, scanning->curfblock->end2_o, 
-						scanning->curfblock->patternum, scanning->curfblock->end1_o, match_end_o);
-		scanning->curfblock->end1_o = match_end_o;
+		scanning_add_tag(scanning, pat->selftag, gtk_text_iter_get_offset(&match->start), match_end_o);
 	}
+	scanstack_stretch_block(scanning->curfblock, pat, match_end_o);
 
 	if G_LIKELY((!pat->starts_block && !pat->ends_block
 		&& (pat->nextcontext == 0 || pat->nextcontext == scanning->context))) {
@@ -1535,13 +1041,13 @@ found_match(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 			DBG_SCANCACHE("found_match, cache item at offset %d is still valid\n",
 						  scanning->nextfound->charoffset_o);
 			if (scanning->nextfound->numcontextchange >= 0) {
-				context = scanning->nextfound->fcontext ? scanning->nextfound->fcontext->context : 1;
-				tmpfcontext = scanning->nextfound->fcontext;
+				context = found_fcontext(btv, scanning->nextfound) ? found_fcontext(btv, scanning->nextfound)->context : 1;
+				tmpfcontext = found_fcontext(btv, scanning->nextfound);
 			} else if (pat->nextcontext < 0) {
 				gint tmp = 0;
 				tmpfcontext =
-					pop_and_apply_contexts(btv, pat->nextcontext, scanning->curfcontext, &match->start, &tmp);
-				Tfoundcontext *tmpfcontext2 = pop_contexts(pat->nextcontext, scanning->nextfound->fcontext);
+					pop_and_apply_contexts(btv, scanning, pat->nextcontext, scanning->curfcontext, &match->start, &tmp);
+				Tfoundcontext *tmpfcontext2 = pop_contexts(btv, pat->nextcontext, found_fcontext(btv, scanning->nextfound));
 				context = tmpfcontext ? tmpfcontext->context : 1;
 				if (tmpfcontext != tmpfcontext2) {
 					g_warning
@@ -1552,12 +1058,12 @@ found_match(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 				tmpfcontext = NULL;
 			}
 			if (scanning->nextfound->numblockchange < 0) {
-				scanning->curfblock = pop_blocks(scanning->nextfound->numblockchange, fblock);
+				scanning->curfblock = pop_blocks(btv, scanning->nextfound->numblockchange, fblock);
 			} else {
-				scanning->curfblock = scanning->nextfound->fblock;
+				scanning->curfblock = found_fblock(btv, scanning->nextfound);
 			}
 			scanning->curfcontext = tmpfcontext;
-			scanning->nextfound = get_foundcache_next(btv, &scanning->siter);
+			scanning->nextfound = get_foundcache_next(btv, scanning->nextfound);
 			return context;
 		} else {				/* either a smaller offset, or invalid */
 			cleanup_obsolete_cache_items = TRUE;
@@ -1588,7 +1094,7 @@ found_match(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 	} else if (numblockchange > 1) {
 		g_assert(FALSE);
 	} else if (numblockchange < 0) {
-		Tfoundblock *tmpfblock = pop_blocks(numblockchange, fblock);
+		Tfoundblock *tmpfblock = pop_blocks(btv, numblockchange, fblock);
 		g_assert(tmpfblock == scanning->curfblock);
 	}
 #endif
@@ -1613,22 +1119,19 @@ found_match(BluefishTextView * btv, Tmatch * match, Tscanning * scanning)
 		enlarge_scanning_region(btv, scanning, invalidoffset);
 	}
 
-	found = g_slice_new0(Tfound);
-#ifdef HL_PROFILING
-	hl_profiling.found_refcount++;
-#endif
+	found = arenapool_alloc(&SCANARENA(btv)->found);
 	found->numblockchange = numblockchange;
-	found->fblock = fblock;
+	found->fblock = fblock_handle(btv, fblock);
 	found->numcontextchange = numcontextchange;
-	found->fcontext = fcontext;
+	found->fcontext = fcontext_handle(btv, fcontext);
 	found->charoffset_o = match_end_o;
 	DBG_SCANCACHE
 		("found_match, put found %p in the cache charoffset_o=%d fblock=%p numblockchange=%d fcontext=%p numcontextchange=%d\n",
-		 found, found->charoffset_o, found->fblock, found->numblockchange, found->fcontext,
+		 found, found->charoffset_o, found_fblock(btv, found), found->numblockchange, found_fcontext(btv, found),
 		 found->numcontextchange);
-	g_sequence_insert_sorted(btv->scancache.foundcaches, found, foundcache_compare_charoffset_o, NULL);
-	g_assert(found->numblockchange == 0 || found->fblock);
-	g_assert(found->numcontextchange == 0 || found->fcontext);
+	foundcache_insert(btv->scancache.foundcaches, found);
+	g_assert(found->numblockchange == 0 || found_fblock(btv, found));
+	g_assert(found->numcontextchange == 0 || found_fcontext(btv, found));
 	return scanning->context;
 }
 
@@ -1648,7 +1151,7 @@ markregion_find_region2scan(BluefishTextView * btv, GtkTextIter * sit, GtkTextIt
 		guint start2, end2;
 		cont=FALSE;
 		tmp = markregion_get_region(&btv->scanning, tmp, &start2, &end2);
-		if (start2-end < (loops_per_timer) && (start2 - start) < (NUM_TIMER_CHECKS_PER_RUN * loops_per_timer)) {
+		if (start2-end < (btv->scancache.loops_per_timer) && (start2 - start) < (NUM_TIMER_CHECKS_PER_RUN * btv->scancache.loops_per_timer)) {
 			DBG_MARKREGION("markregion_find_region2scan, current region %u:%u, next region begins at %u, ends at %u, merge!\n",start,end,start2,end2);
 			end = end2;
 			cont=TRUE;
@@ -1699,7 +1202,7 @@ needscanning_find_region2scan(BluefishTextView * btv, GtkTextIter * start,GtkTex
 			/* there is another start in the doc, see if it is close (doable within one scanning run, and
 			the number of chars between the regions should not be a lot more than the number of chars that
 			actually need scanning), if so merge them */
-			if ((nextitoffset - endoffset < (loops_per_timer)) && (nextitoffset - startoffset) < (NUM_TIMER_CHECKS_PER_RUN * loops_per_timer)) {
+			if ((nextitoffset - endoffset < (btv->scancache.loops_per_timer)) && (nextitoffset - startoffset) < (NUM_TIMER_CHECKS_PER_RUN * btv->scancache.loops_per_timer)) {
 				DBG_MARKREGION("needscanning_find_region2scan, next region that needs scanning starts at %d, merge them together!\n", gtk_text_iter_get_offset(&nextit));
 				*end = nextit;
 				cont = TRUE;
@@ -1748,22 +1251,22 @@ reconstruct_scanning(BluefishTextView * btv, GtkTextIter * position, Tscanning *
 	Tfound *found;
 	guint offset = gtk_text_iter_get_offset(position);
 	DBG_SCANNING("reconstruct_scanning at position %d\n", offset);
-	found = get_foundcache_at_offset(btv, offset, &scanning->siter);
+	found = get_foundcache_at_offset(btv, offset);
 	DBG_SCANCACHE("reconstruct_stack, got found %p at offset %d to reconstruct stack at position %d\n", found, found?found->charoffset_o:-1, offset);
 	if (G_LIKELY(found && found->charoffset_o <= offset)) {
 		if (found->numcontextchange < 0) {
-			scanning->curfcontext = pop_contexts(found->numcontextchange, found->fcontext);
+			scanning->curfcontext = pop_contexts(btv, found->numcontextchange, found_fcontext(btv, found));
 		} else {
-			scanning->curfcontext = found->fcontext;
+			scanning->curfcontext = found_fcontext(btv, found);
 		}
 		if (found->numblockchange < 0) {
-			scanning->curfblock = pop_blocks(found->numblockchange, found->fblock);
+			scanning->curfblock = pop_blocks(btv, found->numblockchange, found_fblock(btv, found));
 		} else {
-			scanning->curfblock = found->fblock;
+			scanning->curfblock = found_fblock(btv, found);
 		}
 		scanning->context = (scanning->curfcontext) ? scanning->curfcontext->context : 1;
 
-		scanning->nextfound = get_foundcache_next(btv, &scanning->siter);
+		scanning->nextfound = get_foundcache_next(btv, found);
 		DBG_SCANNING("reconstruct_stack, found at offset %d, curfblock=%p, curfcontext=%p, context=%d\n",
 					 found->charoffset_o, scanning->curfblock, scanning->curfcontext, scanning->context);
 		return found->charoffset_o;
@@ -1772,84 +1275,367 @@ reconstruct_scanning(BluefishTextView * btv, GtkTextIter * position, Tscanning *
 		scanning->curfcontext = NULL;
 		scanning->curfblock = NULL;
 		scanning->context = 1;
-		scanning->nextfound = get_foundcache_first(btv, &scanning->siter);
+		scanning->nextfound = get_foundcache_first(btv);
 		DBG_SCANNING("reconstruct_scanning, nextfound=%p\n", scanning->nextfound);
 		return 0;
 	}
 }
 
-/* if visible_end is set (not NULL) we will scan only the visible area and nothing else.
-this can be used to delay scanning everything until the editor is idle for several milliseconds */
-gboolean
-bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
+/* the scanner walks the UTF-8 text of a slice that starts at chunkstart (with offset chunkstart_o),
+this returns the GtkTextIter for an offset that is within (or just before) that slice */
+static inline void
+scanning_iter_at_offset(GtkTextIter * chunkstart, guint chunkstart_o, guint offset, GtkTextIter * iter)
+{
+	*iter = *chunkstart;
+	if (offset >= chunkstart_o)
+		gtk_text_iter_forward_chars(iter, offset - chunkstart_o);
+	else
+		gtk_text_iter_backward_chars(iter, chunkstart_o - offset);
+}
+
+/* the state of dfa_run() in run_scanner() and largefile_run(), the Tdfarun data */
+typedef struct {
+	BluefishTextView *btv;
+	Tscanning *scanning;
+	GtkTextIter chunkstart;		/* the start of the slice of text that is scanned now */
+	guint chunkstart_o;
+	gchar *chunk;
+	gboolean provisional;
+	guint itcursor_o;			/* identifiers around the cursor are not stored */
+} Tscanslice;
+
+/* the fetch callback for dfa_run(), we do not step a GtkTextIter for every character, that is way too
+slow. Instead we fetch the text in slices of SCANNING_CHUNK_CHARS characters, and only if we have a
+match we turn the offsets into GtkTextIter's again, relative to the start of the slice (chunkstart) */
+static void
+scanning_fetch(Tdfarun * run)
+{
+	Tscanslice *slice = run->data;
+	GtkTextIter chunkend;
+	g_free(slice->chunk);
+	scanning_iter_at_offset(&slice->chunkstart, slice->chunkstart_o, run->iter_o, &slice->chunkstart);
+	slice->chunkstart_o = run->iter_o;
+	chunkend = slice->chunkstart;
+	gtk_text_iter_forward_chars(&chunkend, SCANNING_CHUNK_CHARS);
+	slice->chunk = gtk_text_iter_get_slice(&slice->chunkstart, &chunkend);
+	run->p = slice->chunk;
+	run->text_end = slice->chunk + strlen(slice->chunk);
+}
+
+static gint
+tagrun_compare(gconstpointer a, gconstpointer b)
+{
+	return (gint) ((const Ttagrun *) a)->start_o - (gint) ((const Ttagrun *) b)->start_o;
+}
+
+/* applies and frees the runs collected by scanning_add_tag(). The runs are applied in the order of
+the text, so we can move a single GtkTextIter forward from base (with offset base_o) instead of
+looking up every offset in the buffer */
+static void
+scanning_apply_tags(BluefishTextView * btv, Tscanning * scanning, GtkTextIter * base, guint base_o)
+{
+	GtkTextIter it = *base, it2;
+	guint it_o = base_o, i;
+	DBG_SCANNING("scanning_apply_tags, apply %d tag runs\n", scanning->tagruns->len);
+	g_array_sort(scanning->tagruns, tagrun_compare);
+	for (i = 0; i < scanning->tagruns->len; i++) {
+		Ttagrun *run = &g_array_index(scanning->tagruns, Ttagrun, i);
+		scanning_iter_at_offset(&it, it_o, run->start_o, &it);
+		it_o = run->start_o;
+		scanning_iter_at_offset(&it, it_o, run->end_o, &it2);
+		gtk_text_buffer_apply_tag(btv->buffer, run->tag, &it, &it2);
+		if (G_UNLIKELY(!g_hash_table_lookup(btv->scancache.appliedtags, run->tag)))
+			g_hash_table_insert(btv->scancache.appliedtags, run->tag, run->tag);
+	}
+	g_array_free(scanning->tagruns, TRUE);
+	scanning->tagruns = NULL;
+}
+
+#ifdef THREADED_SCANNING
+/* replays the events that the worker found in batch through found_match(). Returns FALSE if the
+scancache does not agree with the worker, in that case the job should be cancelled and the rest is
+scanned in the mainloop */
+static gboolean
+scanthread_apply_batch(BluefishTextView * btv, Tscanjob * job, Tscanbatch * batch)
 {
-	GtkTextIter iter;
-	GtkTextIter mstart;
 	Tscanning scanning;
-	guint pos = 0, newpos, reconstruction_o, endoffset;
-	gboolean end_of_region = FALSE, last_character_run = FALSE, continue_loop = TRUE, finished;
-	gint loop = 0;
+	GtkTextIter base;
+	guint start_o = batch->start_o + job->delta, end_o = batch->end_o + job->delta, base_o, done_o, i;
+	gboolean consistent = TRUE;
 #ifdef IDENTSTORING
 	GtkTextIter itcursor;
-#endif
-#ifdef HL_PROFILING
-	guint startpos;
-	gdouble stage1 = 0;
-	gdouble stage2;
-	gdouble stage3;
-	gdouble stage4;
-	hl_profiling.longest_contextstack = 0;
-	hl_profiling.longest_blockstack = 0;
-	hl_profiling.numcontextstart = 0;
-	hl_profiling.numcontextend = 0;
-	hl_profiling.numblockstart = 0;
-	hl_profiling.numblockend = 0;
-	hl_profiling.numchars = 0;
-	hl_profiling.numloops = 0;
+	guint itcursor_o;
 #endif
 
+	DBG_SCANNING("scanthread_apply_batch, apply %d events from %d to %d\n", batch->events->len, start_o, end_o);
 	scanning.context = 1;
-#ifdef IDENTSTORING
-	scanning.identmode = 0;
-#endif							/* IDENTSTORING */
-
-	DBG_MSG("bftextview2_run_scanner for btv %p..\n", btv);
-	if (!btv->bflang->st) {
-		DBG_MSG("no scantable, nothing to scan, returning...\n");
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &scanning.start, start_o);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &scanning.end, end_o);
+	scanning.end_o = end_o;
+	if (start_o == 0) {
+		scanning.nextfound = get_foundcache_first(btv);
+		scanning.curfcontext = NULL;
+		scanning.curfblock = NULL;
+	} else if (batch->start_o == job->start_o) {
+		/* reconstruct just like bftextview2_run_scanner() did when it started the job */
+		base = scanning.start;
+		gtk_text_iter_backward_char(&base);
+		reconstruct_scanning(btv, &base, &scanning);
+	} else {
+		reconstruct_scanning(btv, &scanning.start, &scanning);
+	}
+	if (scanning.context != batch->start_context) {
+		DBG_SCANNING("scanthread_apply_batch, context %d at %d, worker started in context %d\n", scanning.context,
+					 start_o, batch->start_context);
 		return FALSE;
 	}
-#ifdef VALGRIND_PROFILING
-	CALLGRIND_START_INSTRUMENTATION;
-#endif							/* VALGRIND_PROFILING */
+	if (btv->needremovetags < end_o) {
+		remove_all_highlighting_in_area(btv, &scanning.start, &scanning.end, end_o);
+	}
+#ifdef IDENTSTORING
+	gtk_text_buffer_get_iter_at_mark(btv->buffer, &itcursor, gtk_text_buffer_get_insert(btv->buffer));
+	itcursor_o = gtk_text_iter_get_offset(&itcursor);
+#endif
+	scanning.tagruns = g_array_sized_new(FALSE, FALSE, sizeof(Ttagrun), batch->events->len);
+	base = scanning.start;
+	base_o = done_o = start_o;
+	for (i = 0; i < batch->events->len; i++) {
+		Tscanevent *ev = &g_array_index(batch->events, Tscanevent, i);
+		guint ev_start_o = ev->start_o + job->delta, ev_end_o = ev->end_o + job->delta;
+		Tmatch match;
+		/* the events are sorted, so we only have to move forward from the previous event */
+		scanning_iter_at_offset(&base, base_o, ev_start_o, &match.start);
+		match.end = match.start;
+		gtk_text_iter_forward_chars(&match.end, ev_end_o - ev_start_o);
+		base = match.end;
+		base_o = ev_end_o;
+		if (ev->type == scanevent_match) {
+			match.patternum = ev->patternum;
+			scanning.context = found_match(btv, &match, &scanning);
+			if (scanning.context != ev->context) {
+				DBG_SCANNING("scanthread_apply_batch, context %d after match at %d, worker found %d\n",
+							 scanning.context, ev_end_o, ev->context);
+				consistent = FALSE;
+				done_o = ev_end_o;
+				break;
+			}
+		}
+#ifdef IDENTSTORING
+		else if (itcursor_o < ev_start_o || itcursor_o > ev_end_o) {
+			found_identifier(btv, &match.start, &match.end, ev->context, ev->identaction);
+		}
+#endif							/* IDENTSTORING */
+	}
+	if (consistent) {
+		done_o = end_o;
+		if (batch->last) {
+			/* the same checks that the scanning loop does at the end of a region */
+			if (scanning.nextfound && scanning.nextfound->charoffset_o <= end_o) {
+				enlarge_scanning_region(btv, &scanning, remove_invalid_cache(btv, end_o, &scanning));
+			}
+			if (scanning.nextfound && !nextcache_valid(btv, &scanning)) {
+				enlarge_scanning_region(btv, &scanning, remove_invalid_cache(btv, 0, &scanning));
+			}
+		}
+	}
+	scanning_iter_at_offset(&base, base_o, done_o, &base);
+	if (!gtk_text_iter_is_end(&base) && scanning.curfcontext) {
+		if (g_array_index(btv->bflang->st->contexts, Tcontext, scanning.curfcontext->context).contexttag) {
+			scanning_add_tag(&scanning, g_array_index(btv->bflang->st->contexts, Tcontext,
+										scanning.curfcontext->context).contexttag, scanning.curfcontext->start_o, done_o);
+		}
+	}
+	scanning_apply_tags(btv, &scanning, &base, done_o);
+	markregion_region_done(&btv->scanning, done_o);
+	if (scanning.end_o > done_o) {
+		markregion_nochange(&btv->scanning, done_o, scanning.end_o);
+	}
+	return consistent;
+}
+
+/* called from bftextview2_run_scanner() if a job is running. region_o is the start of the
+first region that needs scanning. Returns TRUE if the region was handled (or is waiting for the
+worker) and *call_again is set, FALSE if the region should be scanned in the mainloop */
+static gboolean
+scanthread_run(BluefishTextView * btv, guint region_o, GTimer * timer, gboolean * call_again)
+{
+	Tscanjob *job = btv->scanjob;
+	Tscanbatch *batch;
+
+	if (region_o >= (guint) (job->end_o + job->delta)) {
+		/* the job does not cover any region that still needs scanning */
+		scanthread_cancel(btv);
+		return FALSE;
+	}
+	if (region_o < (guint) (job->applied_o + job->delta)) {
+		/* text was changed in the part that was already applied */
+		return FALSE;
+	}
+	while ((batch = g_queue_pop_head(&job->ready))) {
+		gboolean consistent, last = batch->last;
+		consistent = scanthread_apply_batch(btv, job, batch);
+		job->applied_o = batch->end_o;
+		scanbatch_free(batch);
+		if (!consistent || last) {
+			scanthread_cancel(btv);
+			*call_again = TRUE;
+			return TRUE;
+		}
+		if (g_timer_elapsed(timer, NULL) >= MAX_CONTINUOUS_SCANNING_INTERVAL) {
+			*call_again = TRUE;
+			return TRUE;
+		}
+	}
+	/* wait for the worker, scanbatch_deliver_lcb() will schedule scanning again */
+	*call_again = FALSE;
+	return TRUE;
+}
+
+/* starts a job for the region from scanning->start to scanning->end, the context stack
+is taken from scanning->curfcontext */
+static gboolean
+scanthread_dispatch(BluefishTextView * btv, Tscanning * scanning, guint start_o)
+{
+	GArray *contextstack;
+	Tfoundcontext *fcontext;
+	gint16 context;
+	guint i, num = 0;
+
+	for (fcontext = scanning->curfcontext; fcontext; fcontext = fcontext_parent(btv, fcontext))
+		num++;
+	contextstack = g_array_sized_new(FALSE, FALSE, sizeof(gint16), num + 16);
+	g_array_set_size(contextstack, num);
+	/* the bottom of the stack goes first */
+	for (i = num, fcontext = scanning->curfcontext; fcontext; fcontext = fcontext_parent(btv, fcontext)) {
+		i--;
+		context = fcontext->context;
+		g_array_index(contextstack, gint16, i) = context;
+	}
+	btv->scanjob =
+		scanjob_start(btv, btv->bflang->st, gtk_text_iter_get_slice(&scanning->start, &scanning->end), start_o,
+					  scanning->end_o, contextstack);
+	DBG_SCANNING("scanthread_dispatch, started job %p for %d:%d\n", btv->scanjob, start_o, scanning->end_o);
+	return (btv->scanjob != NULL);
+}
+#endif							/* THREADED_SCANNING */
 
-#ifdef UPDATE_OFFSET_DELAYED
-	DEBUG_MSG("bftextview2_run_scanner, first call foundcache_process_offsetupdates()\n");
-	foundcache_process_offsetupdates(btv);
+/* the callbacks for dfa_run() in run_scanner(), run->data is a Tscanslice */
+static gint16
+scanning_match(Tdfarun * run, guint16 patternum, Tpattern * pat)
+{
+	Tscanslice *slice = run->data;
+	Tscanning *scanning = slice->scanning;
+	Tmatch match;
+	match.patternum = patternum;
+	scanning->nummatches++;
+	scanning_iter_at_offset(&slice->chunkstart, slice->chunkstart_o, run->mstart_o, &match.start);
+	scanning_iter_at_offset(&slice->chunkstart, slice->chunkstart_o, run->iter_o, &match.end);
+	scanning->context = found_match(slice->btv, &match, scanning);
+	DBG_SCANNING("after match context=%d\n", scanning->context);
+	/* found_match() might have enlarged the region, a provisional scan does not follow it */
+	if (!slice->provisional)
+		run->end_o = scanning->end_o;
+	return scanning->context;
+}
+
+#ifdef IDENTSTORING
+static gboolean
+scanning_identifier(Tdfarun * run, gint16 context)
+{
+	Tscanslice *slice = run->data;
+	GtkTextIter istart, iend;
+	/* ignore if the cursor is within the range, because it could be that the user is still typing the name */
+	if (G_UNLIKELY(slice->itcursor_o >= run->mstart_o && slice->itcursor_o <= run->iter_o))
+		return FALSE;
+	scanning_iter_at_offset(&slice->chunkstart, slice->chunkstart_o, run->mstart_o, &istart);
+	scanning_iter_at_offset(&slice->chunkstart, slice->chunkstart_o, run->iter_o, &iend);
+	found_identifier(slice->btv, &istart, &iend, context, run->identaction);
+	return TRUE;
+}
+#endif							/* IDENTSTORING */
+
+/* at the end of the region the next item in the cache should be valid, otherwise the region is
+enlarged and the scanning continues */
+static void
+scanning_region_end(Tdfarun * run, gboolean matched)
+{
+	Tscanslice *slice = run->data;
+	Tscanning *scanning = slice->scanning;
+	if (!matched && scanning->nextfound && scanning->nextfound->charoffset_o <= run->iter_o) {
+		/* scanning->nextfound is invalid! remove from cache */
+		enlarge_scanning_region(slice->btv, scanning, remove_invalid_cache(slice->btv, run->iter_o, scanning));
+	}
+	if (scanning->nextfound && !nextcache_valid(slice->btv, scanning)) {
+		/* see if nextfound has a valid context and block stack, if not we enlarge the scanning area */
+		DBG_SCANNING("scanning_region_end, nextfound %p is INVALID!\n", scanning->nextfound);
+		enlarge_scanning_region(slice->btv, scanning, remove_invalid_cache(slice->btv, 0, scanning));
+	}
+	run->end_o = scanning->end_o;
+}
+
+/* if visible_end is set (not NULL) we will scan only the visible area and nothing else.
+this can be used to delay scanning everything until the editor is idle for several milliseconds.
+
+if visible_start is set as well, this is a provisional scan of the visible window, see
+bftextview2_scan_viewport(). The region is not marked as done, the regular scanning will
+rescan it later and validate (or remove) the cache entries that it created */
+static gboolean
+run_scanner(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end)
+{
+	GtkTextIter iter;
+	Tscanning scanning;
+	Tscanslice slice;
+	Tdfarun run;
+	Tdfarun_status status;
+	guint reconstruction_o, endoffset, iter_o, loop;
+	guint region_start_o = 0, provisional_end_o = 0, savedremovetags = 0, scanstart_o;
+	gboolean provisional = (visible_start != NULL);
+	gboolean end_of_region, finished;
+	guint loops_per_timer = btv->scancache.loops_per_timer;
+#ifdef IDENTSTORING
+	GtkTextIter itcursor;
 #endif
+	gdouble stage1, stage2, stage3;
 
-	if (!bftextview2_find_region2scan(btv, &scanning.start, &scanning.end)) {
+	scanning.context = 1;
+	scanning.nummatches = scanning.numcontextpush = scanning.numcontextpop = 0;
+	scanning.numblockpush = scanning.numblockpop = 0;
+
+	DBG_MSG("bftextview2_run_scanner for btv %p..\n", btv);
+	if (!btv->bflang->st) {
+		DBG_MSG("no scantable, nothing to scan, returning...\n");
+		return FALSE;
+	}
+#ifdef VALGRIND_PROFILING
+	CALLGRIND_START_INSTRUMENTATION;
+#endif							/* VALGRIND_PROFILING */
+
+	if (provisional) {
+		scanning.start = *visible_start;
+		scanning.end = *visible_end;
+	} else if (!bftextview2_find_region2scan(btv, &scanning.start, &scanning.end)) {
 		DBG_MSG("nothing to scan here.. return FALSE\n");
 #ifdef VALGRIND_PROFILING
 		CALLGRIND_STOP_INSTRUMENTATION;
 #endif							/* VALGRIND_PROFILING */
-#ifdef HL_PROFILING
-		if (totalruntimer) {
-			g_print("Nothing to scan anymore, total run timer took %d ms\n",(gint) (1000.0 * g_timer_elapsed(totalruntimer,NULL)));
-			g_timer_destroy(totalruntimer);
-			totalruntimer = NULL;
-		}
-#endif /*HL_PROFILING*/
 		return FALSE;
 	}
 	DBG_SCANNING("bftextview2_find_region2scan returned region %d:%d\n",gtk_text_iter_get_offset(&scanning.start),gtk_text_iter_get_offset(&scanning.end));
+	region_start_o = gtk_text_iter_get_offset(&scanning.start);
 	/* start timer */
 	scanning.timer = g_timer_new();
-
-#ifdef HL_PROFILING
-	if (totalruntimer == NULL) {
-		totalruntimer = g_timer_new();
+#ifdef THREADED_SCANNING
+	if (btv->scanjob && !visible_end) {
+		gboolean call_again;
+		if (scanthread_run(btv, gtk_text_iter_get_offset(&scanning.start), scanning.timer, &call_again)) {
+			g_timer_destroy(scanning.timer);
+#ifdef VALGRIND_PROFILING
+			CALLGRIND_STOP_INSTRUMENTATION;
+#endif							/* VALGRIND_PROFILING */
+			return call_again;
+		}
 	}
-#endif
+#endif							/* THREADED_SCANNING */
 
 	if (visible_end) {
 		/* make sure that we only scan up to visible_end and no further */
@@ -1868,14 +1654,11 @@ bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
 			scanning.end = *visible_end;
 		}
 	}
-#ifdef HL_PROFILING
 	stage1 = g_timer_elapsed(scanning.timer, NULL);
-#endif
-	iter = mstart = scanning.start;
+	iter = scanning.start;
 	if (gtk_text_iter_is_start(&scanning.start)) {
 		DBG_SCANNING("start scanning at start iter\n");
-		scanning.siter = g_sequence_get_begin_iter(btv->scancache.foundcaches);
-		scanning.nextfound = get_foundcache_first(btv, &scanning.siter);
+		scanning.nextfound = get_foundcache_first(btv);
 		scanning.curfcontext = NULL;
 		scanning.curfblock = NULL;
 		reconstruction_o = 0;
@@ -1884,12 +1667,11 @@ bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
 		if we previously found <b and now there is <bo and we reconstruct the stack between the b and the o and we would not
 		detect that the tag has changed. so we move scanning.start one position up. */
 		gtk_text_iter_backward_char(&iter);
-		mstart = scanning.start = iter;
+		scanning.start = iter;
 		DBG_SCANNING("moved scanning.start back to %d\n",gtk_text_iter_get_offset(&scanning.start));
 		/* reconstruct the context stack and the block stack */
 		reconstruction_o = reconstruct_scanning(btv, &iter, &scanning);
-		pos = 0;
-		DBG_SCANNING("reconstructed stacks, context=%d, startstate=%d, nextfound=%p\n", scanning.context, pos, scanning.nextfound);
+		DBG_SCANNING("reconstructed stacks, context=%d, nextfound=%p\n", scanning.context, scanning.nextfound);
 		/* now move the start position either to the start of the line, or to the position
 		   where the stack was reconstructed, the largest offset */
 		gtk_text_buffer_get_iter_at_offset(btv->buffer, &iter, reconstruction_o);
@@ -1897,9 +1679,9 @@ bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
 		DBG_SCANNING("compare possible start positions %d and %d\n",
 					 gtk_text_iter_get_offset(&scanning.start), gtk_text_iter_get_offset(&iter));
 		if (gtk_text_iter_compare(&iter, &scanning.start) > 0)
-			mstart = scanning.start = iter;
+			scanning.start = iter;
 		else
-			iter = mstart = scanning.start;
+			iter = scanning.start;
 	}
 	if (!gtk_text_iter_is_end(&scanning.end)) {
 		/* the end position should be the largest of the end of the line and the 'end' iter */
@@ -1910,131 +1692,90 @@ bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
 			scanning.end = iter;
 		iter = scanning.start;
 	}
+	if (provisional) {
+		provisional_end_o = gtk_text_iter_get_offset(&scanning.end);
+	} else if (btv->viewscan_start_o != BF_OFFSET_UNDEFINED) {
+		if (region_start_o < btv->viewscan_start_o) {
+			/* stop in front of the window that was scanned provisionally, the next run removes and
+			   rescans that window in one go, so the user does not see the highlighting disappear */
+			if (gtk_text_iter_get_offset(&scanning.end) > btv->viewscan_start_o)
+				gtk_text_buffer_get_iter_at_offset(btv->buffer, &scanning.end, btv->viewscan_start_o);
+		} else {
+			DBG_DELAYSCANNING("regular scanning reached the provisional window at %d\n", btv->viewscan_start_o);
+			btv->viewscan_start_o = btv->viewscan_end_o = BF_OFFSET_UNDEFINED;
+		}
+	}
+#ifdef THREADED_SCANNING
+	if (btv->scanjob && !provisional) {
+		/* do not scan the text that the worker will deliver */
+		guint applied_o = ((Tscanjob *) btv->scanjob)->applied_o + ((Tscanjob *) btv->scanjob)->delta;
+		if (gtk_text_iter_get_offset(&scanning.end) > applied_o)
+			gtk_text_buffer_get_iter_at_offset(btv->buffer, &scanning.end, applied_o);
+	} else if (!visible_end
+			   && gtk_text_iter_get_offset(&scanning.end) - gtk_text_iter_get_offset(&scanning.start) >=
+			   SCANTHREAD_MIN_CHARS) {
+		scanning.end_o = gtk_text_iter_get_offset(&scanning.end);
+		if (scanthread_dispatch(btv, &scanning, gtk_text_iter_get_offset(&scanning.start))) {
+			g_timer_destroy(scanning.timer);
+#ifdef VALGRIND_PROFILING
+			CALLGRIND_STOP_INSTRUMENTATION;
+#endif							/* VALGRIND_PROFILING */
+			return FALSE;		/* scanbatch_deliver_lcb() will schedule scanning again */
+		}
+	}
+#endif							/* THREADED_SCANNING */
 	DBG_SCANNING("scanning from %d to %d\n", gtk_text_iter_get_offset(&scanning.start),
 				 gtk_text_iter_get_offset(&scanning.end));
-#ifdef HL_PROFILING
-	startpos = gtk_text_iter_get_offset(&scanning.start);
 	stage2 = g_timer_elapsed(scanning.timer, NULL);
-#endif
 	endoffset = gtk_text_iter_get_offset(&scanning.end);
-	if (btv->needremovetags < endoffset) {
+	if (provisional) {
+		/* the window might have old highlighting, but the rest of the region still has to be
+		   cleaned by the regular scanning */
+		savedremovetags = btv->needremovetags;
+		remove_all_highlighting_in_area(btv, &scanning.start, &scanning.end, endoffset);
+	} else if (btv->needremovetags < endoffset) {
 		remove_all_highlighting_in_area(btv, &scanning.start, &scanning.end, endoffset);
 	}
-#ifdef HL_PROFILING
 	stage3 = g_timer_elapsed(scanning.timer, NULL);
-#endif
 /*	if (!visible_end)
 		gtk_text_iter_forward_to_end(&end);
 	else
 		end = *visible_end;*/
+	scanning.end_o = gtk_text_iter_get_offset(&scanning.end);
+	scanning.tagruns = g_array_sized_new(FALSE, FALSE, sizeof(Ttagrun), 256);
+	scanstart_o = gtk_text_iter_get_offset(&iter);
+	slice.btv = btv;
+	slice.scanning = &scanning;
+	slice.chunkstart = iter;
+	slice.chunkstart_o = scanstart_o;
+	slice.chunk = NULL;
+	slice.provisional = provisional;
 #ifdef IDENTSTORING
 	gtk_text_buffer_get_iter_at_mark(btv->buffer, &itcursor, gtk_text_buffer_get_insert(btv->buffer));
+	slice.itcursor_o = gtk_text_iter_get_offset(&itcursor);
 #endif
-/* ******************************************************************************
-in the following loop we do the actual scanning. At the current offset (iter) we get a character (uc) 
-
-every loop, we lookup the next position in the table (newpos), using the character (uc), context (scanning.context), and previous position (pos)  
-
-if newpos==0 we have a symbol (see bftextview2.h for an explanation of symbols and identifiers)
-   a symbol can be the start or the end of a match, and may be part of the match. so whenever we hit a symbol, we 
-   set the match start (mstart) to the current offset
-   if we find a symbol again, and we have a match, we have the start of the match (mstart) and the end of the match at the current position (iter) 
-
-****************************************************************************** */
-	do {
-		gunichar uc;
-		loop++;
-#ifdef HL_PROFILING
-		hl_profiling.numloops++;
-#endif
-		if (G_UNLIKELY(last_character_run)) {
-			uc = '\0';
-		} else {
-			uc = gtk_text_iter_get_char(&iter);
-			if (G_UNLIKELY(uc > 128)) {
-				/* multibyte characters cannot be matched by the engine. character
-				   1 in ascii is "SOH (start of heading)". we need this to support a
-				   pattern like [^#]* .  */
-				uc = 1;
-			}
-		}
-		DBG_SCANNING("scanning offset %d pos %d '%c'=%d ", gtk_text_iter_get_offset(&iter), pos, uc, uc);
-		newpos = get_tablerow(btv->bflang->st,scanning.context,pos).row[uc];
-		DBG_SCANNING("(context=%d).. got newpos %d %s\n", scanning.context, newpos, (newpos==0?" -> symbol or pattern itself ends on symbol":""));
-		if (G_UNLIKELY(newpos == 0 || uc == '\0')) {
-			if (G_UNLIKELY(get_tablerow(btv->bflang->st,scanning.context,pos).match)) {
-				Tmatch match;
-				guint oldcontext = scanning.context;
-				match.patternum = get_tablerow(btv->bflang->st,scanning.context,pos).match;
-				match.start = mstart;
-				match.end = iter;
-				DBG_SCANNING("we have a match from pos %d to %d\n", gtk_text_iter_get_offset(&match.start),
-							 gtk_text_iter_get_offset(&match.end));
-				scanning.context = found_match(btv, &match, &scanning);
-				DBG_SCANNING("after match context=%d\n", scanning.context);
-				if (G_UNLIKELY(scanning.identmode == 2 && !gtk_text_iter_in_range(&itcursor, &mstart, &iter)
-								 && !gtk_text_iter_equal(&itcursor, &mstart)
-								 && !gtk_text_iter_equal(&itcursor, &iter))) {
-					found_identifier(btv, &mstart, &iter, oldcontext, scanning.identaction);
-					scanning.identmode = 0;
-				}
-			} else {
-				if (G_UNLIKELY(uc == '\0' && scanning.nextfound &&
-					scanning.nextfound->charoffset_o <= gtk_text_iter_get_offset(&iter))) {
-					guint invalidoffset;
-					/* scanning->nextfound is invalid! remove from cache */
-					invalidoffset = remove_invalid_cache(btv, gtk_text_iter_get_offset(&iter), &scanning);
-					if (enlarge_scanning_region(btv, &scanning, invalidoffset))
-						last_character_run = FALSE;
-				}
+	/* the actual scanning, see bftextview2_dfarun.c. A provisional scan does not follow the region
+	   if found_match() enlarges it */
+	dfarun_init(&run, btv->bflang->st, NULL, NULL, NULL, scanstart_o, provisional ? provisional_end_o : scanning.end_o);
+	run.context = scanning.context;
+	run.match = scanning_match;
+	if (!provisional) {
 #ifdef IDENTSTORING
-				if (G_UNLIKELY
-					(scanning.identmode == 1 && pos == 1)) {
-					/* ignore if the cursor is within the range, because it could be that the user is still typing the name */
-					if (G_LIKELY(!gtk_text_iter_in_range(&itcursor, &mstart, &iter)
-								 && !gtk_text_iter_equal(&itcursor, &mstart)
-								 && !gtk_text_iter_equal(&itcursor, &iter))) {
-						found_identifier(btv, &mstart, &iter, scanning.context, scanning.identaction);
-						scanning.identmode = 0;
-					}
-				}
-#endif							/* IDENTSTORING */
-				DBG_SCANNING("no match, but do set mstart to offset %d and set newpos=0\n",gtk_text_iter_get_offset(&iter));
-			}
-			if (G_UNLIKELY(last_character_run && scanning.nextfound && !nextcache_valid(&scanning))) {
-				guint invalidoffset;
-				/* see if nextfound has a valid context and block stack, if not we enlarge the scanning area */
-				DBG_SCANNING("last_character_run, but nextfound %p is INVALID!\n", scanning.nextfound);
-				invalidoffset = remove_invalid_cache(btv, 0, &scanning);
-				enlarge_scanning_region(btv, &scanning, invalidoffset);
-				/* TODO: do we need to rescan this position with the real uc instead of uc='\0' ?? */
-			}
-
-			if (G_LIKELY(gtk_text_iter_equal(&mstart, &iter) && !last_character_run)) {
-				gtk_text_iter_forward_char(&iter);
-#ifdef HL_PROFILING
-				hl_profiling.numchars++;
-#endif
-			}
-			mstart = iter;
-			/*DBG_SCANNING("mstart is set to offset %d, newpos=0\n",gtk_text_iter_get_offset(&mstart));*/
-			newpos = 0;
-		} else if (G_LIKELY(!last_character_run)) {
-			gtk_text_iter_forward_char(&iter);
-#ifdef HL_PROFILING
-			hl_profiling.numchars++;
+		run.identifier = scanning_identifier;
 #endif
-		}
-		pos = newpos;
-		end_of_region = gtk_text_iter_equal(&iter, &scanning.end);
-		if (G_UNLIKELY(end_of_region || last_character_run)) {
-			last_character_run = !last_character_run;
-		}
-		continue_loop = (!end_of_region || last_character_run);
-		/*DBG_SCANNING("continue_loop=%d, end_of_region=%d, last_character_run=%d\n",continue_loop,end_of_region,last_character_run); */
-	} while (continue_loop
-			 && (loop % loops_per_timer != 0
-				 || g_timer_elapsed(scanning.timer, NULL) < MAX_CONTINUOUS_SCANNING_INTERVAL));
+		run.region_end = scanning_region_end;
+	}
+	run.fetch = scanning_fetch;
+	run.data = &slice;
+	do {
+		status = dfa_run(&run, loops_per_timer);
+	} while (status == dfarun_loops && g_timer_elapsed(scanning.timer, NULL) < MAX_CONTINUOUS_SCANNING_INTERVAL);
+	g_free(slice.chunk);
+	iter_o = run.iter_o;
+	loop = run.loops;
+	end_of_region = (status == dfarun_end);
+	/* from here on we work with GtkTextIter's again */
+	scanning_iter_at_offset(&slice.chunkstart, slice.chunkstart_o, iter_o, &iter);
 	DBG_SCANNING
 		("scanned from %d to position %d, (end=%d) which took %f microseconds, loops_per_timer=%d\n",
 		 gtk_text_iter_get_offset(&scanning.start), gtk_text_iter_get_offset(&iter),
@@ -2042,26 +1783,36 @@ if newpos==0 we have a symbol (see bftextview2.h for an explanation of symbols a
 	/* TODO: if we end the scan within a context that has a tag, we have to apply the contexttag */
 	if (!gtk_text_iter_is_end(&scanning.end) && scanning.curfcontext) {
 		if (g_array_index(btv->bflang->st->contexts, Tcontext, scanning.curfcontext->context).contexttag) {
-			GtkTextIter iter2;
-			gtk_text_buffer_get_iter_at_offset(btv->buffer, &iter2, scanning.curfcontext->start_o);
-			gtk_text_buffer_apply_tag(btv->buffer,
-									  g_array_index(btv->bflang->st->contexts, Tcontext,
-													scanning.curfcontext->context).contexttag, &iter, &iter2);
+			scanning_add_tag(&scanning, g_array_index(btv->bflang->st->contexts, Tcontext,
+										scanning.curfcontext->context).contexttag, scanning.curfcontext->start_o, iter_o);
 		}
 	}
+	scanning_apply_tags(btv, &scanning, &iter, iter_o);
 #ifdef NEEDSCANNING
 	gtk_text_buffer_remove_tag(btv->buffer, btv->needscanning, &scanning.start, &iter);
 	if (gtk_text_iter_compare(&iter, &scanning.end) < 0) {
 		gtk_text_buffer_apply_tag(btv->buffer, btv->needscanning, &iter, &scanning.end);
 	}
 #endif
+	if (provisional) {
+		btv->needremovetags = savedremovetags;
+		btv->viewscan_start_o = gtk_text_iter_get_offset(&scanning.start);
+		btv->viewscan_end_o = iter_o;
+		DBG_DELAYSCANNING("provisional scan of %d:%d done\n", btv->viewscan_start_o, btv->viewscan_end_o);
 #ifdef MARKREGION
-	DBG_MARKREGION("bftextview2_run_scanner, region done until %d, mark needscanning from %d:%d\n",gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&scanning.end));
-	markregion_region_done(&btv->scanning, gtk_text_iter_get_offset(&iter));
-	if (gtk_text_iter_compare(&iter, &scanning.end) < 0) {
-		markregion_nochange(&btv->scanning, gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&scanning.end));
-	}
+		/* found_match() might have invalidated cache entries after the window, so the
+		   complete region still needs the regular scanning */
+		markregion_nochange(&btv->scanning, btv->viewscan_start_o, MAX(iter_o, scanning.end_o));
+#endif
+	} else {
+#ifdef MARKREGION
+		DBG_MARKREGION("bftextview2_run_scanner, region done until %d, mark needscanning from %d:%d\n",gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&scanning.end));
+		markregion_region_done(&btv->scanning, gtk_text_iter_get_offset(&iter));
+		if (gtk_text_iter_compare(&iter, &scanning.end) < 0) {
+			markregion_nochange(&btv->scanning, gtk_text_iter_get_offset(&iter), gtk_text_iter_get_offset(&scanning.end));
+		}
 #endif
+	}
 
 #ifdef MARKREGION
 #ifdef NEEDSCANNING
@@ -2072,47 +1823,32 @@ if newpos==0 we have a symbol (see bftextview2.h for an explanation of symbols a
 
 	finished = gtk_text_iter_is_end(&iter);
 
-#ifdef HL_PROFILING
-	stage4 = g_timer_elapsed(scanning.timer, NULL);
-	hl_profiling.total_runs++;
-	hl_profiling.total_chars += hl_profiling.numchars;
-	hl_profiling.total_time_ms += (gint) (1000.0 * stage4);
-	g_print
-		("scanning run %d (%d ms): %d, %d, %d, %d; from %d-%d, loops=%d,chars=%d,blocks %d/%d (%d) contexts %d/%d (%d) scancache %d\n",
-		 hl_profiling.total_runs, (gint) (1000.0 * stage4)
-		 , (gint) (1000.0 * stage1)
-		 , (gint) (1000.0 * stage2 - stage1)
-		 , (gint) (1000.0 * stage3 - stage2)
-		 , (gint) (1000.0 * stage4 - stage3)
-		 , startpos, gtk_text_iter_get_offset(&iter)
-		 , hl_profiling.numloops, hl_profiling.numchars, hl_profiling.numblockstart, hl_profiling.numblockend,
-		 hl_profiling.longest_blockstack, hl_profiling.numcontextstart, hl_profiling.numcontextend,
-		 hl_profiling.longest_contextstack, g_sequence_get_length(btv->scancache.foundcaches)
-		);
-	g_print("memory scancache %d(%dKb+%dKb) found %d(%dKb) fcontext %d(%dKb) = %dKb\n",
-			hl_profiling.found_refcount, (gint) (hl_profiling.found_refcount * sizeof(Tfound) / 1024.0),
-			(gint) (hl_profiling.found_refcount * 40 / 1024.0)
-			, hl_profiling.fblock_refcount,
-			(gint) (hl_profiling.fblock_refcount * sizeof(Tfoundblock) / 1024.0)
-			, hl_profiling.fcontext_refcount,
-			(gint) (hl_profiling.fcontext_refcount * sizeof(Tfoundcontext) / 1024.0)
-			,
-			(gint) ((hl_profiling.found_refcount * sizeof(Tfound) +
-					 hl_profiling.found_refcount * 5 * sizeof(gpointer) +
-					 hl_profiling.fblock_refcount * sizeof(Tfoundblock) +
-					 hl_profiling.fcontext_refcount * sizeof(Tfoundcontext)) / 1024.0)
-		);
-	g_print("average %d chars/s %d chars/run\n",
-			(guint) (1000.0 * hl_profiling.total_chars / hl_profiling.total_time_ms)
-			, (guint) (1.0 * hl_profiling.total_chars / hl_profiling.total_runs)
-		);
-#endif
+	if (G_UNLIKELY(scantelemetry_active)) {
+		gdouble stage4 = g_timer_elapsed(scanning.timer, NULL);
+		Tscantelemetry *rec = scantelemetry_record(btv, provisional ? scantelemetry_viewport : scantelemetry_scan, stage4);
+		rec->stage[0] = 1000.0 * stage1;
+		rec->stage[1] = 1000.0 * (stage2 - stage1);
+		rec->stage[2] = 1000.0 * (stage3 - stage2);
+		rec->stage[3] = 1000.0 * (stage4 - stage3);
+		rec->start_o = scanstart_o;
+		rec->end_o = iter_o;
+		rec->numchars = iter_o - scanstart_o;
+		rec->numloops = loop;
+		rec->nummatches = scanning.nummatches;
+		rec->numcontextpush = scanning.numcontextpush;
+		rec->numcontextpop = scanning.numcontextpop;
+		rec->numblockpush = scanning.numblockpush;
+		rec->numblockpop = scanning.numblockpop;
+		rec->foundcache_len = foundcache_length((Tfoundcache *) btv->scancache.foundcaches);
+		rec->arena_kb = ARENAPOOL_KB(&SCANARENA(btv)->found) + ARENAPOOL_KB(&SCANARENA(btv)->fblock)
+			+ ARENAPOOL_KB(&SCANARENA(btv)->fcontext);
+	}
 	/* tune the loops_per_timer, try to have 10 timer checks per loop, so we have around 10% deviation from the set interval */
 	if (!end_of_region)
-		loops_per_timer = MAX(loop / NUM_TIMER_CHECKS_PER_RUN, 200);
+		btv->scancache.loops_per_timer = MAX(loop / NUM_TIMER_CHECKS_PER_RUN, 200);
 
 #ifdef DEVELOPMENT
-	if (finished)
+	if (finished && !provisional)
 		scancache_check_integrity(btv, scanning.timer);
 #endif
 
@@ -2133,14 +1869,693 @@ if newpos==0 we have a symbol (see bftextview2.h for an explanation of symbols a
 	return !finished;
 }
 
+gboolean
+bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end)
+{
+	return run_scanner(btv, NULL, visible_end);
+}
+
+/* if the first region that needs scanning is far in front of the visible window (for example after
+a jump to the end of a large file that is still being scanned) we scan the visible window first. The
+stacks are reconstructed from the nearest entry in the scancache, which might be wrong, so the
+window stays marked as needing scanning. When the regular scanning arrives at the window it checks
+if the stacks match with the cache entries of the window, and removes the entries that don't.
+returns TRUE if the window was scanned */
+gboolean
+bftextview2_scan_viewport(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end)
+{
+#ifdef MARKREGION
+	gpointer tmp = NULL;
+	guint start, end, front_o, vstart_o, vend_o;
+	gboolean needscanning = FALSE;
+
+	if (!btv->bflang->st)
+		return FALSE;
+	vstart_o = gtk_text_iter_get_offset(visible_start);
+	vend_o = gtk_text_iter_get_offset(visible_end);
+	if (btv->viewscan_start_o != BF_OFFSET_UNDEFINED && btv->viewscan_start_o <= vstart_o
+		&& btv->viewscan_end_o >= vend_o) {
+		return FALSE;
+	}
+	tmp = markregion_get_region(&btv->scanning, NULL, &start, &end);
+	if (start == BF_OFFSET_UNDEFINED)
+		return FALSE;
+	front_o = start;
+	/* the regular scanning will be in the visible window within one run */
+	if (front_o + NUM_TIMER_CHECKS_PER_RUN * btv->scancache.loops_per_timer > vstart_o)
+		return FALSE;
+	while (start < vend_o) {
+		if (end > vstart_o) {
+			needscanning = TRUE;
+			break;
+		}
+		if (!tmp)
+			break;
+		tmp = markregion_get_region(&btv->scanning, tmp, &start, &end);
+	}
+	if (!needscanning)
+		return FALSE;
+#ifdef THREADED_SCANNING
+	if (btv->scanjob
+		&& vstart_o < ((Tscanjob *) btv->scanjob)->applied_o + ((Tscanjob *) btv->scanjob)->delta
+		+ NUM_TIMER_CHECKS_PER_RUN * btv->scancache.loops_per_timer) {
+		/* the worker will deliver this window soon enough */
+		return FALSE;
+	}
+#endif
+	DBG_DELAYSCANNING("bftextview2_scan_viewport, scan %d:%d before the regular scanning at %d\n", vstart_o, vend_o, front_o);
+	run_scanner(btv, visible_start, visible_end);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/****************************** large-file mode ******************************/
+
+/* in large-file mode (see bftextview2.h) there is no scancache. The scanning runs the same dfa_run() as
+the regular scanning, but only keeps the context stack, and stores a copy of it in a checkpoint every
+LARGEFILE_CHECKPOINT_LINES lines. The visible window is highlighted on demand, starting from the
+checkpoint in front of it */
+#define LARGEFILE_CHECKPOINT_LINES 512
+#define LARGEFILE_CHECKPOINT_CHARS 65536	/* also a checkpoint after this many characters, for very long lines */
+#define LARGEFILE_WINDOW_CHARS (4 * LARGEFILE_CHECKPOINT_CHARS)	/* the largest window that is highlighted at once */
+#define LARGEFILE_MAX_RANGES 6		/* the number of highlighted windows, the least recently used is removed */
+
+typedef struct {
+	guint depth;
+	gint16 *contexts;			/* bottom of the stack first */
+} Tlfstack;
+
+typedef struct {
+	guint offset;				/* the DFA is in its start state at this offset */
+	Tlfstack *stack;			/* interned in Tlargefile->stacks, so equal stacks have equal pointers */
+} Tlfcheckpoint;
+
+typedef struct {
+	guint start_o;
+	guint end_o;
+	gboolean provisional;		/* highlighted with a context stack that was not known, or the text changed */
+} Tlfrange;
+
+typedef struct {
+	gint16 context;
+	guint start_o;
+} Tlfcontext;
+
+typedef struct {
+	GArray *checkpoints;		/* Tlfcheckpoint's sorted by offset, the first one is at offset 0 with an empty stack */
+	guint nvalid;				/* checkpoints from nvalid on are from before a change, and are only used if the
+								   scanning finds the same stack at the same offset again */
+	guint scanned_o;			/* the valid checkpoints are complete up to this offset */
+	guint converge_o;			/* the end of the last change, old checkpoints before it cannot be valid */
+	gboolean complete;
+	GHashTable *stacks;			/* the interned Tlfstack's */
+	GArray *ranges;				/* highlighted Tlfrange's, most recently used last */
+} Tlargefile;
+
+#define LARGEFILE_STACK_KNOWN(lf, offset) ((lf)->complete || (lf)->scanned_o >= (offset))
+
+static guint
+lfstack_hash(gconstpointer key)
+{
+	const Tlfstack *lfs = key;
+	guint i, hash = lfs->depth;
+	for (i = 0; i < lfs->depth; i++)
+		hash = (hash << 5) - hash + lfs->contexts[i];
+	return hash;
+}
+
+static gboolean
+lfstack_equal(gconstpointer a, gconstpointer b)
+{
+	const Tlfstack *lfs1 = a, *lfs2 = b;
+	return (lfs1->depth == lfs2->depth
+			&& memcmp(lfs1->contexts, lfs2->contexts, lfs1->depth * sizeof(gint16)) == 0);
+}
+
+static void
+lfstack_free(gpointer data)
+{
+	Tlfstack *lfs = data;
+	g_free(lfs->contexts);
+	g_slice_free(Tlfstack, lfs);
+}
+
+static gboolean
+lfstack_equals_stack(Tlfstack * lfs, GArray * stack)
+{
+	guint i;
+	if (lfs->depth != stack->len)
+		return FALSE;
+	for (i = 0; i < stack->len; i++) {
+		if (lfs->contexts[i] != g_array_index(stack, Tlfcontext, i).context)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static Tlfstack *
+lfstack_intern(Tlargefile * lf, GArray * stack)
+{
+	Tlfstack tmp, *lfs;
+	guint i;
+	tmp.depth = stack->len;
+	tmp.contexts = g_new(gint16, MAX(stack->len, 1));
+	for (i = 0; i < stack->len; i++)
+		tmp.contexts[i] = g_array_index(stack, Tlfcontext, i).context;
+	lfs = g_hash_table_lookup(lf->stacks, &tmp);
+	if (lfs) {
+		g_free(tmp.contexts);
+		return lfs;
+	}
+	lfs = g_slice_new(Tlfstack);
+	*lfs = tmp;
+	g_hash_table_insert(lf->stacks, lfs, lfs);
+	return lfs;
+}
+
+/* returns a new stack of Tlfcontext's for the interned stack lfs, the contexts start at offset */
+static GArray *
+lfstack_expand(Tlfstack * lfs, guint offset)
+{
+	GArray *stack = g_array_sized_new(FALSE, FALSE, sizeof(Tlfcontext), MAX(lfs->depth, 8));
+	guint i;
+	for (i = 0; i < lfs->depth; i++) {
+		Tlfcontext lfc;
+		lfc.context = lfs->contexts[i];
+		lfc.start_o = offset;
+		g_array_append_val(stack, lfc);
+	}
+	return stack;
+}
+
+#define lfstack_context(stack) ((stack)->len ? g_array_index((stack), Tlfcontext, (stack)->len - 1).context : 1)
+
+/* the index of the last checkpoint before or at offset, searched in the first num checkpoints */
+static guint
+largefile_checkpoint_before(Tlargefile * lf, guint offset, guint num)
+{
+	guint low = 0, high = num;
+	while (high - low > 1) {
+		guint mid = (low + high) / 2;
+		if (g_array_index(lf->checkpoints, Tlfcheckpoint, mid).offset <= offset)
+			low = mid;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* the part of found_match() that is left in large-file mode: the tag of the pattern and the context stack */
+static inline void
+largefile_match(BluefishTextView * btv, Tpattern * pat, GArray * stack, Tscanning * scanning, guint mstart_o,
+				guint match_end_o)
+{
+	gboolean addtags = (scanning && scanning->tagruns);
+	if (addtags && pat->selftag)
+		scanning_add_tag(scanning, pat->selftag, mstart_o, match_end_o);
+	if (scanning)
+		scanning->nummatches++;
+	if (pat->nextcontext < 0) {
+		gint num = pat->nextcontext;
+		while (num < 0 && stack->len > 0) {
+			Tlfcontext *lfc = &g_array_index(stack, Tlfcontext, stack->len - 1);
+			GtkTextTag *contexttag = g_array_index(btv->bflang->st->contexts, Tcontext, lfc->context).contexttag;
+			if (addtags && contexttag)
+				scanning_add_tag(scanning, contexttag, lfc->start_o, mstart_o);
+			g_array_set_size(stack, stack->len - 1);
+			num++;
+		}
+		if (scanning)
+			scanning->numcontextpop++;
+	} else if (pat->nextcontext != 0 && pat->nextcontext != lfstack_context(stack)) {
+		Tlfcontext lfc;
+		lfc.context = pat->nextcontext;
+		lfc.start_o = match_end_o;
+		g_array_append_val(stack, lfc);
+		if (scanning)
+			scanning->numcontextpush++;
+	}
+}
+
+/* the state of dfa_run() in largefile_run(), the Tdfarun data */
+typedef struct {
+	Tscanslice slice;			/* the first member, so scanning_fetch() can use it */
+	Tlargefile *lf;
+	GArray *stack;
+	const gchar *counted;		/* the newlines in the slice are counted up to here */
+	guint lines;				/* the number of lines since the last checkpoint */
+	guint lastcp_o;
+	guint nextold;				/* the first old checkpoint that was not yet passed */
+} Tlfrun;
+
+static gint16
+largefile_run_match(Tdfarun * run, guint16 patternum, Tpattern * pat)
+{
+	Tlfrun *lfr = run->data;
+	largefile_match(lfr->slice.btv, pat, lfr->stack, lfr->slice.scanning, run->mstart_o, run->iter_o);
+	return lfstack_context(lfr->stack);
+}
+
+static inline void
+largefile_count_lines(Tlfrun * lfr, const gchar * upto)
+{
+	for (; lfr->counted < upto; lfr->counted++) {
+		if (*lfr->counted == '\n')
+			lfr->lines++;
+	}
+}
+
+static void
+largefile_fetch(Tdfarun * run)
+{
+	Tlfrun *lfr = run->data;
+	largefile_count_lines(lfr, run->text_end);
+	scanning_fetch(run);
+	lfr->counted = run->p;
+}
+
+/* the DFA is in its start state at every symbol, so the scanning can be continued from here. Stores
+a checkpoint, or returns FALSE if the stack is the same as the old checkpoint at this offset */
+static gboolean
+largefile_symbol(Tdfarun * run)
+{
+	Tlfrun *lfr = run->data;
+	Tlargefile *lf = lfr->lf;
+	guint iter_o = run->iter_o;
+
+	largefile_count_lines(lfr, run->p);
+	while (lfr->nextold < lf->checkpoints->len
+		   && g_array_index(lf->checkpoints, Tlfcheckpoint, lfr->nextold).offset < iter_o)
+		lfr->nextold++;
+	if (G_UNLIKELY(lfr->nextold < lf->checkpoints->len
+				   && g_array_index(lf->checkpoints, Tlfcheckpoint, lfr->nextold).offset == iter_o
+				   && iter_o > lf->converge_o
+				   && lfstack_equals_stack(g_array_index(lf->checkpoints, Tlfcheckpoint, lfr->nextold).stack,
+										   lfr->stack))) {
+		/* the same stack as before the change, the old checkpoints from here on are valid */
+		DBG_SCANNING("largefile_run, converged with the old checkpoints at %d\n", iter_o);
+		return FALSE;
+	}
+	if (lfr->lines >= LARGEFILE_CHECKPOINT_LINES || iter_o - lfr->lastcp_o >= LARGEFILE_CHECKPOINT_CHARS) {
+		Tlfcheckpoint cp;
+		cp.offset = iter_o;
+		cp.stack = lfstack_intern(lf, lfr->stack);
+		if (lfr->nextold > lf->nvalid) {
+			/* re-use the slot of an old checkpoint that we passed */
+			g_array_index(lf->checkpoints, Tlfcheckpoint, lf->nvalid) = cp;
+		} else {
+			g_array_insert_val(lf->checkpoints, lf->nvalid, cp);
+			lfr->nextold++;
+		}
+		lf->nvalid++;
+		lfr->lines = 0;
+		lfr->lastcp_o = iter_o;
+	}
+	return TRUE;
+}
+
+/* the scanning of large-file mode, dfa_run() without scancache, blocks and identifiers. It scans from
+start, where the DFA is in its start state with context stack stack, up to end_o. If scanning is set it
+counts the matches and context changes, and if scanning->tagruns is set the highlighting is collected
+there as well. If lf is set checkpoints are stored, and the old checkpoints after a change are replaced
+or validated. Stops early if timer is set and runs out. Returns the offset where the scanning stopped,
+stack is updated to that offset */
+static guint
+largefile_run(BluefishTextView * btv, Tlargefile * lf, GArray * stack, GtkTextIter * start, guint end_o,
+			  Tscanning * scanning, GTimer * timer)
+{
+	Tlfrun lfr;
+	Tdfarun run;
+	Tdfarun_status status;
+	guint start_o = gtk_text_iter_get_offset(start);
+	guint maxloops = timer ? btv->scancache.loops_per_timer : G_MAXUINT;
+
+	if (start_o >= end_o)
+		return start_o;
+	lfr.slice.btv = btv;
+	lfr.slice.scanning = scanning;
+	lfr.slice.chunkstart = *start;
+	lfr.slice.chunkstart_o = start_o;
+	lfr.slice.chunk = NULL;
+	lfr.slice.provisional = FALSE;
+	lfr.lf = lf;
+	lfr.stack = stack;
+	lfr.counted = NULL;
+	lfr.lines = 0;
+	lfr.lastcp_o = start_o;
+	lfr.nextold = lf ? lf->nvalid : 0;
+	dfarun_init(&run, btv->bflang->st, NULL, NULL, NULL, start_o, end_o);
+	run.context = lfstack_context(stack);
+	run.match = largefile_run_match;
+	if (lf) {
+		run.symbol = largefile_symbol;
+		run.fetch = largefile_fetch;
+	} else {
+		run.fetch = scanning_fetch;
+	}
+	run.data = &lfr;
+	do {
+		status = dfa_run(&run, maxloops);
+	} while (status == dfarun_loops
+			 && (!timer || g_timer_elapsed(timer, NULL) < MAX_CONTINUOUS_SCANNING_INTERVAL));
+	g_free(lfr.slice.chunk);
+	if (lf) {
+		if (lfr.nextold > lf->nvalid)
+			g_array_remove_range(lf->checkpoints, lf->nvalid, lfr.nextold - lf->nvalid);
+		if (status == dfarun_stopped) {
+			lf->nvalid = lf->checkpoints->len;
+			lf->complete = TRUE;
+		}
+	}
+	return run.iter_o;
+}
+
+/* large-file mode is used for documents of main_v->props.largefile_size MB or more. It is decided
+when the scanning of a language starts. Returns TRUE if btv is in large-file mode */
+gboolean
+largefile_start(BluefishTextView * btv)
+{
+	Tlargefile *lf;
+	Tlfcheckpoint cp;
+	GArray *emptystack;
+	guint numchars;
+
+	if (btv->largefile)
+		return TRUE;
+	numchars = gtk_text_buffer_get_char_count(btv->buffer);
+	if (main_v->props.largefile_size <= 0 || numchars < (guint64) main_v->props.largefile_size * 1024 * 1024)
+		return FALSE;
+	DBG_MSG("largefile_start, %d characters, use large-file mode for %p\n", numchars, btv);
+	lf = g_slice_new0(Tlargefile);
+	lf->checkpoints = g_array_sized_new(FALSE, FALSE, sizeof(Tlfcheckpoint), numchars / (LARGEFILE_CHECKPOINT_LINES * 32));
+	lf->stacks = g_hash_table_new_full(lfstack_hash, lfstack_equal, lfstack_free, NULL);
+	lf->ranges = g_array_sized_new(FALSE, FALSE, sizeof(Tlfrange), LARGEFILE_MAX_RANGES + 1);
+	emptystack = g_array_new(FALSE, FALSE, sizeof(Tlfcontext));
+	cp.offset = 0;
+	cp.stack = lfstack_intern(lf, emptystack);
+	g_array_free(emptystack, TRUE);
+	g_array_append_val(lf->checkpoints, cp);
+	lf->nvalid = 1;
+	btv->largefile = lf;
+#ifdef MARKREGION
+	/* the regular scanning does not run in large-file mode */
+	markregion_region_done(&btv->scanning, BF_POSITION_UNDEFINED);
+#endif
+#ifdef NEEDSCANNING
+	{
+		GtkTextIter begin, end;
+		gtk_text_buffer_get_bounds(btv->buffer, &begin, &end);
+		gtk_text_buffer_remove_tag(btv->buffer, btv->needscanning, &begin, &end);
+	}
+#endif
+	return TRUE;
+}
+
+static void
+largefile_free(BluefishTextView * btv)
+{
+	Tlargefile *lf = btv->largefile;
+	if (!lf)
+		return;
+	g_array_free(lf->checkpoints, TRUE);
+	g_hash_table_destroy(lf->stacks);
+	g_array_free(lf->ranges, TRUE);
+	g_slice_free(Tlargefile, lf);
+	btv->largefile = NULL;
+}
+
+static inline guint
+largefile_shift_offset(guint offset, guint startpos, gint change)
+{
+	if (offset <= startpos)
+		return offset;
+	if (change < 0 && offset < startpos - change)
+		return startpos;
+	return offset + change;
+}
+
+/* called from foundcache_update_offsets(), the checkpoints after startpos become old checkpoints
+that the scanning might validate again, and the highlighted windows after startpos are outdated */
+static void
+largefile_text_changed(BluefishTextView * btv, guint startpos, gint offset)
+{
+	Tlargefile *lf = btv->largefile;
+	guint i;
+
+	i = largefile_checkpoint_before(lf, startpos, lf->checkpoints->len);
+	if (g_array_index(lf->checkpoints, Tlfcheckpoint, i).offset < startpos || i == 0)
+		i++;
+	lf->nvalid = MIN(lf->nvalid, i);
+	for (; i < lf->checkpoints->len; i++) {
+		Tlfcheckpoint *cp = &g_array_index(lf->checkpoints, Tlfcheckpoint, i);
+		cp->offset = largefile_shift_offset(cp->offset, startpos, offset);
+	}
+	lf->converge_o = MAX(largefile_shift_offset(lf->converge_o, startpos, offset), startpos + MAX(offset, 0));
+	lf->scanned_o = MIN(lf->scanned_o, startpos);
+	lf->complete = FALSE;
+	for (i = 0; i < lf->ranges->len; i++) {
+		Tlfrange *range = &g_array_index(lf->ranges, Tlfrange, i);
+		if (range->end_o >= startpos) {
+			range->start_o = largefile_shift_offset(range->start_o, startpos, offset);
+			range->end_o = largefile_shift_offset(range->end_o, startpos, offset);
+			range->provisional = TRUE;
+		}
+	}
+}
+
+static void
+largefile_telemetry(BluefishTextView * btv, Tscantelemetry_kind kind, Tscanning * scanning, gdouble duration,
+					guint start_o, guint end_o)
+{
+	Tscantelemetry *rec = scantelemetry_record(btv, kind, duration);
+	/* there are no separate stages in large-file mode, all time is scanning time */
+	rec->stage[3] = 1000.0 * duration;
+	rec->start_o = start_o;
+	rec->end_o = end_o;
+	rec->numchars = end_o - start_o;
+	rec->nummatches = scanning->nummatches;
+	rec->numcontextpush = scanning->numcontextpush;
+	rec->numcontextpop = scanning->numcontextpop;
+	rec->foundcache_len = ((Tlargefile *) btv->largefile)->checkpoints->len;
+}
+
+/* scans for checkpoints, continuing at the last valid checkpoint, until the timer runs out.
+Returns TRUE if it should be called again */
+gboolean
+largefile_extend_checkpoints(BluefishTextView * btv)
+{
+	Tlargefile *lf = btv->largefile;
+	Tlfcheckpoint *cp;
+	GtkTextIter start;
+	Tscanning scanning;
+	GArray *stack;
+	GTimer *timer;
+	guint iter_o, end_o;
+
+	if (lf->complete)
+		return FALSE;
+	memset(&scanning, 0, sizeof(Tscanning));
+	cp = &g_array_index(lf->checkpoints, Tlfcheckpoint, lf->nvalid - 1);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &start, cp->offset);
+	stack = lfstack_expand(cp->stack, cp->offset);
+	end_o = gtk_text_buffer_get_char_count(btv->buffer);
+	timer = g_timer_new();
+	iter_o = largefile_run(btv, lf, stack, &start, end_o, &scanning, timer);
+	if (!lf->complete && iter_o >= end_o) {
+		/* the old checkpoints after the end of the text are obsolete */
+		g_array_set_size(lf->checkpoints, lf->nvalid);
+		lf->complete = TRUE;
+	}
+	if (lf->complete)
+		lf->converge_o = 0;
+	lf->scanned_o = MAX(lf->scanned_o, iter_o);
+	DBG_SCANNING("largefile_extend_checkpoints, scanned up to %d in %f s, %d checkpoints, complete=%d\n", iter_o,
+				 g_timer_elapsed(timer, NULL), lf->checkpoints->len, lf->complete);
+	if (G_UNLIKELY(scantelemetry_active))
+		largefile_telemetry(btv, scantelemetry_largefile_checkpoints, &scanning, g_timer_elapsed(timer, NULL),
+							gtk_text_iter_get_offset(&start), iter_o);
+	g_timer_destroy(timer);
+	g_array_free(stack, TRUE);
+	/* once more after completing, so windows that were highlighted provisionally are done again */
+	return TRUE;
+}
+
+static void
+largefile_window_offsets(GtkTextIter * visible_start, GtkTextIter * visible_end, guint * vstart_o, guint * vend_o)
+{
+	*vstart_o = gtk_text_iter_get_offset(visible_start);
+	*vend_o = MIN(gtk_text_iter_get_offset(visible_end), *vstart_o + LARGEFILE_WINDOW_CHARS);
+}
+
+static Tlfrange *
+largefile_find_range(Tlargefile * lf, guint vstart_o, guint vend_o)
+{
+	guint i;
+	for (i = lf->ranges->len; i > 0; i--) {
+		Tlfrange *range = &g_array_index(lf->ranges, Tlfrange, i - 1);
+		if (range->start_o <= vstart_o && range->end_o >= vend_o)
+			return range;
+	}
+	return NULL;
+}
+
+/* returns TRUE if the window does not need highlighting, the draw handler uses this to see if
+scanning should be scheduled after scrolling */
+gboolean
+largefile_window_highlighted(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end)
+{
+	Tlargefile *lf = btv->largefile;
+	Tlfrange *range;
+	guint vstart_o, vend_o;
+	largefile_window_offsets(visible_start, visible_end, &vstart_o, &vend_o);
+	range = largefile_find_range(lf, vstart_o, vend_o);
+	return (range && (!range->provisional || !LARGEFILE_STACK_KNOWN(lf, vstart_o)));
+}
+
+/* removes the highlighting of the least recently used window, except where it overlaps with
+the other windows */
+static void
+largefile_remove_range(BluefishTextView * btv, Tlargefile * lf)
+{
+	Tlfrange old = g_array_index(lf->ranges, Tlfrange, 0);
+	GtkTextIter start, end;
+	guint i, from_o = old.start_o;
+
+	g_array_remove_index(lf->ranges, 0);
+	while (from_o < old.end_o) {
+		guint to_o = old.end_o, covered_o = from_o;
+		for (i = 0; i < lf->ranges->len; i++) {
+			Tlfrange *range = &g_array_index(lf->ranges, Tlfrange, i);
+			if (range->start_o <= from_o && range->end_o > covered_o)
+				covered_o = range->end_o;
+			else if (range->start_o > from_o && range->start_o < to_o)
+				to_o = range->start_o;
+		}
+		if (covered_o > from_o) {
+			/* still highlighted for another window */
+			from_o = covered_o;
+			continue;
+		}
+		gtk_text_buffer_get_iter_at_offset(btv->buffer, &start, from_o);
+		gtk_text_buffer_get_iter_at_offset(btv->buffer, &end, to_o);
+		remove_all_highlighting_in_area(btv, &start, &end, btv->needremovetags);
+		from_o = to_o;
+	}
+}
+
+/* returns the checkpoint to scan from for offset, and in start_o the offset to start at. If the
+stack at offset is not known yet an old checkpoint is used as well, its stack is a better guess than
+nothing, but in that case we don't scan a lot of text in front of offset */
+static Tlfcheckpoint *
+largefile_checkpoint_for_offset(BluefishTextView * btv, Tlargefile * lf, guint offset, guint * start_o)
+{
+	Tlfcheckpoint *cp;
+	gboolean known = LARGEFILE_STACK_KNOWN(lf, offset);
+
+	cp = &g_array_index(lf->checkpoints, Tlfcheckpoint,
+						largefile_checkpoint_before(lf, offset, known ? lf->nvalid : lf->checkpoints->len));
+	*start_o = cp->offset;
+	if (!known && offset - cp->offset > LARGEFILE_CHECKPOINT_CHARS) {
+		GtkTextIter iter;
+		gtk_text_buffer_get_iter_at_offset(btv->buffer, &iter, offset);
+		gtk_text_iter_set_line_offset(&iter, 0);
+		*start_o = MAX(gtk_text_iter_get_offset(&iter), offset - LARGEFILE_CHECKPOINT_CHARS);
+	}
+	return cp;
+}
+
+/* highlights the visible window if it is not highlighted yet, or if it was highlighted provisionally
+and the context stack in front of it is known by now */
+void
+largefile_highlight_window(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end)
+{
+	Tlargefile *lf = btv->largefile;
+	Tlfcheckpoint *cp;
+	Tlfrange *range, newrange;
+	Tscanning scanning;
+	GtkTextIter start, end;
+	GArray *stack;
+	GTimer *timer = NULL;
+	guint vstart_o, vend_o, start_o, i;
+	gboolean provisional;
+
+	largefile_window_offsets(visible_start, visible_end, &vstart_o, &vend_o);
+	provisional = !LARGEFILE_STACK_KNOWN(lf, vstart_o);
+	range = largefile_find_range(lf, vstart_o, vend_o);
+	if (range && (!range->provisional || provisional))
+		return;
+	if (G_UNLIKELY(scantelemetry_active))
+		timer = g_timer_new();
+	cp = largefile_checkpoint_for_offset(btv, lf, vstart_o, &start_o);
+	DBG_SCANNING("largefile_highlight_window, window %d:%d, start at %d, provisional=%d\n", vstart_o, vend_o,
+				 start_o, provisional);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &start, start_o);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &end, vend_o);
+	remove_all_highlighting_in_area(btv, &start, &end, btv->needremovetags);
+	stack = lfstack_expand(cp->stack, start_o);
+	memset(&scanning, 0, sizeof(Tscanning));
+	scanning.tagruns = g_array_sized_new(FALSE, FALSE, sizeof(Ttagrun), 256);
+	vend_o = largefile_run(btv, NULL, stack, &start, vend_o, &scanning, NULL);
+	/* the contexts that continue after the window */
+	for (i = 0; i < stack->len; i++) {
+		Tlfcontext *lfc = &g_array_index(stack, Tlfcontext, i);
+		GtkTextTag *contexttag = g_array_index(btv->bflang->st->contexts, Tcontext, lfc->context).contexttag;
+		if (contexttag)
+			scanning_add_tag(&scanning, contexttag, lfc->start_o, vend_o);
+	}
+	scanning_apply_tags(btv, &scanning, &start, start_o);
+	g_array_free(stack, TRUE);
+	if (G_UNLIKELY(timer)) {
+		largefile_telemetry(btv, scantelemetry_largefile_window, &scanning, g_timer_elapsed(timer, NULL), start_o,
+							vend_o);
+		g_timer_destroy(timer);
+	}
+
+	if (range)
+		g_array_remove_index(lf->ranges, range - (Tlfrange *) lf->ranges->data);
+	newrange.start_o = start_o;
+	newrange.end_o = vend_o;
+	newrange.provisional = provisional;
+	g_array_append_val(lf->ranges, newrange);
+	if (lf->ranges->len > LARGEFILE_MAX_RANGES)
+		largefile_remove_range(btv, lf);
+}
+
+/* get_contextstack_at_position() for large-file mode */
+static void
+largefile_contextstack(BluefishTextView * btv, guint offset, GQueue * retqueue)
+{
+	Tlargefile *lf = btv->largefile;
+	Tlfcheckpoint *cp;
+	GtkTextIter start;
+	GArray *stack;
+	guint i, start_o;
+
+	cp = largefile_checkpoint_for_offset(btv, lf, offset, &start_o);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &start, start_o);
+	stack = lfstack_expand(cp->stack, start_o);
+	largefile_run(btv, NULL, stack, &start, offset, NULL, NULL);
+	for (i = stack->len; i > 0; i--) {
+		gint context = g_array_index(stack, Tlfcontext, i - 1).context;
+		g_queue_push_tail(retqueue, GINT_TO_POINTER(context));
+	}
+	g_array_free(stack, TRUE);
+}
+
 GQueue *
 get_contextstack_at_position(BluefishTextView * btv, GtkTextIter * position)
 {
 	Tfound *found;
 	GQueue *retqueue = g_queue_new();
-	found = get_foundcache_at_offset(btv, gtk_text_iter_get_offset(position), NULL);
+	if (G_UNLIKELY(btv->largefile)) {
+		largefile_contextstack(btv, gtk_text_iter_get_offset(position), retqueue);
+		return retqueue;
+	}
+	found = get_foundcache_at_offset(btv, gtk_text_iter_get_offset(position));
 	if (found) {
-		Tfoundcontext *tmpfcontext = found->fcontext;
+		Tfoundcontext *tmpfcontext = found_fcontext(btv, found);
 		gint changecounter = found->numcontextchange;
 		while (tmpfcontext) {
 			if (changecounter >= 0) {
@@ -2149,7 +2564,7 @@ get_contextstack_at_position(BluefishTextView * btv, GtkTextIter * position)
 			} else {
 				changecounter++;
 			}
-			tmpfcontext = (Tfoundcontext *) tmpfcontext->parentfcontext;
+			tmpfcontext = fcontext_parent(btv, tmpfcontext);
 		}
 	}
 	return retqueue;
@@ -2173,22 +2588,22 @@ scan_for_autocomp_prefix(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIt
 	while (!gtk_text_iter_equal(&iter, cursorpos)) {
 		gunichar uc;
 		uc = gtk_text_iter_get_char(&iter);
-		if (G_UNLIKELY(uc > 128)) {
+		if (G_UNLIKELY(uc > 127)) {
 			/* multibyte characters cannot be matched by the engine. character
 			   1 in ascii is "SOH (start of heading)". we need this to support a
 			   pattern like [^#]* .  */
 			uc = 1;
 		}
 		DBG_AUTOCOMP("scanning %c\n", uc);
-		newpos = get_tablerow(btv->bflang->st,*contextnum,pos).row[uc];
+		newpos = dfa_next_state(get_context(btv->bflang->st, *contextnum), pos, uc);
 		if (G_UNLIKELY(newpos == 0 || uc == '\0')) {
 			DBG_AUTOCOMP("newpos=%d...\n", newpos);
-			if (G_UNLIKELY(get_tablerow(btv->bflang->st,*contextnum,pos).match)) {
+			if (G_UNLIKELY(dfa_match(get_context(btv->bflang->st, *contextnum), pos))) {
 				if (g_array_index
 					(btv->bflang->st->matches, Tpattern,
-					 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext < 0) {
+					 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext < 0) {
 					gint num = g_array_index(btv->bflang->st->matches, Tpattern,
-											 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext;
+											 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext;
 					while (num != 0) {
 						g_queue_pop_head(contextstack);
 						num++;
@@ -2199,11 +2614,11 @@ scan_for_autocomp_prefix(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIt
 				} else
 					if (g_array_index
 						(btv->bflang->st->matches, Tpattern,
-						 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext > 0) {
+						 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext > 0) {
 					DBG_AUTOCOMP("previous pos=%d had a match with a context change!\n", pos);
 					*contextnum =
 						g_array_index(btv->bflang->st->matches, Tpattern,
-									  get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext;
+									  dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext;
 					g_queue_push_head(contextstack, GINT_TO_POINTER(*contextnum));
 				}
 			}
@@ -2242,17 +2657,17 @@ scan_for_tooltip(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIter * pos
 	while (!gtk_text_iter_equal(&iter, &end)) {
 		gunichar uc;
 		uc = gtk_text_iter_get_char(&iter);
-		if (G_UNLIKELY(uc > 128)) {
+		if (G_UNLIKELY(uc > 127)) {
 			newpos = 0;
 		} else {
 			DBG_TOOLTIP("scanning %c\n", uc);
-			newpos = get_tablerow(btv->bflang->st,*contextnum,pos).row[uc];
+			newpos = dfa_next_state(get_context(btv->bflang->st, *contextnum), pos, uc);
 		}
 		if (G_UNLIKELY(newpos == 0 || uc == '\0')) {
 			DBG_TOOLTIP("newpos=%d...\n", newpos);
-			if (G_UNLIKELY(get_tablerow(btv->bflang->st,*contextnum,pos).match)) {
+			if (G_UNLIKELY(dfa_match(get_context(btv->bflang->st, *contextnum), pos))) {
 				DBG_MSG("found match %d, retthismatch=%d\n",
-						get_tablerow(btv->bflang->st,*contextnum,pos).match, retthismatch);
+						dfa_match(get_context(btv->bflang->st, *contextnum), pos), retthismatch);
 				if (retthismatch) {
 					*position = iter;
 					g_queue_free(contextstack);
@@ -2262,9 +2677,9 @@ scan_for_tooltip(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIter * pos
 				}
 				if (g_array_index
 					(btv->bflang->st->matches, Tpattern,
-					 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext < 0) {
+					 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext < 0) {
 					gint num = g_array_index(btv->bflang->st->matches, Tpattern,
-											 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext;
+											 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext;
 					while (num != 0) {
 						g_queue_pop_head(contextstack);
 						num++;
@@ -2277,10 +2692,10 @@ scan_for_tooltip(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIter * pos
 				} else
 					if (g_array_index
 						(btv->bflang->st->matches, Tpattern,
-						 get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext > 0) {
+						 dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext > 0) {
 					*contextnum =
 						g_array_index(btv->bflang->st->matches, Tpattern,
-									  get_tablerow(btv->bflang->st,*contextnum,pos).match).nextcontext;
+									  dfa_match(get_context(btv->bflang->st, *contextnum), pos)).nextcontext;
 					DBG_TOOLTIP("previous pos=%d had a match that pushed the context to %d!\n", pos,
 								*contextnum);
 					g_queue_push_head(contextstack, GINT_TO_POINTER(*contextnum));
@@ -2320,18 +2735,15 @@ static void
 scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 	GQueue contexts;
 	GQueue blocks;
-	GSequenceIter *siter;
+	Tfound *found;
 	gfloat start;
 	guint32 prevfound_o=0;
 
 	start = g_timer_elapsed(timer, NULL);
 	g_queue_init(&contexts);
 	g_queue_init(&blocks);
-	siter = g_sequence_get_begin_iter(btv->scancache.foundcaches);
-	while (siter && !g_sequence_iter_is_end(siter)) {
-		Tfound *found = g_sequence_get(siter);
-		if (!found)
-			break;
+	found = get_foundcache_first(btv);
+	while (found) {
 		if (found->charoffset_o <= 0) {
 			g_warning("scancache_check_integrity, found %p has offset < 0\n", found);
 			dump_scancache(btv);
@@ -2349,26 +2761,26 @@ scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 
 		if (found->numcontextchange > 0) {
 			/* push context */
-			if (found->fcontext->parentfcontext != g_queue_peek_head(&contexts)) {
-				if (found->fcontext->parentfcontext == NULL) {
+			if (fcontext_parent(btv, found_fcontext(btv, found)) != g_queue_peek_head(&contexts)) {
+				if (fcontext_parent(btv, found_fcontext(btv, found)) == NULL) {
 					g_warning("scancache_check_integrity, pushing context at %d:%d on top of non-NULL stack, but parent contexts is NULL!? found at %d\n"
-									,found->fcontext->start_o, found->fcontext->end_o,found->charoffset_o);
+									,found_fcontext(btv, found)->start_o, found_fcontext(btv, found)->end_o,found->charoffset_o);
 					dump_scancache(btv);
 					g_assert_not_reached();
 				} else {
 					g_warning("scancache_check_integrity, pushing context at %d:%d, parent contexts at %d:%d do not match! found at %d\n"
-									,found->fcontext->start_o, found->fcontext->end_o
-									,((Tfoundcontext *)found->fcontext->parentfcontext)->start_o
-									,((Tfoundcontext *)found->fcontext->parentfcontext)->end_o,found->charoffset_o);
+									,found_fcontext(btv, found)->start_o, found_fcontext(btv, found)->end_o
+									,fcontext_parent(btv, found_fcontext(btv, found))->start_o
+									,fcontext_parent(btv, found_fcontext(btv, found))->end_o,found->charoffset_o);
 					dump_scancache(btv);
 					g_assert_not_reached();
 				}
 			}
-			g_queue_push_head(&contexts, found->fcontext);
+			g_queue_push_head(&contexts, found_fcontext(btv, found));
 
-			if (found->fcontext->start_o < prevfound_o || found->fcontext->start_o > found->fcontext->end_o || found->fcontext->end_o < found->charoffset_o) {
+			if (found_fcontext(btv, found)->start_o < prevfound_o || found_fcontext(btv, found)->start_o > found_fcontext(btv, found)->end_o || found_fcontext(btv, found)->end_o < found->charoffset_o) {
 					g_warning("scancache_check_integrity, context is at %d:%d, but prevoffset is at %d and charoffset_o is at %d\n"
-									,found->fcontext->start_o, found->fcontext->end_o,prevfound_o, found->charoffset_o);
+									,found_fcontext(btv, found)->start_o, found_fcontext(btv, found)->end_o,prevfound_o, found->charoffset_o);
 					dump_scancache(btv);
 					g_assert_not_reached();
 			}
@@ -2376,7 +2788,7 @@ scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 		} else {
 			gint i;
 			/* check the current context */
-			if (found->fcontext != g_queue_peek_head(&contexts)) {
+			if (found_fcontext(btv, found) != g_queue_peek_head(&contexts)) {
 				g_warning("scancache_check_integrity, contexts don't match, found(%p) at %d\n",found,found->charoffset_o);
 				dump_scancache(btv);
 				g_assert_not_reached();
@@ -2389,20 +2801,20 @@ scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 		}
 
 		if (found->numblockchange > 0) {
-			if (found->fblock->parentfblock != g_queue_peek_head(&blocks)) {
+			if (fblock_parent(btv, found_fblock(btv, found)) != g_queue_peek_head(&blocks)) {
 				g_warning("scancache_check_integrity, pushing block, parent blocks do not match, found(%p) at %d\n",found,found->charoffset_o);
 				dump_scancache(btv);
 				g_assert_not_reached();
 			}
-			g_queue_push_head(&blocks, found->fblock);
+			g_queue_push_head(&blocks, found_fblock(btv, found));
 
-			if (found->fblock->start1_o < prevfound_o
-					|| found->fblock->end1_o < found->charoffset_o
-					|| found->fblock->end1_o < found->fblock->start1_o
-					|| found->fblock->start2_o < found->fblock->end1_o
-					|| found->fblock->end2_o < found->fblock->start2_o) {
+			if (found_fblock(btv, found)->start1_o < prevfound_o
+					|| found_fblock(btv, found)->end1_o < found->charoffset_o
+					|| found_fblock(btv, found)->end1_o < found_fblock(btv, found)->start1_o
+					|| found_fblock(btv, found)->start2_o < found_fblock(btv, found)->end1_o
+					|| found_fblock(btv, found)->end2_o < found_fblock(btv, found)->start2_o) {
 				g_warning("scancache_check_integrity, block is at %d:%d-%d:%d, prevfound_o at %d and charoffset_o at %d\n",
-								found->fblock->start1_o,found->fblock->end1_o,found->fblock->start2_o,found->fblock->end2_o,
+								found_fblock(btv, found)->start1_o,found_fblock(btv, found)->end1_o,found_fblock(btv, found)->start2_o,found_fblock(btv, found)->end2_o,
 								prevfound_o,found->charoffset_o);
 				dump_scancache(btv);
 				g_assert_not_reached();
@@ -2411,7 +2823,7 @@ scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 		} else {
 			gint i;
 			/* check the current context */
-			if (found->fblock != g_queue_peek_head(&blocks)) {
+			if (found_fblock(btv, found) != g_queue_peek_head(&blocks)) {
 				g_warning("blocks don't match, found(%p) at %d\n",found,found->charoffset_o);
 				dump_scancache(btv);
 				g_assert_not_reached();
@@ -2423,7 +2835,7 @@ scancache_check_integrity(BluefishTextView * btv, GTimer *timer) {
 			}
 		}
 		prevfound_o = found->charoffset_o;
-		siter = g_sequence_iter_next(siter);
+		found = get_foundcache_next(btv, found);
 	}
 	g_queue_clear(&contexts);
 	g_queue_clear(&blocks);
@@ -2435,7 +2847,13 @@ void
 cleanup_scanner(BluefishTextView * btv)
 {
 	GtkTextIter begin, end;
-	GSequenceIter *sit1, *sit2;
+
+#ifdef THREADED_SCANNING
+	scanthread_cancel(btv);
+#endif
+#ifdef HAVE_LIBENCHANT
+	bftextview2_spell_cancel(btv);
+#endif
 
 	gtk_text_buffer_get_bounds(btv->buffer, &begin, &end);
 	gtk_text_buffer_remove_all_tags(btv->buffer, &begin, &end);
@@ -2446,31 +2864,11 @@ cleanup_scanner(BluefishTextView * btv)
 #endif
 #endif
 
-	g_sequence_foreach(btv->scancache.foundcaches, found_free_lcb, btv);
-	sit1 = g_sequence_get_begin_iter(btv->scancache.foundcaches);
-	if (sit1 && !g_sequence_iter_is_end(sit1)) {
-		sit2 = g_sequence_get_end_iter(btv->scancache.foundcaches);
-		/*g_sequence_foreach_range(sit1,sit2,foundstack_free_lcb,btv); */
-		g_sequence_remove_range(sit1, sit2);
-	} else {
-		/*DBG_SCANNING("cleanup_scanner, no sit1, no cleanup ??\n"); */
-	}
-#ifdef HL_PROFILING
-	g_print("cleanup_scanner, memory scancache %d(%dKb+%dKb) found %d(%dKb) fcontext %d(%dKb) = %dKb\n",
-			hl_profiling.found_refcount, (gint) (hl_profiling.found_refcount * sizeof(Tfound) / 1024.0),
-			(gint) (hl_profiling.found_refcount * 40 / 1024.0)
-			, hl_profiling.fblock_refcount,
-			(gint) (hl_profiling.fblock_refcount * sizeof(Tfoundblock) / 1024.0)
-			, hl_profiling.fcontext_refcount,
-			(gint) (hl_profiling.fcontext_refcount * sizeof(Tfoundcontext) / 1024.0)
-			,
-			(gint) ((hl_profiling.found_refcount * sizeof(Tfound) +
-					 hl_profiling.found_refcount * 5 * sizeof(gpointer) +
-					 hl_profiling.fblock_refcount * sizeof(Tfoundblock) +
-					 hl_profiling.fcontext_refcount * sizeof(Tfoundcontext)) / 1024.0)
-		);
-
-#endif
+	foundcache_clear(btv->scancache.foundcaches);
+	scanarena_clear(btv->scancache.arena);
+	g_hash_table_remove_all(btv->scancache.appliedtags);
+	btv->viewscan_start_o = btv->viewscan_end_o = BF_OFFSET_UNDEFINED;
+	largefile_free(btv);
 #ifdef IDENTSTORING
 	bftextview2_identifier_hash_remove_doc(DOCUMENT(btv->doc)->bfwin, btv->doc);
 #endif							/* IDENTSTORING */
@@ -2480,7 +2878,14 @@ cleanup_scanner(BluefishTextView * btv)
 void
 scancache_destroy(BluefishTextView * btv)
 {
-	g_sequence_foreach(btv->scancache.foundcaches, found_free_lcb, btv);
-	g_sequence_free(btv->scancache.foundcaches);
+#ifdef THREADED_SCANNING
+	scanthread_cancel(btv);
+#endif
+	foundcache_free(btv->scancache.foundcaches);
 	btv->scancache.foundcaches = NULL;
+	scanarena_free(btv->scancache.arena);
+	btv->scancache.arena = NULL;
+	g_hash_table_destroy(btv->scancache.appliedtags);
+	btv->scancache.appliedtags = NULL;
+	largefile_free(btv);
 }
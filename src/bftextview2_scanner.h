@@ -24,18 +24,23 @@
 #include "bftextview2.h"
 
 GQueue *get_contextstack_at_position(BluefishTextView * btv, GtkTextIter * position);
-Tfound *get_foundcache_next(BluefishTextView * bt2, GSequenceIter ** siter);
-Tfound *get_foundcache_first(BluefishTextView * bt2, GSequenceIter ** retsiter);
-Tfound *get_foundcache_at_offset(BluefishTextView * btv, guint offset, GSequenceIter ** retsiter);
+Tfound *get_foundcache_next(BluefishTextView * bt2, Tfound * found);
+Tfound *get_foundcache_first(BluefishTextView * bt2);
+Tfound *get_foundcache_at_offset(BluefishTextView * btv, guint offset);
 void foundcache_update_offsets(BluefishTextView * btv, guint startpos, gint offset);
-Tfoundblock *pop_blocks(gint numchange, Tfoundblock * curblock);
+Tfoundblock *pop_blocks(BluefishTextView * btv, gint numchange, Tfoundblock * curblock);
 gboolean bftextview2_run_scanner(BluefishTextView * btv, GtkTextIter * visible_end);
+gboolean bftextview2_scan_viewport(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end);
 void scan_for_prefix_start(BluefishTextView * btv, guint16 contextnum, GtkTextIter * start,
 						   GtkTextIter * cursor);
 void scan_for_autocomp_prefix(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIter * cursorpos,
 							  gint * contextnum);
 gboolean scan_for_tooltip(BluefishTextView * btv, GtkTextIter * mstart, GtkTextIter * position,
 						  gint * contextnum);
+gboolean largefile_start(BluefishTextView * btv);
+gboolean largefile_extend_checkpoints(BluefishTextView * btv);
+gboolean largefile_window_highlighted(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end);
+void largefile_highlight_window(BluefishTextView * btv, GtkTextIter * visible_start, GtkTextIter * visible_end);
 void cleanup_scanner(BluefishTextView * btv);
 void scancache_destroy(BluefishTextView * btv);
 
@@ -0,0 +1,119 @@
+/* Bluefish HTML Editor
+ * bftextview2_scanstack.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+the block and context stack handling of found_match() in bftextview2_scanner.c. These functions
+only use the Tscanarena, the highlighting and the scancache validation stay in found_match(), so
+the scanner benchmark (bftextview2_scanbench.c) runs exactly the same stack code without a
+BluefishTextView. */
+#ifndef _BFTEXTVIEW2_SCANSTACK_H_
+#define _BFTEXTVIEW2_SCANSTACK_H_
+
+#include "bftextview2_private.h"
+#include "bftextview2_arena.h"
+
+/* a pattern with stretch_blockstart stretches the end of the start of the current block up
+to the end of the match, if this block was started by pat->blockstartpattern and it does
+not have an end before this match. start2_o could be equal to match_end_o if the end starts
+where the start ends as in <p></p> */
+static inline void
+scanstack_stretch_block(Tfoundblock * curfblock, Tpattern * pat, guint match_end_o)
+{
+	if (G_UNLIKELY(pat->stretch_blockstart && curfblock && curfblock->patternum == pat->blockstartpattern
+				   && (curfblock->start2_o == BF_POSITION_UNDEFINED || curfblock->start2_o < match_end_o))) {
+		curfblock->end1_o = match_end_o;
+	}
+}
+
+/* returns the new block, which is the new current block */
+static inline Tfoundblock *
+scanstack_push_block(Tscanarena * arena, Tfoundblock * curfblock, guint16 patternum, guint match_start_o,
+					 guint match_end_o)
+{
+	Tfoundblock *fblock = arenapool_alloc(&arena->fblock);
+	fblock->start1_o = match_start_o;
+	fblock->end1_o = match_end_o;
+	fblock->start2_o = BF_POSITION_UNDEFINED;
+	fblock->end2_o = BF_POSITION_UNDEFINED;
+	fblock->patternum = patternum;
+	fblock->parentfblock = arenapool_handle(&arena->fblock, curfblock);
+	return fblock;
+}
+
+/* returns the block on the stack that is ended by pat, numblockchange is decreased for every
+block on top of it. Returns NULL and sets numblockchange to 0 if there is no such block */
+static inline Tfoundblock *
+scanstack_find_block_start(Tscanarena * arena, Tfoundblock * curfblock, Tpattern * pat, gint * numblockchange)
+{
+	Tfoundblock *fblock = curfblock;
+	while (fblock && fblock->patternum != pat->blockstartpattern && pat->blockstartpattern != -1) {
+		fblock = arenapool_get(&arena->fblock, fblock->parentfblock);
+		(*numblockchange)--;
+	}
+	if (G_UNLIKELY(!fblock))
+		*numblockchange = 0;
+	return fblock;
+}
+
+/* ends fblock (returned by scanstack_find_block_start()), returns the new current block */
+static inline Tfoundblock *
+scanstack_end_block(Tscanarena * arena, Tfoundblock * fblock, guint match_start_o, guint match_end_o,
+					gint * numblockchange)
+{
+	if (G_UNLIKELY(fblock->end1_o > match_start_o)) {
+		/* possibly the block was stretched with stretch_blockstart, undo the stretch */
+		fblock->end1_o = match_start_o;
+	}
+	fblock->start2_o = match_start_o;
+	fblock->end2_o = match_end_o;
+	(*numblockchange)--;
+	return arenapool_get(&arena->fblock, fblock->parentfblock);
+}
+
+/* returns the new context, which is the new current context */
+static inline Tfoundcontext *
+scanstack_push_context(Tscanarena * arena, Tfoundcontext * curfcontext, gint16 context, guint match_end_o)
+{
+	Tfoundcontext *fcontext = arenapool_alloc(&arena->fcontext);
+	fcontext->start_o = match_end_o;
+	fcontext->end_o = BF_OFFSET_UNDEFINED;
+	fcontext->context = context;
+	fcontext->parentfcontext = arenapool_handle(&arena->fcontext, curfcontext);
+	return fcontext;
+}
+
+/* pops -numchange (a negative number) contexts and ends them at offset, but does not pop if
+there is nothing to pop (because of an error in the language file). numchanged is decreased for
+every popped context, returns the new current context */
+static inline Tfoundcontext *
+scanstack_pop_contexts(Tscanarena * arena, Tfoundcontext * curfcontext, gint numchange, guint offset,
+					   gint * numchanged)
+{
+	Tfoundcontext *fcontext = curfcontext;
+	while (numchange < 0 && fcontext) {
+		fcontext->end_o = offset;
+		fcontext = arenapool_get(&arena->fcontext, fcontext->parentfcontext);
+		(*numchanged)--;
+		numchange++;
+	}
+	return fcontext;
+}
+
+#endif							/* _BFTEXTVIEW2_SCANSTACK_H_ */
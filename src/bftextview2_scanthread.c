@@ -0,0 +1,239 @@
+/* Bluefish HTML Editor
+ * bftextview2_scanthread.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+scanning large regions in a thread:
+
+if bftextview2_run_scanner() finds a large region that needs scanning, it makes a copy
+of the text (the snapshot) and starts a Tscanjob. The worker thread runs the DFA over the
+snapshot with dfa_run() (bftextview2_dfarun.c), keeps its own context stack, and produces
+Tscanevent's: every match, and every identifier with its identaction. It does not touch the
+GtkTextBuffer, the GtkTextTag's or the scancache.
+
+After every SCANTHREAD_BATCH_CHARS characters the events are handed to the mainloop as a
+Tscanbatch. The mainloop (scanthread_apply_batch() in bftextview2_scanner.c) reconstructs the
+scanning state from the scancache at the start of the batch, replays the events through
+found_match(), which applies the tags and updates the scancache, and marks the batch as done.
+If the context that the mainloop ends up in differs from the context the worker found, the job
+is cancelled and the remaining text is scanned in the mainloop as usual.
+
+If the text is changed while a job runs, foundcache_update_offsets() either rebases the job
+(the change is before the part that is not yet applied, all later offsets shift) or cancels it.
+
+The Tscantable is never freed while bluefish runs (only on exit with MEMORY_LEAK_DEBUG), so
+the worker can read it without locking.
+*/
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_scanthread.h"
+
+#ifdef THREADED_SCANNING
+
+typedef struct {
+	Tscanjob *job;
+	Tscanbatch *batch;
+} Tscanbatch_delivery;
+
+static void
+scanjob_unref(Tscanjob * job)
+{
+	if (g_atomic_int_dec_and_test(&job->refcount)) {
+		Tscanbatch *batch;
+		while ((batch = g_queue_pop_head(&job->ready))) {
+			scanbatch_free(batch);
+		}
+		g_slice_free(Tscanjob, job);
+	}
+}
+
+void
+scanbatch_free(Tscanbatch * batch)
+{
+	g_array_free(batch->events, TRUE);
+	g_slice_free(Tscanbatch, batch);
+}
+
+static Tscanbatch *
+scanbatch_new(guint32 start_o, gint16 context)
+{
+	Tscanbatch *batch = g_slice_new0(Tscanbatch);
+	batch->start_o = start_o;
+	batch->start_context = context;
+	batch->events = g_array_sized_new(FALSE, FALSE, sizeof(Tscanevent), 1024);
+	return batch;
+}
+
+/* runs in the mainloop */
+static gboolean
+scanbatch_deliver_lcb(gpointer data)
+{
+	Tscanbatch_delivery *sbd = data;
+	DEBUG_SIG("scanbatch_deliver_lcb, priority=%d\n", SCANTHREAD_BATCH_PRIORITY);
+	if (g_atomic_int_get(&sbd->job->cancelled) || !sbd->job->btv) {
+		scanbatch_free(sbd->batch);
+	} else {
+		g_queue_push_tail(&sbd->job->ready, sbd->batch);
+		bftextview2_schedule_scanning(sbd->job->btv);
+	}
+	scanjob_unref(sbd->job);
+	g_slice_free(Tscanbatch_delivery, sbd);
+	return FALSE;
+}
+
+/* runs in the thread */
+static void
+scanbatch_deliver(Tscanjob * job, Tscanbatch * batch)
+{
+	Tscanbatch_delivery *sbd = g_slice_new(Tscanbatch_delivery);
+	g_atomic_int_inc(&job->refcount);
+	sbd->job = job;
+	sbd->batch = batch;
+	g_idle_add_full(SCANTHREAD_BATCH_PRIORITY, scanbatch_deliver_lcb, sbd, NULL);
+}
+
+static inline void
+scanbatch_add_event(Tscanbatch * batch, Tscanevent_type type, guint32 start_o, guint32 end_o, guint16 patternum,
+					gint16 context, guint8 identaction)
+{
+	Tscanevent event;
+	event.start_o = start_o;
+	event.end_o = end_o;
+	event.patternum = patternum;
+	event.context = context;
+	event.type = type;
+	event.identaction = identaction;
+	g_array_append_val(batch->events, event);
+}
+
+/* the callbacks for dfa_run(), run->data is a Tscanbatch_delivery with the current batch */
+static gint16
+scanjob_match(Tdfarun * run, guint16 patternum, Tpattern * pat)
+{
+	Tscanbatch_delivery *sbd = run->data;
+	gint16 context = dfarun_context_change(run, patternum, pat);
+	scanbatch_add_event(sbd->batch, scanevent_match, run->mstart_o, run->iter_o, patternum, context, 0);
+	return context;
+}
+
+static gboolean
+scanjob_identifier(Tdfarun * run, gint16 context)
+{
+	Tscanbatch_delivery *sbd = run->data;
+	scanbatch_add_event(sbd->batch, scanevent_identifier, run->mstart_o, run->iter_o, 0, context,
+						run->identaction);
+	return TRUE;
+}
+
+static gboolean
+scanjob_symbol(Tdfarun * run)
+{
+	Tscanbatch_delivery *sbd = run->data;
+	if (G_LIKELY(run->mstart_o - sbd->batch->start_o < SCANTHREAD_BATCH_CHARS))
+		return TRUE;
+	/* a batch always ends on a symbol, so there is no pattern that runs into the next batch */
+	sbd->batch->end_o = run->mstart_o;
+	scanbatch_deliver(sbd->job, sbd->batch);
+	if (g_atomic_int_get(&sbd->job->cancelled)) {
+		sbd->batch = NULL;
+		return FALSE;
+	}
+	sbd->batch = scanbatch_new(run->mstart_o, run->context);
+	return TRUE;
+}
+
+/* runs the DFA over the snapshot with the same dfa_run() as bftextview2_run_scanner(), but
+without the scancache. Contexts are pushed and popped exactly like found_match() does */
+static gpointer
+scanjob_thread(gpointer data)
+{
+	Tscanjob *job = data;
+	Tscanbatch_delivery sbd;
+	Tdfarun run;
+
+	dfarun_init(&run, job->st, job->contextstack, job->text, job->text + strlen(job->text), job->start_o,
+				job->end_o);
+	run.match = scanjob_match;
+	run.identifier = scanjob_identifier;
+	run.symbol = scanjob_symbol;
+	run.data = &sbd;
+	sbd.job = job;
+	sbd.batch = scanbatch_new(job->start_o, run.context);
+	dfa_run(&run, G_MAXUINT);
+
+	if (sbd.batch) {
+		sbd.batch->end_o = run.iter_o;
+		sbd.batch->last = TRUE;
+		scanbatch_deliver(job, sbd.batch);
+	}
+	g_free(job->text);
+	job->text = NULL;
+	g_array_free(job->contextstack, TRUE);
+	job->contextstack = NULL;
+	scanjob_unref(job);
+	return NULL;
+}
+
+/* called in the mainloop. text and contextstack (an array of gint16 with the
+bottom of the stack first) are owned by the job afterwards. The returned job has a
+reference for the caller, which is released by scanjob_cancel() */
+Tscanjob *
+scanjob_start(BluefishTextView * btv, Tscantable * st, gchar * text, guint32 start_o, guint32 end_o,
+			  GArray * contextstack)
+{
+	GError *gerror = NULL;
+	Tscanjob *job = g_slice_new0(Tscanjob);
+	job->refcount = 2;			/* one for the caller, one for the thread */
+	job->btv = btv;
+	job->st = st;
+	job->text = text;
+	job->start_o = start_o;
+	job->end_o = end_o;
+	job->applied_o = start_o;
+	job->contextstack = contextstack;
+	g_queue_init(&job->ready);
+	g_thread_create(scanjob_thread, job, FALSE, &gerror);
+	if (gerror) {
+		g_warning("failed to start scanning thread: %s\n", gerror->message);
+		g_error_free(gerror);
+		g_free(job->text);
+		g_array_free(job->contextstack, TRUE);
+		g_slice_free(Tscanjob, job);
+		return NULL;
+	}
+	return job;
+}
+
+/* called in the mainloop, releases the reference of the caller of scanjob_start() */
+void
+scanjob_cancel(Tscanjob * job)
+{
+	Tscanbatch *batch;
+	g_atomic_int_set(&job->cancelled, 1);
+	job->btv = NULL;
+	while ((batch = g_queue_pop_head(&job->ready))) {
+		scanbatch_free(batch);
+	}
+	scanjob_unref(job);
+}
+
+#endif							/* THREADED_SCANNING */
@@ -0,0 +1,74 @@
+/* Bluefish HTML Editor
+ * bftextview2_scanthread.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_SCANTHREAD_H_
+#define _BFTEXTVIEW2_SCANTHREAD_H_
+
+#include "bftextview2.h"
+
+#ifdef THREADED_SCANNING
+
+#define SCANTHREAD_MIN_CHARS 65536	/* regions smaller than this are scanned in the mainloop */
+#define SCANTHREAD_BATCH_CHARS 32768	/* the worker hands back results after this number of characters */
+
+typedef enum {
+	scanevent_match,			/* a pattern matched from start_o to end_o */
+	scanevent_identifier		/* an identifier from start_o to end_o, see found_identifier() */
+} Tscanevent_type;
+
+typedef struct {
+	guint32 start_o;
+	guint32 end_o;
+	guint16 patternum;
+	gint16 context;				/* the context after this event according to the worker */
+	guint8 type;				/* Tscanevent_type */
+	guint8 identaction;			/* only for scanevent_identifier */
+} Tscanevent;
+
+typedef struct {
+	guint32 start_o;			/* offsets are relative to the text when the job was started, see Tscanjob.delta */
+	guint32 end_o;
+	gint16 start_context;		/* the context the worker was in at start_o */
+	gboolean last;				/* the worker reached the end of the snapshot with this batch */
+	GArray *events;				/* array of Tscanevent, sorted by offset */
+} Tscanbatch;
+
+typedef struct {
+	gint refcount;				/* atomic, the worker thread and every batch in the mainloop hold a reference */
+	gint cancelled;				/* atomic, set from the mainloop, checked in the worker */
+	BluefishTextView *btv;		/* NULL once the view is gone, only accessed in the mainloop */
+	Tscantable *st;
+	gchar *text;				/* the snapshot, owned by the worker */
+	guint32 start_o;
+	guint32 end_o;
+	GArray *contextstack;		/* the contexts on the stack at start_o, only used by the worker */
+	/* the following members are only used in the mainloop */
+	gint32 delta;				/* text inserted (or removed) before applied_o after the job was started */
+	guint32 applied_o;			/* everything before this offset (without delta) has been applied */
+	GQueue ready;				/* batches that the worker finished, but that are not yet applied */
+} Tscanjob;
+
+Tscanjob *scanjob_start(BluefishTextView * btv, Tscantable * st, gchar * text, guint32 start_o, guint32 end_o,
+						GArray * contextstack);
+void scanjob_cancel(Tscanjob * job);
+void scanbatch_free(Tscanbatch * batch);
+
+#endif							/* THREADED_SCANNING */
+#endif							/* _BFTEXTVIEW2_SCANTHREAD_H_ */
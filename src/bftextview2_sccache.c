@@ -0,0 +1,803 @@
+/* Bluefish HTML Editor
+ * bftextview2_sccache.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+the persisted scancache:
+
+when a document is closed or autosaved, and it is completely scanned, and the scancache changed
+since it was last saved or restored (BluefishTextView.sccache_saved, cleared by
+mark_needscanning() and by a fold), sccache_save() writes the scancache to
+~/.bluefish/cache/<md5 of the uri>.sccache: all Tfound, Tfoundblock
+(including the folded state) and Tfoundcontext, the highlighting that was applied (for each
+tag in Tscancache.appliedtags the name and the ranges), and the identifiers of this document. The file starts with a key: the bluefish version, the uri, the number of
+characters and the md5 of the text, and the scantable key (see stcache_key()) of the language.
+
+When the scanner runs for the first time on a document that needs scanning from start to
+end, sccache_restore() checks if there is a file with exactly the same key. If so the
+scancache, the highlighting and the folds are restored and the scanning region is marked
+done, so the document does not have to be scanned at all.
+
+Like the scantable cache the file does not contain pointers, the blocks and contexts refer
+to each other and are referred to by their index + 1 (0 means NULL), and a parent is always
+stored before its children. The identifiers are the ones that this document added (see
+Tidentdoc in bftextview2_identifier.h), for jump and for autocompletion.
+
+sccache_save() only takes a snapshot in the mainloop: the scancache, the tag runs and the
+identifiers are serialized and the text is copied. sccache_save_thread() computes the md5 of the
+text, writes the file and, once per session, prunes the cache directory: files that were not
+written or restored for SCCACHE_MAX_AGE days are removed, and the oldest ones if the total is
+more than SCCACHE_MAX_TOTAL.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_sccache.h"
+#include "bftextview2_foundcache.h"
+#include "bftextview2_arena.h"
+#include "bftextview2_markregion.h"
+#include "bftextview2_langmgr.h"
+#include "bftextview2_identifier.h"
+
+/*#define DBG_SCCACHE g_print*/
+#define DBG_SCCACHE(args...)
+
+#define SCCACHE_MAGIC "BFSCCACH"
+#define SCCACHE_VERSION 1
+#define SCCACHE_BYTEORDER 0x01020304
+#define SCCACHE_MAX_AGE 30			/* days, cache files that were not written or used for this long are removed */
+#define SCCACHE_MAX_TOTAL (64 * 1024 * 1024)	/* bytes, the oldest cache files are removed above this size */
+
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 byteorder;
+	guint32 filelen;
+	guint32 keylen;				/* the key follows directly after the header */
+	guint32 numchars;
+	guint32 numfound;
+	guint32 numfblock;
+	guint32 numfcontext;
+	guint32 numtagrun;
+	guint32 numidentifier;
+	guint32 found_o;
+	guint32 fblock_o;
+	guint32 fcontext_o;
+	guint32 tagrun_o;
+	guint32 identifier_o;
+	guint32 strings_o;
+} Tscc_header;
+
+typedef struct {
+	guint32 charoffset_o;
+	guint32 fblock;				/* index + 1 in the fblock array, or 0 */
+	guint32 fcontext;			/* index + 1 in the fcontext array, or 0 */
+	gint16 numblockchange;
+	gint8 numcontextchange;
+	guint8 padding;
+} Tscc_found;
+
+typedef struct {
+	guint32 parentfblock;		/* index + 1 of an earlier fblock, or 0 */
+	guint32 start1_o;
+	guint32 end1_o;
+	guint32 start2_o;
+	guint32 end2_o;
+	gint16 patternum;
+	guint8 folded;
+	guint8 foldable;
+} Tscc_fblock;
+
+typedef struct {
+	guint32 parentfcontext;		/* index + 1 of an earlier fcontext, or 0 */
+	guint32 start_o;
+	guint32 end_o;
+	gint16 context;
+	guint16 padding;
+} Tscc_fcontext;
+
+typedef struct {
+	guint32 tag;				/* string offset of the tag name */
+	guint32 start_o;
+	guint32 end_o;
+} Tscc_tagrun;
+
+typedef struct {
+	guint32 name;				/* string offset */
+	guint32 line;
+	gint16 context;
+	guint8 identaction;
+	guint8 padding;
+} Tscc_identifier;
+
+static gchar *
+sccache_filename(const gchar * uri)
+{
+	gchar *md5, *filename;
+	md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri, -1);
+	filename = g_strconcat(g_get_home_dir(), "/." PACKAGE "/cache/", md5, ".sccache", NULL);
+	g_free(md5);
+	return filename;
+}
+
+/* does not use the BluefishTextView, so it can be called from the save thread */
+static gchar *
+sccache_key_for_text(const gchar * text, const gchar * uri, guint numchars, const gchar * stkey)
+{
+	gchar *md5, *key;
+	md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, text, -1);
+	key = g_strdup_printf("%s\n%s\n%u\n%s\n%s", VERSION, uri, numchars, md5, stkey);
+	g_free(md5);
+	return key;
+}
+
+static gchar *
+sccache_key(BluefishTextView * btv, const gchar * uri, guint numchars)
+{
+	GtkTextIter start, end;
+	gchar *text, *stkey, *key;
+
+	gtk_text_buffer_get_bounds(btv->buffer, &start, &end);
+	text = gtk_text_buffer_get_text(btv->buffer, &start, &end, TRUE);
+	stkey = langmgr_scantable_key(btv->bflang);
+	key = sccache_key_for_text(text, uri, numchars, stkey);
+	g_free(text);
+	g_free(stkey);
+	return key;
+}
+
+/* the scancache is only worth saving (and only valid) if the document is completely scanned */
+static gboolean
+scancache_complete(BluefishTextView * btv)
+{
+	guint start, end;
+	if (btv != btv->master || !btv->bflang || !btv->bflang->st || !btv->doc || !DOCUMENT(btv->doc)->uri)
+		return FALSE;
+	if (gtk_text_buffer_get_char_count(btv->buffer) < SCCACHE_MIN_CHARS)
+		return FALSE;
+#ifdef THREADED_SCANNING
+	if (btv->scanjob)
+		return FALSE;
+#endif
+	if (btv->viewscan_start_o != BF_OFFSET_UNDEFINED || btv->largefile)
+		return FALSE;
+	return (markregion_get_region(&btv->scanning, NULL, &start, &end) == NULL);
+}
+
+/****************************** saving ******************************/
+
+typedef struct {
+	BluefishTextView *btv;
+	GString *found;
+	GString *fblock;
+	GString *fcontext;
+	GString *tagrun;
+	GString *identifier;
+	GString *strings;
+	GHashTable *fblockidx;		/* Tfoundblock pointer -> index + 1 */
+	GHashTable *fcontextidx;	/* Tfoundcontext pointer -> index + 1 */
+	guint numfblock;
+	guint numfcontext;
+} Tscc_writer;
+
+/* a snapshot of everything that is written, the save thread never touches the BluefishTextView */
+typedef struct {
+	Tscc_writer scw;
+	Tscc_header header;
+	gchar *text;				/* a copy of the buffer, the md5 for the key is computed in the thread */
+	gchar *uri;
+	gchar *stkey;
+	gboolean prune;				/* also run sccache_prune() after writing */
+} Tscc_savejob;
+
+static guint32
+scc_string(Tscc_writer * scw, const gchar * string)
+{
+	guint32 offset = scw->strings->len;
+	g_string_append_len(scw->strings, string, strlen(string) + 1);
+	return offset;
+}
+
+static guint32
+scc_fblock(Tscc_writer * scw, Tfoundblock * fblock)
+{
+	Tscc_fblock sfb;
+	gpointer idx;
+	if (!fblock)
+		return 0;
+	idx = g_hash_table_lookup(scw->fblockidx, fblock);
+	if (idx)
+		return GPOINTER_TO_UINT(idx);
+	/* the parent is written first, so on loading it always exists already */
+	sfb.parentfblock = scc_fblock(scw, fblock_parent(scw->btv, fblock));
+	sfb.start1_o = fblock->start1_o;
+	sfb.end1_o = fblock->end1_o;
+	sfb.start2_o = fblock->start2_o;
+	sfb.end2_o = fblock->end2_o;
+	sfb.patternum = fblock->patternum;
+	sfb.folded = fblock->folded;
+	sfb.foldable = fblock->foldable;
+	g_string_append_len(scw->fblock, (gchar *) & sfb, sizeof(Tscc_fblock));
+	scw->numfblock++;
+	g_hash_table_insert(scw->fblockidx, fblock, GUINT_TO_POINTER(scw->numfblock));
+	return scw->numfblock;
+}
+
+static guint32
+scc_fcontext(Tscc_writer * scw, Tfoundcontext * fcontext)
+{
+	Tscc_fcontext sfc;
+	gpointer idx;
+	if (!fcontext)
+		return 0;
+	idx = g_hash_table_lookup(scw->fcontextidx, fcontext);
+	if (idx)
+		return GPOINTER_TO_UINT(idx);
+	sfc.parentfcontext = scc_fcontext(scw, fcontext_parent(scw->btv, fcontext));
+	sfc.start_o = fcontext->start_o;
+	sfc.end_o = fcontext->end_o;
+	sfc.context = fcontext->context;
+	sfc.padding = 0;
+	g_string_append_len(scw->fcontext, (gchar *) & sfc, sizeof(Tscc_fcontext));
+	scw->numfcontext++;
+	g_hash_table_insert(scw->fcontextidx, fcontext, GUINT_TO_POINTER(scw->numfcontext));
+	return scw->numfcontext;
+}
+
+static void
+scc_tagruns(Tscc_writer * scw, GtkTextTag * tag)
+{
+	GtkTextIter iter;
+	gchar *name = NULL;
+	guint32 nameoffset;
+
+	g_object_get(tag, "name", &name, NULL);
+	if (!name)
+		return;
+	nameoffset = scc_string(scw, name);
+	g_free(name);
+	gtk_text_buffer_get_start_iter(scw->btv->buffer, &iter);
+	while (gtk_text_iter_begins_tag(&iter, tag) || gtk_text_iter_forward_to_tag_toggle(&iter, tag)) {
+		Tscc_tagrun run;
+		run.tag = nameoffset;
+		run.start_o = gtk_text_iter_get_offset(&iter);
+		gtk_text_iter_forward_to_tag_toggle(&iter, tag);
+		run.end_o = gtk_text_iter_get_offset(&iter);
+		g_string_append_len(scw->tagrun, (gchar *) & run, sizeof(Tscc_tagrun));
+	}
+}
+
+#ifdef IDENTSTORING
+static void
+scc_identifier(Tscc_writer * scw, Tidentname * in, guint line, guint8 identaction)
+{
+	Tscc_identifier sid;
+	sid.name = scc_string(scw, in->name);
+	sid.line = line;
+	sid.context = in->set->key.context;
+	sid.identaction = identaction;
+	sid.padding = 0;
+	g_string_append_len(scw->identifier, (gchar *) & sid, sizeof(Tscc_identifier));
+}
+
+static void
+scc_identifiers(Tscc_writer * scw)
+{
+	BluefishTextView *btv = scw->btv;
+	Tidentdoc *idoc = identifier_doc_get(btv);
+	GHashTable *written;
+	GHashTableIter iter;
+	gpointer key;
+	guint i;
+
+	if (!idoc)
+		return;
+	/* the names that this document added for jump, with the autocompletion flag if it holds them
+	   for autocompletion as well, and then the names that it holds for autocompletion only */
+	written = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < idoc->jumpnames->len; i++) {
+		Tidentname *in = g_ptr_array_index(idoc->jumpnames, i);
+		Tjumpkey ijk;
+		Tjumpdata *ijd;
+		if (in->set->key.bflang != btv->bflang)
+			continue;
+		ijk.bflang = in->set->key.bflang;
+		ijk.context = in->set->key.context;
+		ijk.name = in->name;
+		ijd = g_hash_table_lookup(BFWIN(DOCUMENT(btv->doc)->bfwin)->identifier_jump, &ijk);
+		scc_identifier(scw, in, ijd ? ijd->line : 0, g_hash_table_lookup(idoc->acnames, in) ? 3 : 1);
+		g_hash_table_insert(written, in, in);
+	}
+	g_hash_table_iter_init(&iter, idoc->acnames);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		Tidentname *in = key;
+		if (in->set->key.bflang != btv->bflang)
+			continue;
+		if (!g_hash_table_lookup(written, in))
+			scc_identifier(scw, in, 0, 2);
+	}
+	g_hash_table_destroy(written);
+}
+#endif							/* IDENTSTORING */
+
+static void
+scc_align(GString * out)
+{
+	while (out->len % 4)
+		g_string_append_c(out, '\0');
+}
+
+typedef struct {
+	gchar *path;
+	glong mtime;
+	goffset size;
+} Tscc_cachefile;
+
+static gint
+scc_cachefile_newest_first(gconstpointer a, gconstpointer b)
+{
+	return ((const Tscc_cachefile *) b)->mtime - ((const Tscc_cachefile *) a)->mtime;
+}
+
+/* removes the cache files that were not written or used for SCCACHE_MAX_AGE days, and the
+oldest ones if all of them together are larger than SCCACHE_MAX_TOTAL */
+static void
+sccache_prune(void)
+{
+	struct stat statbuf;
+	gchar *dirname;
+	GDir *gdir;
+	GArray *files;
+	const gchar *name;
+	glong now = time(NULL);
+	goffset total = 0;
+	guint i;
+
+	dirname = g_strconcat(g_get_home_dir(), "/." PACKAGE "/cache", NULL);
+	gdir = g_dir_open(dirname, 0, NULL);
+	if (!gdir) {
+		g_free(dirname);
+		return;
+	}
+	files = g_array_new(FALSE, FALSE, sizeof(Tscc_cachefile));
+	while ((name = g_dir_read_name(gdir))) {
+		Tscc_cachefile cf;
+		if (!g_str_has_suffix(name, ".sccache"))
+			continue;
+		cf.path = g_build_filename(dirname, name, NULL);
+		if (g_stat(cf.path, &statbuf) != 0) {
+			g_free(cf.path);
+			continue;
+		}
+		if (now - statbuf.st_mtime > SCCACHE_MAX_AGE * 24 * 3600) {
+			DBG_SCCACHE("sccache_prune, remove outdated %s\n", cf.path);
+			g_unlink(cf.path);
+			g_free(cf.path);
+			continue;
+		}
+		cf.mtime = statbuf.st_mtime;
+		cf.size = statbuf.st_size;
+		g_array_append_val(files, cf);
+	}
+	g_dir_close(gdir);
+	g_array_sort(files, scc_cachefile_newest_first);
+	for (i = 0; i < files->len; i++) {
+		Tscc_cachefile *cf = &g_array_index(files, Tscc_cachefile, i);
+		total += cf->size;
+		if (total > SCCACHE_MAX_TOTAL) {
+			DBG_SCCACHE("sccache_prune, cache is larger than %d bytes, remove %s\n", SCCACHE_MAX_TOTAL, cf->path);
+			g_unlink(cf->path);
+		}
+		g_free(cf->path);
+	}
+	g_array_free(files, TRUE);
+	g_free(dirname);
+}
+
+static void
+scc_savejob_free(Tscc_savejob * job)
+{
+	if (job->scw.fblockidx)
+		g_hash_table_destroy(job->scw.fblockidx);
+	if (job->scw.fcontextidx)
+		g_hash_table_destroy(job->scw.fcontextidx);
+	g_string_free(job->scw.found, TRUE);
+	g_string_free(job->scw.fblock, TRUE);
+	g_string_free(job->scw.fcontext, TRUE);
+	g_string_free(job->scw.tagrun, TRUE);
+	g_string_free(job->scw.identifier, TRUE);
+	g_string_free(job->scw.strings, TRUE);
+	g_free(job->text);
+	g_free(job->uri);
+	g_free(job->stkey);
+	g_slice_free(Tscc_savejob, job);
+}
+
+static gpointer
+sccache_save_thread(gpointer data)
+{
+	Tscc_savejob *job = data;
+	Tscc_writer *scw = &job->scw;
+	Tscc_header *header = &job->header;
+	GString *out;
+	gchar *key, *filename, *dirname;
+	GError *gerror = NULL;
+
+	key = sccache_key_for_text(job->text, job->uri, header->numchars, job->stkey);
+	g_free(job->text);
+	job->text = NULL;
+	header->keylen = strlen(key);
+
+	out = g_string_sized_new(sizeof(Tscc_header) + header->keylen + 4 + scw->found->len + scw->fblock->len
+							 + scw->fcontext->len + scw->tagrun->len + scw->identifier->len + scw->strings->len);
+	g_string_append_len(out, (gchar *) header, sizeof(Tscc_header));
+	g_string_append_len(out, key, header->keylen);
+	scc_align(out);
+	header->found_o = out->len;
+	g_string_append_len(out, scw->found->str, scw->found->len);
+	header->fblock_o = out->len;
+	g_string_append_len(out, scw->fblock->str, scw->fblock->len);
+	header->fcontext_o = out->len;
+	g_string_append_len(out, scw->fcontext->str, scw->fcontext->len);
+	header->tagrun_o = out->len;
+	g_string_append_len(out, scw->tagrun->str, scw->tagrun->len);
+	header->identifier_o = out->len;
+	g_string_append_len(out, scw->identifier->str, scw->identifier->len);
+	header->strings_o = out->len;
+	g_string_append_len(out, scw->strings->str, scw->strings->len);
+	header->filelen = out->len;
+	memcpy(out->str, header, sizeof(Tscc_header));
+
+	filename = sccache_filename(job->uri);
+	dirname = g_path_get_dirname(filename);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+	/* g_file_set_contents() writes a temporary file and renames it, so if bluefish quits before
+	   this thread is finished there is no new cache file, never a half written one */
+	if (!g_file_set_contents(filename, out->str, out->len, &gerror)) {
+		g_warning("failed to write scancache %s: %s\n", filename, gerror->message);
+		g_error_free(gerror);
+	} else {
+		DBG_SCCACHE("sccache_save_thread, wrote %d found, %d blocks, %d contexts and %d tag runs for %s to %s\n",
+					header->numfound, header->numfblock, header->numfcontext, header->numtagrun, job->uri,
+					filename);
+	}
+	g_free(filename);
+	g_free(key);
+	g_string_free(out, TRUE);
+	if (job->prune)
+		sccache_prune();
+	scc_savejob_free(job);
+	return NULL;
+}
+
+/* takes a snapshot of the scancache, the highlighting and the text in the mainloop (the
+GtkTextBuffer can only be used from the mainloop), the md5 for the key is computed and the
+file is written by sccache_save_thread() */
+void
+sccache_save(BluefishTextView * btv)
+{
+	static gboolean pruned = FALSE;
+	Tscc_savejob *job;
+	Tscc_writer *scw;
+	Tscc_header *header;
+	GHashTableIter hiter;
+	GtkTextIter start, end;
+	gpointer tag;
+	Tfound *found;
+	GError *gerror = NULL;
+
+	if (!scancache_complete(btv)) {
+		DBG_SCCACHE("sccache_save, scancache of %p is not complete, not saved\n", btv);
+		return;
+	}
+	if (btv->sccache_saved) {
+		DBG_SCCACHE("sccache_save, scancache of %p did not change since it was saved or restored\n", btv);
+		return;
+	}
+	job = g_slice_new0(Tscc_savejob);
+	scw = &job->scw;
+	header = &job->header;
+	scw->btv = btv;
+	scw->found = g_string_sized_new(foundcache_length(btv->scancache.foundcaches) * sizeof(Tscc_found));
+	scw->fblock = g_string_new(NULL);
+	scw->fcontext = g_string_new(NULL);
+	scw->tagrun = g_string_new(NULL);
+	scw->identifier = g_string_new(NULL);
+	scw->strings = g_string_new(NULL);
+	scw->fblockidx = g_hash_table_new(g_direct_hash, g_direct_equal);
+	scw->fcontextidx = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	memcpy(header->magic, SCCACHE_MAGIC, 8);
+	header->version = SCCACHE_VERSION;
+	header->byteorder = SCCACHE_BYTEORDER;
+	header->numchars = gtk_text_buffer_get_char_count(btv->buffer);
+
+	for (found = foundcache_first(btv->scancache.foundcaches); found;
+		 found = foundcache_next(btv->scancache.foundcaches, found)) {
+		Tscc_found sf;
+		sf.charoffset_o = found->charoffset_o;
+		sf.fblock = scc_fblock(scw, found_fblock(btv, found));
+		sf.fcontext = scc_fcontext(scw, found_fcontext(btv, found));
+		sf.numblockchange = found->numblockchange;
+		sf.numcontextchange = found->numcontextchange;
+		sf.padding = 0;
+		g_string_append_len(scw->found, (gchar *) & sf, sizeof(Tscc_found));
+		header->numfound++;
+	}
+	g_hash_table_iter_init(&hiter, btv->scancache.appliedtags);
+	while (g_hash_table_iter_next(&hiter, &tag, NULL)) {
+		scc_tagruns(scw, tag);
+	}
+#ifdef IDENTSTORING
+	scc_identifiers(scw);
+#endif
+	header->numfblock = scw->numfblock;
+	header->numfcontext = scw->numfcontext;
+	header->numtagrun = scw->tagrun->len / sizeof(Tscc_tagrun);
+	header->numidentifier = scw->identifier->len / sizeof(Tscc_identifier);
+	g_hash_table_destroy(scw->fblockidx);
+	g_hash_table_destroy(scw->fcontextidx);
+	scw->fblockidx = scw->fcontextidx = NULL;
+	scw->btv = NULL;
+
+	job->uri = g_file_get_uri(DOCUMENT(btv->doc)->uri);
+	job->stkey = langmgr_scantable_key(btv->bflang);
+	gtk_text_buffer_get_bounds(btv->buffer, &start, &end);
+	job->text = gtk_text_buffer_get_text(btv->buffer, &start, &end, TRUE);
+	/* the cache directory is pruned once per session, after the first save */
+	job->prune = !pruned;
+	pruned = TRUE;
+
+	g_thread_create(sccache_save_thread, job, FALSE, &gerror);
+	if (gerror) {
+		g_warning("failed to start scancache save thread: %s\n", gerror->message);
+		g_error_free(gerror);
+		scc_savejob_free(job);
+		return;
+	}
+	btv->sccache_saved = TRUE;
+}
+
+/****************************** restoring ******************************/
+
+typedef struct {
+	const gchar *data;
+	gsize len;
+	const Tscc_header *header;
+	const Tscc_found *found;
+	const Tscc_fblock *fblock;
+	const Tscc_fcontext *fcontext;
+	const Tscc_tagrun *tagrun;
+	const Tscc_identifier *identifier;
+} Tscc_reader;
+
+static gconstpointer
+scc_data(Tscc_reader * scr, guint32 offset, guint32 num, gsize size)
+{
+	if (offset > scr->len || num > (scr->len - offset) / size)
+		return NULL;
+	return scr->data + offset;
+}
+
+static const gchar *
+scc_get_string(Tscc_reader * scr, guint32 offset)
+{
+	if (offset >= scr->len - scr->header->strings_o)
+		return NULL;
+	return scr->data + scr->header->strings_o + offset;
+}
+
+/* checks every index and offset in the file before anything is restored, so a corrupt
+file can never result in an invalid scancache */
+static gboolean
+scc_validate(Tscc_reader * scr, Tscantable * st)
+{
+	const Tscc_header *h = scr->header;
+	guint i, prev_o = 0;
+
+	scr->found = scc_data(scr, h->found_o, h->numfound, sizeof(Tscc_found));
+	scr->fblock = scc_data(scr, h->fblock_o, h->numfblock, sizeof(Tscc_fblock));
+	scr->fcontext = scc_data(scr, h->fcontext_o, h->numfcontext, sizeof(Tscc_fcontext));
+	scr->tagrun = scc_data(scr, h->tagrun_o, h->numtagrun, sizeof(Tscc_tagrun));
+	scr->identifier = scc_data(scr, h->identifier_o, h->numidentifier, sizeof(Tscc_identifier));
+	if (!scr->found || !scr->fblock || !scr->fcontext || !scr->tagrun || !scr->identifier
+		|| h->strings_o > scr->len || (h->strings_o < scr->len && scr->data[scr->len - 1] != '\0'))
+		return FALSE;
+	for (i = 0; i < h->numfblock; i++) {
+		if (scr->fblock[i].parentfblock > i || scr->fblock[i].patternum <= 0
+			|| (guint) scr->fblock[i].patternum >= st->matches->len || scr->fblock[i].start1_o > h->numchars)
+			return FALSE;
+	}
+	for (i = 0; i < h->numfcontext; i++) {
+		if (scr->fcontext[i].parentfcontext > i || scr->fcontext[i].context <= 0
+			|| (guint) scr->fcontext[i].context >= st->contexts->len || scr->fcontext[i].start_o > h->numchars)
+			return FALSE;
+	}
+	for (i = 0; i < h->numfound; i++) {
+		const Tscc_found *sf = &scr->found[i];
+		if (sf->charoffset_o < prev_o || sf->charoffset_o > h->numchars
+			|| sf->fblock > h->numfblock || sf->fcontext > h->numfcontext
+			|| (sf->numblockchange != 0 && sf->fblock == 0) || (sf->numcontextchange != 0 && sf->fcontext == 0))
+			return FALSE;
+		prev_o = sf->charoffset_o;
+	}
+	for (i = 0; i < h->numtagrun; i++) {
+		if (!scc_get_string(scr, scr->tagrun[i].tag) || scr->tagrun[i].start_o > scr->tagrun[i].end_o
+			|| scr->tagrun[i].end_o > h->numchars)
+			return FALSE;
+	}
+	for (i = 0; i < h->numidentifier; i++) {
+		if (!scc_get_string(scr, scr->identifier[i].name) || scr->identifier[i].context <= 0
+			|| (guint) scr->identifier[i].context >= st->contexts->len)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+scc_restore_tagruns(Tscc_reader * scr, BluefishTextView * btv)
+{
+	GtkTextTagTable *tagtable = gtk_text_buffer_get_tag_table(btv->buffer);
+	GtkTextTag *tag = NULL;
+	guint32 tagname = G_MAXUINT32;
+	guint i;
+	for (i = 0; i < scr->header->numtagrun; i++) {
+		const Tscc_tagrun *run = &scr->tagrun[i];
+		GtkTextIter it1, it2;
+		if (run->tag != tagname) {
+			/* the runs of a tag are stored together */
+			tagname = run->tag;
+			tag = gtk_text_tag_table_lookup(tagtable, scc_get_string(scr, tagname));
+			if (tag && !g_hash_table_lookup(btv->scancache.appliedtags, tag))
+				g_hash_table_insert(btv->scancache.appliedtags, tag, tag);
+		}
+		if (!tag)
+			continue;
+		gtk_text_buffer_get_iter_at_offset(btv->buffer, &it1, run->start_o);
+		gtk_text_buffer_get_iter_at_offset(btv->buffer, &it2, run->end_o);
+		gtk_text_buffer_apply_tag(btv->buffer, tag, &it1, &it2);
+	}
+}
+
+gboolean
+sccache_restore(BluefishTextView * btv)
+{
+	GMappedFile *mapped;
+	Tscc_reader scr;
+	guint32 *fblocks;
+	guint32 *fcontexts;
+	gchar *uri, *filename, *key;
+	guint i, numchars, start, end;
+
+	if (btv != btv->master || !btv->bflang || !btv->bflang->st || !btv->doc || !DOCUMENT(btv->doc)->uri
+		|| foundcache_length(btv->scancache.foundcaches) != 0)
+		return FALSE;
+	numchars = gtk_text_buffer_get_char_count(btv->buffer);
+	if (numchars < SCCACHE_MIN_CHARS)
+		return FALSE;
+	/* only restore if the complete document still has to be scanned */
+	if (!markregion_get_region(&btv->scanning, NULL, &start, &end) || start != 0 || end < numchars)
+		return FALSE;
+#ifdef THREADED_SCANNING
+	if (btv->scanjob)
+		return FALSE;
+#endif
+
+	uri = g_file_get_uri(DOCUMENT(btv->doc)->uri);
+	filename = sccache_filename(uri);
+	mapped = g_mapped_file_new(filename, FALSE, NULL);
+	if (!mapped) {
+		DBG_SCCACHE("sccache_restore, no cache %s for %s\n", filename, uri);
+		g_free(filename);
+		g_free(uri);
+		return FALSE;
+	}
+	scr.data = g_mapped_file_get_contents(mapped);
+	scr.len = g_mapped_file_get_length(mapped);
+	scr.header = (const Tscc_header *) scr.data;
+	key = sccache_key(btv, uri, numchars);
+	if (scr.len < sizeof(Tscc_header)
+		|| memcmp(scr.header->magic, SCCACHE_MAGIC, 8) != 0
+		|| scr.header->version != SCCACHE_VERSION
+		|| scr.header->byteorder != SCCACHE_BYTEORDER
+		|| scr.header->filelen != scr.len
+		|| scr.header->numchars != numchars
+		|| scr.header->keylen != strlen(key)
+		|| scr.header->keylen > scr.len - sizeof(Tscc_header)
+		|| memcmp(scr.data + sizeof(Tscc_header), key, scr.header->keylen) != 0
+		|| !scc_validate(&scr, btv->bflang->st)) {
+		DBG_SCCACHE("sccache_restore, cache %s is outdated or invalid\n", filename);
+		g_free(key);
+		g_free(filename);
+		g_free(uri);
+		g_mapped_file_unref(mapped);
+		return FALSE;
+	}
+	g_free(key);
+	/* the modification time is the last use, see sccache_prune() */
+	g_utime(filename, NULL);
+
+	fblocks = g_new(guint32, scr.header->numfblock + 1);
+	fblocks[0] = 0;
+	for (i = 0; i < scr.header->numfblock; i++) {
+		const Tscc_fblock *sfb = &scr.fblock[i];
+		Tfoundblock *fblock = arenapool_alloc(&SCANARENA(btv)->fblock);
+		fblock->parentfblock = fblocks[sfb->parentfblock];
+		fblock->start1_o = sfb->start1_o;
+		fblock->end1_o = sfb->end1_o;
+		fblock->start2_o = sfb->start2_o;
+		fblock->end2_o = sfb->end2_o;
+		fblock->patternum = sfb->patternum;
+		fblock->folded = sfb->folded;
+		fblock->foldable = sfb->foldable;
+		fblocks[i + 1] = fblock_handle(btv, fblock);
+	}
+	fcontexts = g_new(guint32, scr.header->numfcontext + 1);
+	fcontexts[0] = 0;
+	for (i = 0; i < scr.header->numfcontext; i++) {
+		const Tscc_fcontext *sfc = &scr.fcontext[i];
+		Tfoundcontext *fcontext = arenapool_alloc(&SCANARENA(btv)->fcontext);
+		fcontext->parentfcontext = fcontexts[sfc->parentfcontext];
+		fcontext->start_o = sfc->start_o;
+		fcontext->end_o = sfc->end_o;
+		fcontext->context = sfc->context;
+		fcontexts[i + 1] = fcontext_handle(btv, fcontext);
+	}
+	for (i = 0; i < scr.header->numfound; i++) {
+		const Tscc_found *sf = &scr.found[i];
+		Tfound *found = arenapool_alloc(&SCANARENA(btv)->found);
+		found->charoffset_o = sf->charoffset_o;
+		found->fblock = fblocks[sf->fblock];
+		found->fcontext = fcontexts[sf->fcontext];
+		found->numblockchange = sf->numblockchange;
+		found->numcontextchange = sf->numcontextchange;
+		foundcache_insert(btv->scancache.foundcaches, found);
+	}
+	g_free(fblocks);
+	g_free(fcontexts);
+
+	scc_restore_tagruns(&scr, btv);
+#ifdef IDENTSTORING
+	for (i = 0; i < scr.header->numidentifier; i++) {
+		identifier_restore(btv, scc_get_string(&scr, scr.identifier[i].name), scr.identifier[i].line,
+						   scr.identifier[i].context, scr.identifier[i].identaction);
+	}
+#endif
+	/* the highlighting is complete, nothing has to be removed or scanned anymore */
+	btv->needremovetags = numchars;
+	markregion_region_done(&btv->scanning, BF_POSITION_UNDEFINED);
+	bftextview2_apply_folded_blocks(btv);
+	btv->sccache_saved = TRUE;
+	DBG_SCCACHE("sccache_restore, restored %d found and %d tag runs from %s\n", scr.header->numfound,
+				scr.header->numtagrun, filename);
+	g_free(filename);
+	g_free(uri);
+	g_mapped_file_unref(mapped);
+	gtk_widget_queue_draw(GTK_WIDGET(btv));
+	if (btv->slave)
+		gtk_widget_queue_draw(GTK_WIDGET(btv->slave));
+	return TRUE;
+}
@@ -0,0 +1,179 @@
+/* Bluefish HTML Editor
+ * bftextview2_scheduler.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+one scheduler for the scanning and spellchecking of all documents:
+
+every master BluefishTextView that has work is in a single queue. There is one idle function
+for the whole process. Every time it runs (a frame) it picks the view with the highest class
+from the queue, runs one scanning run for it, and moves it to the end of the queue, so views of
+the same class take turns. This repeats until SCHEDULER_FRAME_BUDGET is used, then we return
+to the mainloop so gtk can handle events and redraw.
+
+the classes are: the current document of the active window, other visible views (other windows
+and split views), and all other documents.
+
+after a change the idle function runs once with SCANNING_IDLE_PRIORITY so the change is
+highlighted before it is drawn, after that it continues with SCANNING_IDLE_AFTER_TIMEOUT_PRIORITY.
+*/
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_scheduler.h"
+
+typedef enum {
+	schedclass_active,
+	schedclass_visible,
+	schedclass_background
+} Tschedclass;
+
+typedef struct {
+	GQueue queue;				/* master BluefishTextView's that need scanning or spellchecking */
+	guint idle_id;
+	gboolean immediate;			/* the idle function runs with SCANNING_IDLE_PRIORITY */
+	GTimer *timer;
+} Tscheduler;
+
+static Tscheduler sched = { G_QUEUE_INIT, 0, FALSE, NULL };
+
+static gboolean scheduler_idle(gpointer data);
+
+static Tschedclass
+scheduler_class(BluefishTextView * master)
+{
+	if (master->doc && DOCUMENT(master->doc)->bfwin) {
+		Tbfwin *bfwin = BFWIN(DOCUMENT(master->doc)->bfwin);
+		if (bfwin->current_document == master->doc && bfwin->main_window
+			&& gtk_window_is_active(GTK_WINDOW(bfwin->main_window)))
+			return schedclass_active;
+	}
+	if (gtk_widget_get_mapped(GTK_WIDGET(master))
+		|| (master->slave && gtk_widget_get_mapped(GTK_WIDGET(master->slave))))
+		return schedclass_visible;
+	return schedclass_background;
+}
+
+static GList *
+scheduler_pick(void)
+{
+	GList *tmplist, *best = NULL;
+	Tschedclass bestclass = schedclass_background + 1;
+	for (tmplist = sched.queue.head; tmplist; tmplist = tmplist->next) {
+		Tschedclass class = scheduler_class(BLUEFISH_TEXT_VIEW(tmplist->data));
+		if (class < bestclass) {
+			best = tmplist;
+			bestclass = class;
+			if (class == schedclass_active)
+				break;
+		}
+	}
+	return best;
+}
+
+static void
+scheduler_start(gboolean immediate)
+{
+	sched.immediate = immediate;
+	sched.idle_id = g_idle_add_full(immediate ? SCANNING_IDLE_PRIORITY : SCANNING_IDLE_AFTER_TIMEOUT_PRIORITY,
+									scheduler_idle, NULL, NULL);
+}
+
+static gboolean
+scheduler_idle(gpointer data)
+{
+	GList *link;
+	if (!sched.timer)
+		sched.timer = g_timer_new();
+	else
+		g_timer_start(sched.timer);
+	while ((link = scheduler_pick())) {
+		BluefishTextView *master = link->data;
+		gdouble start = g_timer_elapsed(sched.timer, NULL);
+		gboolean again = bftextview2_scanner_scan(master);
+		master->schedtime += g_timer_elapsed(sched.timer, NULL) - start;
+		DBG_SCHEDULER("scheduler_idle, run for %p took %f, again=%d, queue length %d\n", master,
+					  g_timer_elapsed(sched.timer, NULL) - start, again, g_queue_get_length(&sched.queue));
+		/* the scanning run might have removed master from the queue, for example when the
+		   language was changed */
+		if (master->schedlink) {
+			g_queue_unlink(&sched.queue, master->schedlink);
+			if (again) {
+				g_queue_push_tail_link(&sched.queue, master->schedlink);
+			} else {
+				g_list_free_1(master->schedlink);
+				master->schedlink = NULL;
+			}
+		}
+		if (g_timer_elapsed(sched.timer, NULL) >= SCHEDULER_FRAME_BUDGET)
+			break;
+	}
+	if (g_queue_is_empty(&sched.queue)) {
+		DBG_SCHEDULER("scheduler_idle, queue is empty, stop\n");
+		sched.idle_id = 0;
+		return FALSE;
+	}
+	if (sched.immediate) {
+		scheduler_start(FALSE);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void
+bftextview2_scheduler_add(BluefishTextView * master, gboolean immediate)
+{
+	if (!master->schedlink) {
+		g_queue_push_tail(&sched.queue, master);
+		master->schedlink = sched.queue.tail;
+	}
+	if (sched.idle_id && immediate && !sched.immediate) {
+		g_source_remove(sched.idle_id);
+		sched.idle_id = 0;
+	}
+	if (!sched.idle_id)
+		scheduler_start(immediate);
+	DBG_SCHEDULER("bftextview2_scheduler_add, %p, queue length %d\n", master, g_queue_get_length(&sched.queue));
+}
+
+void
+bftextview2_scheduler_remove(BluefishTextView * master)
+{
+	if (!master->schedlink)
+		return;
+	g_queue_delete_link(&sched.queue, master->schedlink);
+	master->schedlink = NULL;
+	if (g_queue_is_empty(&sched.queue) && sched.idle_id) {
+		g_source_remove(sched.idle_id);
+		sched.idle_id = 0;
+	}
+}
+
+guint
+bftextview2_scheduler_queue_length(void)
+{
+	return g_queue_get_length(&sched.queue);
+}
+
+/* the time in seconds that the scheduler spent on scanning and spellchecking this document */
+gdouble
+bftextview2_scheduler_time_spent(BluefishTextView * btv)
+{
+	return BLUEFISH_TEXT_VIEW(btv->master)->schedtime;
+}
@@ -0,0 +1,35 @@
+/* Bluefish HTML Editor
+ * bftextview2_scheduler.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_SCHEDULER_H_
+#define _BFTEXTVIEW2_SCHEDULER_H_
+
+#include "bftextview2.h"
+
+#define SCHEDULER_FRAME_BUDGET 0.1	/* float in seconds, no new scanning run is started after this time */
+
+void bftextview2_scheduler_add(BluefishTextView * master, gboolean immediate);
+void bftextview2_scheduler_remove(BluefishTextView * master);
+guint bftextview2_scheduler_queue_length(void);
+gdouble bftextview2_scheduler_time_spent(BluefishTextView * btv);
+
+#define bftextview2_scheduler_is_queued(master) ((master)->schedlink != NULL)
+
+#endif							/* _BFTEXTVIEW2_SCHEDULER_H_ */
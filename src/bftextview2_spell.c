@@ -31,6 +31,7 @@
 #include <string.h>				/*strlen */
 #include "bftextview2_private.h"
 #include "bftextview2_scanner.h"
+#include "bftextview2_arena.h"
 #include "bftextview2_langmgr.h"
 #include "bftextview2_spell.h"
 #ifdef MARKREGION
@@ -43,10 +44,116 @@
 #define DBG_SPELL g_print*/
 
 #define MAX_CONTINUOUS_SPELLCHECK_INTERVAL 0.1	/* float in seconds */
+#define SPELL_CACHE_MAX_WORDS 100000	/* the verdict cache of a dictionary is emptied when it grows beyond this */
+#ifdef THREADED_SCANNING
+#define SPELLTHREAD_MIN_CHARS 16384	/* regions smaller than this are checked in the mainloop */
+#define SPELLTHREAD_CHUNK_CHARS 65536	/* the number of characters that a worker checks in one job */
+#endif
 
 static EnchantBroker *eb;
 static guint loops_per_timer = 1000;
 
+typedef enum {
+	spell_unknown = 0,
+	spell_ok,
+	spell_misspelled
+} Tspellverdict;
+
+/* the verdicts for a dictionary, shared by all windows that use the dictionary. enchant
+dictionaries may not be used from two threads at the same time, so all calls to enchant_dict_*
+and all access to a Tspelldict are done with the spelldicts lock held */
+typedef struct {
+	EnchantDict *ed;			/* NULL once the last window released the dictionary */
+	GHashTable *verdicts;		/* word -> Tspellverdict */
+	gint users;					/* the number of windows that loaded this dictionary */
+	gint refcount;				/* users plus running jobs */
+} Tspelldict;
+
+G_LOCK_DEFINE_STATIC(spelldicts);
+static GHashTable *spelldicts;	/* EnchantDict -> Tspelldict */
+
+/* called with the spelldicts lock held */
+static void
+spelldict_unref(Tspelldict * sd)
+{
+	sd->refcount--;
+	if (sd->refcount == 0) {
+		g_hash_table_destroy(sd->verdicts);
+		g_slice_free(Tspelldict, sd);
+	}
+}
+
+/* called after every successful enchant_broker_request_dict() */
+static void
+spelldict_register(EnchantDict * ed)
+{
+	Tspelldict *sd;
+	G_LOCK(spelldicts);
+	sd = g_hash_table_lookup(spelldicts, ed);
+	if (!sd) {
+		sd = g_slice_new0(Tspelldict);
+		sd->ed = ed;
+		sd->verdicts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		g_hash_table_insert(spelldicts, ed, sd);
+	}
+	sd->users++;
+	sd->refcount++;
+	G_UNLOCK(spelldicts);
+}
+
+/* called with the spelldicts lock held, just before enchant_broker_free_dict() */
+static void
+spelldict_release(EnchantDict * ed)
+{
+	Tspelldict *sd = g_hash_table_lookup(spelldicts, ed);
+	if (!sd)
+		return;
+	sd->users--;
+	if (sd->users == 0) {
+		g_hash_table_remove(spelldicts, ed);
+		sd->ed = NULL;
+	}
+	spelldict_unref(sd);
+}
+
+static Tspelldict *
+spelldict_get(EnchantDict * ed)
+{
+	Tspelldict *sd;
+	G_LOCK(spelldicts);
+	sd = g_hash_table_lookup(spelldicts, ed);
+	G_UNLOCK(spelldicts);
+	return sd;
+}
+
+/* returns TRUE if word is spelled correctly, and remembers the verdict. A word with entities
+that is not in the dictionary is checked again after the entities are converted.
+called with the spelldicts lock held, from the mainloop or from a worker thread */
+static gboolean
+spelldict_check(Tspelldict * sd, const gchar * word)
+{
+	gpointer verdict;
+	gboolean ok;
+
+	if (!sd->ed)
+		return TRUE;
+	verdict = g_hash_table_lookup(sd->verdicts, word);
+	if (verdict)
+		return (GPOINTER_TO_INT(verdict) == spell_ok);
+
+	ok = (enchant_dict_check(sd->ed, word, strlen(word)) == 0);
+	if (!ok && strchr(word, '&')) {
+		gchar *word_conv = xmlentities2utf8(word);
+		ok = (!word_conv || enchant_dict_check(sd->ed, word_conv, strlen(word_conv)) == 0);
+		DBG_SPELL("'%s' after entity conversion (%s) spelled correctly=%d\n", word, word_conv, ok);
+		g_free(word_conv);
+	}
+	if (g_hash_table_size(sd->verdicts) >= SPELL_CACHE_MAX_WORDS)
+		g_hash_table_remove_all(sd->verdicts);
+	g_hash_table_insert(sd->verdicts, g_strdup(word), GINT_TO_POINTER(ok ? spell_ok : spell_misspelled));
+	return ok;
+}
+
 #ifdef MARKREGION
 static gboolean
 markregion_find_region2spellcheck(BluefishTextView * btv, GtkTextIter * sit, GtkTextIter * eit)
@@ -157,6 +264,7 @@ dicts_load_first_lcb(const char *const lang_tag, const char *const provider_name
 		bfwin->ed = (void *) enchant_broker_request_dict(eb, lang_tag);
 		DBG_SPELL("loaded first available dictionary %s at %p\n", lang_tag, bfwin->ed);
 		if (bfwin->ed) {
+			spelldict_register((EnchantDict *) bfwin->ed);
 			g_free(bfwin->session->spell_lang);
 			bfwin->session->spell_lang = g_strdup(lang_tag);
 		}
@@ -167,6 +275,8 @@ void
 unload_spell_dictionary(Tbfwin * bfwin)
 {
 	if (bfwin->ed) {
+		G_LOCK(spelldicts);
+		spelldict_release((EnchantDict *) bfwin->ed);
 #ifdef HAVE_LIBENCHANT_1_4
 		DBG_SPELL("unload_spell_dictionary, bfwin=%p, ed=%p\n", bfwin, bfwin->ed);
 		enchant_broker_free_dict(eb, (EnchantDict *) bfwin->ed);
@@ -187,6 +297,7 @@ unload_spell_dictionary(Tbfwin * bfwin)
 			enchant_broker_free_dict(eb, (EnchantDict *) bfwin->ed);
 		}
 #endif
+		G_UNLOCK(spelldicts);
 	}
 }
 
@@ -201,6 +312,8 @@ load_dictionary(Tbfwin * bfwin)
 				  bfwin->session->spell_lang);
 		bfwin->ed = (void *) enchant_broker_request_dict(eb, bfwin->session->spell_lang);
 		DBG_SPELL("loaded dictionary %s at %p\n", bfwin->session->spell_lang, bfwin->ed);
+		if (bfwin->ed)
+			spelldict_register((EnchantDict *) bfwin->ed);
 		return (bfwin->ed != NULL);
 	} else {
 		DBG_SPELL("load_dictionary, no setting, load first available\n");
@@ -212,37 +325,21 @@ load_dictionary(Tbfwin * bfwin)
 }
 
 static void
-spellcheck_word(BluefishTextView * btv, GtkTextBuffer * buffer, GtkTextIter * start, GtkTextIter * end)
+spellcheck_word(Tspelldict * sd, GtkTextBuffer * buffer, GtkTextIter * start, GtkTextIter * end)
 {
 	gchar *tocheck;
+	gboolean ok;
 
 	tocheck = gtk_text_buffer_get_text(buffer, start, end, FALSE);
 	if (!tocheck)
 		return;
 
-	DBG_SPELL("spellcheck_word, check word %s in dictionary %p\n", tocheck,
-			  BFWIN(DOCUMENT(btv->doc)->bfwin)->ed);
-	if (enchant_dict_check((EnchantDict *) BFWIN(DOCUMENT(btv->doc)->bfwin)->ed, tocheck, strlen(tocheck)) !=
-		0) {
-		DBG_SPELL("'%s' *not* spelled correctly!\n", tocheck);
-		if (g_utf8_strchr(tocheck, -1, '&')) {
-			gchar *tocheck_conv = xmlentities2utf8(tocheck);
-			/* check for entities */
-			if (tocheck_conv
-				&& enchant_dict_check((EnchantDict *) BFWIN(DOCUMENT(btv->doc)->bfwin)->ed, tocheck_conv,
-									  strlen(tocheck_conv)) != 0) {
-				DBG_SPELL("'%s' after entity conversion (%s) *not* spelled correctly!\n", tocheck,
-						  tocheck_conv);
-				gtk_text_buffer_apply_tag_by_name(buffer, "_spellerror_", start, end);
-			} else {
-				DBG_SPELL("'%s' after entity conversion (%s) spelled correctly!\n", tocheck, tocheck_conv);
-			}
-			g_free(tocheck_conv);
-		} else {
-			gtk_text_buffer_apply_tag_by_name(buffer, "_spellerror_", start, end);
-		}
-	} else {
-		DBG_SPELL("'%s' spelled correctly!\n", tocheck);
+	G_LOCK(spelldicts);
+	ok = spelldict_check(sd, tocheck);
+	G_UNLOCK(spelldicts);
+	DBG_SPELL("spellcheck_word, '%s' spelled correctly=%d\n", tocheck, ok);
+	if (!ok) {
+		gtk_text_buffer_apply_tag_by_name(buffer, "_spellerror_", start, end);
 	}
 	g_free(tocheck);
 }
@@ -276,24 +373,24 @@ get_spellcheck_from_context_at_position(BluefishTextView *btv, GtkTextIter *iter
 	if (!btv || !btv->bflang)
 		return TRUE;
 
-	found = get_foundcache_at_offset(btv, gtk_text_iter_get_offset(iter), NULL);
+	found = get_foundcache_at_offset(btv, gtk_text_iter_get_offset(iter));
 
 	if (!found) {
 		return btv->bflang->default_spellcheck;
 	}
 
-	tmpfcontext = found->fcontext;
+	tmpfcontext = found_fcontext(btv, found);
 	changecounter = found->numcontextchange;
 
 	while (changecounter < 0) {
-		tmpfcontext = (Tfoundcontext *) tmpfcontext->parentfcontext;
+		tmpfcontext = fcontext_parent(btv, tmpfcontext);
 		changecounter++;
 	}
 	DBG_SPELL("get_spellcheck_from_context_at_position, got context %d with default_spellcheck=%d\n"
 					,tmpfcontext ? tmpfcontext->context: 0
 					, tmpfcontext ?g_array_index(btv->bflang->st->contexts, Tcontext, tmpfcontext->context).default_spellcheck: -1);
 	while (tmpfcontext && g_array_index(btv->bflang->st->contexts, Tcontext, tmpfcontext->context).default_spellcheck == SPELLCHECK_INHERIT) {
-		tmpfcontext = (Tfoundcontext *) tmpfcontext->parentfcontext;
+		tmpfcontext = fcontext_parent(btv, tmpfcontext);
 		DBG_SPELL("get_spellcheck_from_context_at_position, get parent, got context %d with default_spellcheck=%d\n"
 					,tmpfcontext ? tmpfcontext->context: 0
 					, tmpfcontext ?g_array_index(btv->bflang->st->contexts, Tcontext, tmpfcontext->context).default_spellcheck: -1);
@@ -459,7 +556,7 @@ text_iter_next_word_bounds(GtkTextIter * soword, GtkTextIter * eoword, gboolean
 #endif
 
 static gboolean
-spellcheck_region(BluefishTextView * btv, GTimer *timer, GtkTextIter *itcursor, GtkTextIter *so, GtkTextIter *eo)
+spellcheck_region(BluefishTextView * btv, Tspelldict * sd, GTimer *timer, GtkTextIter *itcursor, GtkTextIter *so, GtkTextIter *eo)
 {
 	GtkTextIter iter;
 	gboolean cont=TRUE;
@@ -504,11 +601,16 @@ spellcheck_region(BluefishTextView * btv, GTimer *timer, GtkTextIter *itcursor,
 				DBG_SPELL("spellcheck_region, iter at %d, backward wordstart at %d\n", gtk_text_iter_get_offset(&iter),
 						  gtk_text_iter_get_offset(&wordstart));
 
-				/* check word */
+				/* the word at the cursor is probably still being typed, it is not checked */
+				if (gtk_text_iter_compare(&wordstart, itcursor) < 0 && gtk_text_iter_compare(&iter, itcursor) >= 0) {
+					DBG_SPELL("spellcheck_region, skip word %d:%d at the cursor\n", gtk_text_iter_get_offset(&wordstart),
+							  gtk_text_iter_get_offset(&iter));
+				} else {
 #ifdef SPELL_PROFILING
-				profile_words++;
+					profile_words++;
 #endif
-				spellcheck_word(btv, btv->buffer, &wordstart, &iter);
+					spellcheck_word(sd, btv->buffer, &wordstart, &iter);
+				}
 			} else {
 				DBG_SPELL("spellcheck_region, no word end within region\n");
 				iter = eo2;
@@ -550,11 +652,349 @@ spellcheck_region(BluefishTextView * btv, GTimer *timer, GtkTextIter *itcursor,
 	return (!gtk_text_iter_is_end(&iter));
 }
 
+#ifdef THREADED_SCANNING
+/* spellchecking large regions in a thread:
+
+if bftextview2_run_spellcheck() finds a large region, it takes a chunk of at most
+SPELLTHREAD_CHUNK_CHARS (extended to the end of the line), finds the parts of the chunk that
+need a spellcheck (get_next_region() needs the scanner tags, so that is done in the mainloop),
+and hands a copy of the text with these ranges to a worker thread. The worker finds the words
+with pango_default_break() and the same apostrophe and entity rules as text_iter_next_word_bounds(),
+checks them against the verdict cache or enchant, and hands the misspelled words back. The mainloop
+only applies the _spellerror_ tags and marks the chunk as done.
+
+Any change to the text cancels the job, the chunk is checked again in the next run (which is
+cheap, most words are in the verdict cache by then). */
+
+typedef struct {
+	guint32 start_o;
+	guint32 end_o;
+} Tspellrange;
+
+typedef struct {
+	gint refcount;				/* atomic, the mainloop and the worker thread each hold a reference */
+	gint cancelled;				/* atomic, set from the mainloop, checked in the worker */
+	gboolean finished;			/* the worker delivered, only accessed in the mainloop */
+	BluefishTextView *btv;		/* NULL once the job is cancelled, only accessed in the mainloop */
+	Tspelldict *sd;				/* the job holds a reference */
+	gchar *text;				/* the snapshot from start_o to end_o */
+	guint32 start_o;
+	guint32 end_o;
+	guint32 cursor_o;			/* the word at the cursor is skipped, like in spellcheck_region() */
+	gboolean decode_entities;
+	GArray *ranges;				/* Tspellrange, the parts of the snapshot that need a spellcheck, sorted */
+	GArray *misspelled;			/* Tspellrange, filled by the worker */
+} Tspelljob;
+
+static void
+spelljob_unref(Tspelljob * job)
+{
+	if (g_atomic_int_dec_and_test(&job->refcount)) {
+		g_free(job->text);
+		g_array_free(job->ranges, TRUE);
+		g_array_free(job->misspelled, TRUE);
+		G_LOCK(spelldicts);
+		spelldict_unref(job->sd);
+		G_UNLOCK(spelldicts);
+		g_slice_free(Tspelljob, job);
+	}
+}
+
+/* runs in the mainloop */
+static gboolean
+spelljob_deliver_lcb(gpointer data)
+{
+	Tspelljob *job = data;
+	DEBUG_SIG("spelljob_deliver_lcb, priority=%d\n", SCANTHREAD_BATCH_PRIORITY);
+	if (!g_atomic_int_get(&job->cancelled) && job->btv) {
+		job->finished = TRUE;
+		bftextview2_schedule_scanning(job->btv);
+	}
+	spelljob_unref(job);
+	return FALSE;
+}
+
+static inline glong
+attrs_word_end(const PangoLogAttr * attrs, glong n, glong i)
+{
+	for (i++; i <= n; i++) {
+		if (attrs[i].is_word_end)
+			return i;
+	}
+	return -1;
+}
+
+static inline glong
+attrs_word_start(const PangoLogAttr * attrs, glong i)
+{
+	for (i--; i > 0; i--) {
+		if (attrs[i].is_word_start)
+			return i;
+	}
+	return 0;
+}
+
+#define CHAR_AT(i) ((i) < n ? g_utf8_get_char(text + bytepos[i]) : 0)
+
+static inline glong
+end_of_entity(const gchar * text, const guint * bytepos, glong n, glong i)
+{
+	gint loop = 0;
+	while (CHAR_AT(i) != ';') {
+		i++;
+		if (i >= n || loop++ > 8)
+			return -1;
+	}
+	return i + 1;
+}
+
+/* text_iter_next_word_bounds() for the worker, on character positions in text. attrs and bytepos
+have n+1 entries */
+static gboolean
+text_next_word_bounds(const gchar * text, const guint * bytepos, const PangoLogAttr * attrs, glong n,
+					  glong * soword, glong * eoword, gboolean enable_entities)
+{
+	gunichar uc;
+	gboolean handled_starting_entity = FALSE;
+	glong i;
+
+	i = attrs_word_end(attrs, n, *eoword);
+	if (i < 0)
+		return FALSE;
+	*eoword = i;
+	*soword = attrs_word_start(attrs, i);
+
+	uc = CHAR_AT(*eoword);
+	while (uc == '\'' || (enable_entities && (uc == ';' || uc == '&'))) {
+		if (uc == '\'' && *eoword + 1 < n) {
+			if (!g_unichar_isalpha(CHAR_AT(*eoword + 1)))
+				return TRUE;
+		} else if (enable_entities && uc == '&') {
+			i = end_of_entity(text, bytepos, n, *eoword);
+			if (i < 0)
+				return TRUE;	/* no entity, return previous word end */
+			*eoword = i;
+			if (!g_unichar_isalpha(CHAR_AT(i)))
+				return TRUE;	/* after the entity the word stops */
+		} else if (enable_entities && uc == ';') {
+			if (!handled_starting_entity && *soword > 0 && CHAR_AT(*soword - 1) == '&') {
+				/* the word probably starts with an entity */
+				(*soword)--;
+				(*eoword)++;
+				handled_starting_entity = TRUE;
+				if (!g_unichar_isalpha(CHAR_AT(*eoword))) {
+					uc = CHAR_AT(*eoword);
+					continue;
+				}
+			} else if (!g_unichar_isalpha(CHAR_AT(*eoword + 1))) {
+				return TRUE;
+			}
+		} else {
+			return TRUE;
+		}
+		/* continue to the end of the word after the apostrophe or the entity */
+		i = attrs_word_end(attrs, n, *eoword);
+		if (i < 0)
+			return TRUE;
+		*eoword = i;
+		uc = CHAR_AT(*eoword);
+	}
+	return TRUE;
+}
+
+#undef CHAR_AT
+
+/* runs in the thread, text is the part of the snapshot from start_o with len bytes */
+static void
+spelljob_check_range(Tspelljob * job, const gchar * text, gsize len, guint32 start_o)
+{
+	glong n, i, soword = 0, eoword = 0;
+	const gchar *p;
+	guint *bytepos;
+	PangoLogAttr *attrs;
+
+	n = g_utf8_strlen(text, len);
+	bytepos = g_new(guint, n + 1);
+	for (p = text, i = 0; i < n; i++, p = g_utf8_next_char(p)) {
+		bytepos[i] = p - text;
+	}
+	bytepos[n] = len;
+	/* pango_default_break() only uses the unicode tables, unlike pango_get_log_attrs() it does
+	   not need the (not thread safe) language engines */
+	attrs = g_new(PangoLogAttr, n + 1);
+	pango_default_break(text, len, NULL, attrs, n + 1);
+
+	while (!g_atomic_int_get(&job->cancelled)
+		   && text_next_word_bounds(text, bytepos, attrs, n, &soword, &eoword, job->decode_entities)) {
+		gchar *word;
+		gboolean ok;
+		if (start_o + soword < job->cursor_o && start_o + eoword >= job->cursor_o)
+			continue;
+		word = g_strndup(text + bytepos[soword], bytepos[eoword] - bytepos[soword]);
+		G_LOCK(spelldicts);
+		ok = spelldict_check(job->sd, word);
+		G_UNLOCK(spelldicts);
+		if (!ok) {
+			Tspellrange found;
+			found.start_o = start_o + soword;
+			found.end_o = start_o + eoword;
+			g_array_append_val(job->misspelled, found);
+		}
+		g_free(word);
+	}
+	g_free(attrs);
+	g_free(bytepos);
+}
+
+static gpointer
+spelljob_thread(gpointer data)
+{
+	Tspelljob *job = data;
+	const gchar *p = job->text;
+	guint32 p_o = job->start_o;
+	guint i;
+
+	for (i = 0; i < job->ranges->len && !g_atomic_int_get(&job->cancelled); i++) {
+		Tspellrange *range = &g_array_index(job->ranges, Tspellrange, i);
+		const gchar *rstart;
+		rstart = g_utf8_offset_to_pointer(p, range->start_o - p_o);
+		p = g_utf8_offset_to_pointer(rstart, range->end_o - range->start_o);
+		p_o = range->end_o;
+		spelljob_check_range(job, rstart, p - rstart, range->start_o);
+	}
+	/* the reference of the thread is passed to spelljob_deliver_lcb() */
+	g_idle_add_full(SCANTHREAD_BATCH_PRIORITY, spelljob_deliver_lcb, job, NULL);
+	return NULL;
+}
+
+static void
+spellthread_cancel(BluefishTextView * btv)
+{
+	Tspelljob *job = btv->spelljob;
+	if (job) {
+		DBG_SPELL("spellthread_cancel, cancel job %p\n", job);
+		g_atomic_int_set(&job->cancelled, 1);
+		job->btv = NULL;
+		btv->spelljob = NULL;
+		spelljob_unref(job);
+	}
+}
+
+/* applies the results of a finished job */
+static void
+spellthread_apply(BluefishTextView * btv)
+{
+	Tspelljob *job = btv->spelljob;
+	GtkTextIter start, end, wordstart, wordend;
+	GtkTextTag *misspelled;
+	guint i;
+
+	DBG_SPELL("spellthread_apply, %d misspelled words from %d to %d\n", job->misspelled->len, job->start_o,
+			  job->end_o);
+	misspelled = gtk_text_tag_table_lookup(langmgr_get_tagtable(), "_spellerror_");
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &start, job->start_o);
+	gtk_text_buffer_get_iter_at_offset(btv->buffer, &end, job->end_o);
+	gtk_text_buffer_remove_tag(btv->buffer, misspelled, &start, &end);
+	wordstart = start;
+	for (i = 0; i < job->misspelled->len; i++) {
+		Tspellrange *found = &g_array_index(job->misspelled, Tspellrange, i);
+		gtk_text_iter_forward_chars(&wordstart, found->start_o - gtk_text_iter_get_offset(&wordstart));
+		wordend = wordstart;
+		gtk_text_iter_forward_chars(&wordend, found->end_o - found->start_o);
+		gtk_text_buffer_apply_tag(btv->buffer, misspelled, &wordstart, &wordend);
+	}
+#ifdef NEEDSCANNING
+	gtk_text_buffer_remove_tag(btv->buffer, btv->needspellcheck, &start, &end);
+#endif
+#ifdef MARKREGION
+	markregion_region_done(&btv->spellcheck, job->end_o);
+#endif
+	spellthread_cancel(btv);
+}
+
+/* starts a job for the first chunk of the region so-eo, returns FALSE if no job was started */
+static gboolean
+spellthread_dispatch(BluefishTextView * btv, Tspelldict * sd, GtkTextIter * itcursor, GtkTextIter * so,
+					 GtkTextIter * eo)
+{
+	GtkTextIter cs = *so, ce = *so, iter;
+	GError *gerror = NULL;
+	Tspelljob *job;
+	Tspellrange range;
+	GArray *ranges;
+
+	gtk_text_iter_set_line_offset(&cs, 0);
+	gtk_text_iter_forward_chars(&ce, SPELLTHREAD_CHUNK_CHARS);
+	if (gtk_text_iter_compare(&ce, eo) > 0)
+		ce = *eo;
+	if (!gtk_text_iter_ends_line(&ce))
+		gtk_text_iter_forward_to_line_end(&ce);
+
+	ranges = g_array_new(FALSE, FALSE, sizeof(Tspellrange));
+	if (btv->bflang->st) {
+		iter = cs;
+		while (gtk_text_iter_compare(&iter, &ce) < 0) {
+			GtkTextIter eo2 = ce;
+			if (!get_next_region(btv, &iter, &eo2) || gtk_text_iter_compare(&iter, &ce) >= 0)
+				break;
+			if (gtk_text_iter_compare(&eo2, &ce) > 0)
+				eo2 = ce;
+			if (gtk_text_iter_compare(&eo2, &iter) <= 0)
+				break;
+			range.start_o = gtk_text_iter_get_offset(&iter);
+			range.end_o = gtk_text_iter_get_offset(&eo2);
+			g_array_append_val(ranges, range);
+			iter = eo2;
+		}
+	} else {
+		range.start_o = gtk_text_iter_get_offset(&cs);
+		range.end_o = gtk_text_iter_get_offset(&ce);
+		g_array_append_val(ranges, range);
+	}
+
+	job = g_slice_new0(Tspelljob);
+	job->refcount = 2;			/* one for btv->spelljob, one for the thread */
+	job->btv = btv;
+	job->sd = sd;
+	job->text = gtk_text_iter_get_slice(&cs, &ce);
+	job->start_o = gtk_text_iter_get_offset(&cs);
+	job->end_o = gtk_text_iter_get_offset(&ce);
+	job->cursor_o = gtk_text_iter_get_offset(itcursor);
+	job->decode_entities = btv->bflang->spell_decode_entities;
+	job->ranges = ranges;
+	job->misspelled = g_array_new(FALSE, FALSE, sizeof(Tspellrange));
+	G_LOCK(spelldicts);
+	sd->refcount++;
+	G_UNLOCK(spelldicts);
+	DBG_SPELL("spellthread_dispatch, start job %p for %d:%d with %d ranges\n", job, job->start_o, job->end_o,
+			  ranges->len);
+	g_thread_create(spelljob_thread, job, FALSE, &gerror);
+	if (gerror) {
+		g_warning("failed to start spellcheck thread: %s\n", gerror->message);
+		g_error_free(gerror);
+		job->refcount = 1;
+		spelljob_unref(job);
+		return FALSE;
+	}
+	btv->spelljob = job;
+	return TRUE;
+}
+#endif							/* THREADED_SCANNING */
+
+void
+bftextview2_spell_cancel(BluefishTextView * btv)
+{
+#ifdef THREADED_SCANNING
+	spellthread_cancel(btv);
+#endif
+}
+
 gboolean
 bftextview2_run_spellcheck(BluefishTextView * btv)
 {
 	GtkTextIter so, eo, itcursor;
 	GTimer *timer;
+	Tspelldict *sd;
 	gboolean cont = TRUE;
 
 #ifdef SPELL_PROFILING
@@ -568,6 +1008,18 @@ bftextview2_run_spellcheck(BluefishTextView * btv)
 		DBG_SPELL("bftextview2_run_spellcheck, no dictionary.. return..\n");
 		return FALSE;
 	}
+	sd = spelldict_get((EnchantDict *) BFWIN(DOCUMENT(btv->doc)->bfwin)->ed);
+	if (!sd)
+		return FALSE;
+#ifdef THREADED_SCANNING
+	if (btv->spelljob) {
+		if (!((Tspelljob *) btv->spelljob)->finished) {
+			/* spelljob_deliver_lcb() schedules this view again when the worker is finished */
+			return FALSE;
+		}
+		spellthread_apply(btv);
+	}
+#endif
 
 	timer = g_timer_new();
 
@@ -587,7 +1039,14 @@ bftextview2_run_spellcheck(BluefishTextView * btv)
 			return FALSE;
 		}
 		DBG_SPELL("bftextview2_run_spellcheck, call spellcheck_region(%d:%d)\n",gtk_text_iter_get_offset(&so), gtk_text_iter_get_offset(&eo));
-		cont = spellcheck_region(btv, timer, &itcursor, &so, &eo);
+#ifdef THREADED_SCANNING
+		if (gtk_text_iter_get_offset(&eo) - gtk_text_iter_get_offset(&so) >= SPELLTHREAD_MIN_CHARS
+			&& spellthread_dispatch(btv, sd, &itcursor, &so, &eo)) {
+			g_timer_destroy(timer);
+			return FALSE;
+		}
+#endif
+		cont = spellcheck_region(btv, sd, timer, &itcursor, &so, &eo);
 
 
 
@@ -605,6 +1064,7 @@ bftextview2_run_spellcheck(BluefishTextView * btv)
 void
 bftextview2_spell_init(void)
 {
+	spelldicts = g_hash_table_new(g_direct_hash, g_direct_equal);
 	eb = enchant_broker_init();
 	if (!eb) {
 		g_warning("could not initialize spell checking engine\n");
@@ -617,6 +1077,8 @@ bftextview2_spell_cleanup(void)
 {
 	enchant_broker_free(eb);
 	eb = NULL;
+	g_hash_table_destroy(spelldicts);
+	spelldicts = NULL;
 }
 
 static void
@@ -624,11 +1086,16 @@ recheck_document(Tdocument * doc)
 {
 #ifdef NEEDSCANNING
 	GtkTextIter start, end;
+#endif
+#ifdef MARKREGION
+	GtkTextIter ite;
+#endif
+	bftextview2_spell_cancel(BLUEFISH_TEXT_VIEW(doc->view));
+#ifdef NEEDSCANNING
 	gtk_text_buffer_get_bounds(doc->buffer, &start, &end);
 	gtk_text_buffer_apply_tag(doc->buffer, BLUEFISH_TEXT_VIEW(doc->view)->needspellcheck, &start, &end);
 #endif
 #ifdef MARKREGION
-	GtkTextIter ite;
 	gtk_text_buffer_get_end_iter(BLUEFISH_TEXT_VIEW(doc->view)->buffer, &ite);
 	markregion_nochange(&BLUEFISH_TEXT_VIEW(doc->view)->spellcheck, 0, gtk_text_iter_get_offset(&ite));
 #endif
@@ -667,11 +1134,13 @@ static void
 bftextview2_add_word_backend(BluefishTextView * btv, Tbfwin * bfwin, gboolean to_dict)
 {
 	GtkTextIter so, eo;
+	Tspelldict *sd;
 	gchar *word;
 	if (!get_misspelled_word_at_bevent(btv, &so, &eo))
 		return;
 
 	word = gtk_text_buffer_get_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(btv)), &so, &eo, FALSE);
+	G_LOCK(spelldicts);
 	if (to_dict) {
 #ifdef HAVE_LIBENCHANT_1_4
 		enchant_dict_add((EnchantDict *) bfwin->ed, word, strlen(word));
@@ -681,6 +1150,12 @@ bftextview2_add_word_backend(BluefishTextView * btv, Tbfwin * bfwin, gboolean to
 	} else {
 		enchant_dict_add_to_session((EnchantDict *) bfwin->ed, word, strlen(word));
 	}
+	/* the word might be part of other cached verdicts (for example after entity conversion) */
+	sd = g_hash_table_lookup(spelldicts, bfwin->ed);
+	if (sd)
+		g_hash_table_remove_all(sd->verdicts);
+	G_UNLOCK(spelldicts);
+	g_free(word);
 	recheck_bfwin(bfwin);
 }
 
@@ -848,8 +1323,10 @@ bftextview2_populate_suggestions_popup(GtkMenu * menu, Tdocument * doc)
 		}
 
 		DBG_SPELL("list alternatives for %s\n", word);
+		G_LOCK(spelldicts);
 		suggestions =
 			enchant_dict_suggest((EnchantDict *) BFWIN(doc->bfwin)->ed, word, strlen(word), &n_suggs);
+		G_UNLOCK(spelldicts);
 
 		menuitem = gtk_image_menu_item_new_with_label(_("Add to dictionary"));
 		gtk_menu_shell_prepend(GTK_MENU_SHELL(menu), GTK_WIDGET(menuitem));
@@ -887,7 +1364,9 @@ bftextview2_populate_suggestions_popup(GtkMenu * menu, Tdocument * doc)
 				gtk_menu_shell_prepend(GTK_MENU_SHELL(menu), GTK_WIDGET(menuitem));
 			}
 
+			G_LOCK(spelldicts);
 			enchant_dict_free_string_list((EnchantDict *) BFWIN(doc->bfwin)->ed, suggestions);
+			G_UNLOCK(spelldicts);
 		}
 		g_free(word);
 	}
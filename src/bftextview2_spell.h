@@ -24,6 +24,7 @@
 #include "bftextview2.h"
 void unload_spell_dictionary(Tbfwin * bfwin);
 gboolean bftextview2_run_spellcheck(BluefishTextView * btv);
+void bftextview2_spell_cancel(BluefishTextView * btv);
 void bftextview2_spell_init(void);
 void bftextview2_spell_cleanup(void);
 void bftextview2_populate_suggestions_popup(GtkMenu * menu, Tdocument * doc);
@@ -0,0 +1,609 @@
+/* Bluefish HTML Editor
+ * bftextview2_stcache.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h
+
+the scantable cache:
+
+build_lang_thread() writes the finished Tscantable to ~/.bluefish/cache/<md5 of the bflang2 path>.stcache
+The file starts with a key: the bluefish version, the bflang2 path, the newest mtime of the
+bflang2 file and the .bfinc files next to it, and all options that are set for this language
+(these decide which class / notclass parts of the file are compiled). If the key in the
+file is not exactly the key for the current situation the file is ignored, and overwritten
+after the language is compiled again.
+
+The file does not contain any pointers, only offsets. The DFA tables and all strings are used
+directly from the mmap'ed file, only the GArray's, the hash tables and the autocompletion
+indexes are rebuilt. The GtkTextTag's are looked up by bftextview2_scantable_rematch_highlights()
+just like after compiling.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "bluefish.h"
+#include "bftextview2_private.h"
+#include "bftextview2_stcache.h"
+
+/*#define DBG_STCACHE g_print*/
+#define DBG_STCACHE(args...)
+
+#define STCACHE_MAGIC "BFSTCACH"
+#define STCACHE_VERSION 1
+#define STCACHE_BYTEORDER 0x01020304
+#define STCACHE_NOSTRING G_MAXUINT32
+
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 byteorder;
+	guint32 filelen;
+	guint32 keylen;				/* the key follows directly after the header */
+	guint32 numcontexts;
+	guint32 nummatches;
+	guint32 numcomments;
+	guint32 numblocks;
+	guint32 numautocomp;
+	guint32 contexts_o;
+	guint32 matches_o;
+	guint32 comments_o;
+	guint32 blocks_o;
+	guint32 autocomp_o;
+	guint32 strings_o;
+	guint32 smartindentchars;
+	guint32 smartoutdentchars;
+	guint32 flags;				/* bit 0 default_spellcheck, bit 1 spell_decode_entities */
+	guint8 allsymbols[128];
+} Tstc_header;
+
+typedef struct {
+	guint32 contexthighlight;
+	guint32 numstates;
+	guint32 dfa_o;
+	guint32 patternhash_o;		/* array of Tstc_hashentry */
+	guint32 numpatternhash;
+	guint32 ac_o;				/* array of guint32 string offsets */
+	guint32 numac;
+	guint16 rowlen;
+	guint8 has_tagclose_from_blockstack;
+	guint8 comment_block;
+	guint8 comment_line;
+	guint8 autocomplete_case_insens;
+	guint8 default_spellcheck;
+	guint8 padding;
+	guint8 charclass[NUMSCANCHARS + 1];
+} Tstc_context;
+
+typedef struct {
+	guint32 key;
+	guint32 pattern_id;
+} Tstc_hashentry;
+
+typedef struct {
+	guint32 reference;
+	guint32 pattern;
+	guint32 selfhighlight;
+	guint16 block;
+	gint16 blockstartpattern;
+	gint16 nextcontext;
+	guint16 flags;				/* see STC_PAT_ */
+} Tstc_pattern;
+
+#define STC_PAT_IDENTACTION 0x0003
+#define STC_PAT_STARTS_BLOCK (1<<2)
+#define STC_PAT_ENDS_BLOCK (1<<3)
+#define STC_PAT_TAGCLOSE (1<<4)
+#define STC_PAT_STRETCH (1<<5)
+#define STC_PAT_CASE_INSENS (1<<6)
+#define STC_PAT_IS_REGEX (1<<7)
+#define STC_PAT_IDENTMODE (1<<8)
+
+typedef struct {
+	guint32 matchnum;
+	guint32 string;
+	guint32 backup_cursor;
+} Tstc_autocomp;
+
+typedef struct {
+	guint32 so;
+	guint32 eo;
+	guint32 type;
+} Tstc_comment;
+
+typedef struct {
+	guint32 name;
+	guint32 highlight;
+	guint32 foldable;
+} Tstc_block;
+
+static gchar *
+stcache_filename(const gchar * bflangfile)
+{
+	gchar *md5, *filename;
+	md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, bflangfile, -1);
+	filename = g_strconcat(g_get_home_dir(), "/." PACKAGE "/cache/", md5, ".stcache", NULL);
+	g_free(md5);
+	return filename;
+}
+
+/* the bflang2 file includes .bfinc files from the same directory, so a change in any of
+these files should invalidate the cache */
+static glong
+newest_mtime(const gchar * bflangfile)
+{
+	struct stat statbuf;
+	glong mtime = 0;
+	gchar *dirname;
+	GDir *gdir;
+
+	if (g_stat(bflangfile, &statbuf) == 0)
+		mtime = statbuf.st_mtime;
+	dirname = g_path_get_dirname(bflangfile);
+	gdir = g_dir_open(dirname, 0, NULL);
+	if (gdir) {
+		const gchar *name;
+		while ((name = g_dir_read_name(gdir))) {
+			if (g_str_has_suffix(name, ".bfinc")) {
+				gchar *path = g_build_filename(dirname, name, NULL);
+				if (g_stat(path, &statbuf) == 0 && statbuf.st_mtime > mtime)
+					mtime = statbuf.st_mtime;
+				g_free(path);
+			}
+		}
+		g_dir_close(gdir);
+	}
+	g_free(dirname);
+	return mtime;
+}
+
+/* the key changes whenever the compiled scantable for this bflang2 file and these options changes */
+gchar *
+stcache_key(const gchar * bflangfile, const gchar * options)
+{
+	return g_strdup_printf("%s\n%s\n%ld\n%s", VERSION, bflangfile, newest_mtime(bflangfile), options);
+}
+
+/****************************** saving ******************************/
+
+typedef struct {
+	GString *out;
+	GString *strings;
+	GHashTable *stringoffsets;	/* the same string is stored only once */
+} Tstc_writer;
+
+static guint32
+stc_string(Tstc_writer * stw, const gchar * string)
+{
+	gpointer offset;
+	if (!string)
+		return STCACHE_NOSTRING;
+	if (g_hash_table_lookup_extended(stw->stringoffsets, string, NULL, &offset))
+		return GPOINTER_TO_UINT(offset);
+	offset = GUINT_TO_POINTER(stw->strings->len);
+	g_string_append_len(stw->strings, string, strlen(string) + 1);
+	g_hash_table_insert(stw->stringoffsets, (gpointer) string, offset);
+	return GPOINTER_TO_UINT(offset);
+}
+
+static void
+stc_align(GString * out)
+{
+	while (out->len % 4)
+		g_string_append_c(out, '\0');
+}
+
+void
+stcache_save(const gchar * bflangfile, const gchar * options, Tscantable * st, Tstcache_props * props)
+{
+	Tstc_writer stw;
+	Tstc_header header;
+	Tstc_context *cont;
+	gchar *key, *filename, *dirname;
+	guint i;
+	GError *gerror = NULL;
+
+	stw.out = g_string_sized_new(1024 * 1024);
+	stw.strings = g_string_sized_new(64 * 1024);
+	stw.stringoffsets = g_hash_table_new(g_str_hash, g_str_equal);
+	memset(&header, 0, sizeof(Tstc_header));
+	memcpy(header.magic, STCACHE_MAGIC, 8);
+	header.version = STCACHE_VERSION;
+	header.byteorder = STCACHE_BYTEORDER;
+	memcpy(header.allsymbols, st->allsymbols, 128);
+	header.smartindentchars = stc_string(&stw, props->smartindentchars);
+	header.smartoutdentchars = stc_string(&stw, props->smartoutdentchars);
+	header.flags = (props->default_spellcheck ? 1 : 0) | (props->spell_decode_entities ? 2 : 0);
+	/* the header is written again at the end, when all offsets are known */
+	g_string_append_len(stw.out, (gchar *) & header, sizeof(Tstc_header));
+	key = stcache_key(bflangfile, options);
+	header.keylen = strlen(key);
+	g_string_append_len(stw.out, key, header.keylen);
+	stc_align(stw.out);
+	g_free(key);
+
+	/* first the variable sized data of each context */
+	header.numcontexts = st->contexts->len;
+	cont = g_new0(Tstc_context, st->contexts->len);
+	for (i = 0; i < st->contexts->len; i++) {
+		Tcontext *ctx = &g_array_index(st->contexts, Tcontext, i);
+		cont[i].contexthighlight = stc_string(&stw, ctx->contexthighlight);
+		cont[i].has_tagclose_from_blockstack = ctx->has_tagclose_from_blockstack;
+		cont[i].comment_block = ctx->comment_block;
+		cont[i].comment_line = ctx->comment_line;
+		cont[i].autocomplete_case_insens = ctx->autocomplete_case_insens;
+		cont[i].default_spellcheck = ctx->default_spellcheck;
+		if (ctx->dfa) {
+			cont[i].numstates = ctx->numstates;
+			cont[i].rowlen = ctx->rowlen;
+			memcpy(cont[i].charclass, ctx->charclass, NUMSCANCHARS + 1);
+			cont[i].dfa_o = stw.out->len;
+			g_string_append_len(stw.out, (gchar *) ctx->dfa, ctx->numstates * ctx->rowlen * sizeof(guint16));
+			stc_align(stw.out);
+		}
+		if (ctx->patternhash) {
+			GHashTableIter iter;
+			gpointer hkey, hvalue;
+			cont[i].patternhash_o = stw.out->len;
+			g_hash_table_iter_init(&iter, ctx->patternhash);
+			while (g_hash_table_iter_next(&iter, &hkey, &hvalue)) {
+				Tstc_hashentry he;
+				he.key = stc_string(&stw, hkey);
+				he.pattern_id = GPOINTER_TO_INT(hvalue);
+				g_string_append_len(stw.out, (gchar *) & he, sizeof(Tstc_hashentry));
+				cont[i].numpatternhash++;
+			}
+		}
+		if (ctx->ac) {
+			guint j;
+			cont[i].ac_o = stw.out->len;
+			for (j = 0; j < acindex_length(ctx->ac); j++) {
+				guint32 string = stc_string(&stw, acindex_item(ctx->ac, j));
+				g_string_append_len(stw.out, (gchar *) & string, sizeof(guint32));
+				cont[i].numac++;
+			}
+		}
+	}
+	header.contexts_o = stw.out->len;
+	g_string_append_len(stw.out, (gchar *) cont, st->contexts->len * sizeof(Tstc_context));
+	g_free(cont);
+
+	header.nummatches = st->matches->len;
+	header.matches_o = stw.out->len;
+	for (i = 0; i < st->matches->len; i++) {
+		Tpattern *pat = &g_array_index(st->matches, Tpattern, i);
+		Tpattern_cold *patc = &g_array_index(st->matchinfo, Tpattern_cold, i);
+		Tstc_pattern spat;
+		spat.reference = stc_string(&stw, patc->reference);
+		spat.pattern = stc_string(&stw, patc->pattern);
+		spat.selfhighlight = stc_string(&stw, patc->selfhighlight);
+		spat.block = pat->block;
+		spat.blockstartpattern = pat->blockstartpattern;
+		spat.nextcontext = pat->nextcontext;
+		spat.flags = (pat->starts_block ? STC_PAT_STARTS_BLOCK : 0)
+			| (pat->ends_block ? STC_PAT_ENDS_BLOCK : 0)
+			| (pat->tagclose_from_blockstack ? STC_PAT_TAGCLOSE : 0)
+			| (pat->stretch_blockstart ? STC_PAT_STRETCH : 0)
+			| (patc->case_insens ? STC_PAT_CASE_INSENS : 0)
+			| (patc->is_regex ? STC_PAT_IS_REGEX : 0);
+#ifdef IDENTSTORING
+		spat.flags |= (pat->identaction & STC_PAT_IDENTACTION) | (pat->identmode ? STC_PAT_IDENTMODE : 0);
+#endif
+		g_string_append_len(stw.out, (gchar *) & spat, sizeof(Tstc_pattern));
+	}
+
+	header.autocomp_o = stw.out->len;
+	for (i = 0; i < st->matches->len; i++) {
+		GSList *tmpslist;
+		for (tmpslist = g_array_index(st->matchinfo, Tpattern_cold, i).autocomp_items; tmpslist;
+			 tmpslist = g_slist_next(tmpslist)) {
+			Tpattern_autocomplete *pac = tmpslist->data;
+			Tstc_autocomp sac;
+			sac.matchnum = i;
+			sac.string = stc_string(&stw, pac->autocomplete_string);
+			sac.backup_cursor = pac->autocomplete_backup_cursor;
+			g_string_append_len(stw.out, (gchar *) & sac, sizeof(Tstc_autocomp));
+			header.numautocomp++;
+		}
+	}
+
+	header.numcomments = st->comments->len;
+	header.comments_o = stw.out->len;
+	for (i = 0; i < st->comments->len; i++) {
+		Tcomment *com = &g_array_index(st->comments, Tcomment, i);
+		Tstc_comment scom;
+		scom.so = stc_string(&stw, com->so);
+		scom.eo = stc_string(&stw, com->eo);
+		scom.type = com->type;
+		g_string_append_len(stw.out, (gchar *) & scom, sizeof(Tstc_comment));
+	}
+
+	header.numblocks = st->blocks->len;
+	header.blocks_o = stw.out->len;
+	for (i = 0; i < st->blocks->len; i++) {
+		Tpattern_block *pb = &g_array_index(st->blocks, Tpattern_block, i);
+		Tstc_block sblock;
+		sblock.name = stc_string(&stw, pb->name);
+		sblock.highlight = stc_string(&stw, pb->highlight);
+		sblock.foldable = pb->foldable;
+		g_string_append_len(stw.out, (gchar *) & sblock, sizeof(Tstc_block));
+	}
+
+	header.strings_o = stw.out->len;
+	g_string_append_len(stw.out, stw.strings->str, stw.strings->len);
+	header.filelen = stw.out->len;
+	memcpy(stw.out->str, &header, sizeof(Tstc_header));
+
+	filename = stcache_filename(bflangfile);
+	dirname = g_path_get_dirname(filename);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+	if (!g_file_set_contents(filename, stw.out->str, stw.out->len, &gerror)) {
+		g_warning("failed to write scantable cache %s: %s\n", filename, gerror->message);
+		g_error_free(gerror);
+	} else {
+		DBG_STCACHE("stcache_save, wrote %d bytes to %s\n", (gint) stw.out->len, filename);
+	}
+	g_free(filename);
+	g_hash_table_destroy(stw.stringoffsets);
+	g_string_free(stw.strings, TRUE);
+	g_string_free(stw.out, TRUE);
+}
+
+/****************************** loading ******************************/
+
+typedef struct {
+	const gchar *data;
+	gsize len;
+	const Tstc_header *header;
+	gboolean error;
+} Tstc_reader;
+
+/* returns a pointer to size bytes at offset, or NULL (and sets the error) if that is outside the file */
+static gconstpointer
+stc_data(Tstc_reader * str, guint32 offset, gsize size)
+{
+	if (offset > str->len || size > str->len - offset) {
+		str->error = TRUE;
+		return NULL;
+	}
+	return str->data + offset;
+}
+
+static gchar *
+stc_get_string(Tstc_reader * str, guint32 offset)
+{
+	if (offset == STCACHE_NOSTRING)
+		return NULL;
+	if (offset >= str->len - str->header->strings_o) {
+		str->error = TRUE;
+		return NULL;
+	}
+	return (gchar *) str->data + str->header->strings_o + offset;
+}
+
+static void
+stc_free_partial(Tscantable * st)
+{
+	guint i;
+	for (i = 0; i < st->matches->len; i++) {
+		GSList *slist;
+		for (slist = g_array_index(st->matchinfo, Tpattern_cold, i).autocomp_items; slist; slist = g_slist_next(slist)) {
+			g_slice_free(Tpattern_autocomplete, slist->data);
+		}
+		g_slist_free(g_array_index(st->matchinfo, Tpattern_cold, i).autocomp_items);
+	}
+	for (i = 0; i < st->contexts->len; i++) {
+		if (g_array_index(st->contexts, Tcontext, i).ac)
+			acindex_free(g_array_index(st->contexts, Tcontext, i).ac);
+		if (g_array_index(st->contexts, Tcontext, i).patternhash)
+			g_hash_table_destroy(g_array_index(st->contexts, Tcontext, i).patternhash);
+	}
+	g_array_free(st->matches, TRUE);
+	g_array_free(st->matchinfo, TRUE);
+	g_array_free(st->contexts, TRUE);
+	g_array_free(st->comments, TRUE);
+	g_array_free(st->blocks, TRUE);
+	g_slice_free(Tscantable, st);
+}
+
+Tscantable *
+stcache_load(const gchar * bflangfile, const gchar * options, Tstcache_props * props)
+{
+	GMappedFile *mapped;
+	Tstc_reader str;
+	Tscantable *st;
+	const Tstc_context *cont;
+	const Tstc_pattern *spat;
+	const Tstc_autocomp *sac;
+	const Tstc_comment *scom;
+	const Tstc_block *sblock;
+	gchar *filename, *key;
+	guint i, j;
+
+	filename = stcache_filename(bflangfile);
+	mapped = g_mapped_file_new(filename, FALSE, NULL);
+	if (!mapped) {
+		DBG_STCACHE("stcache_load, no cache %s for %s\n", filename, bflangfile);
+		g_free(filename);
+		return NULL;
+	}
+	str.data = g_mapped_file_get_contents(mapped);
+	str.len = g_mapped_file_get_length(mapped);
+	str.header = (const Tstc_header *) str.data;
+	str.error = FALSE;
+	key = stcache_key(bflangfile, options);
+	if (str.len < sizeof(Tstc_header)
+		|| memcmp(str.header->magic, STCACHE_MAGIC, 8) != 0
+		|| str.header->version != STCACHE_VERSION
+		|| str.header->byteorder != STCACHE_BYTEORDER
+		|| str.header->filelen != str.len
+		|| str.header->strings_o > str.len
+		|| (str.header->strings_o < str.len && str.data[str.len - 1] != '\0')
+		|| str.header->keylen != strlen(key)
+		|| !stc_data(&str, sizeof(Tstc_header), str.header->keylen)
+		|| memcmp(str.data + sizeof(Tstc_header), key, str.header->keylen) != 0) {
+		DBG_STCACHE("stcache_load, cache %s is outdated or invalid\n", filename);
+		g_free(key);
+		g_free(filename);
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+	g_free(key);
+
+	cont = stc_data(&str, str.header->contexts_o, str.header->numcontexts * sizeof(Tstc_context));
+	spat = stc_data(&str, str.header->matches_o, str.header->nummatches * sizeof(Tstc_pattern));
+	sac = stc_data(&str, str.header->autocomp_o, str.header->numautocomp * sizeof(Tstc_autocomp));
+	scom = stc_data(&str, str.header->comments_o, str.header->numcomments * sizeof(Tstc_comment));
+	sblock = stc_data(&str, str.header->blocks_o, str.header->numblocks * sizeof(Tstc_block));
+	if (str.error) {
+		g_warning("scantable cache %s is corrupt\n", filename);
+		g_free(filename);
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+
+	st = g_slice_new0(Tscantable);
+	memcpy(st->allsymbols, str.header->allsymbols, 128);
+	st->contexts = g_array_sized_new(TRUE, TRUE, sizeof(Tcontext), str.header->numcontexts);
+	st->matches = g_array_sized_new(TRUE, TRUE, sizeof(Tpattern), str.header->nummatches);
+	st->matchinfo = g_array_sized_new(TRUE, TRUE, sizeof(Tpattern_cold), str.header->nummatches);
+	st->comments = g_array_sized_new(TRUE, FALSE, sizeof(Tcomment), str.header->numcomments);
+	st->blocks = g_array_sized_new(TRUE, FALSE, sizeof(Tpattern_block), str.header->numblocks);
+	g_array_set_size(st->contexts, str.header->numcontexts);
+	g_array_set_size(st->matches, str.header->nummatches);
+	g_array_set_size(st->matchinfo, str.header->nummatches);
+	g_array_set_size(st->comments, str.header->numcomments);
+	g_array_set_size(st->blocks, str.header->numblocks);
+
+	for (i = 0; i < str.header->nummatches; i++) {
+		Tpattern *pat = &g_array_index(st->matches, Tpattern, i);
+		Tpattern_cold *patc = &g_array_index(st->matchinfo, Tpattern_cold, i);
+		patc->reference = stc_get_string(&str, spat[i].reference);
+		patc->pattern = stc_get_string(&str, spat[i].pattern);
+		patc->selfhighlight = stc_get_string(&str, spat[i].selfhighlight);
+		pat->block = spat[i].block;
+		pat->blockstartpattern = spat[i].blockstartpattern;
+		pat->nextcontext = spat[i].nextcontext;
+		pat->starts_block = (spat[i].flags & STC_PAT_STARTS_BLOCK) != 0;
+		pat->ends_block = (spat[i].flags & STC_PAT_ENDS_BLOCK) != 0;
+		pat->tagclose_from_blockstack = (spat[i].flags & STC_PAT_TAGCLOSE) != 0;
+		pat->stretch_blockstart = (spat[i].flags & STC_PAT_STRETCH) != 0;
+		patc->case_insens = (spat[i].flags & STC_PAT_CASE_INSENS) != 0;
+		patc->is_regex = (spat[i].flags & STC_PAT_IS_REGEX) != 0;
+#ifdef IDENTSTORING
+		pat->identaction = spat[i].flags & STC_PAT_IDENTACTION;
+		pat->identmode = (spat[i].flags & STC_PAT_IDENTMODE) != 0;
+#endif
+	}
+	/* the autocomp items were written in list order */
+	for (i = 0; i < str.header->numautocomp && !str.error; i++) {
+		Tpattern_autocomplete *pac;
+		if (sac[i].matchnum >= str.header->nummatches) {
+			str.error = TRUE;
+			break;
+		}
+		pac = g_slice_new(Tpattern_autocomplete);
+		pac->autocomplete_string = stc_get_string(&str, sac[i].string);
+		pac->autocomplete_backup_cursor = sac[i].backup_cursor;
+		g_array_index(st->matchinfo, Tpattern_cold, sac[i].matchnum).autocomp_items =
+			g_slist_append(g_array_index(st->matchinfo, Tpattern_cold, sac[i].matchnum).autocomp_items, pac);
+	}
+
+	for (i = 0; i < str.header->numcontexts && !str.error; i++) {
+		Tcontext *ctx = &g_array_index(st->contexts, Tcontext, i);
+		ctx->contexthighlight = stc_get_string(&str, cont[i].contexthighlight);
+		ctx->has_tagclose_from_blockstack = cont[i].has_tagclose_from_blockstack;
+		ctx->comment_block = cont[i].comment_block;
+		ctx->comment_line = cont[i].comment_line;
+		ctx->autocomplete_case_insens = cont[i].autocomplete_case_insens;
+		ctx->default_spellcheck = cont[i].default_spellcheck;
+		if (cont[i].numstates) {
+			for (j = 0; j <= NUMSCANCHARS; j++) {
+				if (cont[i].charclass[j] >= cont[i].rowlen)
+					str.error = TRUE;
+			}
+			ctx->numstates = cont[i].numstates;
+			ctx->rowlen = cont[i].rowlen;
+			memcpy(ctx->charclass, cont[i].charclass, NUMSCANCHARS + 1);
+			ctx->dfa =
+				(guint16 *) stc_data(&str, cont[i].dfa_o, cont[i].numstates * cont[i].rowlen * sizeof(guint16));
+			/* a corrupt state number would make the scanner read outside the table */
+			for (j = 0; ctx->dfa && j < cont[i].numstates * cont[i].rowlen; j++) {
+				if ((j % cont[i].rowlen == 0) ? (ctx->dfa[j] >= str.header->nummatches) : (ctx->dfa[j] >= cont[i].numstates)) {
+					str.error = TRUE;
+					break;
+				}
+			}
+		}
+		if (cont[i].numpatternhash) {
+			const Tstc_hashentry *he =
+				stc_data(&str, cont[i].patternhash_o, cont[i].numpatternhash * sizeof(Tstc_hashentry));
+			ctx->patternhash = g_hash_table_new(g_str_hash, g_str_equal);
+			for (j = 0; he && j < cont[i].numpatternhash; j++) {
+				gchar *hkey = stc_get_string(&str, he[j].key);
+				if (hkey)
+					g_hash_table_insert(ctx->patternhash, hkey, GINT_TO_POINTER(he[j].pattern_id));
+			}
+		}
+		if (cont[i].numac) {
+			const guint32 *ac = stc_data(&str, cont[i].ac_o, cont[i].numac * sizeof(guint32));
+			ctx->ac = acindex_new(ctx->autocomplete_case_insens);
+			for (j = 0; ac && j < cont[i].numac; j++) {
+				gchar *item = stc_get_string(&str, ac[j]);
+				if (item)
+					acindex_add(ctx->ac, item);
+			}
+			/* the items were written in sorted order, so sorting them again is cheap */
+			acindex_finish(ctx->ac);
+		}
+	}
+
+	for (i = 0; i < str.header->numcomments; i++) {
+		g_array_index(st->comments, Tcomment, i).so = stc_get_string(&str, scom[i].so);
+		g_array_index(st->comments, Tcomment, i).eo = stc_get_string(&str, scom[i].eo);
+		g_array_index(st->comments, Tcomment, i).type = scom[i].type;
+	}
+	for (i = 0; i < str.header->numblocks; i++) {
+		g_array_index(st->blocks, Tpattern_block, i).name = stc_get_string(&str, sblock[i].name);
+		g_array_index(st->blocks, Tpattern_block, i).highlight = stc_get_string(&str, sblock[i].highlight);
+		g_array_index(st->blocks, Tpattern_block, i).foldable = sblock[i].foldable;
+	}
+
+	if (str.error) {
+		g_warning("scantable cache %s is corrupt\n", filename);
+		stc_free_partial(st);
+		g_free(filename);
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+	for (i = 0; i < str.header->numcontexts; i++) {
+		if (g_array_index(st->contexts, Tcontext, i).dfa)
+			compute_dfa_skips(&g_array_index(st->contexts, Tcontext, i));
+	}
+	props->smartindentchars = g_strdup(stc_get_string(&str, str.header->smartindentchars));
+	props->smartoutdentchars = g_strdup(stc_get_string(&str, str.header->smartoutdentchars));
+	props->default_spellcheck = (str.header->flags & 1) != 0;
+	props->spell_decode_entities = (str.header->flags & 2) != 0;
+	st->mapped = mapped;
+	DBG_STCACHE("stcache_load, loaded %s for %s\n", filename, bflangfile);
+	g_free(filename);
+	return st;
+}
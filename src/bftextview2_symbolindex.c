@@ -0,0 +1,751 @@
+/* Bluefish HTML Editor
+ * bftextview2_symbolindex.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bf_lib.h"
+#include "bftextview2_private.h"
+#include "bftextview2_langmgr.h"
+#include "bftextview2_identifier.h"
+#include "bftextview2_symbolindex.h"
+
+#ifdef IDENTSTORING
+
+/*#define DBG_SYMBOLINDEX g_print*/
+#define DBG_SYMBOLINDEX(args...)
+
+#define SYMBOLINDEX_MAGIC "BFSYMIDX"
+#define SYMBOLINDEX_VERSION 1
+#define SYMBOLINDEX_BYTEORDER 0x01020304
+
+/* the file on disk is a Tsymindex_header, followed by the arrays of Tsymfile and Tsymbol and
+the strings, the same structs are used in memory */
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 byteorder;
+	guint32 numfiles;
+	guint32 numsymbols;
+	guint32 stringslen;
+	guint32 padding;
+} Tsymindex_header;
+
+typedef struct {
+	guint32 path;				/* string offset, the path relative to the basedir */
+	guint32 lang;				/* string offset, the scantable key (see langmgr_scantable_key()) */
+	guint64 mtime;
+	guint32 first;				/* the symbols of this file are first .. first+num-1 */
+	guint32 num;
+} Tsymfile;
+
+typedef struct {
+	guint32 name;				/* string offset */
+	guint32 file;				/* index in the files */
+	guint32 line;
+	gint16 context;
+	guint8 identaction;
+	guint8 padding;
+} Tsymbol;
+
+typedef struct {
+	GArray *files;				/* Tsymfile */
+	GArray *symbols;			/* Tsymbol */
+	GString *strings;			/* every string is stored only once */
+	GHashTable *dedup;			/* string -> offset + 1, only while the index is built */
+	/* the following members are created by symindex_finish() */
+	GPtrArray *filelangs;		/* the Tbflang of every file */
+	GHashTable *names;			/* name -> index + 1 of the first symbol for jump with that name */
+	guint32 *next;				/* for every symbol the index + 1 of the next symbol for jump with the same name */
+	GHashTable *ac;				/* Tackey -> Tacindex */
+} Tsymindex;
+
+typedef struct {
+	Tscantable *st;
+	gchar *key;
+} Tsymlang;
+
+typedef struct {
+	gpointer bfwin;
+	GFile *basedir;
+	Tsymindex *index;			/* NULL until the first update is finished */
+	gpointer job;				/* the running Tsymjob */
+	guint refresh_id;
+	gboolean rerun;				/* an update was requested while the job was running */
+	guint retries;
+	guint generation;
+} Tsymbolindex;
+
+typedef struct {
+	gint cancelled;				/* atomic, set from the mainloop, checked in the worker */
+	Tsymbolindex *si;			/* only accessed in the mainloop, and only if not cancelled */
+	GFile *basedir;
+	gchar *cachefile;
+	GHashTable *lookup;			/* see langmgr_get_bflang_lookup() */
+	GHashTable *langs;			/* Tbflang -> Tsymlang, the languages with a scantable with identifier patterns */
+	GHashTable *unloaded;		/* Tbflang -> Tbflang, the languages that have no scantable yet */
+	/* the following members are only used by the worker, until the job is finished */
+	GHashTable *needlangs;		/* Tbflang -> mimetype, unloaded languages that the project uses */
+	Tsymindex *old;
+	GHashTable *oldfiles;		/* path -> index + 1 in old->files */
+	Tsymindex *result;
+	guint numfiles;
+	guint numscanned;
+} Tsymjob;
+
+static gboolean
+symindex_ac_equal(gconstpointer k1, gconstpointer k2)
+{
+	return (ACKEY(k1)->bflang == ACKEY(k2)->bflang && ACKEY(k1)->context == ACKEY(k2)->context);
+}
+
+static guint
+symindex_ac_hash(gconstpointer v)
+{
+	return g_direct_hash(ACKEY(v)->bflang) ^ ACKEY(v)->context;
+}
+
+static void
+symindex_ac_key_free(gpointer p)
+{
+	g_slice_free(Tackey, p);
+}
+
+static Tsymindex *
+symindex_new(void)
+{
+	Tsymindex *idx = g_slice_new0(Tsymindex);
+	idx->files = g_array_new(FALSE, FALSE, sizeof(Tsymfile));
+	idx->symbols = g_array_sized_new(FALSE, FALSE, sizeof(Tsymbol), 1024);
+	idx->strings = g_string_sized_new(4096);
+	idx->dedup = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	return idx;
+}
+
+static void
+symindex_free(Tsymindex * idx)
+{
+	g_array_free(idx->files, TRUE);
+	g_array_free(idx->symbols, TRUE);
+	g_string_free(idx->strings, TRUE);
+	if (idx->dedup)
+		g_hash_table_destroy(idx->dedup);
+	if (idx->filelangs)
+		g_ptr_array_free(idx->filelangs, TRUE);
+	if (idx->names)
+		g_hash_table_destroy(idx->names);
+	g_free(idx->next);
+	if (idx->ac)
+		g_hash_table_destroy(idx->ac);
+	g_slice_free(Tsymindex, idx);
+}
+
+#define symindex_str(idx, offset) ((idx)->strings->str + (offset))
+
+/* returns the offset of string (of len bytes) in idx->strings, it is added if it is not yet there */
+static guint32
+symindex_string(Tsymindex * idx, const gchar * string, gsize len)
+{
+	gchar *key = g_strndup(string, len);
+	gpointer offset = g_hash_table_lookup(idx->dedup, key);
+	if (offset) {
+		g_free(key);
+		return GPOINTER_TO_UINT(offset) - 1;
+	}
+	offset = GUINT_TO_POINTER(idx->strings->len + 1);
+	g_string_append_len(idx->strings, key, len + 1);
+	g_hash_table_insert(idx->dedup, key, offset);
+	return GPOINTER_TO_UINT(offset) - 1;
+}
+
+/* builds the lookup tables, after this no strings can be added anymore, because the
+hashtables point into idx->strings */
+static void
+symindex_finish(Tsymindex * idx, GPtrArray * filelangs)
+{
+	GHashTableIter iter;
+	gpointer aci;
+	guint i;
+	g_hash_table_destroy(idx->dedup);
+	idx->dedup = NULL;
+	idx->filelangs = filelangs;
+	idx->names = g_hash_table_new(g_str_hash, g_str_equal);
+	idx->next = g_new0(guint32, idx->symbols->len + 1);
+	idx->ac = g_hash_table_new_full(symindex_ac_hash, symindex_ac_equal, symindex_ac_key_free,
+									(GDestroyNotify) acindex_free);
+	/* backwards, so the chain of every name is in the order of the files */
+	for (i = idx->symbols->len; i > 0; i--) {
+		Tsymbol *sym = &g_array_index(idx->symbols, Tsymbol, i - 1);
+		if (sym->identaction & 1) {
+			gchar *name = symindex_str(idx, sym->name);
+			idx->next[i - 1] = GPOINTER_TO_UINT(g_hash_table_lookup(idx->names, name));
+			g_hash_table_insert(idx->names, name, GUINT_TO_POINTER(i));
+		}
+	}
+	for (i = 0; i < idx->symbols->len; i++) {
+		Tsymbol *sym = &g_array_index(idx->symbols, Tsymbol, i);
+		if (sym->identaction & 2) {
+			Tackey iak;
+			iak.bflang = g_ptr_array_index(idx->filelangs, sym->file);
+			iak.context = sym->context;
+			aci = g_hash_table_lookup(idx->ac, &iak);
+			if (!aci) {
+				Tackey *iakp = g_slice_new(Tackey);
+				*iakp = iak;
+				aci = acindex_new(FALSE);
+				g_hash_table_insert(idx->ac, iakp, aci);
+			}
+			acindex_add(aci, symindex_str(idx, sym->name));
+		}
+	}
+	g_hash_table_iter_init(&iter, idx->ac);
+	while (g_hash_table_iter_next(&iter, NULL, &aci)) {
+		acindex_finish(aci);
+	}
+}
+
+/* reads the index that was written by the previous update, the hashtables are not built,
+only the files and symbols are used */
+static Tsymindex *
+symindex_load(const gchar * filename)
+{
+	Tsymindex_header header;
+	Tsymindex *idx;
+	const Tsymfile *files;
+	const Tsymbol *symbols;
+	gchar *data;
+	gsize len, files_o, symbols_o, strings_o;
+	guint i;
+
+	if (!g_file_get_contents(filename, &data, &len, NULL))
+		return NULL;
+	if (len < sizeof(Tsymindex_header))
+		goto invalid;
+	memcpy(&header, data, sizeof(Tsymindex_header));
+	files_o = sizeof(Tsymindex_header);
+	symbols_o = files_o + (gsize) header.numfiles * sizeof(Tsymfile);
+	strings_o = symbols_o + (gsize) header.numsymbols * sizeof(Tsymbol);
+	if (memcmp(header.magic, SYMBOLINDEX_MAGIC, 8) != 0 || header.version != SYMBOLINDEX_VERSION
+		|| header.byteorder != SYMBOLINDEX_BYTEORDER || header.numfiles > len / sizeof(Tsymfile)
+		|| header.numsymbols > len / sizeof(Tsymbol) || strings_o + header.stringslen != len
+		|| header.stringslen == 0 || data[len - 1] != '\0')
+		goto invalid;
+	files = (const Tsymfile *) (data + files_o);
+	symbols = (const Tsymbol *) (data + symbols_o);
+	for (i = 0; i < header.numfiles; i++) {
+		if (files[i].path >= header.stringslen || files[i].lang >= header.stringslen
+			|| files[i].first > header.numsymbols || files[i].num > header.numsymbols - files[i].first)
+			goto invalid;
+	}
+	for (i = 0; i < header.numsymbols; i++) {
+		if (symbols[i].name >= header.stringslen || symbols[i].file >= header.numfiles)
+			goto invalid;
+	}
+	idx = g_slice_new0(Tsymindex);
+	idx->files = g_array_sized_new(FALSE, FALSE, sizeof(Tsymfile), header.numfiles);
+	g_array_append_vals(idx->files, files, header.numfiles);
+	idx->symbols = g_array_sized_new(FALSE, FALSE, sizeof(Tsymbol), header.numsymbols);
+	g_array_append_vals(idx->symbols, symbols, header.numsymbols);
+	idx->strings = g_string_new_len(data + strings_o, header.stringslen);
+	g_free(data);
+	DBG_SYMBOLINDEX("symindex_load, %d files and %d symbols from %s\n", header.numfiles, header.numsymbols,
+					filename);
+	return idx;
+  invalid:
+	DBG_SYMBOLINDEX("symindex_load, %s is invalid\n", filename);
+	g_free(data);
+	return NULL;
+}
+
+static void
+symindex_save(Tsymindex * idx, const gchar * filename)
+{
+	Tsymindex_header header;
+	GString *out;
+	gchar *dirname;
+	GError *gerror = NULL;
+
+	memset(&header, 0, sizeof(Tsymindex_header));
+	memcpy(header.magic, SYMBOLINDEX_MAGIC, 8);
+	header.version = SYMBOLINDEX_VERSION;
+	header.byteorder = SYMBOLINDEX_BYTEORDER;
+	header.numfiles = idx->files->len;
+	header.numsymbols = idx->symbols->len;
+	header.stringslen = idx->strings->len;
+	out = g_string_sized_new(sizeof(Tsymindex_header) + idx->files->len * sizeof(Tsymfile)
+							 + idx->symbols->len * sizeof(Tsymbol) + idx->strings->len);
+	g_string_append_len(out, (gchar *) & header, sizeof(Tsymindex_header));
+	g_string_append_len(out, idx->files->data, idx->files->len * sizeof(Tsymfile));
+	g_string_append_len(out, idx->symbols->data, idx->symbols->len * sizeof(Tsymbol));
+	g_string_append_len(out, idx->strings->str, idx->strings->len);
+	dirname = g_path_get_dirname(filename);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+	if (!g_file_set_contents(filename, out->str, out->len, &gerror)) {
+		g_warning("failed to write symbol index %s: %s\n", filename, gerror->message);
+		g_error_free(gerror);
+	}
+	g_string_free(out, TRUE);
+}
+
+static void
+symjob_add_symbol(Tsymindex * idx, guint32 file, const gchar * start, const gchar * end, guint line,
+				  gint16 context, guint8 identaction)
+{
+	Tsymbol sym;
+	if (end <= start || !identaction)
+		return;
+	sym.name = symindex_string(idx, start, end - start);
+	sym.file = file;
+	sym.line = line;
+	sym.context = context;
+	sym.identaction = identaction;
+	sym.padding = 0;
+	g_array_append_val(idx->symbols, sym);
+}
+
+typedef struct {
+	Tsymindex *idx;
+	guint32 file;
+	const gchar *counted;		/* the newlines are counted up to here */
+	guint line;
+} Tsymscan;
+
+static gboolean
+symjob_identifier(Tdfarun * run, gint16 context)
+{
+	Tsymscan *ss = run->data;
+	for (; ss->counted < run->p; ss->counted++) {
+		if (*ss->counted == '\n')
+			ss->line++;
+	}
+	symjob_add_symbol(ss->idx, ss->file, run->mstart, run->p, ss->line, context, run->identaction);
+	return TRUE;
+}
+
+/* runs the same dfa_run() as the scanner of an open document, but only the identifiers are collected,
+exactly like found_identifier() would store them if the file was opened. Lines start at 1 */
+static void
+symjob_scan(Tsymindex * idx, guint32 file, Tscantable * st, const gchar * buf, gsize buflen)
+{
+	GArray *stack = g_array_sized_new(FALSE, FALSE, sizeof(gint16), 16);
+	Tsymscan ss;
+	Tdfarun run;
+
+	ss.idx = idx;
+	ss.file = file;
+	ss.counted = buf;
+	ss.line = 1;
+	dfarun_init(&run, st, stack, buf, buf + buflen, 0, G_MAXUINT32);
+	run.match = dfarun_context_change;
+	run.identifier = symjob_identifier;
+	run.data = &ss;
+	dfa_run(&run, G_MAXUINT);
+	g_array_free(stack, TRUE);
+}
+
+/* like langmgr_get_bflang(), but with the copy of the lookup table, and it does not load the language */
+static Tbflang *
+symjob_get_bflang(Tsymjob * job, const gchar * conttype, const gchar * filename)
+{
+	Tbflang *bflang = NULL;
+	gchar *mimetype;
+	if (!conttype)
+		return NULL;
+#ifdef WIN32
+	mimetype = g_content_type_get_mime_type(conttype);
+	if (!mimetype)
+		return NULL;
+#else
+	mimetype = g_strdup(conttype);
+#endif
+	if (strchr(mimetype, '?') == NULL) {
+		gchar *key = mime_with_extension(mimetype, filename);
+		bflang = g_hash_table_lookup(job->lookup, key);
+		g_free(key);
+	}
+	if (!bflang)
+		bflang = g_hash_table_lookup(job->lookup, mimetype);
+	if (bflang && g_hash_table_lookup(job->unloaded, bflang) && !g_hash_table_lookup(job->needlangs, bflang)) {
+		g_hash_table_insert(job->needlangs, bflang, mimetype);
+		return NULL;
+	}
+	g_free(mimetype);
+	return bflang;
+}
+
+static void
+symjob_index_file(Tsymjob * job, Tsymindex * idx, GPtrArray * filelangs, GFile * uri, GFileInfo * finfo,
+				  const gchar * relpath)
+{
+	Tbflang *bflang;
+	Tsymlang *sl;
+	Tsymfile sf;
+	gpointer oldfile;
+	gboolean reused = FALSE;
+
+	if (g_file_info_get_size(finfo) > SYMBOLINDEX_MAX_FILESIZE)
+		return;
+	bflang = symjob_get_bflang(job, g_file_info_get_attribute_string(finfo, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE),
+							   g_file_info_get_name(finfo));
+	sl = bflang ? g_hash_table_lookup(job->langs, bflang) : NULL;
+	if (!sl)
+		return;
+	sf.path = symindex_string(idx, relpath, strlen(relpath));
+	sf.lang = symindex_string(idx, sl->key, strlen(sl->key));
+	sf.mtime = g_file_info_get_attribute_uint64(finfo, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	sf.first = idx->symbols->len;
+	oldfile = job->oldfiles ? g_hash_table_lookup(job->oldfiles, relpath) : NULL;
+	if (oldfile) {
+		Tsymfile *osf = &g_array_index(job->old->files, Tsymfile, GPOINTER_TO_UINT(oldfile) - 1);
+		if (osf->mtime == sf.mtime && strcmp(symindex_str(job->old, osf->lang), sl->key) == 0) {
+			guint i;
+			for (i = osf->first; i < osf->first + osf->num; i++) {
+				Tsymbol sym = g_array_index(job->old->symbols, Tsymbol, i);
+				const gchar *name = symindex_str(job->old, sym.name);
+				sym.name = symindex_string(idx, name, strlen(name));
+				sym.file = idx->files->len;
+				g_array_append_val(idx->symbols, sym);
+			}
+			reused = TRUE;
+		}
+	}
+	if (!reused) {
+		gchar *buf;
+		gsize buflen;
+		if (!g_file_load_contents(uri, NULL, &buf, &buflen, NULL, NULL))
+			return;
+		/* the document would be converted when it is opened, that is not done here */
+		if (g_utf8_validate(buf, buflen, NULL))
+			symjob_scan(idx, idx->files->len, sl->st, buf, buflen);
+		g_free(buf);
+		job->numscanned++;
+	}
+	sf.num = idx->symbols->len - sf.first;
+	g_array_append_val(idx->files, sf);
+	g_ptr_array_add(filelangs, bflang);
+}
+
+static void
+symjob_walk(Tsymjob * job, Tsymindex * idx, GPtrArray * filelangs, GFile * dir, const gchar * relpath)
+{
+	GFileEnumerator *en;
+	GFileInfo *finfo;
+
+	en = g_file_enumerate_children(dir, "standard::name,standard::type,standard::size,standard::is-hidden,"
+								   "standard::fast-content-type,time::modified",
+								   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+	if (!en)
+		return;
+	while ((finfo = g_file_enumerator_next_file(en, NULL, NULL))) {
+		const gchar *name = g_file_info_get_name(finfo);
+		GFileType type = g_file_info_get_file_type(finfo);
+		if (g_atomic_int_get(&job->cancelled) || job->numfiles >= SYMBOLINDEX_MAX_FILES) {
+			g_object_unref(finfo);
+			break;
+		}
+		/* hidden files and directories, such as .git and .svn, are skipped */
+		if (!g_file_info_get_is_hidden(finfo) && name[0] != '.'
+			&& (type == G_FILE_TYPE_DIRECTORY || type == G_FILE_TYPE_REGULAR)) {
+			GFile *child = g_file_get_child(dir, name);
+			gchar *childpath = relpath ? g_strconcat(relpath, "/", name, NULL) : g_strdup(name);
+			if (type == G_FILE_TYPE_DIRECTORY) {
+				symjob_walk(job, idx, filelangs, child, childpath);
+			} else {
+				job->numfiles++;
+				symjob_index_file(job, idx, filelangs, child, finfo, childpath);
+			}
+			g_free(childpath);
+			g_object_unref(child);
+		}
+		g_object_unref(finfo);
+	}
+	g_file_enumerator_close(en, NULL, NULL);
+	g_object_unref(en);
+}
+
+static gboolean symjob_finished_lcb(gpointer data);
+
+static gpointer
+symjob_thread(gpointer data)
+{
+	Tsymjob *job = data;
+	GPtrArray *filelangs = g_ptr_array_new();
+	Tsymindex *idx = symindex_new();
+
+	job->old = symindex_load(job->cachefile);
+	if (job->old) {
+		guint i;
+		job->oldfiles = g_hash_table_new(g_str_hash, g_str_equal);
+		for (i = 0; i < job->old->files->len; i++) {
+			g_hash_table_insert(job->oldfiles,
+								symindex_str(job->old, g_array_index(job->old->files, Tsymfile, i).path),
+								GUINT_TO_POINTER(i + 1));
+		}
+	}
+	symjob_walk(job, idx, filelangs, job->basedir, NULL);
+	if (!g_atomic_int_get(&job->cancelled)) {
+		symindex_save(idx, job->cachefile);
+		symindex_finish(idx, filelangs);
+		DBG_SYMBOLINDEX("symjob_thread, %d files, %d scanned, %d symbols\n", job->numfiles, job->numscanned,
+						idx->symbols->len);
+	} else {
+		g_ptr_array_free(filelangs, TRUE);
+	}
+	job->result = idx;
+	g_idle_add(symjob_finished_lcb, job);
+	return NULL;
+}
+
+static void
+symjob_free(Tsymjob * job)
+{
+	if (job->result)
+		symindex_free(job->result);
+	if (job->old)
+		symindex_free(job->old);
+	if (job->oldfiles)
+		g_hash_table_destroy(job->oldfiles);
+	g_hash_table_destroy(job->needlangs);
+	g_hash_table_destroy(job->unloaded);
+	g_hash_table_destroy(job->langs);
+	g_hash_table_destroy(job->lookup);
+	g_free(job->cachefile);
+	g_object_unref(job->basedir);
+	g_slice_free(Tsymjob, job);
+}
+
+static void
+symjob_lang_free(gpointer data)
+{
+	g_free(((Tsymlang *) data)->key);
+	g_slice_free(Tsymlang, data);
+}
+
+static gboolean
+scantable_has_identifiers(Tscantable * st)
+{
+	guint i;
+	for (i = 0; i < st->matches->len; i++) {
+		if (g_array_index(st->matches, Tpattern, i).identaction)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+symjob_start(Tsymbolindex * si)
+{
+	Tsymjob *job;
+	GList *tmplist, *langs;
+	gchar *uri, *md5;
+	GError *gerror = NULL;
+
+	job = g_slice_new0(Tsymjob);
+	job->si = si;
+	job->basedir = g_object_ref(si->basedir);
+	uri = g_file_get_uri(si->basedir);
+	md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri, -1);
+	job->cachefile = g_strconcat(g_get_home_dir(), "/." PACKAGE "/cache/", md5, ".symbolindex", NULL);
+	g_free(md5);
+	g_free(uri);
+	job->lookup = langmgr_get_bflang_lookup();
+	job->langs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, symjob_lang_free);
+	job->unloaded = g_hash_table_new(g_direct_hash, g_direct_equal);
+	job->needlangs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	/* the worker does not touch the Tbflang, the scantables are never freed while bluefish runs */
+	langs = langmgr_get_languages();
+	for (tmplist = g_list_first(langs); tmplist; tmplist = tmplist->next) {
+		Tbflang *bflang = tmplist->data;
+		if (bflang->st && scantable_has_identifiers(bflang->st)) {
+			Tsymlang *sl = g_slice_new(Tsymlang);
+			sl->st = bflang->st;
+			sl->key = langmgr_scantable_key(bflang);
+			g_hash_table_insert(job->langs, bflang, sl);
+		} else if (!bflang->st && bflang->filename && !bflang->no_st) {
+			g_hash_table_insert(job->unloaded, bflang, bflang);
+		}
+	}
+	g_list_free(langs);
+	si->job = job;
+	g_thread_create(symjob_thread, job, FALSE, &gerror);
+	if (gerror) {
+		g_warning("failed to start symbol index thread: %s\n", gerror->message);
+		g_error_free(gerror);
+		si->job = NULL;
+		symjob_free(job);
+	}
+}
+
+static gboolean
+symbolindex_refresh_lcb(gpointer data)
+{
+	Tsymbolindex *si = data;
+	/* the languages are known only after the language manager has scanned the bflang2 files */
+	if (!langmgr_done_scanning())
+		return TRUE;
+	si->refresh_id = 0;
+	if (si->job) {
+		si->rerun = TRUE;
+		return FALSE;
+	}
+	symjob_start(si);
+	return FALSE;
+}
+
+/* runs in the mainloop */
+static gboolean
+symjob_finished_lcb(gpointer data)
+{
+	Tsymjob *job = data;
+	Tsymbolindex *si = job->si;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (g_atomic_int_get(&job->cancelled)) {
+		symjob_free(job);
+		return FALSE;
+	}
+	si->job = NULL;
+	if (si->index)
+		symindex_free(si->index);
+	si->index = job->result;
+	job->result = NULL;
+	/* a Tacrange of an autocompletion popup may still point to an index that was just freed,
+	   if a new index has the same address it should not be narrowed, see acindex_complete() */
+	si->generation++;
+	g_hash_table_iter_init(&iter, si->index->ac);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		((Tacindex *) value)->changes = si->generation;
+	}
+	/* request the languages that the project uses but that were not yet loaded, and update again */
+	if (g_hash_table_size(job->needlangs) > 0 && si->retries < SYMBOLINDEX_MAX_RETRIES) {
+		g_hash_table_iter_init(&iter, job->needlangs);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			langmgr_get_bflang(value, NULL);
+		}
+		si->retries++;
+		si->rerun = TRUE;
+	}
+	symjob_free(job);
+	if (si->rerun) {
+		si->rerun = FALSE;
+		symbolindex_refresh(si->bfwin);
+	}
+	return FALSE;
+}
+
+/* the basedir of a project is the last directory that was set as basedir in the filebrowser */
+static GFile *
+symbolindex_project_basedir(Tbfwin * bfwin)
+{
+	const gchar *tmp;
+	if (!bfwin->project || !bfwin->session->recent_dirs)
+		return NULL;
+	tmp = (const gchar *) ((GList *) g_list_first(bfwin->session->recent_dirs))->data;
+	if (!tmp || !tmp[0])
+		return NULL;
+	return g_file_new_for_uri(strip_trailing_slash((gchar *) tmp));
+}
+
+/* (re)starts the index for the project of bfwin, the first update runs after SYMBOLINDEX_REFRESH_SECONDS */
+void
+symbolindex_start(gpointer bfwin)
+{
+	Tsymbolindex *si;
+	GFile *basedir;
+
+	symbolindex_stop(bfwin);
+	basedir = symbolindex_project_basedir(BFWIN(bfwin));
+	if (!basedir)
+		return;
+	/* walking a remote project would take too long */
+	if (!g_file_is_native(basedir)) {
+		g_object_unref(basedir);
+		return;
+	}
+	si = g_slice_new0(Tsymbolindex);
+	si->bfwin = bfwin;
+	si->basedir = basedir;
+	BFWIN(bfwin)->symbolindex = si;
+	symbolindex_refresh(bfwin);
+}
+
+/* schedules an update, only the files with a different modification time are scanned again */
+void
+symbolindex_refresh(gpointer bfwin)
+{
+	Tsymbolindex *si = BFWIN(bfwin)->symbolindex;
+	if (!si || si->refresh_id)
+		return;
+	si->refresh_id = g_timeout_add_seconds(SYMBOLINDEX_REFRESH_SECONDS, symbolindex_refresh_lcb, si);
+}
+
+void
+symbolindex_stop(gpointer bfwin)
+{
+	Tsymbolindex *si = BFWIN(bfwin)->symbolindex;
+	if (!si)
+		return;
+	if (si->refresh_id)
+		g_source_remove(si->refresh_id);
+	/* the job is freed by symjob_finished_lcb() */
+	if (si->job)
+		g_atomic_int_set(&((Tsymjob *) si->job)->cancelled, 1);
+	if (si->index)
+		symindex_free(si->index);
+	g_object_unref(si->basedir);
+	g_slice_free(Tsymbolindex, si);
+	BFWIN(bfwin)->symbolindex = NULL;
+}
+
+/* returns the file with the jump location for name, and sets line, or returns NULL */
+GFile *
+symbolindex_lookup(gpointer bfwin, gpointer bflang, gint16 context, const gchar * name, guint * line)
+{
+	Tsymbolindex *si = BFWIN(bfwin)->symbolindex;
+	guint32 i;
+	if (!si || !si->index)
+		return NULL;
+	for (i = GPOINTER_TO_UINT(g_hash_table_lookup(si->index->names, name)); i; i = si->index->next[i - 1]) {
+		Tsymbol *sym = &g_array_index(si->index->symbols, Tsymbol, i - 1);
+		if (sym->context == context && g_ptr_array_index(si->index->filelangs, sym->file) == bflang) {
+			Tsymfile *sf = &g_array_index(si->index->files, Tsymfile, sym->file);
+			*line = sym->line;
+			return g_file_resolve_relative_path(si->basedir, symindex_str(si->index, sf->path));
+		}
+	}
+	return NULL;
+}
+
+Tacindex *
+symbolindex_ac_get_index(gpointer bfwin, gpointer bflang, gint16 context)
+{
+	Tsymbolindex *si = BFWIN(bfwin)->symbolindex;
+	Tackey iak;
+	if (!si || !si->index)
+		return NULL;
+	iak.bflang = bflang;
+	iak.context = context;
+	return g_hash_table_lookup(si->index->ac, &iak);
+}
+
+#endif							/* IDENTSTORING */
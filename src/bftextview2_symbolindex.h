@@ -0,0 +1,41 @@
+/* Bluefish HTML Editor
+ * bftextview2_symbolindex.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_SYMBOLINDEX_H_
+#define _BFTEXTVIEW2_SYMBOLINDEX_H_
+
+#include "bftextview2.h"
+#include "bftextview2_acindex.h"
+
+#ifdef IDENTSTORING
+
+#define SYMBOLINDEX_REFRESH_SECONDS 5	/* the delay before an update after the project is opened or a file is saved */
+#define SYMBOLINDEX_MAX_FILESIZE (2 * 1024 * 1024)	/* larger files are not indexed */
+#define SYMBOLINDEX_MAX_FILES 100000	/* the indexer stops walking the project after this number of files */
+#define SYMBOLINDEX_MAX_RETRIES 3	/* the number of updates to pick up languages that were not yet loaded */
+
+void symbolindex_start(gpointer bfwin);
+void symbolindex_refresh(gpointer bfwin);
+void symbolindex_stop(gpointer bfwin);
+GFile *symbolindex_lookup(gpointer bfwin, gpointer bflang, gint16 context, const gchar * name, guint * line);
+Tacindex *symbolindex_ac_get_index(gpointer bfwin, gpointer bflang, gint16 context);
+
+#endif							/* IDENTSTORING */
+#endif							/* _BFTEXTVIEW2_SYMBOLINDEX_H_ */
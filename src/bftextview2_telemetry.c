@@ -0,0 +1,229 @@
+/* Bluefish HTML Editor
+ * bftextview2_telemetry.c
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+
+#include <string.h>
+
+#include "bluefish.h"
+#include "bftextview2_scheduler.h"
+#include "bftextview2_telemetry.h"
+
+/*#define DBG_TELEMETRY g_print*/
+#define DBG_TELEMETRY(args...)
+
+gboolean scantelemetry_active = FALSE;
+
+static struct {
+	Tscantelemetry *records;
+	guint next;					/* the index of the next record to write */
+	guint count;				/* the number of valid records */
+	GTimer *timer;
+	gchar *exportfile;			/* from BLUEFISH_SCAN_TELEMETRY, written on exit */
+} stm = { NULL, 0, 0, NULL, NULL };
+
+static const gchar *kindnames[] = { "scan", "viewport", "largefile_window", "largefile_checkpoints" };
+
+void
+scantelemetry_set_active(gboolean active)
+{
+	if (active && !stm.records) {
+		stm.records = g_new0(Tscantelemetry, SCANTELEMETRY_RECORDS);
+		stm.timer = g_timer_new();
+	}
+	scantelemetry_active = active;
+	DBG_TELEMETRY("scantelemetry_set_active, active=%d, %d records\n", active, stm.count);
+}
+
+void
+scantelemetry_init(void)
+{
+	const gchar *env = g_getenv("BLUEFISH_SCAN_TELEMETRY");
+	if (!env || env[0] == '\0')
+		return;
+	if (strcmp(env, "1") != 0)
+		stm.exportfile = g_strdup(env);
+	scantelemetry_set_active(TRUE);
+}
+
+/* returns the record for a run that took duration seconds and ended now, the caller fills in the rest */
+Tscantelemetry *
+scantelemetry_record(BluefishTextView * btv, Tscantelemetry_kind kind, gdouble duration)
+{
+	Tscantelemetry *rec = &stm.records[stm.next];
+	g_free(rec->docname);
+	memset(rec, 0, sizeof(Tscantelemetry));
+	rec->start = g_timer_elapsed(stm.timer, NULL) - duration;
+	rec->kind = kind;
+	rec->schedqueue = bftextview2_scheduler_queue_length();
+	rec->schedtime = 1000.0 * bftextview2_scheduler_time_spent(btv);
+	if (btv->doc && DOCUMENT(btv->doc)->uri)
+		rec->docname = g_file_get_parse_name(DOCUMENT(btv->doc)->uri);
+	else
+		rec->docname = g_strdup_printf("untitled %p", btv->doc);
+	stm.next = (stm.next + 1) % SCANTELEMETRY_RECORDS;
+	if (stm.count < SCANTELEMETRY_RECORDS)
+		stm.count++;
+	return rec;
+}
+
+static void
+json_append_string(GString * str, const gchar * value)
+{
+	const gchar *p;
+	g_string_append_c(str, '"');
+	for (p = value; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			g_string_append_c(str, '\\');
+			g_string_append_c(str, *p);
+		} else if ((guchar) * p < 0x20) {
+			g_string_append_printf(str, "\\u%04x", (guchar) * p);
+		} else {
+			g_string_append_c(str, *p);
+		}
+	}
+	g_string_append_c(str, '"');
+}
+
+static void
+json_append_counters(GString * str, Tscantelemetry * rec)
+{
+	g_string_append_printf(str,
+						   "\"start\":%u,\"end\":%u,\"chars\":%u,\"loops\":%u,\"matches\":%u,"
+						   "\"contextpush\":%u,\"contextpop\":%u,\"blockpush\":%u,\"blockpop\":%u,"
+						   "\"foundcache\":%u,\"arena_kb\":%u,\"schedqueue\":%u,\"schedtime_ms\":%.3f", rec->start_o,
+						   rec->end_o, rec->numchars, rec->numloops, rec->nummatches, rec->numcontextpush,
+						   rec->numcontextpop, rec->numblockpush, rec->numblockpop, rec->foundcache_len,
+						   rec->arena_kb, rec->schedqueue, rec->schedtime);
+}
+
+/* the tid of a document in the Chrome trace, so every document gets its own row */
+static guint
+chrometrace_tid(GHashTable * tids, const gchar * docname)
+{
+	guint tid = GPOINTER_TO_UINT(g_hash_table_lookup(tids, docname));
+	if (!tid) {
+		tid = g_hash_table_size(tids) + 1;
+		g_hash_table_insert(tids, (gpointer) docname, GUINT_TO_POINTER(tid));
+	}
+	return tid;
+}
+
+static void
+chrometrace_append_event(GString * str, const gchar * name, guint tid, gdouble start, gdouble duration_ms)
+{
+	g_string_append(str, "{\"name\":");
+	json_append_string(str, name);
+	g_string_append_printf(str, ",\"cat\":\"scanner\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,\"dur\":%.0f",
+						   tid, start * 1000000.0, duration_ms * 1000.0);
+}
+
+gboolean
+scantelemetry_export(const gchar * filename, gboolean chrometrace, GError ** gerror)
+{
+	static const gchar *stagenames[] = { "find region", "reconstruct", "remove tags", "scan" };
+	GString *str = g_string_sized_new(256 * stm.count + 64);
+	GHashTable *tids = NULL;
+	gboolean ret;
+	guint i, j;
+
+	if (chrometrace) {
+		tids = g_hash_table_new(g_str_hash, g_str_equal);
+		g_string_append(str, "{\"traceEvents\":[\n");
+	} else {
+		g_string_append(str, "{\"records\":[\n");
+	}
+	for (i = 0; i < stm.count; i++) {
+		Tscantelemetry *rec =
+			&stm.records[(stm.next + SCANTELEMETRY_RECORDS - stm.count + i) % SCANTELEMETRY_RECORDS];
+		gdouble duration = rec->stage[0] + rec->stage[1] + rec->stage[2] + rec->stage[3];
+		if (chrometrace) {
+			guint tid = chrometrace_tid(tids, rec->docname);
+			gdouble stagestart = rec->start;
+			chrometrace_append_event(str, kindnames[rec->kind], tid, rec->start, duration);
+			g_string_append(str, ",\"args\":{\"document\":");
+			json_append_string(str, rec->docname);
+			g_string_append_c(str, ',');
+			json_append_counters(str, rec);
+			g_string_append(str, "}},\n");
+			for (j = 0; j < 4; j++) {
+				if (rec->stage[j] > 0) {
+					chrometrace_append_event(str, stagenames[j], tid, stagestart, rec->stage[j]);
+					g_string_append(str, "},\n");
+				}
+				stagestart += rec->stage[j] / 1000.0;
+			}
+		} else {
+			g_string_append_printf(str, "{\"time\":%.6f,\"kind\":\"%s\",\"document\":", rec->start,
+								   kindnames[rec->kind]);
+			json_append_string(str, rec->docname);
+			g_string_append_printf(str, ",\"duration_ms\":%.3f,\"stages_ms\":[%.3f,%.3f,%.3f,%.3f],", duration,
+								   rec->stage[0], rec->stage[1], rec->stage[2], rec->stage[3]);
+			json_append_counters(str, rec);
+			g_string_append(str, i + 1 < stm.count ? "},\n" : "}\n");
+		}
+	}
+	if (chrometrace) {
+		GHashTableIter hiter;
+		gpointer key, value;
+		/* the metadata events name the row of each document */
+		g_hash_table_iter_init(&hiter, tids);
+		while (g_hash_table_iter_next(&hiter, &key, &value)) {
+			g_string_append_printf(str, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+								   GPOINTER_TO_UINT(value));
+			json_append_string(str, key);
+			g_string_append(str, "}},\n");
+		}
+		g_string_append(str, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"bluefish scanner\"}}\n");
+		g_hash_table_destroy(tids);
+	}
+	g_string_append(str, "]}\n");
+	ret = g_file_set_contents(filename, str->str, str->len, gerror);
+	DBG_TELEMETRY("scantelemetry_export, wrote %d records to %s, ret=%d\n", stm.count, filename, ret);
+	g_string_free(str, TRUE);
+	return ret;
+}
+
+/* writes the file from BLUEFISH_SCAN_TELEMETRY, and frees all memory */
+void
+scantelemetry_cleanup(void)
+{
+	guint i;
+	if (stm.exportfile) {
+		GError *gerror = NULL;
+		gboolean chrometrace = (g_str_has_suffix(stm.exportfile, ".trace")
+								|| g_str_has_suffix(stm.exportfile, ".trace.json"));
+		if (!scantelemetry_export(stm.exportfile, chrometrace, &gerror)) {
+			g_warning("failed to write scanner telemetry to %s: %s\n", stm.exportfile, gerror->message);
+			g_error_free(gerror);
+		}
+		g_free(stm.exportfile);
+		stm.exportfile = NULL;
+	}
+	scantelemetry_active = FALSE;
+	if (stm.records) {
+		for (i = 0; i < SCANTELEMETRY_RECORDS; i++)
+			g_free(stm.records[i].docname);
+		g_free(stm.records);
+		stm.records = NULL;
+		g_timer_destroy(stm.timer);
+		stm.timer = NULL;
+	}
+	stm.next = stm.count = 0;
+}
@@ -0,0 +1,65 @@
+/* Bluefish HTML Editor
+ * bftextview2_telemetry.h
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for the design docs see bftextview2.h */
+#ifndef _BFTEXTVIEW2_TELEMETRY_H_
+#define _BFTEXTVIEW2_TELEMETRY_H_
+
+#include "bftextview2.h"
+
+#define SCANTELEMETRY_RECORDS 4096	/* the size of the ring buffer, older runs are overwritten */
+
+typedef enum {
+	scantelemetry_scan,			/* a run of the regular scanning */
+	scantelemetry_viewport,		/* a provisional scan of the visible window */
+	scantelemetry_largefile_window,	/* large-file mode, highlighting of a window */
+	scantelemetry_largefile_checkpoints	/* large-file mode, scanning for checkpoints */
+} Tscantelemetry_kind;
+
+/* one scanning run. The four stages of a regular run are: finding the region, reconstructing
+the stacks, removing the old highlighting, and the scanning loop with applying the tags */
+typedef struct {
+	gdouble start;				/* seconds since the telemetry was started */
+	gdouble stage[4];			/* milliseconds */
+	gchar *docname;
+	guint start_o;
+	guint end_o;
+	guint numchars;
+	guint numloops;
+	guint nummatches;
+	guint numcontextpush;
+	guint numcontextpop;
+	guint numblockpush;
+	guint numblockpop;
+	guint foundcache_len;		/* the number of Tfound's in the scancache, or checkpoints in large-file mode */
+	guint arena_kb;				/* the memory of the scanning arena after the run */
+	guint schedqueue;			/* the number of documents in the scheduler queue */
+	gdouble schedtime;			/* milliseconds that the scheduler spent on this document before this run */
+	Tscantelemetry_kind kind;
+} Tscantelemetry;
+
+extern gboolean scantelemetry_active;
+
+void scantelemetry_init(void);
+void scantelemetry_set_active(gboolean active);
+Tscantelemetry *scantelemetry_record(BluefishTextView * btv, Tscantelemetry_kind kind, gdouble duration);
+gboolean scantelemetry_export(const gchar * filename, gboolean chrometrace, GError ** gerror);
+void scantelemetry_cleanup(void);
+
+#endif							/* _BFTEXTVIEW2_TELEMETRY_H_ */
@@ -46,9 +46,11 @@
 #include "project.h"
 #include "rcfile.h"
 #include "snr3.h"
+#include "snr3_trigram.h"
 
 #ifdef IDENTSTORING
 #include "bftextview2_identifier.h"
+#include "bftextview2_symbolindex.h"
 #endif /* IDENTSTORING */
 
 #ifdef HAVE_LIBENCHANT
@@ -556,8 +558,10 @@ bfwin_destroy_and_cleanup(Tbfwin *bfwin)
 	}
 	DEBUG_MSG("bfwin_cleanup, finished unref actiongroups\n");
 #ifdef IDENTSTORING
+	symbolindex_stop(bfwin);
 	bftextview2_identifier_hash_destroy(bfwin);
 #endif
+	trigramindex_stop(bfwin);
 
 	DEBUG_MSG("bfwin_cleanup, going to free bfwin %p\n", bfwin);
 	g_free(bfwin);
@@ -28,6 +28,7 @@
 #include "bfwin.h"
 #include "bftextview2.h"
 #include "bftextview2_langmgr.h"
+#include "bftextview2_telemetry.h"
 #include "blocksync.h"
 #include "bookmark.h"
 #include "document.h"
@@ -38,6 +39,7 @@
 #include "encodings_dialog.h"
 #include "external_commands.h"
 #include "file_dialogs.h"
+#include "gtk_easy.h"
 #include "outputbox.h"
 #include "preferences.h"
 #include "project.h"
@@ -725,6 +727,62 @@ ui_word_count(GtkAction * action, gpointer user_data)
 		doc_word_count(bfwin);
 }
 
+static void
+ui_scanner_telemetry_toggle(GtkAction * action, gpointer user_data)
+{
+	scantelemetry_set_active(gtk_toggle_action_get_active(GTK_TOGGLE_ACTION(action)));
+}
+
+static void
+scanner_telemetry_export_lcb(GtkDialog * dialog, gint response, gpointer user_data)
+{
+	Tbfwin *bfwin = BFWIN(user_data);
+
+	if (response == GTK_RESPONSE_ACCEPT) {
+		GError *gerror = NULL;
+		gchar *filename, *message;
+		gboolean chrometrace = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(dialog), "chrometrace"));
+
+		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+		if (scantelemetry_export(filename, chrometrace, &gerror)) {
+			message = g_strdup_printf(_("Scanner telemetry saved to %s"), filename);
+		} else {
+			message = g_strdup_printf(_("Failed to save scanner telemetry: %s"), gerror->message);
+			g_error_free(gerror);
+		}
+		bfwin_statusbar_message(bfwin, message, 3);
+		g_free(message);
+		g_free(filename);
+	}
+	gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+static void
+scanner_telemetry_export(Tbfwin * bfwin, gboolean chrometrace)
+{
+	GtkWidget *dialog;
+
+	dialog =
+		file_chooser_dialog(bfwin, _("Save scanner telemetry"), GTK_FILE_CHOOSER_ACTION_SAVE,
+							chrometrace ? "scanner.trace.json" : "scanner-telemetry.json", TRUE, FALSE, NULL,
+							FALSE);
+	g_object_set_data(G_OBJECT(dialog), "chrometrace", GINT_TO_POINTER(chrometrace));
+	g_signal_connect(dialog, "response", G_CALLBACK(scanner_telemetry_export_lcb), bfwin);
+	gtk_widget_show_all(dialog);
+}
+
+static void
+ui_scanner_telemetry_export_json(GtkAction * action, gpointer user_data)
+{
+	scanner_telemetry_export(BFWIN(user_data), FALSE);
+}
+
+static void
+ui_scanner_telemetry_export_trace(GtkAction * action, gpointer user_data)
+{
+	scanner_telemetry_export(BFWIN(user_data), TRUE);
+}
+
 static void
 ui_lorem_ipsum(GtkAction * action, gpointer user_data)
 {
@@ -891,6 +949,11 @@ static const GtkActionEntry global_actions[] = {
 	 {"DeleteLine", NULL, N_("_Delete Line"), "<control>y", N_("Delete the current line"),
 	 G_CALLBACK(ui_delete_line)},
 	{"WordCount", NULL, N_("_Word Count"), NULL, N_("Word count"), G_CALLBACK(ui_word_count)},
+	{"ScannerTelemetryExportJSON", NULL, N_("Save Scanner Telemetry as _JSON..."), NULL,
+	 N_("Save the recorded scanner telemetry as JSON"), G_CALLBACK(ui_scanner_telemetry_export_json)},
+	{"ScannerTelemetryExportTrace", NULL, N_("Save Scanner Telemetry as T_race..."), NULL,
+	 N_("Save the recorded scanner telemetry in Chrome trace format"),
+	 G_CALLBACK(ui_scanner_telemetry_export_trace)},
 	{"LoremIpsum", NULL, N_("Lorem Ipsum generator"), NULL, N_("Lorem Ipsum generator"), G_CALLBACK(ui_lorem_ipsum)},
 	{"RelativeFilename", NULL, N_("Insert Relative Filename"), NULL, N_("Insert Relative Filename"), G_CALLBACK(ui_insert_relative_filename)},
 	{"AbsoluteFilename", NULL, N_("Insert Absolute Filename"), NULL, N_("Insert Absolute Filename"), G_CALLBACK(ui_insert_absolute_filename)},
@@ -915,6 +978,8 @@ static const GtkActionEntry global_actions[] = {
 static const GtkToggleActionEntry global_toggle_actions[] = {
 	{"ViewFullScreen", GTK_STOCK_FULLSCREEN, N_("_Full Screen"), "F11", N_("Full screen"),
 	 G_CALLBACK(ui_fullscreen_toggle), FALSE},
+	{"ScannerTelemetry", NULL, N_("Record Scanner _Telemetry"), NULL,
+	 N_("Record the timing of the syntax scanner"), G_CALLBACK(ui_scanner_telemetry_toggle), FALSE},
 	{"ViewMainToolbar", NULL, N_("_Main Toolbar"), NULL, N_("Show main toolbar"),
 	 G_CALLBACK(ui_main_toolbar_show), TRUE},
 	{"ViewSidePane", NULL, N_("_Side Pane"), "F9", N_("Show side pane"), G_CALLBACK(ui_side_pane_show), TRUE},
@@ -1278,6 +1343,7 @@ bfwin_main_ui_init(Tbfwin * bfwin, GtkWidget * vbox)
 	bfwin_set_menu_toggle_item_from_path(bfwin->uimanager, "/MainMenu/ViewMenu/ViewSidePane", bfwin->session->view_left_panel);
 	bfwin_set_menu_toggle_item_from_path(bfwin->uimanager, "/MainMenu/ViewMenu/ViewMainToolbar", bfwin->session->view_main_toolbar);
 	bfwin_set_menu_toggle_item_from_path(bfwin->uimanager, "/MainMenu/ViewMenu/ViewStatusbar", bfwin->session->view_statusbar);
+	bfwin_set_menu_toggle_item_from_path(bfwin->uimanager, "/MainMenu/ToolsMenu/ScannerTelemetry", scantelemetry_active);
 
 	/* now the toolbars */
 #if GTK_CHECK_VERSION(3,4,0)
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 #include <stdlib.h>				/* exit() on Solaris and unsetenv()  */
+#include <string.h>				/* strcmp() */
 #include <time.h>				/* nanosleep */
 
 #ifndef WIN32
@@ -41,6 +42,8 @@
 #endif							/* ENABLE_NLS */
 
 #include "bftextview2_langmgr.h"
+#include "bftextview2_scanbench.h"
+#include "bftextview2_telemetry.h"
 #ifdef HAVE_LIBENCHANT
 #include "bftextview2_spell.h"
 #endif
@@ -289,8 +292,10 @@ static gboolean startup_in_idle(gpointer data) {
 
 int main(int argc, char *argv[])
 {
-	static gboolean arg_curwindow = FALSE, arg_newwindow=FALSE;
+	static gboolean arg_curwindow = FALSE, arg_newwindow=FALSE, arg_bench_scanner=FALSE;
+	static gchar *arg_bench_mimetype = NULL;
 	static gchar **files = NULL;
+	gint i;
 	Tstartup *startup;
 #ifdef MAC_INTEGRATION
 	GPollFunc orig_poll_func;
@@ -362,6 +367,10 @@ int main(int argc, char *argv[])
 		 N_("Open in new window."), NULL},
 		{"version", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, (void *) cb_print_version,
 		 N_("Print version information."), NULL},
+		{"bench-scanner", 0, 0, G_OPTION_ARG_NONE, &arg_bench_scanner,
+		 N_("Run the syntax scanner over FILE(S) without a window and print statistics."), NULL},
+		{"bench-mimetype", 0, 0, G_OPTION_ARG_STRING, &arg_bench_mimetype,
+		 N_("Use this mime type for all files in --bench-scanner."), N_("TYPE")},
 		{G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
 		 "Special option that collects any remaining arguments for us", NULL},
 		{NULL}
@@ -397,7 +406,12 @@ int main(int argc, char *argv[])
 
 	/* this one or bail out with the error of g_option_context_parse () */
 	g_option_context_set_ignore_unknown_options(context, TRUE);
-	g_option_context_add_group(context, gtk_get_option_group(TRUE));
+	/* the scanner benchmark should run without a display, so don't let GTK open one */
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench-scanner") == 0)
+			arg_bench_scanner = TRUE;
+	}
+	g_option_context_add_group(context, gtk_get_option_group(!arg_bench_scanner));
 	if (!g_option_context_parse(context, &argc, &argv, &error)) {
 		g_error(N_("Error parsing command line options. %s\nPlease run: %s -?\n"), error->message,
 				argv[0]);
@@ -425,6 +439,17 @@ int main(int argc, char *argv[])
 	main_v->alldochash = g_hash_table_new(g_file_hash, (GEqualFunc) g_file_equal);
 	DEBUG_MSG("main, main_v is at %p\n", main_v);
 
+	if (arg_bench_scanner) {
+		gint ret;
+		rcfile_check_directory();
+		rcfile_parse_main();
+		langmgr_init();
+		ret = bftextview2_scanbench_run(files, arg_bench_mimetype);
+		g_strfreev(files);
+		g_free(arg_bench_mimetype);
+		exit(ret);
+	}
+
 	if (files != NULL) {
 		gchar **tmp = files;
 		while (*tmp) {
@@ -467,6 +492,7 @@ int main(int argc, char *argv[])
 #endif
 	rcfile_check_directory();
 	rcfile_parse_main();
+	scantelemetry_init();
 #ifdef ENABLE_NLS
 	if (main_v->props.language!=NULL && main_v->props.language[0]!='\0') {
 #ifndef WIN32
@@ -580,6 +606,7 @@ void bluefish_exit_request()
 	flush_queue();
 
 	rcfile_save_global_session();
+	scantelemetry_cleanup();
 
 	gtk_main_quit();
 	DEBUG_MSG("bluefish_exit_request, after gtk_main_quit()\n");
@@ -21,7 +21,6 @@
 
 /*#define IDENTSTORING*/
 
-/* #define HL_PROFILING */
 /* if you define DEBUG here you will get debug output from all Bluefish parts */
 /* #define DEBUG */
 
@@ -180,6 +179,9 @@ gtk events (100) */
 scanning in a lower priority timeout than the language file notice
 so a newly loaded language file uses a priority 113 event to notice all documents to be rescanned. */
 #define BUILD_LANG_FINISHED_PRIORITY 113
+/* results from the scanner thread are handed to the mainloop just after the language file notice,
+but before the idle-after-timeout scanning. */
+#define SCANTHREAD_BATCH_PRIORITY 114
 
 #define BFLANGSCAN_FINISHED_PRIORITY 101
 
@@ -353,6 +355,8 @@ typedef struct {
 	gboolean show_tooltip_reference;
 	gboolean delay_full_scan;
 	gint delay_scan_time;
+	gint largefile_size;		/* documents of this many MB or more are scanned in large-file mode, 0 to disable */
+	gint trigram_index;			/* index the files of a project to narrow a search in files, 0 to disable */
 	gint autocomp_popup_mode;	/* delayed or immediately */
 	gint autocomp_min_prefix_len; /* minimum number of matching characters before autocomp is activated */
 	gboolean reduced_scan_triggers;
@@ -580,7 +584,10 @@ typedef struct {
 #ifdef IDENTSTORING
 	GHashTable *identifier_jump;
 	GHashTable *identifier_ac;
+	GHashTable *identifier_docs;
+	gpointer symbolindex;		/* the Tsymbolindex of the project, see bftextview2_symbolindex.c */
 #endif /* IDENTSTORING */
+	gpointer trigramindex;		/* the Ttrigramindex of the project, see snr3_trigram.c */
 	GSList *curdoc_changed; /* register a CurdocChangedCallback function here that is called when the current document changes*/
 	GSList *doc_insert_text; /* register a DocInsertTextCallback function here that is called when text is inserted into a document */
 	GSList *doc_delete_range; /* register a DocDeleteRangeCallback function here that is called when text is deleted from a document */
@@ -46,6 +46,8 @@
 #include "bftextview2.h"
 #include "bftextview2_langmgr.h"
 #include "bftextview2_identifier.h"
+#include "bftextview2_sccache.h"
+#include "bftextview2_symbolindex.h"
 #include "bfwin.h"
 #include "bfwin_uimanager.h"
 #include "bookmark.h"
@@ -2310,6 +2312,8 @@ doc_destroy(Tdocument * doc, gboolean delay_activation)
 		Tcallback *cb = tmpslist->data;
 		((DocDestroyCallback)cb->func)(doc, cb->data);
 	}
+	if (doc->status != DOC_STATUS_ERROR)
+		sccache_save(BLUEFISH_TEXT_VIEW(doc->view));
 
 	DEBUG_MSG("doc_destroy, calling bmark_clean_for_doc(%p)\n", doc);
 	bmark_clean_for_doc(doc);
@@ -3935,6 +3939,15 @@ doc_jump(Tdocument * doc)
 				bfwin_switch_to_document_by_pointer(doc->bfwin, ijd->doc);
 				doc_select_line(ijd->doc, ijd->line, TRUE);
 			}
+		} else {
+			/* not in any open document, try the files of the project */
+			guint line;
+			GFile *uri = symbolindex_lookup(doc->bfwin, BLUEFISH_TEXT_VIEW(doc->view)->bflang, context, string, &line);
+			if (uri) {
+				DEBUG_MSG("jump to project file, line=%d\n", line);
+				doc_new_from_uri(doc->bfwin, uri, NULL, FALSE, FALSE, line, -1, -1, TRUE, FALSE);
+				g_object_unref(uri);
+			}
 		}
 	}
 #endif
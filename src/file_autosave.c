@@ -81,6 +81,7 @@ during startup:
 
 #include "bluefish.h"
 #include "bf_lib.h"
+#include "bftextview2_sccache.h"
 #include "bfwin.h"
 #include "document.h"
 #include "file.h"
@@ -264,6 +265,7 @@ autosave(Tdocument * doc, GHashTable * hasht)
 	data = doc_get_chars(doc, 0, -1);
 	if (!data || data[0] == '\0')
 		return;
+	sccache_save(BLUEFISH_TEXT_VIEW(doc->view));
 
 	buffer = refcpointer_new(data);
 	doc->autosave_action =
@@ -26,6 +26,7 @@
 
 #include "bluefish.h"
 #include "file_dialogs.h"
+#include "bftextview2_symbolindex.h"
 #include "bfwin.h"
 #include "bookmark.h"
 #include "dialog_utils.h"
@@ -36,6 +37,7 @@
 #include "filebrowser2.h"
 #include "gtk_easy.h"
 #include "snr3.h"				/* snr3_run_extern_replace() */
+#include "snr3_trigram.h"
 #include "stringlist.h"
 #include "undo_redo.h"
 
@@ -558,6 +560,10 @@ gtk_label_get_text(GTK_LABEL(doc->tab_label)));
 					doc_unre_clear_not_modified(doc);
 				}
 				doc_set_modified(doc, 0);
+#ifdef IDENTSTORING
+				symbolindex_refresh(doc->bfwin);
+#endif
+				trigramindex_refresh(doc->bfwin);
 			}
 			/* in fact the filebrowser should also be refreshed if the document was closed, but
 			   when a document is closed, the filebrowser is anyway refreshed (hmm perhaps only if
@@ -33,6 +33,7 @@
 
 #include "bf_lib.h"
 #include "bftextview2_spell.h"
+#include "bftextview2_symbolindex.h"
 #include "bfwin.h"
 #include "bfwin_uimanager.h"
 #include "bookmark.h"
@@ -45,6 +46,7 @@
 #include "preferences.h"
 #include "project.h"
 #include "rcfile.h"
+#include "snr3_trigram.h"
 #include "stringlist.h"
 
 
@@ -201,6 +203,10 @@ setup_bfwin_for_project(Tbfwin * bfwin, Tdocument *active_doc)
 	reload_spell_dictionary(bfwin);
 #endif
 	bfwin_apply_session(bfwin, active_doc);
+#ifdef IDENTSTORING
+	symbolindex_start(bfwin);
+#endif
+	trigramindex_start(bfwin);
 	set_project_menu_actions(bfwin, TRUE);
 #ifdef MAC_INTEGRATION
 /*	ige_mac_menu_sync(GTK_MENU_SHELL(BFWIN(doc->bfwin)->menubar));*/
@@ -222,6 +228,10 @@ setup_bfwin_for_nonproject(Tbfwin * bfwin)
 		bfwin_set_title(bfwin, bfwin->current_document, 0);
 
 	bfwin_apply_session(bfwin, bfwin->current_document);
+#ifdef IDENTSTORING
+	symbolindex_stop(bfwin);
+#endif
+	trigramindex_stop(bfwin);
 	set_project_menu_actions(bfwin, FALSE);
 #ifdef MAC_INTEGRATION
 /*	ige_mac_menu_sync(GTK_MENU_SHELL(BFWIN(bfwin)->menubar));*/
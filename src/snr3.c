@@ -57,6 +57,9 @@ texttag from the tag table??
 #include "bf_lib.h"
 #include "snr3.h"
 #include "snr3_files.h"
+#include "snr3_literal.h"
+#include "snr3_multi.h"
+#include "snr3_trigram.h"
 #include "outputbox.h"
 
 #ifdef SNR3_PROFILING
@@ -313,6 +316,13 @@ s3result_replace(Tsnr3run *s3run, Tsnr3result *s3result, GMatchInfo *matchinfo)
 				offsetupdate.offset = g_utf8_strlen(newstr, -1)-(s3result->eo - s3result->so);
 				g_free(newstr);
 			}
+		} else if (s3run->type == snr3type_multi) {
+			const gchar *replacement = snr3multi_replacement(s3run->multi, s3result->term);
+			if (replacement) {
+				DEBUG_MSG("s3result_replace, replace term %d at %d:%d with %s\n", s3result->term, s3result->so, s3result->eo, replacement);
+				doc_replace_text_backend(s3result->doc, replacement, s3result->so, s3result->eo);
+				offsetupdate.offset = g_utf8_strlen(replacement, -1)-(s3result->eo - s3result->so);
+			}
 		}
 	}
 	offsetupdate.startingpoint = s3result->eo;
@@ -360,12 +370,13 @@ s3run_replace_current(Tsnr3run *s3run)
 	return TRUE;
 }
 
-static Tsnr3result * sn3run_add_result(Tsnr3run *s3run, gulong so, gulong eo, gpointer doc) {
+static Tsnr3result * sn3run_add_result(Tsnr3run *s3run, gulong so, gulong eo, gpointer doc, gint term) {
 	Tsnr3result *s3result;
 	s3result = g_slice_new(Tsnr3result);
 	s3result->so = so;
 	s3result->eo = eo;
 	s3result->doc = doc;
+	s3result->term = term;
 	g_queue_push_tail(&s3run->results, s3result);
 	if (s3run->showinoutputbox && doc && DOCUMENT(doc)->uri) {
 		GtkTextIter it1, it2, tmpit;
@@ -390,6 +401,12 @@ static Tsnr3result * sn3run_add_result(Tsnr3run *s3run, gulong so, gulong eo, gp
 			}
 		}
 		text = gtk_text_buffer_get_text(DOCUMENT(doc)->buffer, &it1, &it2, TRUE);
+		if (s3run->type == snr3type_multi) {
+			/* show which term of the list matched */
+			gchar *tmp = g_strdup_printf("[%s] %s", snr3multi_term(s3run->multi, term), text);
+			g_free(text);
+			text = tmp;
+		}
 		outputbox_add_line(s3run->bfwin, curi, line, text);
 		g_free(curi);
 		g_free(text);
@@ -420,7 +437,7 @@ backend_pcre_loop(Tsnr3run *s3run, gboolean indefinitely) {
 		g_match_info_fetch_pos(match_info, 0, &bso, &beo);
 		so = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, bso);
 		eo = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, beo);
-		s3result = sn3run_add_result(s3run, so+s3run->curoffset+s3run->so, eo+s3run->curoffset+s3run->so, s3run->curdoc);
+		s3result = sn3run_add_result(s3run, so+s3run->curoffset+s3run->so, eo+s3run->curoffset+s3run->so, s3run->curdoc, -1);
 		DEBUG_MSG("backend_pcre_loop, found result at bso %d, so %d, s3run->so=%d, s3run->curoffse=%d\n",bso,so,s3run->so,s3run->curoffset);
 		if (s3run->replaceall) {
 			DEBUG_MSG("backend_pcre_loop, found in buffer at %d:%d, replace at %d:%d (curoffset=%d, s3run->so=%d)\n", so, eo, s3result->so, s3result->eo,s3run->curoffset, s3run->so);
@@ -450,37 +467,82 @@ backend_pcre_loop(Tsnr3run *s3run, gboolean indefinitely) {
 static gboolean
 backend_string_loop(Tsnr3run *s3run, gboolean indefinitely)
 {
-	GTimer *timer = g_timer_new();
-	gint querylen, bytelen;
-	char *(*f) ();
+	GTimer *timer;
+	gsize matchlen;
 	gint loop=0;
 	static guint loops_per_timer=10;
-	gchar *result;
-	if (s3run->is_case_sens) {
-		f = strstr;
-	} else {
-		f = strcasestr;
+	const gchar *result, *end;
+	if (!s3run->literal)
+		return FALSE;
+	timer = g_timer_new();
+	end = s3run->curbuf + s3run->curbuflen;
+	/* now reconstruct the last scan offset */
+	result = s3run->curbuf + utf8_charoffset_to_byteoffset_cached(s3run->curbuf, s3run->curposition);
+
+	do {
+		result = snr3literal_find(s3run->literal, result, end, &matchlen);
+		if (result) {
+			Tsnr3result *s3result;
+			glong char_o = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, (result-s3run->curbuf));
+			/* with case folding the match can have a different length than the query, so the end offset
+			   is calculated from the match length that the literal engine returns */
+			glong char_eo = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, (result+matchlen-s3run->curbuf));
+			DEBUG_MSG("snr3_run_string_loop, add result %d:%d, replaceall=%d\n", (gint)char_o+s3run->so, (gint)char_eo+s3run->so, s3run->replaceall);
+			s3result = sn3run_add_result(s3run, char_o+s3run->so+s3run->curoffset, char_eo+s3run->so+s3run->curoffset, s3run->curdoc, -1);
+			if (s3run->replaceall) {
+				DEBUG_MSG("snr3_run_string_loop, replace %d:%d\n", (gint)char_o+s3run->so, (gint)char_eo+s3run->so);
+				Toffsetupdate offsetupdate = s3result_replace(s3run, s3result, NULL);
+				s3run->curoffset += offsetupdate.offset;
+			}
+			s3run->curposition = char_eo;
+			/* advance the position to the end of the found result */
+			result += matchlen;
+			loop++;
+		}
+	} while (result && (indefinitely || loop % loops_per_timer != 0
+				 || g_timer_elapsed(timer, NULL) < MAX_CONTINUOUS_SEARCH_INTERVAL));
+	DEBUG_MSG("did %d loops in %f seconds\n",loop, g_timer_elapsed(timer, NULL));
+	g_timer_destroy(timer);
+
+	if (result) {
+		loops_per_timer = (loops_per_timer + MAX(loop / 10, 10))/2;
+		return TRUE;
 	}
-	bytelen = strlen(s3run->queryreal);
-	querylen = g_utf8_strlen(s3run->queryreal, -1);
+	return FALSE;
+}
+
+static gboolean
+backend_multi_loop(Tsnr3run *s3run, gboolean indefinitely)
+{
+	GTimer *timer;
+	gsize matchlen;
+	gint term;
+	gint loop=0;
+	static guint loops_per_timer=10;
+	const gchar *result, *end;
+	if (!s3run->multi)
+		return FALSE;
+	timer = g_timer_new();
+	end = s3run->curbuf + s3run->curbuflen;
 	/* now reconstruct the last scan offset */
 	result = s3run->curbuf + utf8_charoffset_to_byteoffset_cached(s3run->curbuf, s3run->curposition);
 
 	do {
-		result = f(result, s3run->queryreal);
+		result = snr3multi_find(s3run->multi, result, end, &matchlen, &term);
 		if (result) {
 			Tsnr3result *s3result;
 			glong char_o = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, (result-s3run->curbuf));
-			DEBUG_MSG("snr3_run_string_loop, add result %d:%d, replaceall=%d\n", (gint)char_o+s3run->so, (gint)char_o+querylen+s3run->so, s3run->replaceall);
-			s3result = sn3run_add_result(s3run, char_o+s3run->so+s3run->curoffset, char_o+querylen+s3run->so+s3run->curoffset, s3run->curdoc);
+			/* the terms have different lengths, so the end offset is calculated for every result */
+			glong char_eo = utf8_byteoffset_to_charsoffset_cached(s3run->curbuf, (result+matchlen-s3run->curbuf));
+			DEBUG_MSG("backend_multi_loop, add result %d:%d for term %d, replaceall=%d\n", (gint)char_o+s3run->so, (gint)char_eo+s3run->so, term, s3run->replaceall);
+			s3result = sn3run_add_result(s3run, char_o+s3run->so+s3run->curoffset, char_eo+s3run->so+s3run->curoffset, s3run->curdoc, term);
 			if (s3run->replaceall) {
-				DEBUG_MSG("snr3_run_string_loop, replace %d:%d\n", (gint)char_o+s3run->so, (gint)char_o+querylen+s3run->so);
 				Toffsetupdate offsetupdate = s3result_replace(s3run, s3result, NULL);
 				s3run->curoffset += offsetupdate.offset;
 			}
-			s3run->curposition = char_o+querylen+s3run->so;
+			s3run->curposition = char_eo;
 			/* advance the position to the end of the found result */
-			result += bytelen;
+			result += matchlen;
 			loop++;
 		}
 	} while (result && (indefinitely || loop % loops_per_timer != 0
@@ -503,6 +565,8 @@ snr3_run_loop_idle_func(Truninidle *rii)
 	DEBUG_MSG("snr3_run_loop_idle_func, next loop\n");
 	if (s3run->type == snr3type_string)
 		cont = backend_string_loop(s3run, FALSE);
+	else if (s3run->type == snr3type_multi)
+		cont = backend_multi_loop(s3run, FALSE);
 	else
 		cont = backend_pcre_loop(s3run, FALSE);
 
@@ -552,6 +616,7 @@ snr3_queue_run(gpointer data) {
 	rii->s3run->curoffset=0;
 	rii->s3run->curposition=0;
 	rii->s3run->curbuf = doc_get_chars(rii->doc, rii->so, rii->eo);
+	rii->s3run->curbuflen = strlen(rii->s3run->curbuf);
 	rii->s3run->so = rii->so;
 	rii->s3run->eo = rii->eo;
 	DEBUG_MSG("snr3_queue_run, run doc %p, curbuf %p (%d:%d)\n",rii->doc, rii->s3run->curbuf, rii->so, rii->eo);
@@ -647,6 +712,12 @@ snr3_run_go(Tsnr3run *s3run, gboolean forward) {
 	if (next) {
 		s3run->current = next;
 		scroll_to_result(next->data, s3run->dialog ? GTK_WINDOW(((TSNRWin *)s3run->dialog)->dialog) : NULL);
+		if (s3run->dialog && s3run->type == snr3type_multi && s3run->multi) {
+			gchar *tmp = g_markup_printf_escaped(_("<i>Match for '%s'</i>"),
+							snr3multi_term(s3run->multi, S3RESULT(next->data)->term));
+			gtk_label_set_markup(GTK_LABEL(((TSNRWin *)s3run->dialog)->searchfeedback), tmp);
+			g_free(tmp);
+		}
 	}
 }
 
@@ -678,7 +749,9 @@ snr3_run(Tsnr3run *s3run, TSNRWin *snrwin, Tdocument *doc, void (*callback)(void
 			gtk_label_set_markup(GTK_LABEL(snrwin->searchfeedback),_("<i>Replace started</i>"));
 		} else {
 			if (s3run->scope == snr3scope_files) {
-				gtk_label_set_text(GTK_LABEL(snrwin->searchfeedback),"");
+				gchar *status = trigramindex_status(s3run->bfwin);
+				gtk_label_set_text(GTK_LABEL(snrwin->searchfeedback),status ? status : "");
+				g_free(status);
 			} else {
 				gtk_label_set_markup(GTK_LABEL(snrwin->searchfeedback),_("<i>Search started</i>"));
 			}
@@ -744,7 +817,7 @@ snr3_cancel_run(Tsnr3run *s3run) {
 		g_source_remove(s3run->changed_idle_id);
 		s3run->changed_idle_id=0;
 	}
-	if (s3run->scope == snr3scope_files) {
+	if (s3run->filesrun) {
 		snr3_run_in_files_cancel(s3run);
 	}
 }
@@ -778,6 +851,8 @@ snr3run_free(Tsnr3run *s3run, gboolean remove_highlights) {
 	DEBUG_MSG("snr3run_free, query at %p\n",s3run->query);
 	g_free(s3run->query);
 	g_free(s3run->queryreal);
+	snr3literal_unref(s3run->literal);
+	snr3multi_unref(s3run->multi);
 	if (s3run->regex)
 		g_regex_unref(s3run->regex);
 	DEBUG_MSG("snr3run_free, replace\n");
@@ -835,6 +910,14 @@ static gint update_snr3run(Tsnr3run *s3run) {
 		g_free(s3run->queryreal);
 		s3run->queryreal=NULL;
 	}
+	if (s3run->literal) {
+		snr3literal_unref(s3run->literal);
+		s3run->literal=NULL;
+	}
+	if (s3run->multi) {
+		snr3multi_unref(s3run->multi);
+		s3run->multi=NULL;
+	}
 	if (s3run->replacereal) {
 		g_free(s3run->replacereal);
 		s3run->replacereal=NULL;
@@ -864,6 +947,12 @@ static gint update_snr3run(Tsnr3run *s3run) {
 			s3run->replacereal = g_strdup(s3run->replace);
 		}
 	}
+	if (s3run->type == snr3type_string) {
+		s3run->literal = snr3literal_new(s3run->queryreal, s3run->is_case_sens);
+	} else if (s3run->type == snr3type_multi) {
+		/* the escape-sequences are replaced first, so \n separates the terms as well */
+		s3run->multi = snr3multi_new(s3run->queryreal, s3run->replacereal, s3run->is_case_sens);
+	}
 	DEBUG_MSG("update_snr3run, query=%s, queryreal=%s, replace=%s, replacereal=%s\n",s3run->query,
 				s3run->type == snr3type_pcre ? "undefined (regex pattern)" : s3run->queryreal,
 				s3run->replace ? s3run->replace : "undefined", s3run->replace ? s3run->replacereal: "undefined");
@@ -876,7 +965,8 @@ void snr3run_bookmark_all(Tsnr3run *s3run) {
 	for (tmpl=g_list_first(s3run->results.head);tmpl;tmpl=g_list_next(tmpl)) {
 		Tsnr3result *s3result = tmpl->data;
 		gchar *text = doc_get_chars(s3result->doc, s3result->so, s3result->eo);
-		bmark_add_extern(s3result->doc, s3result->so, s3run->query, text, !main_v->globses.bookmarks_default_store);
+		const gchar *name = (s3run->type == snr3type_multi) ? snr3multi_term(s3run->multi, s3result->term) : s3run->query;
+		bmark_add_extern(s3result->doc, s3result->so, name, text, !main_v->globses.bookmarks_default_store);
 		g_free(text);
 	}
 }
@@ -888,13 +978,21 @@ threaded_all_ready(void *data) {
 	s3run->curdoc = NULL;
 	if (s3run->dialog) {
 		gchar *tmp;
+		gint count = g_queue_get_length(&s3run->results) + s3run->filesresults;
 		if (s3run->replaceall) {
-			gint count = g_queue_get_length(&s3run->results);
 			tmp = g_strdup_printf(ngettext("<i>Replaced %d entry</i>", "<i>Replaced %d entries</i>", count), count);
 		} else {
-			gint count = g_queue_get_length(&s3run->results);
 			tmp = g_strdup_printf(ngettext("<i>Found %d entry</i>", "<i>Found %d entries</i>", count), count);
 		}
+		if (s3run->scope == snr3scope_files) {
+			gchar *status = trigramindex_status(s3run->bfwin);
+			if (status) {
+				gchar *tmp2 = g_strconcat(tmp, "\n<small>", status, "</small>", NULL);
+				g_free(tmp);
+				g_free(status);
+				tmp = tmp2;
+			}
+		}
 		gtk_label_set_markup(GTK_LABEL(((TSNRWin *)s3run->dialog)->searchfeedback),tmp);
 		g_free(tmp);
 		replace_all_buttons(s3run, TRUE);
@@ -1382,6 +1480,13 @@ snr3_advanced_response(GtkDialog * dialog, gint response, TSNRWin * snrwin)
 	if (s3run->scope == snr3scope_files && s3run->filepattern && s3run->filepattern[0] != '\0')
 		snrwin->bfwin->session->filegloblist = add_to_history_stringlist(snrwin->bfwin->session->filegloblist, s3run->filepattern,TRUE);
 
+	if ((response == SNR_RESPONSE_REPLACE || response == SNR_RESPONSE_REPLACE_ALL)
+			&& s3run->type == snr3type_multi && s3run->multi && !snr3multi_replace_valid(s3run->multi)) {
+		gtk_label_set_markup(GTK_LABEL(snrwin->searchfeedback), _("<span foreground=\"red\">The replace string should have one line, or a line for every search string</span>"));
+		gtk_widget_show(snrwin->searchfeedback);
+		return;
+	}
+
 	switch(response) {
 		case SNR_RESPONSE_FIND:
 			if ((guichange & 1) != 0) {
@@ -1460,7 +1565,7 @@ static void snr_dialog_show_widgets(TSNRWin * snrwin) {
 	widget_set_visible(snrwin->replaceType, (searchtype == snr3type_pcre));
 	widget_set_visible(snrwin->replaceTypeL, (searchtype == snr3type_pcre));
 	widget_set_visible(snrwin->replace, (searchtype != snr3type_pcre || replacetype == snr3replace_string));
-	widget_set_visible(snrwin->escapeChars, (searchtype == snr3type_string));
+	widget_set_visible(snrwin->escapeChars, (searchtype == snr3type_string || searchtype == snr3type_multi));
 	widget_set_visible(snrwin->dotmatchall, (searchtype == snr3type_pcre));
 
 	widget_set_visible(snrwin->replaceButton, (scope != snr3scope_files));
@@ -1518,6 +1623,7 @@ snr3_advanced_dialog_backend(Tbfwin * bfwin, const gchar *findtext, Tsnr3scope s
 	const gchar *matchPattern[] = {
 		N_("Normal"),
 		N_("Regular expression (pcre)"),
+		N_("List of strings, one per line"),
 	};
 
 	const gchar *replaceType[] = {
@@ -1593,6 +1699,8 @@ snr3_advanced_dialog_backend(Tbfwin * bfwin, const gchar *findtext, Tsnr3scope s
 	/*g_signal_connect(snrwin->searchType, "realize", G_CALLBACK(realize_combo_set_tooltip),
 					 _("How to interpret the pattern."));
 */
+	gtk_widget_set_tooltip_text(snrwin->searchType,
+								_("A list of strings finds every line of the pattern in a single pass, a multi-line replace string gives every line its own replacement. With escape-sequences the lines can be separated with \\n."));
 	currentrow++;
 
 	snrwin->replaceType = gtk_combo_box_text_new();
@@ -1772,6 +1880,7 @@ extern_doc_backend(Tsnr3run * s3run, Tdocument *doc, guint so, guint eo)
 	s3run->curposition=0;
 	s3run->curdoc = doc;
 	s3run->curbuf = doc_get_chars(doc, so, eo);
+	s3run->curbuflen = strlen(s3run->curbuf);
 	utf8_offset_cache_reset();
 	s3run->so = so;
 	s3run->eo = eo;
@@ -1779,6 +1888,8 @@ extern_doc_backend(Tsnr3run * s3run, Tdocument *doc, guint so, guint eo)
 		backend_pcre_loop(s3run, TRUE);
 	} else if (s3run->type == snr3type_string) {
 		backend_string_loop(s3run, TRUE);
+	} else if (s3run->type == snr3type_multi) {
+		backend_multi_loop(s3run, TRUE);
 	}
 	g_free(s3run->curbuf);
 	s3run->curbuf = NULL;
@@ -1797,6 +1908,11 @@ snr3_run_extern_replace(Tdocument * doc, const gchar * search_pattern, Tsnr3scop
 	s3run->replace = g_strdup(replace_pattern);
 	update_snr3run(s3run);
 	s3run->replaceall = TRUE;
+	if (s3run->type == snr3type_multi && s3run->multi && !snr3multi_replace_valid(s3run->multi)) {
+		g_warning("snr3_run_extern_replace, the replace string should have one line, or a line for every search string\n");
+		snr3run_free(s3run, FALSE);
+		return;
+	}
 
 	switch(s3run->scope) {
 		case snr3scope_doc:
@@ -23,7 +23,8 @@
 
 typedef enum {
 	snr3type_string,
-	snr3type_pcre
+	snr3type_pcre,
+	snr3type_multi
 } Tsnr3type;
 
 typedef enum {
@@ -44,6 +45,7 @@ typedef struct {
 	gpointer doc;
 	gint32 so;
 	gint32 eo;
+	gint term; /* the line of the query that matched, only for snr3type_multi */
 } Tsnr3result;
 
 #define S3RESULT(var)  ((Tsnr3result *)var)
@@ -54,6 +56,8 @@ typedef struct {
 	gchar *query;
 	gchar *queryreal; /* with characters escaped and such */
 	GRegex *regex;
+	gpointer literal; /* Tsnr3literal for queryreal, only for snr3type_string */
+	gpointer multi; /* Tsnr3multi for queryreal and replacereal, only for snr3type_multi */
 	gchar *replace; /* enabled if not NULL */
 	gchar *replacereal; /* with characters escaped and such */
 	gboolean replaceall; /* set to TRUE bluefish will immediately (while searching) do the replace */
@@ -84,6 +88,7 @@ typedef struct {
 	/* following entries are used during the search run */
 	Tdocument *curdoc; /* the current document */
 	gchar *curbuf; /* the current buffer */
+	gsize curbuflen; /* strlen(curbuf) */
 	gint curoffset; /* when running replace all, the difference between the offset in curbuf and the offset in the text widget */
 	guint curposition; /* the position in curbuf to continue the next search run, used if the first
 							search run took longer than our maximum-allowed-gui-block-time */
@@ -93,7 +98,8 @@ typedef struct {
 	guint idle_id;
 	guint changed_idle_id;
 	Tasyncqueue idlequeue;
-	Tasyncqueue threadqueue;
+	gpointer filesrun; /* Tfilesrun during and after a run in files, see snr3_files.c */
+	guint filesresults; /* the number of results of a run in files that were added to the outputbox */
 	volatile gint runcount;
 	volatile gint cancelled;
 	gpointer findfiles; /* a pointer for the return value of findfiles() so we can cancel it */
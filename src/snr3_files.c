@@ -29,7 +29,9 @@
 #include "outputbox.h"
 #include "snr3.h"
 #include "snr3_files.h"
-#include "async_queue.h"
+#include "snr3_literal.h"
+#include "snr3_multi.h"
+#include "snr3_trigram.h"
 #include "bf_lib.h"
 
 typedef struct {
@@ -37,6 +39,37 @@ typedef struct {
 	gchar *text;
 } Tfileresult;
 
+typedef struct {
+	gint refcount;				/* changed with atomic operations, the pool threads hold references */
+	Tsnr3run *s3run;			/* NULL after the run is cancelled, protected by the filesdone lock */
+	volatile gint cancelled;
+	/* the search itself, the pool threads never use the s3run, so a cancelled run does not
+	have to wait for them */
+	Tsnr3type type;
+	gboolean replaceall;
+	GRegex *regex;
+	Tsnr3literal *literal;
+	Tsnr3multi *multi;
+	gchar *replace;				/* replacereal for a string search, the pattern with references for pcre */
+	gchar *encoding;			/* the default encoding of the session */
+	GThreadPool *pool;
+	GCancellable *cancellable;
+	GQueue done;				/* finished Treplaceinthread's, protected by the filesdone lock */
+	guint deliver_id;			/* protected by the filesdone lock */
+	GSList *trigrams;			/* a Ttrigramquery for every term of the query, NULL if the index
+								   cannot skip files for this query */
+	guint numfound;				/* the number of files pushed on the pool */
+	guint numsearched;			/* the number of files delivered */
+	guint numskipped;			/* the number of files skipped because of the trigram index */
+} Tfilesrun;
+
+typedef struct {
+	GFile *uri;
+	gchar *curi;
+	GList *results;
+	Tfilesrun *fr;				/* every Treplaceinthread holds a reference on the Tfilesrun */
+} Treplaceinthread;
+
 static guint calculate_line_in_buffer(Tlineinbuffer *lib, gchar *buffer, gsize pos) {
 	char *tmp = buffer + lib->pos;
 	char *newpos = buffer + pos;
@@ -100,12 +133,12 @@ static Tfileresult *new_result(guint line, gchar *buffer, guint offset) {
 	return fr;
 }
 
-static GList *snr3_find_pcre(Tsnr3run *s3run, gchar *buffer) {
+static GList *snr3_find_pcre(Tfilesrun *fr, gchar *buffer) {
 	Tlineinbuffer lib = {0,1};
 	GList *results=NULL;
 	GMatchInfo *match_info;
 
-	g_regex_match(s3run->regex, buffer, 0, &match_info);
+	g_regex_match(fr->regex, buffer, 0, &match_info);
 	while(g_match_info_matches(match_info)) {
 		gint so, eo;
 		guint line;
@@ -120,7 +153,7 @@ static GList *snr3_find_pcre(Tsnr3run *s3run, gchar *buffer) {
 }
 
 
-static GList *snr3_replace_pcre(Tsnr3run *s3run, gchar *buffer, gchar **replacedbuffer) {
+static GList *snr3_replace_pcre(Tfilesrun *fr, gchar *buffer, gchar **replacedbuffer) {
 	gchar *newbuf;
 	gchar *bufferpos, *newbufpos;
 	gsize buflen;
@@ -130,7 +163,7 @@ static GList *snr3_replace_pcre(Tsnr3run *s3run, gchar *buffer, gchar **replaced
 	GMatchInfo *match_info;
 	gsize prevpos=0;
 
-	DEBUG_MSG("snr3_replace_pcre, search for %s, replace with %s\n",s3run->query, s3run->replace);
+	DEBUG_MSG("snr3_replace_pcre, replace with %s\n",fr->replace);
 	buflen = strlen(buffer);
 
 	alloced = MAX(buflen*2,4096);
@@ -138,7 +171,7 @@ static GList *snr3_replace_pcre(Tsnr3run *s3run, gchar *buffer, gchar **replaced
 
 	bufferpos = buffer;
 	newbufpos = newbuf;
-	g_regex_match(s3run->regex, buffer, 0, &match_info);
+	g_regex_match(fr->regex, buffer, 0, &match_info);
 	while(g_match_info_matches(match_info)) {
 		gint so, eo;
 		guint line, replacelen;
@@ -154,7 +187,7 @@ static GList *snr3_replace_pcre(Tsnr3run *s3run, gchar *buffer, gchar **replaced
 		line = calculate_line_in_buffer(&lib, newbuf, (newbufpos-newbuf));
 		results = g_list_prepend(results, new_result(line, newbuf, (newbufpos-newbuf)));
 
-		replacestring = g_match_info_expand_references(match_info, s3run->replace, &gerror);
+		replacestring = g_match_info_expand_references(match_info, fr->replace, &gerror);
 		if (gerror) {
 			g_print("replace error %s\n",gerror->message);
 			g_error_free(gerror);
@@ -183,65 +216,54 @@ static GList *snr3_replace_pcre(Tsnr3run *s3run, gchar *buffer, gchar **replaced
 	return results;
 }
 
-static GList *snr3_find_string(Tsnr3run *s3run, gchar *buffer) {
-	gchar *result;
-	guint querylen;
+/* the literal is built once in update_snr3run() and shared by all threads */
+static GList *snr3_find_string(Tfilesrun *fr, gchar *buffer) {
+	const gchar *result, *end;
+	gsize matchlen;
 	Tlineinbuffer lib = {0,1};
 	GList *results=NULL;
-	char *(*f) ();
 
-	if (s3run->is_case_sens) {
-		f = strstr;
-	} else {
-		f = strcasestr;
-	}
-	DEBUG_MSG("snr3_find_string, search for %s\n",s3run->query);
-	querylen = strlen(s3run->query);
+	if (!fr->literal)
+		return NULL;
+	end = buffer + strlen(buffer);
 	result = buffer;
 	do {
-		result = f(result, s3run->query);
+		result = snr3literal_find(fr->literal, result, end, &matchlen);
 		DEBUG_MSG("snr3_find_string, result=%p\n",result);
 		if (result) {
 			guint line = calculate_line_in_buffer(&lib, buffer, (result-buffer));
 			results = g_list_prepend(results, new_result(line, buffer, result-buffer));
-			result += querylen;
+			result += matchlen;
 		}
 	} while (result);
 	DEBUG_MSG("snr3_find_string, finished\n");
 	return results;
 }
 
-static GList *snr3_replace_string(Tsnr3run *s3run, gchar *buffer, gchar **replacedbuffer) {
-	gchar *result, *newbuf;
-	gchar *bufferpos, *newbufpos;
-	gsize querylen, replacelen, buflen;
+static GList *snr3_replace_string(Tfilesrun *fr, gchar *buffer, gchar **replacedbuffer) {
+	const gchar *result, *bufferpos;
+	gchar *newbuf, *newbufpos;
+	gsize replacelen, buflen, matchlen;
 	gsize alloced;
 	Tlineinbuffer lib = {0,1};
 	GList *results=NULL;
-	char *(*f) ();
 
-	DEBUG_MSG("snr3_replace_string, search for %s, replace with %s\n",s3run->query, s3run->replace);
-	querylen = strlen(s3run->query);
-	replacelen = strlen(s3run->replace);
+	DEBUG_MSG("snr3_replace_string, replace with %s\n",fr->replace);
+	if (!fr->literal || !fr->replace)
+		return NULL;
+	replacelen = strlen(fr->replace);
 	buflen = strlen(buffer);
 
 
-	alloced = (replacelen > querylen)? MAX(1+replacelen+buflen*2,4096):MAX(buflen+querylen+1, 4096);
+	alloced = (replacelen > fr->literal->len)? MAX(1+replacelen+buflen*2,4096):MAX(buflen+fr->literal->len+1, 4096);
 	newbuf = g_malloc0(alloced);
 
 	bufferpos = buffer;
 	newbufpos = newbuf;
 
-	if (s3run->is_case_sens) {
-		f = strstr;
-	} else {
-		f = strcasestr;
-	}
-
 	result = buffer;
-
-	do {
-		result = f(result, s3run->query);
+	while (result) {
+		result = snr3literal_find(fr->literal, result, buffer + buflen, &matchlen);
 		if (result) {
 			guint line;
 
@@ -250,9 +272,9 @@ static GList *snr3_replace_string(Tsnr3run *s3run, gchar *buffer, gchar **replac
 
 			line = calculate_line_in_buffer(&lib, newbuf, (newbufpos-newbuf));
 
-			memcpy(newbufpos, s3run->replace, replacelen);
+			memcpy(newbufpos, fr->replace, replacelen);
 			newbufpos += replacelen;
-			result += querylen;
+			result += matchlen;
 			bufferpos = result;
 
 			results = g_list_prepend(results, new_result(line, newbuf, newbufpos-newbuf));
@@ -265,98 +287,293 @@ static GList *snr3_replace_string(Tsnr3run *s3run, gchar *buffer, gchar **replac
 				newbuf=tmp;
 			}
 		}
-	} while (result);
+	}
 
 	memcpy(newbufpos, bufferpos, strlen(bufferpos)+1);
 	*replacedbuffer = newbuf;
 	return results;
 }
 
-typedef struct {
-	GFile *uri;
-	GList *results;
-	Tsnr3run *s3run;
-} Treplaceinthread;
+/* the automaton is built once in update_snr3run() and shared by all threads */
+static Tfileresult *new_multi_result(Tsnr3multi *multi, guint line, gchar *buffer, guint offset, gint term) {
+	Tfileresult *res = new_result(line, buffer, offset);
+	gchar *tmp = g_strdup_printf("[%s] %s", snr3multi_term(multi, term), res->text);
+	g_free(res->text);
+	res->text = tmp;
+	return res;
+}
 
-static gboolean replace_files_in_thread_finished(gpointer data) {
-	Treplaceinthread *rit = data;
-	gchar *curi;
-	GList *tmplist;
+static GList *snr3_find_multi(Tfilesrun *fr, gchar *buffer) {
+	const gchar *result, *end;
+	gsize matchlen;
+	gint term;
+	Tlineinbuffer lib = {0,1};
+	GList *results=NULL;
 
-	DEBUG_MSG("replace_files_in_thread_finished, add %d results to outputbox\n",g_list_length(rit->results));
-	if (g_atomic_int_get(&rit->s3run->cancelled)==0) {
-		curi = g_file_get_uri(rit->uri);
-		for (tmplist=g_list_first(rit->results);tmplist;tmplist=g_list_next(tmplist)) {
-			Tfileresult *fr = tmplist->data;
-			outputbox_add_line(rit->s3run->bfwin, curi, fr->line, fr->text);
-			g_free(fr->text);
-			g_slice_free(Tfileresult, fr);
-		}
-		g_free(curi);
+	if (!fr->multi)
+		return NULL;
+	end = buffer + strlen(buffer);
+	result = buffer;
+	while ((result = snr3multi_find(fr->multi, result, end, &matchlen, &term))) {
+		guint line = calculate_line_in_buffer(&lib, buffer, (result-buffer));
+		results = g_list_prepend(results, new_multi_result(fr->multi, line, buffer, result-buffer, term));
+		result += matchlen;
+	}
+	return results;
+}
+
+static GList *snr3_replace_multi(Tfilesrun *fr, gchar *buffer, gchar **replacedbuffer) {
+	const gchar *result, *bufferpos, *end;
+	gsize buflen, matchlen;
+	gint term;
+	Tlineinbuffer lib = {0,1};
+	GList *results=NULL;
+	GString *newbuf;
+
+	if (!fr->multi)
+		return NULL;
+	buflen = strlen(buffer);
+	newbuf = g_string_sized_new(MAX(buflen+buflen/8, 4096));
+	end = buffer + buflen;
+	bufferpos = result = buffer;
+	while ((result = snr3multi_find(fr->multi, result, end, &matchlen, &term))) {
+		const gchar *replacement = snr3multi_replacement(fr->multi, term);
+		guint line;
+
+		g_string_append_len(newbuf, bufferpos, result-bufferpos);
+		line = calculate_line_in_buffer(&lib, newbuf->str, newbuf->len);
+		/* without a replacement for this term the match is left unchanged */
+		if (replacement)
+			g_string_append(newbuf, replacement);
+		else
+			g_string_append_len(newbuf, result, matchlen);
+		result += matchlen;
+		bufferpos = result;
+		results = g_list_prepend(results, new_multi_result(fr->multi, line, newbuf->str, newbuf->len, term));
+	}
+	g_string_append(newbuf, bufferpos);
+	*replacedbuffer = g_string_free(newbuf, FALSE);
+	return results;
+}
+
+/*
+a run in files has three stages that run at the same time: findfiles() walks the directories
+with asynchronous GIO calls in the main loop and pushes every matching file on a GThreadPool
+with a thread for each processor, the pool threads load, convert, search (and replace) the
+files, and the results are delivered to the outputbox from a single idle callback.
+
+every finished file (also a file without results, a failed load or a cancelled file) is
+appended to Tfilesrun->done, and holds a runcount reference on the s3run until the idle
+callback has added its results. The idle callback adds at most SNR3_FILES_ROWS_PER_DISPATCH
+rows to the outputbox per main loop iteration, so a search in many files does not flood the
+main loop with an idle callback for every file.
+
+before a file is pushed on the pool, the trigram index of the project is asked if the file
+can contain a match at all (see snr3_trigram.c), so a repeated search in a large project only
+loads the files that might match. For a list of strings the index is asked for every string,
+and the file is only skipped if none of them can match.
+
+the pool threads only use the Tfilesrun, which holds its own references on the regex, the
+literal or the multi automaton, and every Treplaceinthread holds a reference on the Tfilesrun.
+snr3_run_in_files_cancel() therefore does not wait for the pool threads: it stops the
+directory walk, cancels the loads that are running and detaches the s3run. The files that are
+still queued return immediately, and files_deliver() drops the results of a file that finishes
+after the cancel, so the s3run is never used from a pool thread.
+*/
+#define SNR3_FILES_ROWS_PER_DISPATCH 500
+
+G_LOCK_DEFINE_STATIC(filesdone);
+
+/* called from the main loop and from the pool threads */
+static void
+filesrun_unref(Tfilesrun *fr)
+{
+	if (g_atomic_int_dec_and_test(&fr->refcount)) {
+		DEBUG_MSG("filesrun_unref, free fr %p\n",fr);
+		g_slist_foreach(fr->trigrams, (GFunc)trigramquery_free, NULL);
+		g_slist_free(fr->trigrams);
+		g_object_unref(fr->cancellable);
+		if (fr->regex)
+			g_regex_unref(fr->regex);
+		snr3literal_unref(fr->literal);
+		snr3multi_unref(fr->multi);
+		g_free(fr->replace);
+		g_free(fr->encoding);
+		g_slice_free(Tfilesrun, fr);
+	}
+}
+
+static void
+replaceinthread_free(Treplaceinthread *rit)
+{
+	GList *tmplist;
+	for (tmplist=rit->results;tmplist;tmplist=g_list_next(tmplist)) {
+		Tfileresult *res = tmplist->data;
+		g_free(res->text);
+		g_slice_free(Tfileresult, res);
 	}
-	DEBUG_MSG("replace_files_in_thread_finished, finished rit %p\n", rit);
-	snr3run_unrun(rit->s3run);
-	/* cleanup */
-	g_object_unref(rit->uri);
 	g_list_free(rit->results);
+	g_free(rit->curi);
+	g_object_unref(rit->uri);
+	filesrun_unref(rit->fr);
 	g_slice_free(Treplaceinthread, rit);
-	return FALSE;
 }
 
-static gpointer files_replace_run(gpointer data) {
+static void
+files_update_feedback(Tfilesrun *fr)
+{
+	Tsnr3run *s3run = fr->s3run;
+	GString *str;
+	gchar *status;
+	if (!s3run->dialog)
+		return;
+	str = g_string_new(NULL);
+	if (s3run->findfiles) {
+		g_string_append_printf(str, _("<i>Searched %d of %d files (still looking for files), found %d entries</i>"),
+						fr->numsearched, fr->numfound, s3run->filesresults);
+	} else {
+		g_string_append_printf(str, _("<i>Searched %d of %d files, found %d entries</i>"),
+						fr->numsearched, fr->numfound, s3run->filesresults);
+	}
+	status = trigramindex_status(s3run->bfwin);
+	if (status) {
+		g_string_append_c(str, '\n');
+		g_string_append_printf(str, _("<small>%s, %d files skipped</small>"), status, fr->numskipped);
+		g_free(status);
+	}
+	gtk_label_set_markup(GTK_LABEL(((TSNRWin *)s3run->dialog)->searchfeedback),str->str);
+	g_string_free(str, TRUE);
+}
+
+static gboolean
+files_deliver_lcb(gpointer data)
+{
+	Tfilesrun *fr = data;
+	Tsnr3run *s3run = fr->s3run;
+	GList *ready=NULL, *tmplist;
+	guint rows=0;
+	gboolean again;
+
+	while (rows < SNR3_FILES_ROWS_PER_DISPATCH) {
+		Treplaceinthread *rit;
+		G_LOCK(filesdone);
+		rit = g_queue_peek_head(&fr->done);
+		G_UNLOCK(filesdone);
+		if (!rit)
+			break;
+		while (rit->results && rows < SNR3_FILES_ROWS_PER_DISPATCH) {
+			Tfileresult *res = rit->results->data;
+			outputbox_add_line(s3run->bfwin, rit->curi, res->line, res->text);
+			g_free(res->text);
+			g_slice_free(Tfileresult, res);
+			rit->results = g_list_delete_link(rit->results, rit->results);
+			s3run->filesresults++;
+			rows++;
+		}
+		if (rit->results) {
+			/* continue with this file in the next dispatch */
+			break;
+		}
+		G_LOCK(filesdone);
+		g_queue_pop_head(&fr->done);
+		G_UNLOCK(filesdone);
+		fr->numsearched++;
+		ready = g_list_prepend(ready, rit);
+	}
+	G_LOCK(filesdone);
+	again = (fr->done.length > 0);
+	if (!again)
+		fr->deliver_id = 0;
+	G_UNLOCK(filesdone);
+	DEBUG_MSG("files_deliver_lcb, added %d rows, %d of %d files ready, again=%d\n",rows,fr->numsearched,fr->numfound,again);
+	files_update_feedback(fr);
+	/* the last unrun might call the callback, so the s3run is not used after this loop */
+	for (tmplist=ready;tmplist;tmplist=g_list_next(tmplist)) {
+		replaceinthread_free(tmplist->data);
+		snr3run_unrun(s3run);
+	}
+	g_list_free(ready);
+	return again;
+}
+
+/* called from the pool threads */
+static void
+files_deliver(Tfilesrun *fr, Treplaceinthread *rit)
+{
+	G_LOCK(filesdone);
+	if (!fr->s3run) {
+		/* the run was cancelled, nobody is waiting for this file anymore */
+		G_UNLOCK(filesdone);
+		DEBUG_MSG("thread %p: files_deliver, run was cancelled, drop rit %p\n", g_thread_self(), rit);
+		replaceinthread_free(rit);
+		return;
+	}
+	g_queue_push_tail(&fr->done, rit);
+	if (fr->deliver_id == 0) {
+		/* the idle callback holds a reference until it is removed */
+		g_atomic_int_inc(&fr->refcount);
+		fr->deliver_id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, files_deliver_lcb, fr, (GDestroyNotify)filesrun_unref);
+	}
+	G_UNLOCK(filesdone);
+}
+
+static void
+files_replace_run(gpointer data, gpointer user_data)
+{
 	Treplaceinthread *rit = data;
+	Tfilesrun *fr = rit->fr;
 	GError *gerror=NULL;
 	gchar *inbuf=NULL, *encoding=NULL, *outbuf, *utf8buf;
 	gsize inbuflen=0, outbuflen=0;
-	Tasyncqueue *tmpqueue;
-
-	if (!data) {
-		g_warning("problem detected in files_replace_run, data is NULL, please report a bug\n");
-		return NULL;
-	}
 
 	DEBUG_MSG("thread %p: files_replace_run, started rit %p\n", g_thread_self(), rit);
-
-	g_file_load_contents(rit->uri,NULL,&inbuf,&inbuflen,NULL,&gerror);
-	if (g_atomic_int_get(&rit->s3run->cancelled)!=0) {
-		g_free(inbuf);
-		return NULL;
+	if (g_atomic_int_get(&fr->cancelled)!=0) {
+		files_deliver(fr, rit);
+		return;
 	}
+
+	g_file_load_contents(rit->uri,fr->cancellable,&inbuf,&inbuflen,NULL,&gerror);
 	if (gerror) {
-		g_print("failed to load file: %s\n",gerror->message);
+		if (g_atomic_int_get(&fr->cancelled)==0)
+			g_print("failed to load file: %s\n",gerror->message);
 		g_error_free(gerror);
-		tmpqueue = &rit->s3run->threadqueue;
-		g_idle_add(replace_files_in_thread_finished, rit);
-		queue_worker_ready_inthread(tmpqueue);
-		return NULL;
+	} else if (g_atomic_int_get(&fr->cancelled)!=0) {
+		g_free(inbuf);
 	} else {
 		DEBUG_MSG("thread %p: calling buffer_find_encoding for %ld bytes\n", g_thread_self(),(glong)strlen(inbuf));
 		/* is the following function thread safe ?? */
-		utf8buf = buffer_find_encoding(inbuf, inbuflen, &encoding, rit->s3run->bfwin->session->encoding);
+		utf8buf = buffer_find_encoding(inbuf, inbuflen, &encoding, fr->encoding);
 		g_free(inbuf);
 
 		if (utf8buf) {
 			gchar *replacedbuf=NULL;
 			DEBUG_MSG("starting threaded search/replace\n");
-			switch (rit->s3run->type) {
+			switch (fr->type) {
 				case snr3type_string:
-					if (rit->s3run->replaceall) {
-						rit->results = snr3_replace_string(rit->s3run, utf8buf, &replacedbuf);
+					if (fr->replaceall) {
+						rit->results = snr3_replace_string(fr, utf8buf, &replacedbuf);
 					} else {
-						rit->results = snr3_find_string(rit->s3run, utf8buf);
+						rit->results = snr3_find_string(fr, utf8buf);
 					}
 				break;
 				case snr3type_pcre:
-				if (rit->s3run->replaceall) {
-						rit->results = snr3_replace_pcre(rit->s3run, utf8buf, &replacedbuf);
+				if (fr->replaceall) {
+						rit->results = snr3_replace_pcre(fr, utf8buf, &replacedbuf);
+					} else {
+						rit->results = snr3_find_pcre(fr, utf8buf);
+					}
+				break;
+				case snr3type_multi:
+					if (fr->replaceall) {
+						rit->results = snr3_replace_multi(fr, utf8buf, &replacedbuf);
 					} else {
-						rit->results = snr3_find_pcre(rit->s3run, utf8buf);
+						rit->results = snr3_find_multi(fr, utf8buf);
 					}
 				break;
 			}
 			DEBUG_MSG("finished threaded search/replace\n");
 			g_free(utf8buf);
-			if ((g_atomic_int_get(&rit->s3run->cancelled)==0) && rit->results && replacedbuf) {
+			if ((g_atomic_int_get(&fr->cancelled)==0) && rit->results && replacedbuf) {
 				DEBUG_MSG("replaced %d entries\n",g_list_length(rit->results));
 				outbuf = g_convert(replacedbuf, -1, encoding, "UTF-8", NULL, &outbuflen, NULL);
 
@@ -368,79 +585,181 @@ static gpointer files_replace_run(gpointer data) {
 				g_free(outbuf);
 			}
 			g_free(replacedbuf);
-
+			g_free(encoding);
 		}
 	}
 	rit->results = g_list_reverse(rit->results);
-	tmpqueue = &rit->s3run->threadqueue;
-	if (g_atomic_int_get(&rit->s3run->cancelled)==0) {
-		g_idle_add(replace_files_in_thread_finished, rit);
+	if (rit->results)
+		rit->curi = g_file_get_uri(rit->uri);
+	files_deliver(fr, rit);
+}
+
+static void finished_finding_files_cb(Tfilesrun *fr) {
+	DEBUG_MSG("finished_finding_files_cb\n");
+	if (fr->s3run) {
+		Tsnr3run *s3run = fr->s3run;
+		s3run->findfiles=NULL;
+		files_update_feedback(fr);
+		filesrun_unref(fr);
+		snr3run_unrun(s3run);
+		return;
 	}
+	/* the run was cancelled */
+	filesrun_unref(fr);
+}
 
-	DEBUG_MSG("thread %p: calling queue_worker_ready_inthread\n",g_thread_self());
-	queue_worker_ready_inthread(tmpqueue);
-	/* we don't need to start a new thread by calling _inthread() inside the thread */
-	return NULL;
+static GSList *
+files_trigram_queries(Tsnr3run *s3run)
+{
+	GSList *list=NULL;
+	gpointer tq;
+	if (s3run->type == snr3type_multi) {
+		Tsnr3multi *multi = s3run->multi;
+		guint i;
+		if (!multi)
+			return NULL;
+		for (i=0;i<multi->numterms;i++) {
+			if (multi->terms[i][0] == '\0')
+				continue;
+			tq = trigramquery_new(multi->terms[i], FALSE, s3run->is_case_sens);
+			if (!tq) {
+				/* a term without trigrams might be in any file */
+				g_slist_foreach(list, (GFunc)trigramquery_free, NULL);
+				g_slist_free(list);
+				return NULL;
+			}
+			list = g_slist_prepend(list, tq);
+		}
+		return list;
+	}
+	/* the query exactly as snr3_find_string() and compile_regex() use it */
+	if (s3run->type == snr3type_pcre)
+		tq = trigramquery_new(s3run->query, TRUE, s3run->is_case_sens);
+	else
+		tq = trigramquery_new(s3run->queryreal, FALSE, s3run->is_case_sens);
+	return tq ? g_slist_prepend(NULL, tq) : NULL;
 }
 
-static void finished_finding_files_cb(Tsnr3run *s3run) {
-	DEBUG_MSG("finished_finding_files_cb\n");
-	s3run->findfiles=NULL;
-	snr3run_unrun(s3run);
+static gboolean
+files_skip_file(Tfilesrun *fr, GFile *uri, GFileInfo *finfo)
+{
+	GSList *tmpslist;
+	if (!fr->trigrams)
+		return FALSE;
+	for (tmpslist=fr->trigrams;tmpslist;tmpslist=g_slist_next(tmpslist)) {
+		if (!trigramquery_skip_file(fr->s3run->bfwin, tmpslist->data, uri, finfo))
+			return FALSE;
+	}
+	return TRUE;
 }
 
-static void filematch_cb(Tsnr3run *s3run, GFile *uri, GFileInfo *finfo) {
+static void filematch_cb(Tfilesrun *fr, GFile *uri, GFileInfo *finfo) {
 	Treplaceinthread *rit;
 	Tdocument *doc;
+	Tsnr3run *s3run = fr->s3run;
 	DEBUG_MSG("filematch_cb\n");
-	if (g_atomic_int_get(&s3run->cancelled)!=0) {
+	if (!s3run || g_atomic_int_get(&s3run->cancelled)!=0) {
 		/* do nothing */
 		DEBUG_MSG("filematch_cb, cancelled, do nothing\n");
 		return;
 	}
-	/* TODO: first check if we have this file open, in that case we have to run the
-	function that replaces in the document */
+	/* if we have this file open, we have to run the function that replaces in the document */
 	doc = documentlist_return_document_from_uri(s3run->bfwin->documentlist, uri);
 	if (doc) {
 		DEBUG_MSG("filematch_cb, this file is already open, use snr3_run_in_doc()\n");
 		snr3_run_in_doc(s3run, doc, 0, -1, FALSE);
 		return;
 	}
+	if (files_skip_file(fr, uri, finfo)) {
+		fr->numskipped++;
+		return;
+	}
 	rit = g_slice_new0(Treplaceinthread);
 	rit->uri = uri;
 	g_object_ref(rit->uri);
-	rit->s3run = s3run;
-	g_atomic_int_inc(&rit->s3run->runcount);
-	DEBUG_MSG("filematch_cb, push rit %p to queue, s3run runcount is %d\n", rit, rit->s3run->runcount);
-	queue_push(&s3run->threadqueue, rit);
-}
-
-static void
-queue_cancel_freefunc(gpointer data, gpointer user_data)
-{
-	Treplaceinthread *rit=data;
-	g_object_unref(rit->uri);
-	snr3run_unrun(rit->s3run);
-	g_slice_free(Treplaceinthread, rit);
+	rit->fr = fr;
+	g_atomic_int_inc(&fr->refcount);
+	g_atomic_int_inc(&s3run->runcount);
+	fr->numfound++;
+	DEBUG_MSG("filematch_cb, push rit %p to pool, s3run runcount is %d\n", rit, s3run->runcount);
+	if (fr->pool) {
+		g_thread_pool_push(fr->pool, rit, NULL);
+	} else {
+		files_replace_run(rit, fr);
+	}
 }
 
 void snr3_run_in_files_cancel(Tsnr3run *s3run) {
+	Tfilesrun *fr = s3run->filesrun;
+	GQueue done = G_QUEUE_INIT;
+	Treplaceinthread *rit;
+	gint outstanding;
 	DEBUG_MSG("snr3_run_in_files_cancel s3run %p\n",s3run);
+	if (!fr)
+		return;
 	g_atomic_int_set(&s3run->cancelled, 1);
+	g_atomic_int_set(&fr->cancelled, 1);
+	/* findfiles() might call filematch_cb() and finished_finding_files_cb() until the pending
+	directory enumerations have returned, those callbacks do nothing without s3run. The pool
+	threads drop the files they finish from now on, see files_deliver() */
+	G_LOCK(filesdone);
+	fr->s3run = NULL;
+	if (fr->deliver_id)
+		g_source_remove(fr->deliver_id);
+	fr->deliver_id = 0;
+	done = fr->done;
+	g_queue_init(&fr->done);
+	G_UNLOCK(filesdone);
+	g_cancellable_cancel(fr->cancellable);
+	/* the references on runcount that this run still holds: one for every file that was not
+	delivered, and one for findfiles() if it did not finish yet */
+	outstanding = fr->numfound - fr->numsearched;
 	if (s3run->findfiles) {
 		findfiles_cancel(s3run->findfiles);
+		s3run->findfiles=NULL;
+		outstanding++;
+	}
+	/* do not wait for the threads that are loading or searching a file, the files that are
+	still queued return immediately because cancelled is set, and the pool is freed after them */
+	if (fr->pool)
+		g_thread_pool_free(fr->pool, FALSE, FALSE);
+	fr->pool = NULL;
+	while ((rit = g_queue_pop_head(&done))) {
+		replaceinthread_free(rit);
 	}
-	queue_cancel(&s3run->threadqueue, queue_cancel_freefunc, NULL);
-	/* hmm but what if there are still idle callbacks registered ???
-	the s3run structure can only be free'd after the fw refcount
-	is 0 */
+	s3run->filesrun = NULL;
+	filesrun_unref(fr);
+	/* the callback is not called for a cancelled run, just like in snr3_cancel_run() */
+	g_atomic_int_add(&s3run->runcount, -outstanding);
 }
 
 void snr3_run_in_files(Tsnr3run *s3run) {
+	Tfilesrun *fr;
 	DEBUG_MSG("snr3_run_in_files, started for s3run=%p\n",s3run);
+	snr3_run_in_files_cancel(s3run);
 	g_atomic_int_set(&s3run->cancelled, 0);
-	queue_init_full(&s3run->threadqueue, 4, TRUE, TRUE, (QueueFunc)files_replace_run);
-	g_print("filepattern=%s\n",s3run->filepattern);
+	s3run->filesresults = 0;
+	fr = g_slice_new0(Tfilesrun);
+	fr->refcount = 2; /* one for the s3run, one for the findfiles() call */
+	fr->s3run = s3run;
+	fr->type = s3run->type;
+	fr->replaceall = s3run->replaceall;
+	if (s3run->regex)
+		fr->regex = g_regex_ref(s3run->regex);
+	fr->literal = snr3literal_ref(s3run->literal);
+	fr->multi = snr3multi_ref(s3run->multi);
+	fr->replace = g_strdup(s3run->type == snr3type_pcre ? s3run->replace : s3run->replacereal);
+	fr->encoding = g_strdup(s3run->bfwin->session->encoding);
+	fr->cancellable = g_cancellable_new();
+	fr->trigrams = files_trigram_queries(s3run);
+	/* not exclusive, so the threads are shared with other pools and kept between runs */
+	fr->pool = g_thread_pool_new(files_replace_run, fr, get_num_processors(), FALSE, NULL);
+	s3run->filesrun = fr;
+	DEBUG_MSG("filepattern=%s\n",s3run->filepattern);
 	g_atomic_int_set(&s3run->runcount, 1); /* start with one reference for the findfiles() call */
-	s3run->findfiles = findfiles(s3run->basedir, (s3run->recursion_level > 0), s3run->recursion_level, TRUE,s3run->filepattern, G_CALLBACK(filematch_cb), G_CALLBACK(finished_finding_files_cb), s3run);
+	s3run->findfiles = findfiles(s3run->basedir, (s3run->recursion_level > 0), s3run->recursion_level, TRUE,s3run->filepattern, G_CALLBACK(filematch_cb), G_CALLBACK(finished_finding_files_cb), fr);
+	if (!s3run->findfiles) {
+		filesrun_unref(fr);
+		snr3run_unrun(s3run);
+	}
 }
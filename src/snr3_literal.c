@@ -0,0 +1,287 @@
+/* Bluefish HTML Editor
+ * snr3_literal.c - literal string search for search and replace
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+the search engine for snr3type_string, used for the search in a document, in all documents
+and in files.
+
+a query of LITERAL_HORSPOOL_MIN_LEN bytes or more is searched with Boyer-Moore-Horspool: the
+byte under the last position of the query decides how far the query can shift, so only a
+fraction of the buffer is ever read. For a case insensitive search both the upper and
+lowercase variant of an ASCII byte get the same shift, and bytes are folded with ASCII_FOLD()
+before they are compared.
+
+shorter queries shift too little for Horspool to win, they are searched 8 bytes at a time:
+the first and the last byte of the query are compared against 8 positions with a few 64 bit
+operations (SWAR, "SIMD within a register", portable to every platform bluefish runs on),
+for a case insensitive query against both the upper and the lowercase variant. Only positions
+where both bytes match are compared completely. This runs at a few GB/s independent of the text.
+
+ASCII folding cannot find 'Ä' for 'ä'. For a case insensitive query with non-ASCII
+characters the longest ASCII run of the query (the anchor) is searched with the skip table,
+and every hit is verified character by character with g_unichar_tolower(), starting anchor_o
+characters before the hit. A query without any ASCII character is compared at every
+character. The match can have a different number of bytes than the query, so
+snr3literal_find() returns the length of the match.
+
+The Tsnr3literal is not changed after snr3literal_new(), so threads can share it. A thread
+that might outlive the search keeps its own reference with snr3literal_ref().
+*/
+
+/*#define DEBUG*/
+
+#include <string.h>
+#include "bluefish.h"
+#include "snr3_literal.h"
+
+#define ASCII_FOLD(c) ((guchar)((c) - 'A') < 26 ? (c) | 0x20 : (c))
+
+#define LITERAL_HORSPOOL_MIN_LEN 32	/* shorter queries use the SWAR search */
+
+#define SWAR_ONES G_GUINT64_CONSTANT(0x0101010101010101)
+#define SWAR_LOWS G_GUINT64_CONSTANT(0x7f7f7f7f7f7f7f7f)
+#define SWAR_HIGHS G_GUINT64_CONSTANT(0x8080808080808080)
+/* the high bit is set in every byte of v that is zero */
+#define SWAR_ZEROBYTES(v) (~((((v) & SWAR_LOWS) + SWAR_LOWS) | (v)) & SWAR_HIGHS)
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define SWAR_BYTE_SET(v, k) ((v) & (G_GUINT64_CONSTANT(0x80) << (8 * (k))))
+#else
+#define SWAR_BYTE_SET(v, k) ((v) & (G_GUINT64_CONSTANT(0x80) << (56 - 8 * (k))))
+#endif
+
+static void
+literal_build_skip(Tsnr3literal * lit)
+{
+	gsize i;
+	for (i = 0; i < 256; i++) {
+		lit->skip[i] = lit->len;
+	}
+	for (i = 0; i + 1 < lit->len; i++) {
+		lit->skip[lit->needle[i]] = lit->len - 1 - i;
+		if (!lit->is_case_sens)
+			lit->skip[g_ascii_toupper(lit->needle[i])] = lit->len - 1 - i;
+	}
+}
+
+Tsnr3literal *
+snr3literal_new(const gchar * query, gboolean is_case_sens)
+{
+	Tsnr3literal *lit;
+	const gchar *p, *anchor = NULL;
+	gsize i, anchorlen = 0;
+
+	if (!query || query[0] == '\0')
+		return NULL;
+	lit = g_slice_new0(Tsnr3literal);
+	lit->refcount = 1;
+	lit->is_case_sens = is_case_sens;
+	for (p = query; *p != '\0' && (guchar) * p < 128; p++);
+	if (is_case_sens || *p == '\0') {
+		lit->len = strlen(query);
+		lit->needle = (guchar *) g_strndup(query, lit->len);
+	} else {
+		glong run_o = 0, i_o = 0;
+		const gchar *run = query;
+		/* find the longest ASCII run as anchor */
+		lit->numchars = g_utf8_strlen(query, -1);
+		lit->chars = g_new(gunichar, lit->numchars);
+		for (p = query; *p != '\0'; p = g_utf8_next_char(p), i_o++) {
+			lit->chars[i_o] = g_unichar_tolower(g_utf8_get_char(p));
+			if ((guchar) * p >= 128) {
+				run = g_utf8_next_char(p);
+				run_o = i_o + 1;
+			} else if ((gsize) (p + 1 - run) > anchorlen) {
+				anchor = run;
+				anchorlen = p + 1 - run;
+				lit->anchor_o = run_o;
+			}
+		}
+		lit->len = anchorlen;
+		lit->needle = (guchar *) g_strndup(anchor ? anchor : "", anchorlen);
+	}
+	if (!is_case_sens) {
+		for (i = 0; i < lit->len; i++)
+			lit->needle[i] = ASCII_FOLD(lit->needle[i]);
+	}
+	literal_build_skip(lit);
+	DEBUG_MSG("snr3literal_new, query %s, needle %s with len %zd, numchars=%ld, anchor_o=%ld\n", query,
+			  lit->needle, lit->len, lit->numchars, lit->anchor_o);
+	return lit;
+}
+
+static inline gboolean
+literal_compare(const Tsnr3literal * lit, const guchar * h)
+{
+	gsize i;
+	if (lit->is_case_sens)
+		return (memcmp(h, lit->needle, lit->len) == 0);
+	for (i = 0; i < lit->len; i++) {
+		if (ASCII_FOLD(h[i]) != lit->needle[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static inline guint64
+swar_load(const guchar * p)
+{
+	guint64 v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static const guchar *
+literal_horspool(const Tsnr3literal * lit, const guchar * h, const guchar * end)
+{
+	const guchar *needle = lit->needle;
+	gsize last = lit->len - 1;
+
+	if (lit->is_case_sens) {
+		if (last == 0)
+			return memchr(h, needle[0], end - h);
+		while ((gsize) (end - h) > last) {
+			guchar c = h[last];
+			if (c == needle[last] && memcmp(h, needle, last) == 0)
+				return h;
+			h += lit->skip[c];
+		}
+	} else {
+		while ((gsize) (end - h) > last) {
+			guchar c = h[last];
+			if (ASCII_FOLD(c) == needle[last]) {
+				gsize i = 0;
+				while (i < last && ASCII_FOLD(h[i]) == needle[i])
+					i++;
+				if (i == last)
+					return h;
+			}
+			h += lit->skip[c];
+		}
+	}
+	return NULL;
+}
+
+static const guchar *
+literal_swar(const Tsnr3literal * lit, const guchar * h, const guchar * end)
+{
+	gsize last = lit->len - 1;
+	guint64 first_lo, first_up, last_lo, last_up;
+
+	first_lo = first_up = lit->needle[0] * SWAR_ONES;
+	last_lo = last_up = lit->needle[last] * SWAR_ONES;
+	if (!lit->is_case_sens) {
+		first_up = (guchar) g_ascii_toupper(lit->needle[0]) * SWAR_ONES;
+		last_up = (guchar) g_ascii_toupper(lit->needle[last]) * SWAR_ONES;
+	}
+	while ((gsize) (end - h) >= last + 8) {
+		guint64 vfirst = swar_load(h), vlast = swar_load(h + last), found;
+		found = (SWAR_ZEROBYTES(vfirst ^ first_lo) | SWAR_ZEROBYTES(vfirst ^ first_up))
+			& (SWAR_ZEROBYTES(vlast ^ last_lo) | SWAR_ZEROBYTES(vlast ^ last_up));
+		if (G_UNLIKELY(found)) {
+			gint k;
+			for (k = 0; k < 8; k++) {
+				if (SWAR_BYTE_SET(found, k) && literal_compare(lit, h + k))
+					return h + k;
+			}
+		}
+		h += 8;
+	}
+	/* the last bytes */
+	return literal_horspool(lit, h, end);
+}
+
+static inline const guchar *
+literal_search(const Tsnr3literal * lit, const guchar * h, const guchar * end)
+{
+	if (lit->len >= LITERAL_HORSPOOL_MIN_LEN)
+		return literal_horspool(lit, h, end);
+	return literal_swar(lit, h, end);
+}
+
+/* compares the query character by character at p, returns the end of the match or NULL */
+static const gchar *
+literal_match_chars(const Tsnr3literal * lit, const gchar * p, const gchar * end)
+{
+	glong i;
+	for (i = 0; i < lit->numchars; i++) {
+		if (p >= end || g_unichar_tolower(g_utf8_get_char(p)) != lit->chars[i])
+			return NULL;
+		p = g_utf8_next_char(p);
+	}
+	return p;
+}
+
+/* returns the first match between start and end (which is not the end of a match, so
+a search continues after the previous match with start=previous+matchlen), or NULL */
+const gchar *
+snr3literal_find(const Tsnr3literal * lit, const gchar * start, const gchar * end, gsize * matchlen)
+{
+	const gchar *p, *matchend;
+
+	if (!lit->chars) {
+		p = (const gchar *) literal_search(lit, (const guchar *) start, (const guchar *) end);
+		if (p)
+			*matchlen = lit->len;
+		return p;
+	}
+
+	if (lit->len == 0) {
+		/* the query has no ASCII characters to search for */
+		for (p = start; p < end; p = g_utf8_next_char(p)) {
+			if ((matchend = literal_match_chars(lit, p, end))) {
+				*matchlen = matchend - p;
+				return p;
+			}
+		}
+		return NULL;
+	}
+
+	p = start;
+	while ((p = (const gchar *) literal_search(lit, (const guchar *) p, (const guchar *) end))) {
+		const gchar *cand = p;
+		glong i;
+		for (i = 0; i < lit->anchor_o && cand > start; i++) {
+			cand = g_utf8_prev_char(cand);
+		}
+		if (i == lit->anchor_o && (matchend = literal_match_chars(lit, cand, end))) {
+			*matchlen = matchend - cand;
+			return cand;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+Tsnr3literal *
+snr3literal_ref(Tsnr3literal * lit)
+{
+	if (lit)
+		g_atomic_int_inc(&lit->refcount);
+	return lit;
+}
+
+void
+snr3literal_unref(Tsnr3literal * lit)
+{
+	if (!lit || !g_atomic_int_dec_and_test(&lit->refcount))
+		return;
+	g_free(lit->needle);
+	g_free(lit->chars);
+	g_slice_free(Tsnr3literal, lit);
+}
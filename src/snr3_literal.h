@@ -0,0 +1,44 @@
+/* Bluefish HTML Editor
+ * snr3_literal.h - literal string search for search and replace
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SNR3_LITERAL_H_
+#define __SNR3_LITERAL_H_
+
+#include <glib.h>
+
+typedef struct {
+	guchar *needle;				/* the part of the query that is searched with the skip table, ASCII
+								   lowercase for a case insensitive search */
+	gsize len;					/* the number of bytes in needle */
+	gsize skip[256];			/* the Horspool shift for every byte value */
+	gboolean is_case_sens;
+	/* only for a case insensitive query with non-ASCII characters, see snr3_literal.c */
+	gunichar *chars;			/* the query in lowercase characters, NULL for a byte search */
+	glong numchars;
+	glong anchor_o;				/* the number of characters in the query before needle */
+	gint refcount;
+} Tsnr3literal;
+
+Tsnr3literal *snr3literal_new(const gchar * query, gboolean is_case_sens);
+const gchar *snr3literal_find(const Tsnr3literal * lit, const gchar * start, const gchar * end,
+							  gsize * matchlen);
+Tsnr3literal *snr3literal_ref(Tsnr3literal * lit);
+void snr3literal_unref(Tsnr3literal * lit);
+
+#endif							/* __SNR3_LITERAL_H_ */
@@ -0,0 +1,276 @@
+/* Bluefish HTML Editor
+ * snr3_multi.c - search for a list of strings at once for search and replace
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+the search engine for snr3type_multi: the query is a list of strings, one per line, and every
+string in the list is searched in a single pass over the text.
+
+snr3multi_new() builds an Aho-Corasick automaton: a trie of all terms, in which every missing
+transition is filled with the transition of the longest suffix that is also in the trie. The
+automaton therefore never has to backtrack, every byte of the text costs one table lookup,
+independent of the number of terms. To keep the table small the bytes are mapped to classes,
+all bytes that do not occur in any term share class 0, and for a case insensitive search the
+upper and lowercase variant of an ASCII letter share a class. Characters outside ASCII are
+compared exactly, also for a case insensitive search.
+
+If several terms match, snr3multi_find() returns the match that starts first, and of the
+matches that start there the longest, so for terms 'foo' and 'foobar' the text 'foobar' is a
+single match for 'foobar'. Terms are complete UTF-8 sequences, so a match always starts and
+ends on a character boundary.
+
+Every result refers to the line of the query that matched, and for a replace the same line of
+the replace string is used, or the replace string itself if it has only one line. A replace string
+with another number of lines is refused by the dialog.
+
+The Tsnr3multi is not changed after snr3multi_new(), so the threads of a search in files
+share it, each run in files holds its own reference with snr3multi_ref().
+*/
+
+/*#define DEBUG*/
+
+#include <string.h>
+#include "bluefish.h"
+#include "snr3_multi.h"
+
+#define ASCII_FOLD(c) ((guchar)((c) - 'A') < 26 ? (c) | 0x20 : (c))
+
+static void
+multi_strip_cr(gchar ** lines)
+{
+	gint i;
+	for (i = 0; lines[i]; i++) {
+		gsize len = strlen(lines[i]);
+		if (len > 0 && lines[i][len - 1] == '\r')
+			lines[i][len - 1] = '\0';
+	}
+}
+
+static guint32
+multi_new_state(Tsnr3multi * multi, guint * allocated, guint32 depth)
+{
+	if (multi->numstates == *allocated) {
+		*allocated *= 2;
+		multi->next = g_renew(guint32, multi->next, *allocated * multi->numclasses);
+		multi->depth = g_renew(guint32, multi->depth, *allocated);
+		multi->term = g_renew(gint, multi->term, *allocated);
+	}
+	memset(multi->next + multi->numstates * multi->numclasses, 0, multi->numclasses * sizeof(guint32));
+	multi->depth[multi->numstates] = depth;
+	multi->term[multi->numstates] = -1;
+	return multi->numstates++;
+}
+
+/* fills the missing transitions and the match of every state, the states are visited
+breadth-first so the fail state of a state is always finished before the state itself */
+static void
+multi_build_transitions(Tsnr3multi * multi)
+{
+	guint32 *fail, *queue;
+	guint head = 0, tail = 0, c, nc = multi->numclasses;
+
+	fail = g_new0(guint32, multi->numstates);
+	queue = g_new(guint32, multi->numstates);
+	multi->match = g_new0(guint32, multi->numstates);
+	for (c = 0; c < nc; c++) {
+		guint32 t = multi->next[c];
+		if (t)
+			queue[tail++] = t;
+	}
+	while (head < tail) {
+		guint32 s = queue[head++];
+		multi->match[s] = (multi->term[s] >= 0) ? s : multi->match[fail[s]];
+		for (c = 0; c < nc; c++) {
+			guint32 t = multi->next[s * nc + c];
+			if (t) {
+				fail[t] = multi->next[fail[s] * nc + c];
+				queue[tail++] = t;
+			} else {
+				multi->next[s * nc + c] = multi->next[fail[s] * nc + c];
+			}
+		}
+	}
+	g_free(fail);
+	g_free(queue);
+}
+
+Tsnr3multi *
+snr3multi_new(const gchar * query, const gchar * replace, gboolean is_case_sens)
+{
+	Tsnr3multi *multi;
+	guint allocated = 64, i;
+	gboolean have_term = FALSE;
+
+	if (!query)
+		return NULL;
+	multi = g_slice_new0(Tsnr3multi);
+	multi->refcount = 1;
+	multi->is_case_sens = is_case_sens;
+	multi->terms = g_strsplit(query, "\n", -1);
+	multi_strip_cr(multi->terms);
+	multi->numterms = g_strv_length(multi->terms);
+
+	/* first the byte classes, the number of classes is the width of the transition table */
+	multi->numclasses = 1;
+	for (i = 0; i < multi->numterms; i++) {
+		const guchar *p;
+		for (p = (const guchar *) multi->terms[i]; *p != '\0'; p++) {
+			guchar b = is_case_sens ? *p : ASCII_FOLD(*p);
+			if (multi->classes[b] == 0) {
+				multi->classes[b] = multi->numclasses++;
+				if (!is_case_sens && b != *p)
+					multi->classes[*p] = multi->classes[b];
+				else if (!is_case_sens && g_ascii_islower(b))
+					multi->classes[g_ascii_toupper(b)] = multi->classes[b];
+			}
+			have_term = TRUE;
+		}
+	}
+	if (!have_term) {
+		snr3multi_unref(multi);
+		return NULL;
+	}
+
+	/* the trie, state 0 is the root */
+	multi->next = g_new(guint32, allocated * multi->numclasses);
+	multi->depth = g_new(guint32, allocated);
+	multi->term = g_new(gint, allocated);
+	multi_new_state(multi, &allocated, 0);
+	for (i = 0; i < multi->numterms; i++) {
+		const guchar *p;
+		guint32 state = 0;
+		if (multi->terms[i][0] == '\0')
+			continue;
+		for (p = (const guchar *) multi->terms[i]; *p != '\0'; p++) {
+			guint c = multi->classes[*p];
+			guint32 t = multi->next[state * multi->numclasses + c];
+			if (!t) {
+				t = multi_new_state(multi, &allocated, multi->depth[state] + 1);
+				multi->next[state * multi->numclasses + c] = t;
+			}
+			state = t;
+		}
+		/* a term that occurs twice keeps its first line */
+		if (multi->term[state] < 0)
+			multi->term[state] = i;
+	}
+	multi_build_transitions(multi);
+
+	if (replace) {
+		multi->replace = g_strsplit(replace, "\n", -1);
+		multi_strip_cr(multi->replace);
+		multi->numreplace = g_strv_length(multi->replace);
+	}
+	DEBUG_MSG("snr3multi_new, %d terms, %d states, %d byte classes\n", multi->numterms, multi->numstates,
+			  multi->numclasses);
+	return multi;
+}
+
+/* returns the first match between start and end, or NULL. matchlen is set to the number of bytes
+of the match and term to the line of the query that matched */
+const gchar *
+snr3multi_find(const Tsnr3multi * multi, const gchar * start, const gchar * end, gsize * matchlen,
+			   gint * term)
+{
+	const guchar *p = (const guchar *) start, *e = (const guchar *) end;
+	const guchar *beststart = NULL, *bestend = NULL;
+	const guint32 *next = multi->next;
+	guint nc = multi->numclasses;
+	guint32 state = 0;
+
+	while (p < e) {
+		guint32 m;
+		if (state == 0 && !beststart) {
+			/* skip the bytes that do not start any term */
+			while (p < e && next[multi->classes[*p]] == 0)
+				p++;
+			if (p == e)
+				break;
+		}
+		state = next[state * nc + multi->classes[*p]];
+		p++;
+		/* the current state cannot lead to a match that starts at or before the best match */
+		if (beststart && p - multi->depth[state] > beststart)
+			break;
+		m = multi->match[state];
+		if (m) {
+			const guchar *s = p - multi->depth[m];
+			if (!beststart || s < beststart || (s == beststart && p > bestend)) {
+				beststart = s;
+				bestend = p;
+				*term = multi->term[m];
+			}
+		}
+	}
+	if (!beststart)
+		return NULL;
+	*matchlen = bestend - beststart;
+	return (const gchar *) beststart;
+}
+
+const gchar *
+snr3multi_term(const Tsnr3multi * multi, gint term)
+{
+	if (term < 0 || (guint) term >= multi->numterms)
+		return NULL;
+	return multi->terms[term];
+}
+
+/* a replace string should have a single line, or a line for every term. Returns FALSE if the
+number of lines does not match, some terms would not have a replacement */
+gboolean
+snr3multi_replace_valid(const Tsnr3multi * multi)
+{
+	return (!multi->replace || multi->numreplace == 1 || multi->numreplace == multi->numterms);
+}
+
+/* returns the replacement for a result of term, or NULL if there is no replace string or no line
+for this term (see snr3multi_replace_valid()), the result should then be left unchanged */
+const gchar *
+snr3multi_replacement(const Tsnr3multi * multi, gint term)
+{
+	if (!multi->replace)
+		return NULL;
+	if (multi->numreplace == 1)
+		return multi->replace[0];
+	if (term >= 0 && (guint) term < multi->numreplace)
+		return multi->replace[term];
+	return NULL;
+}
+
+Tsnr3multi *
+snr3multi_ref(Tsnr3multi * multi)
+{
+	if (multi)
+		g_atomic_int_inc(&multi->refcount);
+	return multi;
+}
+
+void
+snr3multi_unref(Tsnr3multi * multi)
+{
+	if (!multi || !g_atomic_int_dec_and_test(&multi->refcount))
+		return;
+	g_free(multi->next);
+	g_free(multi->match);
+	g_free(multi->depth);
+	g_free(multi->term);
+	g_strfreev(multi->terms);
+	g_strfreev(multi->replace);
+	g_slice_free(Tsnr3multi, multi);
+}
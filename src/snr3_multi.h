@@ -0,0 +1,50 @@
+/* Bluefish HTML Editor
+ * snr3_multi.h - search for a list of strings at once for search and replace
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SNR3_MULTI_H_
+#define __SNR3_MULTI_H_
+
+#include <glib.h>
+
+typedef struct {
+	guint32 *next;				/* numstates * numclasses transitions, the automaton never fails */
+	guint32 *match;				/* for every state the state of the longest term that ends there, or 0 */
+	guint32 *depth;				/* for every state the number of bytes from the root */
+	gint *term;					/* for every state the term that ends exactly there, or -1 */
+	guint numstates;
+	guint numclasses;
+	guint16 classes[256];		/* the class of every byte, 0 for bytes that are not in any term */
+	gboolean is_case_sens;
+	gchar **terms;				/* the lines of the query, a result refers to a line in this array */
+	guint numterms;
+	gchar **replace;			/* the lines of the replace string, or NULL */
+	guint numreplace;
+	gint refcount;
+} Tsnr3multi;
+
+Tsnr3multi *snr3multi_new(const gchar * query, const gchar * replace, gboolean is_case_sens);
+const gchar *snr3multi_find(const Tsnr3multi * multi, const gchar * start, const gchar * end,
+							gsize * matchlen, gint * term);
+const gchar *snr3multi_term(const Tsnr3multi * multi, gint term);
+gboolean snr3multi_replace_valid(const Tsnr3multi * multi);
+const gchar *snr3multi_replacement(const Tsnr3multi * multi, gint term);
+Tsnr3multi *snr3multi_ref(Tsnr3multi * multi);
+void snr3multi_unref(Tsnr3multi * multi);
+
+#endif							/* __SNR3_MULTI_H_ */
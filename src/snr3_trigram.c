@@ -0,0 +1,918 @@
+/* Bluefish HTML Editor
+ * snr3_trigram.c - trigram index for search and replace in files
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+the trigram index tells a search in files which files of the project cannot contain a match,
+so they do not have to be loaded and searched.
+
+for every file under the basedir of the project (the same basedir as the symbol index) the
+index has a small bloom filter with all trigrams (three consecutive bytes) in the file. Only
+trigrams of three ASCII bytes are used, folded to lowercase, so the filter is valid for a
+case sensitive and a case insensitive search, and for every encoding in which ASCII
+characters are stored as ASCII bytes. A file that contains NUL bytes (such as UTF-16) is not
+indexed. The filter has TRIGRAM_BITS_PER_TRIGRAM bits for every trigram in the file (rounded
+up to a power of two), and every trigram sets two bits, so a trigram that is not in the file
+is reported as present in less than 5% of the cases. A query with more trigrams skips more.
+
+trigramquery_new() collects the trigrams that every match of the query must contain: for a
+string search all trigrams of the query, for a regex pattern the trigrams of the literal runs
+that are not optional, outside of groups, character classes and escapes. A pattern with an
+alternation at the top level has no required trigrams. If a search is case insensitive and
+uses unicode case folding, a literal 'k' might match KELVIN SIGN, 's' might match LATIN SMALL
+LETTER LONG S, and 'i' might match LATIN CAPITAL LETTER I WITH DOT ABOVE, so these letters
+are not used in trigrams.
+
+the search in files still walks the directories with findfiles(), and a file is only skipped
+if the index has an entry with the same path, modification time and size, and the filter does
+not have all trigrams of the query. A new or changed file is therefore always searched, a stale
+index only makes the search slower.
+
+the index is updated in a worker thread shortly after the project is opened and after a file
+is saved. Files with the same modification time and size as in the previous index (from disk)
+are not read, their filter is copied. Each update builds a complete new index, and the
+mainloop swaps it in, so the search needs no locking. The index is stored in
+~/.bluefish/cache/<md5 of the basedir>.trigramindex: a Ttri_header, the array of Ttri_file, the
+filters and the paths. The same memory layout is used after loading.
+*/
+
+/*#define DEBUG*/
+
+#include <string.h>
+#include <time.h>
+
+#include "bluefish.h"
+#include "bf_lib.h"
+#include "snr3_trigram.h"
+
+/*#define DBG_TRIGRAM g_print*/
+#define DBG_TRIGRAM(args...)
+
+#define TRIGRAMINDEX_MAGIC "BFTRIGRM"
+#define TRIGRAMINDEX_VERSION 1
+#define TRIGRAMINDEX_BYTEORDER 0x01020304
+
+#define TRIGRAM_BITS_PER_TRIGRAM 8
+#define TRIGRAM_MIN_LG 6			/* the smallest filter is 8 bytes */
+#define TRIGRAM_MAX_LG 22			/* the largest filter is 512 kilobytes */
+#define TRIGRAM_NUMKEYS (1 << 21)	/* three 7 bit characters */
+
+#define ASCII_FOLD(c) ((guchar)((c) - 'A') < 26 ? (c) | 0x20 : (c))
+#define TRIGRAM_KEY(a, b, c) (((guint32) ASCII_FOLD(a) << 14) | ((guint32) ASCII_FOLD(b) << 7) | (guint32) ASCII_FOLD(c))
+#define BIT_SET(bits, n) ((bits)[(n) >> 3] |= (1 << ((n) & 7)))
+#define BIT_CLEAR(bits, n) ((bits)[(n) >> 3] &= ~(1 << ((n) & 7)))
+#define BIT_TEST(bits, n) ((bits)[(n) >> 3] & (1 << ((n) & 7)))
+
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 byteorder;
+	guint32 numfiles;
+	guint32 stringslen;
+	guint64 bitslen;
+	guint64 built;				/* seconds since the epoch */
+} Ttri_header;
+
+typedef struct {
+	guint32 path;				/* string offset, the path relative to the basedir */
+	guint32 lg;					/* the filter has 1 << lg bits */
+	guint64 mtime;				/* in microseconds */
+	guint64 size;
+	guint64 bits_o;				/* the offset of the filter in the bits */
+} Ttri_file;
+
+typedef struct {
+	gint refcount;				/* atomic, the mainloop and the worker can hold a reference */
+	gchar *data;				/* the file contents, the following members point into data */
+	gsize len;
+	const Ttri_header *header;
+	const Ttri_file *files;
+	const guint8 *bits;
+	const gchar *strings;
+	GHashTable *paths;			/* path -> index + 1 in files */
+} Ttriindex;
+
+typedef struct {
+	gpointer bfwin;
+	GFile *basedir;
+	Ttriindex *index;			/* NULL until the previous index is loaded or the first update is finished */
+	gpointer job;				/* the running Ttrijob */
+	guint refresh_id;
+	gboolean rerun;				/* an update was requested while the job was running */
+} Ttrigramindex;
+
+typedef struct {
+	gint cancelled;				/* atomic, set from the mainloop, checked in the worker */
+	guint refcount;				/* only changed in the mainloop, and in the worker before the first idle callback */
+	Ttrigramindex *ti;			/* only accessed in the mainloop, and only if not cancelled */
+	GFile *basedir;
+	gchar *cachefile;
+	Ttriindex *old;				/* the index from disk */
+	/* the following members are only used by the worker, until the job is finished */
+	GArray *files;				/* Ttri_file */
+	GByteArray *bits;
+	GString *strings;
+	guint8 *seen;				/* TRIGRAM_NUMKEYS bits, all zero between files */
+	GArray *keys;				/* the trigrams of the current file */
+	guint numfiles;
+	guint numscanned;
+	Ttriindex *result;
+} Ttrijob;
+
+typedef struct {
+	GArray *keys;				/* the trigrams that every match contains */
+	GString *run;				/* only while the query is parsed */
+	gboolean unicode_fold;
+} Ttrigramquery;
+
+static inline guint
+trigram_hash1(guint32 key, guint lg)
+{
+	return (guint32) (key * 2654435761U) >> (32 - lg);
+}
+
+static inline guint
+trigram_hash2(guint32 key, guint lg)
+{
+	return (guint32) (key * 2246822519U + 3266489917U) >> (32 - lg);
+}
+
+/******************************** the index ********************************/
+
+static void
+triindex_unref(Ttriindex * idx)
+{
+	if (!idx || !g_atomic_int_dec_and_test(&idx->refcount))
+		return;
+	g_hash_table_destroy(idx->paths);
+	g_free(idx->data);
+	g_slice_free(Ttriindex, idx);
+}
+
+/* takes ownership of data, returns NULL (and frees data) if the data is not a valid index */
+static Ttriindex *
+triindex_from_data(gchar * data, gsize len)
+{
+	Ttriindex *idx;
+	const Ttri_header *header = (const Ttri_header *) data;
+	gsize files_o, bits_o, strings_o;
+	guint i;
+
+	if (len < sizeof(Ttri_header))
+		goto invalid;
+	files_o = sizeof(Ttri_header);
+	if (memcmp(header->magic, TRIGRAMINDEX_MAGIC, 8) != 0 || header->version != TRIGRAMINDEX_VERSION
+		|| header->byteorder != TRIGRAMINDEX_BYTEORDER || header->numfiles > len / sizeof(Ttri_file)
+		|| header->bitslen > len)
+		goto invalid;
+	bits_o = files_o + (gsize) header->numfiles * sizeof(Ttri_file);
+	strings_o = bits_o + header->bitslen;
+	if (strings_o + header->stringslen != len || header->stringslen == 0 || data[len - 1] != '\0')
+		goto invalid;
+	idx = g_slice_new0(Ttriindex);
+	idx->refcount = 1;
+	idx->data = data;
+	idx->len = len;
+	idx->header = header;
+	idx->files = (const Ttri_file *) (data + files_o);
+	idx->bits = (const guint8 *) (data + bits_o);
+	idx->strings = data + strings_o;
+	idx->paths = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < header->numfiles; i++) {
+		const Ttri_file *tf = &idx->files[i];
+		if (tf->path >= header->stringslen || tf->lg < TRIGRAM_MIN_LG || tf->lg > TRIGRAM_MAX_LG
+			|| tf->bits_o > header->bitslen || (1 << (tf->lg - 3)) > header->bitslen - tf->bits_o) {
+			triindex_unref(idx);
+			return NULL;
+		}
+		g_hash_table_insert(idx->paths, (gpointer) (idx->strings + tf->path), GUINT_TO_POINTER(i + 1));
+	}
+	return idx;
+  invalid:
+	g_free(data);
+	return NULL;
+}
+
+/******************************** the worker ********************************/
+
+/* collects the unique trigrams of buf in job->keys, returns FALSE if buf is not ASCII compatible */
+static gboolean
+trijob_collect(Ttrijob * job, const gchar * buf, gsize len)
+{
+	const guchar *p = (const guchar *) buf, *end = p + len;
+	guint32 key = 0;
+	guint valid = 0, i;
+
+	g_array_set_size(job->keys, 0);
+	if (memchr(buf, '\0', len))
+		return FALSE;
+	for (; p < end; p++) {
+		guchar c = *p;
+		if (c >= 128) {
+			valid = 0;
+			continue;
+		}
+		key = ((key << 7) | ASCII_FOLD(c)) & (TRIGRAM_NUMKEYS - 1);
+		if (++valid >= 3 && !BIT_TEST(job->seen, key)) {
+			BIT_SET(job->seen, key);
+			g_array_append_val(job->keys, key);
+		}
+	}
+	for (i = 0; i < job->keys->len; i++) {
+		BIT_CLEAR(job->seen, g_array_index(job->keys, guint32, i));
+	}
+	return TRUE;
+}
+
+static void
+trijob_index_file(Ttrijob * job, GFile * uri, GFileInfo * finfo, const gchar * relpath)
+{
+	Ttri_file tf;
+	gpointer oldfile;
+	gsize filterlen;
+
+	tf.size = g_file_info_get_size(finfo);
+	if (tf.size > TRIGRAMINDEX_MAX_FILESIZE)
+		return;
+	tf.mtime = g_file_info_get_attribute_uint64(finfo, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+		+ g_file_info_get_attribute_uint32(finfo, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	tf.bits_o = job->bits->len;
+	oldfile = job->old ? g_hash_table_lookup(job->old->paths, relpath) : NULL;
+	if (oldfile && job->old->files[GPOINTER_TO_UINT(oldfile) - 1].mtime == tf.mtime
+		&& job->old->files[GPOINTER_TO_UINT(oldfile) - 1].size == tf.size) {
+		const Ttri_file *otf = &job->old->files[GPOINTER_TO_UINT(oldfile) - 1];
+		tf.lg = otf->lg;
+		g_byte_array_append(job->bits, job->old->bits + otf->bits_o, 1 << (tf.lg - 3));
+	} else {
+		gchar *buf;
+		gsize buflen;
+		gboolean ascii_compatible;
+		guint i;
+		guint8 *filter;
+
+		if (!g_file_load_contents(uri, NULL, &buf, &buflen, NULL, NULL))
+			return;
+		ascii_compatible = trijob_collect(job, buf, buflen);
+		g_free(buf);
+		job->numscanned++;
+		if (!ascii_compatible)
+			return;
+		tf.lg = TRIGRAM_MIN_LG;
+		while (tf.lg < TRIGRAM_MAX_LG && (1U << tf.lg) < job->keys->len * TRIGRAM_BITS_PER_TRIGRAM)
+			tf.lg++;
+		filterlen = 1 << (tf.lg - 3);
+		g_byte_array_set_size(job->bits, tf.bits_o + filterlen);
+		filter = job->bits->data + tf.bits_o;
+		memset(filter, 0, filterlen);
+		for (i = 0; i < job->keys->len; i++) {
+			guint32 key = g_array_index(job->keys, guint32, i);
+			BIT_SET(filter, trigram_hash1(key, tf.lg));
+			BIT_SET(filter, trigram_hash2(key, tf.lg));
+		}
+	}
+	tf.path = job->strings->len;
+	g_string_append_len(job->strings, relpath, strlen(relpath) + 1);
+	g_array_append_val(job->files, tf);
+}
+
+static void
+trijob_walk(Ttrijob * job, GFile * dir, const gchar * relpath)
+{
+	GFileEnumerator *en;
+	GFileInfo *finfo;
+
+	en = g_file_enumerate_children(dir, "standard::name,standard::type,standard::size,standard::is-hidden,"
+								   "time::modified,time::modified-usec", G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+								   NULL, NULL);
+	if (!en)
+		return;
+	while ((finfo = g_file_enumerator_next_file(en, NULL, NULL))) {
+		const gchar *name = g_file_info_get_name(finfo);
+		GFileType type = g_file_info_get_file_type(finfo);
+		if (g_atomic_int_get(&job->cancelled) || job->numfiles >= TRIGRAMINDEX_MAX_FILES) {
+			g_object_unref(finfo);
+			break;
+		}
+		/* hidden files and directories, such as .git and .svn, are skipped, a search in
+		   these files is not narrowed */
+		if (!g_file_info_get_is_hidden(finfo) && name[0] != '.'
+			&& (type == G_FILE_TYPE_DIRECTORY || type == G_FILE_TYPE_REGULAR)) {
+			GFile *child = g_file_get_child(dir, name);
+			gchar *childpath = relpath ? g_strconcat(relpath, "/", name, NULL) : g_strdup(name);
+			if (type == G_FILE_TYPE_DIRECTORY) {
+				trijob_walk(job, child, childpath);
+			} else {
+				job->numfiles++;
+				trijob_index_file(job, child, finfo, childpath);
+			}
+			g_free(childpath);
+			g_object_unref(child);
+		}
+		g_object_unref(finfo);
+	}
+	g_file_enumerator_close(en, NULL, NULL);
+	g_object_unref(en);
+}
+
+static Ttriindex *
+trijob_result(Ttrijob * job)
+{
+	Ttri_header header;
+	GString *out;
+	gchar *dirname;
+	gsize len;
+	GError *gerror = NULL;
+
+	if (job->strings->len == 0)
+		g_string_append_c(job->strings, '\0');
+	memset(&header, 0, sizeof(Ttri_header));
+	memcpy(header.magic, TRIGRAMINDEX_MAGIC, 8);
+	header.version = TRIGRAMINDEX_VERSION;
+	header.byteorder = TRIGRAMINDEX_BYTEORDER;
+	header.numfiles = job->files->len;
+	header.stringslen = job->strings->len;
+	header.bitslen = job->bits->len;
+	header.built = time(NULL);
+	out = g_string_sized_new(sizeof(Ttri_header) + job->files->len * sizeof(Ttri_file) + job->bits->len
+							 + job->strings->len);
+	g_string_append_len(out, (gchar *) & header, sizeof(Ttri_header));
+	g_string_append_len(out, job->files->data, job->files->len * sizeof(Ttri_file));
+	g_string_append_len(out, (gchar *) job->bits->data, job->bits->len);
+	g_string_append_len(out, job->strings->str, job->strings->len);
+	dirname = g_path_get_dirname(job->cachefile);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+	if (!g_file_set_contents(job->cachefile, out->str, out->len, &gerror)) {
+		g_warning("failed to write trigram index %s: %s\n", job->cachefile, gerror->message);
+		g_error_free(gerror);
+	}
+	len = out->len;
+	return triindex_from_data(g_string_free(out, FALSE), len);
+}
+
+static gboolean trijob_loaded_lcb(gpointer data);
+static gboolean trijob_finished_lcb(gpointer data);
+
+static gpointer
+trijob_thread(gpointer data)
+{
+	Ttrijob *job = data;
+	gchar *olddata;
+	gsize oldlen;
+
+	if (g_file_get_contents(job->cachefile, &olddata, &oldlen, NULL)) {
+		job->old = triindex_from_data(olddata, oldlen);
+		if (job->old) {
+			/* the previous index is valid for every file that did not change, so the
+			   search can use it while the update runs */
+			job->refcount++;
+			g_idle_add(trijob_loaded_lcb, job);
+		}
+	}
+	job->files = g_array_new(FALSE, FALSE, sizeof(Ttri_file));
+	job->bits = g_byte_array_sized_new(1024 * 1024);
+	job->strings = g_string_sized_new(64 * 1024);
+	job->seen = g_malloc0(TRIGRAM_NUMKEYS / 8);
+	job->keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32), 4096);
+	trijob_walk(job, job->basedir, NULL);
+	if (!g_atomic_int_get(&job->cancelled)) {
+		job->result = trijob_result(job);
+		DBG_TRIGRAM("trijob_thread, %d files, %d scanned, %d bytes of filters\n", job->numfiles,
+					job->numscanned, job->bits->len);
+	}
+	g_array_free(job->files, TRUE);
+	g_byte_array_free(job->bits, TRUE);
+	g_string_free(job->strings, TRUE);
+	g_free(job->seen);
+	g_array_free(job->keys, TRUE);
+	g_idle_add(trijob_finished_lcb, job);
+	return NULL;
+}
+
+static void
+trijob_unref(Ttrijob * job)
+{
+	job->refcount--;
+	if (job->refcount > 0)
+		return;
+	triindex_unref(job->result);
+	triindex_unref(job->old);
+	g_free(job->cachefile);
+	g_object_unref(job->basedir);
+	g_slice_free(Ttrijob, job);
+}
+
+static void
+trijob_start(Ttrigramindex * ti)
+{
+	Ttrijob *job;
+	gchar *uri, *md5;
+	GError *gerror = NULL;
+
+	job = g_slice_new0(Ttrijob);
+	job->refcount = 1;
+	job->ti = ti;
+	job->basedir = g_object_ref(ti->basedir);
+	uri = g_file_get_uri(ti->basedir);
+	md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri, -1);
+	job->cachefile = g_strconcat(g_get_home_dir(), "/." PACKAGE "/cache/", md5, ".trigramindex", NULL);
+	g_free(md5);
+	g_free(uri);
+	ti->job = job;
+	g_thread_create(trijob_thread, job, FALSE, &gerror);
+	if (gerror) {
+		g_warning("failed to start trigram index thread: %s\n", gerror->message);
+		g_error_free(gerror);
+		ti->job = NULL;
+		trijob_unref(job);
+	}
+}
+
+/* runs in the mainloop */
+static gboolean
+trijob_loaded_lcb(gpointer data)
+{
+	Ttrijob *job = data;
+	if (!g_atomic_int_get(&job->cancelled) && !job->ti->index) {
+		g_atomic_int_inc(&job->old->refcount);
+		job->ti->index = job->old;
+	}
+	trijob_unref(job);
+	return FALSE;
+}
+
+/* runs in the mainloop */
+static gboolean
+trijob_finished_lcb(gpointer data)
+{
+	Ttrijob *job = data;
+	Ttrigramindex *ti = job->ti;
+
+	if (g_atomic_int_get(&job->cancelled)) {
+		trijob_unref(job);
+		return FALSE;
+	}
+	ti->job = NULL;
+	if (job->result) {
+		triindex_unref(ti->index);
+		ti->index = job->result;
+		job->result = NULL;
+	}
+	trijob_unref(job);
+	if (ti->rerun) {
+		ti->rerun = FALSE;
+		trigramindex_refresh(ti->bfwin);
+	}
+	return FALSE;
+}
+
+static gboolean
+trigramindex_refresh_lcb(gpointer data)
+{
+	Ttrigramindex *ti = data;
+	ti->refresh_id = 0;
+	if (ti->job) {
+		ti->rerun = TRUE;
+		return FALSE;
+	}
+	trijob_start(ti);
+	return FALSE;
+}
+
+/* the same basedir as the symbol index: the last directory that was set as basedir in the filebrowser */
+static GFile *
+trigramindex_project_basedir(Tbfwin * bfwin)
+{
+	const gchar *tmp;
+	if (!bfwin->project || !bfwin->session->recent_dirs)
+		return NULL;
+	tmp = (const gchar *) ((GList *) g_list_first(bfwin->session->recent_dirs))->data;
+	if (!tmp || !tmp[0])
+		return NULL;
+	return g_file_new_for_uri(strip_trailing_slash((gchar *) tmp));
+}
+
+/* (re)starts the index for the project of bfwin, the first update runs after TRIGRAMINDEX_REFRESH_SECONDS */
+void
+trigramindex_start(gpointer bfwin)
+{
+	Ttrigramindex *ti;
+	GFile *basedir;
+
+	trigramindex_stop(bfwin);
+	if (!main_v->props.trigram_index)
+		return;
+	basedir = trigramindex_project_basedir(BFWIN(bfwin));
+	if (!basedir)
+		return;
+	/* walking a remote project would take too long */
+	if (!g_file_is_native(basedir)) {
+		g_object_unref(basedir);
+		return;
+	}
+	ti = g_slice_new0(Ttrigramindex);
+	ti->bfwin = bfwin;
+	ti->basedir = basedir;
+	BFWIN(bfwin)->trigramindex = ti;
+	trigramindex_refresh(bfwin);
+}
+
+/* schedules an update, only the files with a different modification time or size are read again */
+void
+trigramindex_refresh(gpointer bfwin)
+{
+	Ttrigramindex *ti = BFWIN(bfwin)->trigramindex;
+	if (!ti || ti->refresh_id)
+		return;
+	ti->refresh_id = g_timeout_add_seconds(TRIGRAMINDEX_REFRESH_SECONDS, trigramindex_refresh_lcb, ti);
+}
+
+void
+trigramindex_stop(gpointer bfwin)
+{
+	Ttrigramindex *ti = BFWIN(bfwin)->trigramindex;
+	if (!ti)
+		return;
+	if (ti->refresh_id)
+		g_source_remove(ti->refresh_id);
+	/* the job is freed by trijob_finished_lcb() */
+	if (ti->job)
+		g_atomic_int_set(&((Ttrijob *) ti->job)->cancelled, 1);
+	triindex_unref(ti->index);
+	g_object_unref(ti->basedir);
+	g_slice_free(Ttrigramindex, ti);
+	BFWIN(bfwin)->trigramindex = NULL;
+}
+
+/* returns a newly allocated string with the size and the age of the index, or NULL if there is no index */
+gchar *
+trigramindex_status(gpointer bfwin)
+{
+	Ttrigramindex *ti = BFWIN(bfwin)->trigramindex;
+	gchar *sizestr, *retval;
+	glong minutes;
+
+	if (!ti)
+		return NULL;
+	if (!ti->index)
+		return g_strdup(_("Search index: building"));
+#if (GLIB_CHECK_VERSION(2,30,0))
+	sizestr = g_format_size(ti->index->len);
+#else
+	sizestr = g_format_size_for_display(ti->index->len);
+#endif
+	minutes = (time(NULL) - (glong) ti->index->header->built) / 60;
+	retval = g_strdup_printf(ngettext("Search index: %d files, %s, updated %ld minute ago%s",
+									  "Search index: %d files, %s, updated %ld minutes ago%s", minutes),
+							 ti->index->header->numfiles, sizestr, minutes,
+							 ti->job ? _(", updating") : "");
+	g_free(sizestr);
+	return retval;
+}
+
+/******************************** queries ********************************/
+
+static void
+trigramquery_flush(Ttrigramquery * tq)
+{
+	gsize i;
+	guint j;
+	const gchar *s = tq->run->str;
+	for (i = 0; i + 2 < tq->run->len; i++) {
+		guint32 key = TRIGRAM_KEY(s[i], s[i + 1], s[i + 2]);
+		for (j = 0; j < tq->keys->len && g_array_index(tq->keys, guint32, j) != key; j++);
+		if (j == tq->keys->len)
+			g_array_append_val(tq->keys, key);
+	}
+	g_string_truncate(tq->run, 0);
+}
+
+/* adds a character that every match contains at this position to the current run, returns
+FALSE (and ends the run) if the character cannot be used in a trigram */
+static gboolean
+trigramquery_append(Ttrigramquery * tq, guchar c)
+{
+	if (c >= 128 || (tq->unicode_fold && strchr("iIkKsS", c))) {
+		trigramquery_flush(tq);
+		return FALSE;
+	}
+	g_string_append_c(tq->run, c);
+	return TRUE;
+}
+
+/* p points to '[', returns the position after the closing ']' */
+static const gchar *
+regex_skip_class(const gchar * p)
+{
+	p++;
+	if (*p == '^')
+		p++;
+	if (*p == ']')
+		p++;
+	while (*p && *p != ']') {
+		if (*p == '\\' && p[1]) {
+			p += 2;
+		} else if (*p == '[' && p[1] == ':') {
+			const gchar *end = strstr(p, ":]");
+			if (!end)
+				return NULL;
+			p = end + 2;
+		} else {
+			p++;
+		}
+	}
+	return *p ? p + 1 : NULL;
+}
+
+/* p points to '(', returns the position after the matching ')' */
+static const gchar *
+regex_skip_group(const gchar * p)
+{
+	gint depth = 0;
+	while (*p) {
+		if (*p == '\\' && p[1]) {
+			p += 2;
+			continue;
+		}
+		if (*p == '[') {
+			p = regex_skip_class(p);
+			if (!p)
+				return NULL;
+			continue;
+		}
+		if (*p == '(') {
+			depth++;
+		} else if (*p == ')') {
+			depth--;
+			if (depth == 0)
+				return p + 1;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+/* p points to the alphanumeric character after a backslash, returns the position after
+the escape sequence and its arguments */
+static const gchar *
+regex_skip_escape(const gchar * p)
+{
+	gchar c = *p++;
+	switch (c) {
+	case 'x':
+	case 'o':
+	case 'N':
+	case 'p':
+	case 'P':
+	case 'g':
+	case 'k':
+		if (*p == '{' || ((c == 'g' || c == 'k') && (*p == '<' || *p == '\''))) {
+			p = strchr(p + 1, *p == '{' ? '}' : (*p == '<' ? '>' : '\''));
+			return p ? p + 1 : NULL;
+		}
+		if (c == 'x') {
+			if (g_ascii_isxdigit(*p))
+				p++;
+			if (g_ascii_isxdigit(*p))
+				p++;
+		} else if ((c == 'p' || c == 'P') && *p) {
+			p++;
+		} else if (c == 'g') {
+			if (*p == '-' || *p == '+')
+				p++;
+			while (g_ascii_isdigit(*p))
+				p++;
+		}
+		break;
+	case 'c':
+		if (*p)
+			p++;
+		break;
+	default:
+		/* a backreference or an octal character */
+		while (g_ascii_isdigit(c) && g_ascii_isdigit(*p))
+			p++;
+		break;
+	}
+	return p;
+}
+
+/* p points to '{', returns the position after the '}' of a quantifier and sets min, or NULL
+if this is not a quantifier but a literal '{' */
+static const gchar *
+regex_quantifier(const gchar * p, guint * min)
+{
+	p++;
+	if (!g_ascii_isdigit(*p))
+		return NULL;
+	*min = 0;
+	while (g_ascii_isdigit(*p)) {
+		*min = MIN(*min * 10 + (*p - '0'), 65536);
+		p++;
+	}
+	if (*p == ',') {
+		p++;
+		while (g_ascii_isdigit(*p))
+			p++;
+	}
+	return (*p == '}') ? p + 1 : NULL;
+}
+
+/* collects the runs of literal characters that every match of the pattern contains, returns
+FALSE if the pattern cannot be narrowed */
+static gboolean
+trigramquery_regex(Ttrigramquery * tq, const gchar * pattern)
+{
+	const gchar *p = pattern, *next;
+	gboolean lastlit = FALSE;	/* the last character of the run is a single atom that a quantifier applies to */
+	guint min;
+
+	/* quoting, comments and extended mode change the meaning of the characters */
+	if (strstr(pattern, "\\Q") || strstr(pattern, "(?#"))
+		return FALSE;
+	while (*p) {
+		switch (*p) {
+		case '\\':
+			if (p[1] == '\0')
+				return FALSE;
+			if (g_ascii_isalnum(p[1])) {
+				trigramquery_flush(tq);
+				lastlit = FALSE;
+				p = regex_skip_escape(p + 1);
+				if (!p)
+					return FALSE;
+			} else if ((guchar) p[1] >= 128) {
+				lastlit = trigramquery_append(tq, p[1]);
+				p = g_utf8_next_char(p + 1);
+			} else {
+				lastlit = trigramquery_append(tq, p[1]);
+				p += 2;
+			}
+			break;
+		case '.':
+		case '^':
+		case '$':
+			trigramquery_flush(tq);
+			lastlit = FALSE;
+			p++;
+			break;
+		case '[':
+			trigramquery_flush(tq);
+			lastlit = FALSE;
+			p = regex_skip_class(p);
+			if (!p)
+				return FALSE;
+			break;
+		case '(':
+			/* a group can be optional or contain alternatives, it is skipped */
+			if (p[1] == '?') {
+				for (next = p + 2; g_ascii_isalpha(*next) || *next == '-'; next++) {
+					if (*next == 'x')
+						return FALSE;
+				}
+			}
+			trigramquery_flush(tq);
+			lastlit = FALSE;
+			p = regex_skip_group(p);
+			if (!p)
+				return FALSE;
+			break;
+		case ')':
+		case '|':
+			return FALSE;
+		case '*':
+		case '?':
+			/* the previous character is optional */
+			if (lastlit)
+				g_string_truncate(tq->run, tq->run->len - 1);
+			trigramquery_flush(tq);
+			lastlit = FALSE;
+			p++;
+			break;
+		case '+':
+			/* the previous character is required, but it may be repeated */
+			trigramquery_flush(tq);
+			lastlit = FALSE;
+			p++;
+			break;
+		case '{':
+			next = regex_quantifier(p, &min);
+			if (next) {
+				if (lastlit && min == 0)
+					g_string_truncate(tq->run, tq->run->len - 1);
+				trigramquery_flush(tq);
+				lastlit = FALSE;
+				p = next;
+			} else {
+				lastlit = trigramquery_append(tq, *p);
+				p++;
+			}
+			break;
+		default:
+			lastlit = trigramquery_append(tq, *p);
+			p = g_utf8_next_char(p);
+			break;
+		}
+	}
+	trigramquery_flush(tq);
+	return TRUE;
+}
+
+/* returns the trigrams that every match of query contains, or NULL if there are none. query
+is used exactly like the search in files uses it */
+gpointer
+trigramquery_new(const gchar * query, gboolean is_regex, gboolean is_case_sens)
+{
+	Ttrigramquery *tq;
+	const gchar *p;
+	gboolean usable = TRUE;
+
+	if (!query)
+		return NULL;
+	tq = g_slice_new0(Ttrigramquery);
+	tq->keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+	tq->run = g_string_new(NULL);
+	if (is_regex) {
+		/* an inline option might switch on case insensitive matching */
+		tq->unicode_fold = (!is_case_sens || strstr(query, "(?") != NULL);
+		usable = trigramquery_regex(tq, query);
+	} else {
+		/* the literal search folds non-ASCII queries with g_unichar_tolower(), see snr3_literal.c */
+		for (p = query; *p != '\0' && (guchar) * p < 128; p++);
+		tq->unicode_fold = (!is_case_sens && *p != '\0');
+		for (p = query; *p != '\0'; p++) {
+			trigramquery_append(tq, *p);
+		}
+		trigramquery_flush(tq);
+	}
+	g_string_free(tq->run, TRUE);
+	tq->run = NULL;
+	if (!usable || tq->keys->len == 0) {
+		trigramquery_free(tq);
+		return NULL;
+	}
+	DBG_TRIGRAM("trigramquery_new, %d trigrams for %s\n", tq->keys->len, query);
+	return tq;
+}
+
+/* returns TRUE if the index shows that uri cannot contain a match */
+gboolean
+trigramquery_skip_file(gpointer bfwin, gpointer query, GFile * uri, GFileInfo * finfo)
+{
+	Ttrigramindex *ti = BFWIN(bfwin)->trigramindex;
+	Ttrigramquery *tq = query;
+	const Ttri_file *tf;
+	gpointer file;
+	gchar *relpath;
+	guint64 mtime;
+	guint i;
+
+	if (!tq || !ti || !ti->index)
+		return FALSE;
+	relpath = g_file_get_relative_path(ti->basedir, uri);
+	if (!relpath)
+		return FALSE;
+	file = g_hash_table_lookup(ti->index->paths, relpath);
+	g_free(relpath);
+	if (!file)
+		return FALSE;
+	tf = &ti->index->files[GPOINTER_TO_UINT(file) - 1];
+	mtime = g_file_info_get_attribute_uint64(finfo, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+		+ g_file_info_get_attribute_uint32(finfo, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	if (tf->mtime != mtime || tf->size != (guint64) g_file_info_get_size(finfo))
+		return FALSE;
+	for (i = 0; i < tq->keys->len; i++) {
+		guint32 key = g_array_index(tq->keys, guint32, i);
+		const guint8 *filter = ti->index->bits + tf->bits_o;
+		if (!BIT_TEST(filter, trigram_hash1(key, tf->lg)) || !BIT_TEST(filter, trigram_hash2(key, tf->lg)))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+void
+trigramquery_free(gpointer query)
+{
+	Ttrigramquery *tq = query;
+	if (!tq)
+		return;
+	g_array_free(tq->keys, TRUE);
+	if (tq->run)
+		g_string_free(tq->run, TRUE);
+	g_slice_free(Ttrigramquery, tq);
+}
@@ -0,0 +1,38 @@
+/* Bluefish HTML Editor
+ * snr3_trigram.h - trigram index for search and replace in files
+ *
+ * Copyright (C) 2026 The Bluefish Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SNR3_TRIGRAM_H_
+#define __SNR3_TRIGRAM_H_
+
+#include <gio/gio.h>
+
+#define TRIGRAMINDEX_REFRESH_SECONDS 10	/* the delay before an update after the project is opened or a file is saved */
+#define TRIGRAMINDEX_MAX_FILESIZE (4 * 1024 * 1024)	/* larger files are not indexed */
+#define TRIGRAMINDEX_MAX_FILES 200000	/* the indexer stops walking the project after this number of files */
+
+void trigramindex_start(gpointer bfwin);
+void trigramindex_refresh(gpointer bfwin);
+void trigramindex_stop(gpointer bfwin);
+gchar *trigramindex_status(gpointer bfwin);
+
+gpointer trigramquery_new(const gchar * query, gboolean is_regex, gboolean is_case_sens);
+gboolean trigramquery_skip_file(gpointer bfwin, gpointer tq, GFile * uri, GFileInfo * finfo);
+void trigramquery_free(gpointer tq);
+
+#endif							/* __SNR3_TRIGRAM_H_ */